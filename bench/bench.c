@@ -0,0 +1,415 @@
+#include "../shared/protocol.h"
+#include "../server/server.h"
+#include "../server/quiz.h"
+#include "../server/logger.h"
+#include <time.h>
+#include <sys/sem.h>
+
+/*
+ * Microbenchmark dei percorsi caldi del server
+ * - protocollo: formattazione, parsing e invio/ricezione su socketpair
+ * - quiz: verifica delle risposte, validazione del nickname, caricamento dei quiz
+ * - classifica: get_leaderboard con 20, 1000 e 100000 giocatori in classifica
+ *
+ * I risultati sono scritti in JSON (una voce per riga) e confrontati con una baseline:
+ * un benchmark più lento della baseline oltre la soglia è una regressione (uscita con stato 1).
+ * I tempi assoluti variano troppo tra un'esecuzione e l'altra: il confronto usa il rapporto con un benchmark di riferimento (BENCH_REFERENCE, lavoro fisso che
+ * non dipende dal codice del server) misurato a coppie con ogni benchmark: la velocità della
+ * macchina, la frequenza della CPU e il carico di fondo rallentano allo stesso modo i due
+ * membri della coppia e si elidono, e solo un cambiamento del codice misurato sposta il rapporto.
+ * La memoria condivisa è allocata nel processo e il semaforo è privato (IPC_PRIVATE),
+ * quindi il benchmark può girare accanto a un server attivo.
+ */
+
+#define BENCH_MIN_TIME_NS 50000000ULL  // Durata minima di una misura (50 ms)
+#define BENCH_RUNS 7                   // Coppie di misure per benchmark a ogni giro della suite
+#define BENCH_DEFAULT_THRESHOLD 50.0   // Regressione: rapporto con il riferimento oltre questa percentuale
+#define BENCH_MAX 32
+#define BENCH_MAX_ROUNDS 9             // Giri dell'intera suite (-r): la mediana dei rapporti li usa tutti
+#define BENCH_REFERENCE "reference/fnv1a_4k" // Denominatore dei rapporti confrontati con la baseline
+#define BENCH_REFERENCE_BYTES 4096
+
+typedef struct {
+    const char* name;
+    void (*setup)(void);
+    void (*run)(long iterations);
+} Benchmark;
+
+typedef struct {
+    const char* name;
+    long iterations;
+    double ns_per_op;
+    double ratio;       // Rapporto con il riferimento misurato nella stessa coppia (mediana)
+} BenchResult;
+
+static volatile long bench_sink; // Impedisce al compilatore di eliminare il lavoro misurato
+static const char* quiz_file = "src/AGG.txt";
+
+// --- Riferimento ---
+
+static unsigned char reference_data[BENCH_REFERENCE_BYTES];
+
+static void setup_reference(void) {
+    for (int i = 0; i < BENCH_REFERENCE_BYTES; i++) {
+        reference_data[i] = (unsigned char)(i * 31 + 7);
+    }
+}
+
+// Hash FNV-1a di un buffer in cache: solo CPU e L1, come i percorsi caldi misurati
+static void run_reference(long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        uint32_t hash = 2166136261u;
+        for (int j = 0; j < BENCH_REFERENCE_BYTES; j++) {
+            hash = (hash ^ reference_data[j]) * 16777619u;
+        }
+        bench_sink += hash;
+    }
+}
+
+// --- Protocollo ---
+
+static char sample_question[] = "In quale film del trio le colonne sonore sono tutte composte da Daniele Bersani?";
+static int socket_pair[2] = {-1, -1};
+
+static void run_format_msg(long iterations) {
+    char buffer[MAX_MSG_LEN];
+    for (long i = 0; i < iterations; i++) {
+        bench_sink += format_msg(buffer, sizeof(buffer), MSG_QUESTION, sample_question);
+    }
+}
+
+static void run_parse_msg(long iterations) {
+    char frame[MAX_MSG_LEN], line[MAX_MSG_LEN], type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+    int len = format_msg(frame, sizeof(frame), MSG_QUESTION, sample_question) - 1; // senza '\n'
+    for (long i = 0; i < iterations; i++) {
+        memcpy(line, frame, len);
+        line[len] = '\0';
+        bench_sink += parse_msg(line, type, data);
+    }
+}
+
+static void setup_socketpair(void) {
+    if (socket_pair[0] < 0 && socketpair(AF_UNIX, SOCK_STREAM, 0, socket_pair) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+}
+
+static void run_send_recv_msg(long iterations) {
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+    for (long i = 0; i < iterations; i++) {
+        send_msg(socket_pair[0], MSG_QUESTION, sample_question);
+        bench_sink += recv_msg(socket_pair[1], type, data);
+    }
+}
+
+// --- Quiz ---
+
+static Question sample = {
+    "In quale città è ambientato il film \"Così è la vita\"?",
+    "Milano"
+};
+
+static void run_check_answer_correct(long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        bench_sink += check_answer(&sample, "  milano ");
+    }
+}
+
+static void run_check_answer_wrong(long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        bench_sink += check_answer(&sample, "Torino");
+    }
+}
+
+static void run_valid_nickname(long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        bench_sink += valid_nickname("giocatore_numero_42");
+    }
+}
+
+static void run_load_quiz(long iterations) {
+    Quiz quiz;
+    for (long i = 0; i < iterations; i++) {
+        bench_sink += load_quiz((char*)quiz_file, &quiz);
+    }
+}
+
+// --- Classifica ---
+
+/**
+ * Riempie la classifica globale con players voci e punteggi pseudo-casuali sul tema 1
+ * @param players Numero di voci
+ */
+static void fill_board(int players) {
+    unsigned seed = 12345;
+
+    // Classifica vuota: board_rebuild azzera anche l'indice e le prime voci dei temi
+    lock_shared_state();
+    shared_state->board_count = 0;
+    board_rebuild();
+    for (int i = 0; i < players && i < MAX_BOARD_ENTRIES; i++) {
+        char nickname[MAX_NICKNAME_LEN];
+        seed = seed * 1103515245 + 12345;
+        snprintf(nickname, sizeof(nickname), "giocatore%d", i);
+        board_update(1, nickname, (seed >> 16) % (QUIZ_QUESTIONS + 1), (seed >> 8) & 1);
+    }
+    unlock_shared_state();
+}
+
+static void setup_board_20(void) { fill_board(20); }
+static void setup_board_1k(void) { fill_board(1000); }
+static void setup_board_100k(void) { fill_board(100000); }
+
+static void run_get_leaderboard(long iterations) {
+    char leaderboard[MAX_MSG_LEN];
+    for (long i = 0; i < iterations; i++) {
+        get_leaderboard(1, leaderboard);
+        bench_sink += leaderboard[1];
+    }
+}
+
+static const Benchmark reference = { BENCH_REFERENCE, setup_reference, run_reference };
+
+static const Benchmark benchmarks[] = {
+    { "protocol/format_msg",        NULL,             run_format_msg },
+    { "protocol/parse_msg",         NULL,             run_parse_msg },
+    { "protocol/send_recv_msg",     setup_socketpair, run_send_recv_msg },
+    { "protocol/valid_nickname",    NULL,             run_valid_nickname },
+    { "quiz/check_answer_correct",  NULL,             run_check_answer_correct },
+    { "quiz/check_answer_wrong",    NULL,             run_check_answer_wrong },
+    { "quiz/load_quiz",             NULL,             run_load_quiz },
+    { "leaderboard/get_20",         setup_board_20,   run_get_leaderboard },
+    { "leaderboard/get_1k",         setup_board_1k,   run_get_leaderboard },
+    { "leaderboard/get_100k",       setup_board_100k, run_get_leaderboard },
+};
+#define BENCHMARK_COUNT ((int)(sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+/**
+ * Calibra le iterazioni di un benchmark perché una misura duri almeno BENCH_MIN_TIME_NS
+ */
+static long calibrate(const Benchmark* bench) {
+    long iterations = 1;
+    while (1) {
+        uint64_t start = clock_now_ns();
+        bench->run(iterations);
+        if (clock_now_ns() - start >= BENCH_MIN_TIME_NS) {
+            return iterations;
+        }
+        iterations *= 2;
+    }
+}
+
+static uint64_t timed_run(const Benchmark* bench, long iterations) {
+    uint64_t start = clock_now_ns();
+    bench->run(iterations);
+    return clock_now_ns() - start;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/**
+ * Misura un benchmark per un giro della suite: ripete BENCH_RUNS volte la coppia riferimento +
+ * benchmark. Il tempo riportato è il migliore di tutti i giri: il rumore (interruzioni, altri
+ * processi) può solo rallentare una misura, quindi il minimo è la stima più stabile. I rapporti
+ * delle coppie, i cui membri subiscono lo stesso carico, vanno in ratios: la loro mediana su tutti
+ * i giri è il valore confrontato con la baseline
+ *
+ * @param bench Il benchmark
+ * @param reference_iterations Le iterazioni calibrate del riferimento
+ * @param result Il risultato, calibrato al primo giro (iterations 0)
+ * @param ratios Output: BENCH_RUNS rapporti
+ */
+static void measure(const Benchmark* bench, long reference_iterations, BenchResult* result, double* ratios) {
+    if (bench->setup) {
+        bench->setup();
+    }
+    if (result->iterations == 0) {
+        result->name = bench->name;
+        result->iterations = calibrate(bench);
+    }
+
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        double reference_ns = (double)timed_run(&reference, reference_iterations) / reference_iterations;
+        double ns_per_op = (double)timed_run(bench, result->iterations) / result->iterations;
+        if (result->ns_per_op == 0.0 || ns_per_op < result->ns_per_op) {
+            result->ns_per_op = ns_per_op;
+        }
+        ratios[r] = ns_per_op / reference_ns;
+    }
+}
+
+static int write_results(const char* path, const BenchResult* results, int count) {
+    FILE* out = path ? fopen(path, "w") : stdout;
+    if (!out) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(out, "{\n  \"max_board_entries\": %d,\n  \"benchmarks\": [\n", MAX_BOARD_ENTRIES);
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "    {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f, \"ratio\": %.4f}%s\n",
+                results[i].name, results[i].iterations, results[i].ns_per_op, results[i].ratio,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (path) {
+        fclose(out);
+    }
+    return 0;
+}
+
+/**
+ * Legge una baseline scritta da write_results (una voce per riga): nome e rapporto con il riferimento
+ * @return Numero di voci lette, -1 se il file non esiste
+ */
+static int read_baseline(const char* path, char names[][64], double* values, int max) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        return -1;
+    }
+
+    char line[256];
+    int count = 0;
+    while (count < max && fgets(line, sizeof(line), in)) {
+        char* name = strstr(line, "\"name\": \"");
+        char* ratio = strstr(line, "\"ratio\": ");
+        if (!name || !ratio) {
+            continue;
+        }
+        name += strlen("\"name\": \"");
+        char* end = strchr(name, '"');
+        if (!end || end - name >= 64) {
+            continue;
+        }
+        memcpy(names[count], name, end - name);
+        names[count][end - name] = '\0';
+        values[count] = atof(ratio + strlen("\"ratio\": "));
+        count++;
+    }
+    fclose(in);
+    return count;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [-o risultati.json] [-b baseline.json] [-t soglia%%] [-r giri] [-f filtro] [-q file_quiz]\n", prog);
+    fprintf(stderr, "  -o  scrive i risultati in JSON (default stdout)\n");
+    fprintf(stderr, "  -b  confronta con la baseline: uscita 1 se un benchmark regredisce oltre la soglia\n");
+    fprintf(stderr, "  -t  soglia di regressione in percentuale (default %.0f)\n", BENCH_DEFAULT_THRESHOLD);
+    fprintf(stderr, "  -r  giri dell'intera suite, al più %d (default 1)\n", BENCH_MAX_ROUNDS);
+    fprintf(stderr, "  -f  esegue solo i benchmark il cui nome contiene il filtro\n");
+    fprintf(stderr, "  -q  file del quiz per load_quiz (default %s)\n", quiz_file);
+}
+
+int main(int argc, char* argv[]) {
+    const char* output = NULL;
+    const char* baseline = NULL;
+    const char* filter = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    int rounds = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:b:t:f:q:r:")) != -1) {
+        switch (opt) {
+            case 'r': rounds = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 't': threshold = atof(optarg); break;
+            case 'f': filter = optarg; break;
+            case 'q': quiz_file = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (rounds < 1 || rounds > BENCH_MAX_ROUNDS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Stato condiviso locale al processo e semaforo privato: nessuna interferenza con un server attivo
+    set_log_level(LOG_ERROR);
+    shared_state = calloc(1, sizeof(ServerState));
+    sem_id = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+    if (!shared_state || sem_id < 0 || semctl(sem_id, 0, SETVAL, 1) < 0) {
+        perror("Inizializzazione benchmark");
+        return 1;
+    }
+
+    // Il riferimento è misurato come gli altri (results[0]), con rapporto ~1
+    const Benchmark* selected[BENCH_MAX];
+    int count = 0;
+    selected[count++] = &reference;
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        if (!filter || strstr(benchmarks[i].name, filter)) {
+            selected[count++] = &benchmarks[i];
+        }
+    }
+
+    // Giri dell'intera suite: un rallentamento di qualche secondo non pesa su un solo benchmark
+    static BenchResult results[BENCH_MAX];
+    static double ratios[BENCH_MAX][BENCH_MAX_ROUNDS * BENCH_RUNS];
+    setup_reference();
+    long reference_iterations = calibrate(&reference);
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < count; i++) {
+            measure(selected[i], reference_iterations, &results[i], ratios[i] + round * BENCH_RUNS);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        qsort(ratios[i], rounds * BENCH_RUNS, sizeof(ratios[i][0]), compare_double);
+        results[i].ratio = ratios[i][rounds * BENCH_RUNS / 2];
+        fprintf(stderr, "%-28s %12.1f ns/op (%ld iterazioni), rapporto %.4f\n",
+                results[i].name, results[i].ns_per_op, results[i].iterations, results[i].ratio);
+    }
+
+    semctl(sem_id, 0, IPC_RMID);
+    free(shared_state);
+
+    if (write_results(output, results, count) < 0) {
+        return 1;
+    }
+
+    if (!baseline) {
+        return 0;
+    }
+
+    char names[BENCH_MAX][64];
+    double values[BENCH_MAX];
+    int baseline_count = read_baseline(baseline, names, values, BENCH_MAX);
+    if (baseline_count < 0) {
+        fprintf(stderr, "Baseline %s non trovata: nessun confronto\n", baseline);
+        return 0;
+    }
+    if (baseline_count == 0) {
+        fprintf(stderr, "Baseline %s senza rapporti con il riferimento: rigenerarla (make bench-baseline)\n", baseline);
+        return 0;
+    }
+
+    // results[0] è il riferimento stesso (rapporto ~1)
+    int regressions = 0;
+    fprintf(stderr, "\n%-28s %12s %12s %8s\n", "benchmark", "rapporto", "baseline", "delta");
+    for (int i = 1; i < count; i++) {
+        for (int j = 0; j < baseline_count; j++) {
+            if (strcmp(results[i].name, names[j]) != 0 || values[j] <= 0) {
+                continue;
+            }
+            double delta = (results[i].ratio / values[j] - 1.0) * 100.0;
+            int regressed = delta > threshold;
+            regressions += regressed;
+            fprintf(stderr, "%-28s %12.4f %12.4f %+7.1f%%%s\n", results[i].name,
+                    results[i].ratio, values[j], delta, regressed ? "  REGRESSIONE" : "");
+        }
+    }
+
+    if (regressions > 0) {
+        fprintf(stderr, "\n%d benchmark oltre la soglia del %.0f%%\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
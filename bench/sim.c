@@ -0,0 +1,464 @@
+#define _GNU_SOURCE // nftw
+#include "../shared/protocol.h"
+#include "../shared/transport.h"
+#include "../server/server.h"
+#include "../server/quiz.h"
+#include "../server/logger.h"
+#include "../server/persist.h"
+#include "../server/profiles.h"
+#include "../server/metrics.h"
+#include "../server/timer.h"
+#include <ucontext.h>
+#include <ftw.h>
+#include <limits.h>
+#include <sys/sem.h>
+
+/*
+ * Simulazione deterministica del server in un solo processo
+ * Ogni sessione è una coppia di coroutine (ucontext) collegate da un loopback in memoria:
+ * - il lato server esegue handle_client(), lo stesso codice dei processi figli del server
+ * - il lato client esegue uno script di gioco: registrazione, eventuale richiesta delle
+ *   classifiche, un quiz con risposte scelte da un generatore con seme fisso, uscita
+ * Quando un loopback non può avanzare la coroutine cede il controllo allo scheduler,
+ * che le riprende a turno: a parità di seme l'esecuzione e la classifica finale sono identiche.
+ * Il tempo è virtuale: i client simulati riflettono prima di rispondere e, quando nessuna
+ * coroutine può avanzare, l'orologio salta al prossimo risveglio o alla prossima scadenza
+ * dei timer delle sessioni (una sola ruota per tutte le sessioni del processo).
+ *
+ * Persistenza e profili lavorano in una directory temporanea, rimossa alla fine;
+ * la memoria condivisa è allocata nel processo e il semaforo è privato (IPC_PRIVATE).
+ */
+
+#define SIM_STACK_SIZE (256 * 1024)
+#define SIM_DEFAULT_SESSIONS 5000
+#define SIM_DEFAULT_SEED 1
+#define SIM_DEFAULT_CONCURRENCY 20  // La capienza del server reale; -c arriva fino a MAX_CLIENTS (SIM_FLAGS)
+#define SIM_CORRECT_PERCENT 70      // Probabilità di una risposta corretta
+#define SIM_SCORE_PERCENT 25        // Probabilità di chiedere le classifiche prima del quiz
+#define SIM_IDLE_PASSES 3           // Giri dello scheduler senza progressi: stallo
+#define SIM_THINK_MAX_MS 22000      // Tempo di riflessione massimo (oltre QUESTION_TIME_SEC: risposta in ritardo)
+
+typedef struct {
+    ucontext_t context;
+    char* stack;
+    int running;
+} Coroutine;
+
+// Una sessione simulata: le due coroutine e lo stato dello script del client
+typedef struct {
+    Coroutine server;
+    Coroutine client;
+    int handles[2];         // [0] lato server, [1] lato client
+    int id;                 // Numero progressivo della sessione
+    unsigned int rng;       // Stato del generatore del client (rand_r)
+    int in_use;
+    int failed;
+    uint64_t wake_ms;       // Fine della riflessione del client, 0 se non sta riflettendo
+    int server_ready;       // Il lato server può avanzare: il client ha agito o l'orologio è avanzato
+    int client_ready;       // Il lato client può avanzare: il server ha agito
+} SimSlot;
+
+static ucontext_t scheduler;
+static Coroutine* current = NULL;
+static SimSlot* server_slot = NULL; // Sessione della coroutine server in esecuzione
+static Quiz quizzes[MAX_THEMES];    // Risposte note al client simulato
+
+static unsigned long messages = 0;  // Messaggi scambiati (contati dal lato client)
+static unsigned long progress = 0;  // Incrementato a ogni messaggio o sessione conclusa
+static int failures = 0;
+static uint64_t virtual_ms = 0;     // Orologio virtuale (timer delle sessioni e riflessione dei client)
+static unsigned long timeouts = 0;  // Domande scadute prima della risposta
+
+static uint64_t sim_clock(void) {
+    return virtual_ms;
+}
+
+// Chiamata dal trasporto quando un loopback deve attendere: torna allo scheduler
+static void sim_wait(int handle) {
+    (void)handle;
+    swapcontext(&current->context, &scheduler);
+}
+
+// Fine della sessione lato server (al posto di exit(0)): la coroutine non viene più ripresa
+static void sim_session_exit(void) {
+    current->running = 0;
+    progress++;
+    setcontext(&scheduler);
+}
+
+static void server_main(void) {
+    handle_client(server_slot->handles[0]);
+}
+
+static int client_send(SimSlot* slot, const char* type, const char* data) {
+    if (send_msg(slot->handles[1], type, (char*)data) < 0) {
+        return -1;
+    }
+    messages++;
+    progress++;
+    return 0;
+}
+
+static int client_expect(SimSlot* slot, const char* expected, char* data) {
+    char type[MAX_TYPE_LEN];
+    if (recv_msg(slot->handles[1], type, data) < 0) {
+        return -1;
+    }
+    messages++;
+    progress++;
+    return strcmp(type, expected) == 0 ? 0 : -1;
+}
+
+// Il client riflette: la coroutine cede il controllo finché l'orologio virtuale non arriva al risveglio
+static void client_think(SimSlot* slot, uint64_t ms) {
+    slot->wake_ms = virtual_ms + ms;
+    while (virtual_ms < slot->wake_ms) {
+        swapcontext(&current->context, &scheduler);
+    }
+    slot->wake_ms = 0;
+}
+
+/**
+ * Richiede la lista dei temi (THEMES, OK numero, OK, THEMES_LIST)
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int client_themes(SimSlot* slot) {
+    char data[MAX_MSG_LEN];
+    if (client_send(slot, MSG_THEMES, "") < 0 || client_expect(slot, MSG_OK, data) < 0) {
+        return -1;
+    }
+    if (client_send(slot, MSG_OK, "") < 0 || client_expect(slot, MSG_THEMES_LIST, data) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Script del client simulato
+ * @return 0 se la sessione si è svolta come previsto, -1 altrimenti
+ */
+static int client_script(SimSlot* slot) {
+    char data[MAX_MSG_LEN];
+    char nickname[MAX_NICKNAME_LEN];
+
+    snprintf(nickname, sizeof(nickname), "sim%06d", slot->id);
+    if (client_send(slot, MSG_NICK, nickname) < 0 || client_expect(slot, MSG_OK, data) < 0) {
+        return -1;
+    }
+
+    if (client_themes(slot) < 0) {
+        return -1;
+    }
+
+    if ((int)(rand_r(&slot->rng) % 100) < SIM_SCORE_PERCENT) {
+        if (client_send(slot, MSG_SCORE, "") < 0) {
+            return -1;
+        }
+        for (int i = 0; i < themes_count; i++) {
+            if (client_expect(slot, MSG_SCORELIST, data) < 0 || client_send(slot, MSG_OK, "") < 0) {
+                return -1;
+            }
+        }
+        if (client_expect(slot, MSG_END_SCORE, data) < 0 || client_themes(slot) < 0) {
+            return -1;
+        }
+    }
+
+    int choice = rand_r(&slot->rng) % themes_count;
+    snprintf(data, sizeof(data), "%d", choice);
+    if (client_send(slot, MSG_THEME, data) < 0 || client_expect(slot, MSG_OK, data) < 0) {
+        return -1;
+    }
+
+    Quiz* quiz = &quizzes[choice];
+    for (int q = 0; q < quiz->count; q++) {
+        if (client_send(slot, MSG_QUIZ_START, "") < 0 || client_expect(slot, MSG_QUESTION, data) < 0) {
+            return -1;
+        }
+        int correct = (int)(rand_r(&slot->rng) % 100) < SIM_CORRECT_PERCENT;
+        const char* answer = correct ? quiz->questions[q].correct_answer : "risposta sbagliata";
+        client_think(slot, rand_r(&slot->rng) % SIM_THINK_MAX_MS);
+        if (client_send(slot, MSG_ANSWER, answer) < 0 || client_expect(slot, MSG_RESULT, data) < 0) {
+            return -1;
+        }
+        // Tempo scaduto: la risposta arriva in ritardo e il client conferma il TIMEOUT
+        if (strcmp(data, RESP_TIMEOUT) == 0) {
+            timeouts++;
+            if (client_send(slot, MSG_OK, "") < 0) {
+                return -1;
+            }
+        }
+    }
+    if (client_expect(slot, MSG_RESULT, data) < 0 || strcmp(data, RESP_QUIZ_COMPLETE) != 0) {
+        return -1;
+    }
+
+    // Uscita dalla selezione del tema: il server rimuove il giocatore e chiude la sessione
+    if (client_themes(slot) < 0 || client_send(slot, MSG_END, "") < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void client_main(void) {
+    SimSlot* slot = (SimSlot*)((char*)current - offsetof(SimSlot, client));
+    if (client_script(slot) < 0) {
+        slot->failed = 1;
+    }
+    clean_up_socket(slot->handles[1]);
+    current->running = 0;
+    progress++;
+    // Ritorno: uc_link riporta allo scheduler
+}
+
+static int coroutine_start(Coroutine* co, void (*entry)(void)) {
+    if (co->stack == NULL && (co->stack = malloc(SIM_STACK_SIZE)) == NULL) {
+        return -1;
+    }
+    getcontext(&co->context);
+    co->context.uc_stack.ss_sp = co->stack;
+    co->context.uc_stack.ss_size = SIM_STACK_SIZE;
+    co->context.uc_link = &scheduler;
+    makecontext(&co->context, entry, 0);
+    co->running = 1;
+    return 0;
+}
+
+static void coroutine_resume(Coroutine* co) {
+    current = co;
+    swapcontext(&scheduler, &co->context);
+    current = NULL;
+}
+
+/**
+ * Avvia una nuova sessione in uno slot libero
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int slot_start(SimSlot* slot, int id, unsigned int seed) {
+    if (transport_loopback_pair(slot->handles) < 0) {
+        return -1;
+    }
+    slot->id = id;
+    slot->rng = seed ^ (unsigned int)(id * 2654435761u);
+    slot->failed = 0;
+    slot->in_use = 1;
+    slot->server_ready = 1;
+    slot->client_ready = 1;
+    if (coroutine_start(&slot->server, server_main) < 0 || coroutine_start(&slot->client, client_main) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Somma di controllo della classifica globale (FNV-1a su nickname e punteggi)
+static unsigned long long board_checksum(void) {
+    unsigned long long hash = 1469598103934665603ULL;
+    for (int i = 0; i < shared_state->board_count; i++) {
+        const Player* entry = &shared_state->board[i];
+        const unsigned char* bytes = (const unsigned char*)entry->nickname;
+        for (size_t j = 0; j < strlen(entry->nickname); j++) {
+            hash = (hash ^ bytes[j]) * 1099511628211ULL;
+        }
+        for (int t = 0; t < MAX_THEMES; t++) {
+            hash = (hash ^ (unsigned)entry->score[t]) * 1099511628211ULL;
+            hash = (hash ^ (unsigned)entry->completed[t]) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+static int remove_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+/**
+ * Prepara la directory di lavoro temporanea: i quiz restano quelli di ./src
+ * @param workdir Output: il percorso della directory creata
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int setup_workdir(char* workdir) {
+    char source[PATH_MAX], target[PATH_MAX + 8];
+    if (getcwd(source, sizeof(source)) == NULL) {
+        return -1;
+    }
+    strcpy(workdir, "/tmp/quizsim.XXXXXX");
+    if (mkdtemp(workdir) == NULL) {
+        return -1;
+    }
+    snprintf(target, sizeof(target), "%s/src", source);
+    if (chdir(workdir) < 0 || symlink(target, "src") < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [-n sessioni] [-c concorrenza] [-s seme] [-L]\n", prog);
+    fprintf(stderr, "  -n  sessioni da simulare (default %d)\n", SIM_DEFAULT_SESSIONS);
+    fprintf(stderr, "  -c  sessioni contemporanee, al massimo %d (default %d)\n", MAX_CLIENTS, SIM_DEFAULT_CONCURRENCY);
+    fprintf(stderr, "  -s  seme delle risposte dei client (default %d)\n", SIM_DEFAULT_SEED);
+    fprintf(stderr, "  -L  profilo del lock dello stato per punto di chiamata\n");
+}
+
+int main(int argc, char* argv[]) {
+    int total = SIM_DEFAULT_SESSIONS;
+    int concurrency = SIM_DEFAULT_CONCURRENCY;
+    unsigned int seed = SIM_DEFAULT_SEED;
+    int lock_profile = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:s:L")) != -1) {
+        switch (opt) {
+            case 'n': total = atoi(optarg); break;
+            case 'c': concurrency = atoi(optarg); break;
+            case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'L': lock_profile = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (total <= 0 || concurrency <= 0 || concurrency > MAX_CLIENTS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char workdir[64];
+    if (setup_workdir(workdir) < 0) {
+        perror("Directory di lavoro");
+        return 1;
+    }
+
+    set_log_level(LOG_ERROR);
+    players_console_enabled = 0;
+    shared_state = calloc(1, sizeof(ServerState));
+    sem_id = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+    if (!shared_state || sem_id < 0 || semctl(sem_id, 0, SETVAL, 1) < 0) {
+        perror("Inizializzazione");
+        return 1;
+    }
+    shared_state->server_running = 1;
+    shared_state->locks.enabled = lock_profile;
+
+    int status = 1;
+    int started = 0, finished = 0, idle = 0;
+    SimSlot* slots = calloc(concurrency, sizeof(SimSlot));
+    init_themes();
+    if (slots == NULL || themes_count <= 0 || persist_init() < 0 || profiles_init() < 0) {
+        fprintf(stderr, "Errore: temi, persistenza o profili non disponibili\n");
+        goto out;
+    }
+    for (int i = 0; i < themes_count; i++) {
+        char filename[MAX_THEME_LEN + 8];
+        snprintf(filename, sizeof(filename), "src/%s.txt", theme[i]);
+        if (load_quiz(filename, &quizzes[i]) <= 0) {
+            fprintf(stderr, "Errore: quiz %s non disponibile\n", filename);
+            goto out;
+        }
+    }
+
+    transport_set_wait_hook(sim_wait);
+    set_session_exit_hook(sim_session_exit);
+    timer_set_clock(sim_clock);
+
+    uint64_t start = clock_now_ns();
+
+    while (finished < total) {
+        unsigned long before = progress;
+
+        for (int i = 0; i < concurrency; i++) {
+            SimSlot* slot = &slots[i];
+            if (!slot->in_use && started < total) {
+                if (slot_start(slot, started, seed) < 0) {
+                    fprintf(stderr, "Errore: impossibile avviare la sessione %d\n", started);
+                    goto out;
+                }
+                started++;
+            }
+            // Un lato fermo sul loopback può avanzare solo dopo che l'altro ha agito,
+            // o per una scadenza dei timer (orologio avanzato)
+            if (slot->server.running && slot->server_ready) {
+                server_slot = slot;
+                slot->server_ready = 0;
+                coroutine_resume(&slot->server);
+                slot->client_ready = 1;
+            }
+            if (slot->client.running && (slot->wake_ms > 0 ? slot->wake_ms <= virtual_ms : slot->client_ready)) {
+                slot->client_ready = 0;
+                coroutine_resume(&slot->client);
+                slot->server_ready = 1;
+            }
+            // Sessione conclusa su entrambi i lati: lo slot torna libero
+            if (slot->in_use && !slot->server.running && !slot->client.running) {
+                slot->in_use = 0;
+                failures += slot->failed;
+                finished++;
+            }
+        }
+
+        idle = progress == before ? idle + 1 : 0;
+        int advanced = 0;
+        if (idle > 0 && timer_run() > 0) {
+            // Timer scaduti all'istante corrente: le sessioni li vedono al prossimo giro
+            advanced = 1;
+        } else if (idle > 0) {
+            // Nessuno può avanzare: l'orologio salta al primo risveglio o alla prima scadenza
+            int64_t next = timer_next_ms();
+            for (int i = 0; i < concurrency; i++) {
+                if (slots[i].in_use && slots[i].wake_ms > 0 &&
+                    (next < 0 || slots[i].wake_ms - virtual_ms < (uint64_t)next)) {
+                    next = slots[i].wake_ms - virtual_ms;
+                }
+            }
+            if (next >= 0) {
+                virtual_ms += next > 0 ? next : 1;
+                advanced = 1;
+            }
+        }
+        if (advanced) {
+            idle = 0;
+            for (int i = 0; i < concurrency; i++) {
+                slots[i].server_ready = 1;
+            }
+        }
+        if (idle >= SIM_IDLE_PASSES) {
+            fprintf(stderr, "Stallo: nessun progresso con %d sessioni concluse su %d\n", finished, total);
+            goto out;
+        }
+    }
+
+    double elapsed = (clock_now_ns() - start) / 1e9;
+    printf("Sessioni:        %d (%d fallite), %d contemporanee, seme %u\n", total, failures, concurrency, seed);
+    printf("Tempo:           %.3f s\n", elapsed);
+    printf("Sessioni/s:      %.0f\n", total / elapsed);
+    printf("Messaggi/s:      %.0f (%lu messaggi)\n", messages / elapsed, messages);
+    printf("Tempo virtuale:  %.1f s (%lu domande scadute)\n", virtual_ms / 1000.0, timeouts);
+    printf("Classifica:      %d giocatori, checksum %016llx\n", shared_state->board_count, board_checksum());
+
+    // Tempo di servizio per tipo di richiesta, dalle metriche in memoria condivisa
+    static MetricsSnapshot snapshot;
+    metrics_snapshot(&snapshot);
+    printf("\n%-12s %10s %10s %10s %10s\n", "richiesta", "numero", "p50 us", "p99 us", "p999 us");
+    for (int i = 0; i < METRIC_TYPES; i++) {
+        const Histogram* hist = &snapshot.latency[i];
+        if (hist->count > 0) {
+            printf("%-12s %10llu %10.1f %10.1f %10.1f\n", metric_name(i), (unsigned long long)hist->count,
+                   histogram_percentile(hist, 50) / 1000.0, histogram_percentile(hist, 99) / 1000.0,
+                   histogram_percentile(hist, 99.9) / 1000.0);
+        }
+    }
+
+    if (lock_profile) {
+        static char report[16 * 256];
+        lock_profile_report(report, sizeof(report), 16);
+        printf("\nLock dello stato per punto di chiamata:\n%s", report);
+    }
+    status = failures > 0;
+
+out:
+    persist_shutdown();
+    semctl(sem_id, 0, IPC_RMID);
+    if (chdir("/") == 0) {
+        nftw(workdir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    return status;
+}
@@ -1,4 +1,6 @@
 #include "client.h"
+#include "../shared/transport.h"
+#include <poll.h>
 
 /**
  * Pulisce il buffer di input (stdin) rimuovendo tutti i caratteri fino al newline
@@ -69,6 +71,8 @@ int main(int argc, char* argv[]){
     
         if(choice == 1){
             ClientStatus client = {0};
+            strcpy(client.hostname, hostname);
+            client.port = port;
             //Connessione al server
             printf("Connessione al server %s sulla porta %d...\n", hostname, port);
             
@@ -88,6 +92,10 @@ int main(int argc, char* argv[]){
                     theme_result = select_theme(&client);     
                     if(theme_result == 0){
                         play(&client);
+                    } else if(theme_result == 2){
+                        play_room(&client);
+                    } else if(theme_result == 3){
+                        follow_ranks(&client);
                     } else if(theme_result == -1){
                         continue_session = 0;
                     } 
@@ -95,7 +103,7 @@ int main(int argc, char* argv[]){
             }
             
             printf("\nSessione terminata\n");
-            close(client.socket);
+            clean_up_socket(client.socket);
         }
         else if(choice == 0){
             printf("\nArrivederci!\n");
@@ -194,7 +202,24 @@ int register_nickname(ClientStatus *client){
             return -1;
         }
 
+        // Server pieno: il server tiene il posto in coda e registra il nickname appena possibile
+        while(strcmp(type, MSG_WAIT) == 0){
+            int position = 0, eta = -1;
+            sscanf(data, "%d,%d", &position, &eta);
+            if(eta >= 0){
+                printf("Server pieno: sei in coda, posizione %d (attesa stimata %d secondi)...\n", position, eta);
+            } else {
+                printf("Server pieno: sei in coda, posizione %d...\n", position);
+            }
+            if(recv_msg(client->socket, type, data) < 0){
+                printf("Errore nella ricezione della risposta.\n");
+                return -1;
+            }
+        }
+
         if(strcmp(type, MSG_OK) == 0){
+            // Il payload dell'OK è il token di ripresa della sessione
+            snprintf(client->token, sizeof(client->token), "%.*s", SESSION_TOKEN_LEN, data);
             printf("Nickname '%s' registrato con successo!\n", client->nickname);
             return 0;
         } else if(strcmp(type, MSG_ERROR) == 0){
@@ -210,7 +235,8 @@ int register_nickname(ClientStatus *client){
 /**
  * Mostra il menu di selezione del tema e gestisce la scelta
  * @param client Puntatore alla struttura ClientStatus del client
- * @return 0 se un tema è stato selezionato con successo, -1 per terminare la sessione, 1 per ripetere la selezione
+ * @return 0 se un tema è stato selezionato con successo, -1 per terminare la sessione, 1 per ripetere la selezione,
+ *         2 per la stanza dal vivo, 3 per seguire le classifiche
  */
 int select_theme(ClientStatus* client){
     char type[64], data[MAX_MSG_LEN], theme_choice[16];
@@ -250,7 +276,7 @@ int select_theme(ClientStatus* client){
     printf("\n=== SELEZIONE TEMA ===\n");
     print_formatted_list(data, "Temi disponibili:");
 
-    printf("Scegli un tema (numero), 'show score' per classifica o 'endquiz' per uscire: ");
+    printf("Scegli un tema (numero), 'live <numero>' per la stanza dal vivo, 'follow <numeri>' per seguire le classifiche, 'show score' per classifica o 'endquiz' per uscire: ");
     
     char input[64];
     if(fgets(input, sizeof(input), stdin) == NULL) {
@@ -324,6 +350,30 @@ int select_theme(ClientStatus* client){
         return -1; // Termina la sessione
     }
     
+    // Stanza dal vivo di un tema: le domande arrivano a tutti i partecipanti insieme
+    if(strncmp(input, "live ", 5) == 0) {
+        if(send_msg(client->socket, MSG_ROOM, input + 5) < 0 ||
+           recv_msg(client->socket, type, data) < 0){
+            printf("Errore nell'ingresso nella stanza\n");
+            return 1;
+        }
+        if(strcmp(type, MSG_ROOM_WAIT) != 0){
+            printf("Impossibile entrare nella stanza: %s\n", data);
+            return 1;
+        }
+        printf("%s\n", data);
+        return 2;
+    }
+
+    // Classifiche di uno o più temi aggiornate dal server
+    if(strncmp(input, "follow ", 7) == 0) {
+        if(send_msg(client->socket, MSG_SUBSCRIBE, input + 7) < 0){
+            printf("Errore nell'iscrizione alle classifiche\n");
+            return 1;
+        }
+        return 3;
+    }
+
     // Conversione input numerico
     if(!is_numeric(input)){
         printf("Input non valido. Riprova.\n");
@@ -391,11 +441,19 @@ int play(ClientStatus *client){
         
         if(recv_msg(client->socket, type, data) < 0){
             printf("Errore nella connessione.\n");
-            break;
+
+            // Connessione caduta: si riprende il quiz dalla stessa domanda
+            int question;
+            if(resume_session(client, &question) < 0){
+                break;
+            }
+            question_num = question + 1;
+            send_msg(client->socket, MSG_QUIZ_START, "");
+            continue;
         }
 
         if(strcmp(type, MSG_QUESTION) == 0){
-            printf("---- Domanda %d -----\n", question_num);
+            printf("---- Domanda %d (%d secondi) -----\n", question_num, QUESTION_TIME_SEC);
             printf("%s\n", data);
             // printf("La tua risposta / show score / endquiz \n");
 
@@ -473,14 +531,246 @@ int play(ClientStatus *client){
     return 0;
 }
 
+/**
+ * Partecipa all'evento di una stanza dal vivo: le domande arrivano dal server quando
+ * l'orologio della stanza le pone, quindi si attendono insieme il socket e la tastiera
+ * @param client Puntatore alla struttura ClientStatus del client
+ * @return 0 alla fine dell'evento, -1 in caso di errore
+ */
+int play_room(ClientStatus *client){
+    char type[64], data[MAX_MSG_LEN];
+    char input[64];
+
+    printf("Rispondi alle domande quando compaiono, 'leave' per uscire dalla stanza\n");
+
+    while(1){
+        struct pollfd fds[2] = { { client->socket, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+
+        // Un messaggio già ricevuto da recv_msg non risveglia la poll
+        RecvBuffer* pending = transport_recv_buffer(client->socket);
+        if(pending && pending->len > 0){
+            fds[0].revents = POLLIN;
+        } else if(poll(fds, 2, -1) < 0){
+            continue;
+        }
+
+        if(fds[0].revents & (POLLIN | POLLHUP | POLLERR)){
+            if(recv_msg(client->socket, type, data) < 0){
+                printf("Connessione persa con il server.\n");
+                return -1;
+            }
+            if(strcmp(type, MSG_ROOM_QUESTION) == 0){
+                printf("\n%s\n> ", data);
+                fflush(stdout);
+            } else if(strcmp(type, MSG_ROOM_WAIT) == 0 || strcmp(type, MSG_ROOM_RESULT) == 0){
+                printf("%s\n", data);
+            } else if(strcmp(type, MSG_ROOM_END) == 0){
+                printf("%s\n", data);
+                if(send_msg(client->socket, MSG_OK, "") < 0 ||
+                   recv_msg(client->socket, type, data) < 0){
+                    return -1;
+                }
+                printf("Risposte corrette nella stanza: %s\n", data);
+                printf("\nPremi Invio per continuare...");
+                clear_input_buffer();
+                return 0;
+            } else if(strcmp(type, MSG_ERROR) == 0){
+                printf("Errore del server: %s\n", data);
+                return -1;
+            }
+        }
+
+        if(fds[1].revents & POLLIN){
+            if(fgets(input, sizeof(input), stdin) == NULL){
+                continue;
+            }
+            if(strlen(input) > 0 && input[strlen(input)-1] != '\n'){
+                clear_input_buffer();
+                printf("Input troppo lungo. Riprova.\n");
+                continue;
+            }
+            trim_newline(input);
+            if(strcmp(input, "leave") == 0){
+                send_msg(client->socket, MSG_ROOM_LEAVE, "");
+            } else if(strlen(input) > 0){
+                send_msg(client->socket, MSG_ANSWER, input);
+            }
+        }
+    }
+}
+
+// Classifica di un tema come ricevuta dagli aggiornamenti del server
+typedef struct {
+    int count;
+    char nickname[RANK_PUSH_ROWS][MAX_NICKNAME_LEN];
+    int score[RANK_PUSH_ROWS];
+    int completed[RANK_PUSH_ROWS];
+} RankTable;
+
+/**
+ * Applica un aggiornamento MSG_RANK e mostra la classifica risultante
+ * Payload: "tema righe" seguito dalle sole righe cambiate, "posizione:nickname:punti:completato"
+ * @param tables Le classifiche dei temi
+ * @param data Il payload
+ */
+static void apply_rank(RankTable* tables, char* data){
+    char* saveptr = NULL;
+    char* token = strtok_r(data, " ", &saveptr);
+    int t = token ? atoi(token) : -1;
+    token = strtok_r(NULL, " ", &saveptr);
+    if(t < 0 || t >= MAX_THEMES || token == NULL){
+        return;
+    }
+    RankTable* table = &tables[t];
+    table->count = atoi(token);
+    if(table->count > RANK_PUSH_ROWS){
+        table->count = RANK_PUSH_ROWS;
+    }
+
+    while((token = strtok_r(NULL, " ", &saveptr)) != NULL){
+        int pos, score, completed;
+        char nickname[MAX_NICKNAME_LEN];
+        if(sscanf(token, "%d:%31[^:]:%d:%d", &pos, nickname, &score, &completed) != 4 ||
+           pos < 1 || pos > table->count){
+            continue;
+        }
+        strcpy(table->nickname[pos - 1], nickname);
+        table->score[pos - 1] = score;
+        table->completed[pos - 1] = completed;
+    }
+
+    printf("\n=== CLASSIFICA TEMA %d (aggiornata) ===\n", t);
+    if(table->count == 0){
+        printf("Nessun punteggio disponibile per questo tema.\n");
+    }
+    for(int i = 0; i < table->count; i++){
+        printf("%d. %s: %d punti%s\n", i + 1, table->nickname[i], table->score[i],
+               table->completed[i] ? " (completato)" : "");
+    }
+}
+
+/**
+ * Segue le classifiche dei temi scelti: il server invia la classifica intera di ogni tema e poi,
+ * al più una volta per intervallo, le sole righe cambiate
+ * @param client Puntatore alla struttura ClientStatus del client
+ * @return 0 alla fine degli aggiornamenti, -1 in caso di errore
+ */
+int follow_ranks(ClientStatus *client){
+    char type[64], data[MAX_MSG_LEN];
+    char input[64];
+    RankTable tables[MAX_THEMES];
+
+    memset(tables, 0, sizeof(tables));
+    printf("Le classifiche si aggiornano da sole, 'leave' per tornare alla selezione dei temi\n");
+
+    while(1){
+        struct pollfd fds[2] = { { client->socket, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+
+        // Un messaggio già ricevuto da recv_msg non risveglia la poll
+        RecvBuffer* pending = transport_recv_buffer(client->socket);
+        if(pending && pending->len > 0){
+            fds[0].revents = POLLIN;
+        } else if(poll(fds, 2, -1) < 0){
+            continue;
+        }
+
+        if(fds[0].revents & (POLLIN | POLLHUP | POLLERR)){
+            if(recv_msg(client->socket, type, data) < 0){
+                printf("Connessione persa con il server.\n");
+                return -1;
+            }
+            if(strcmp(type, MSG_RANK) == 0){
+                apply_rank(tables, data);
+            } else if(strcmp(type, MSG_RANK_END) == 0){
+                printf("%s\n", data);
+                if(send_msg(client->socket, MSG_OK, "") < 0 ||
+                   recv_msg(client->socket, type, data) < 0){
+                    return -1;
+                }
+                return 0;
+            } else if(strcmp(type, MSG_ERROR) == 0){
+                printf("Impossibile seguire le classifiche: %s\n", data);
+                return 0;
+            }
+        }
+
+        if(fds[1].revents & POLLIN){
+            if(fgets(input, sizeof(input), stdin) == NULL){
+                continue;
+            }
+            if(strlen(input) > 0 && input[strlen(input)-1] != '\n'){
+                clear_input_buffer();
+                continue;
+            }
+            trim_newline(input);
+            if(strcmp(input, "leave") == 0){
+                send_msg(client->socket, MSG_UNSUBSCRIBE, "");
+            }
+        }
+    }
+}
+
+/**
+ * Riconnette il client al server e riprende la sessione interrotta con il token ricevuto
+ * alla registrazione, senza ripetere la registrazione e la selezione del tema
+ * @param client Puntatore alla struttura ClientStatus del client
+ * @param question Output: indice della domanda da cui riprende il quiz
+ * @return 0 se la sessione è stata ripresa con un quiz in corso, -1 altrimenti
+ */
+int resume_session(ClientStatus* client, int* question){
+    char type[64], data[MAX_MSG_LEN], nickname[MAX_NICKNAME_LEN];
+    int theme;
+
+    if(strlen(client->token) == 0){
+        return -1;
+    }
+    clean_up_socket(client->socket);
+    client->socket = -1;
+
+    for(int attempt = 1; attempt <= RESUME_ATTEMPTS; attempt++){
+        printf("Riconnessione in corso (tentativo %d di %d)...\n", attempt, RESUME_ATTEMPTS);
+        sleep(1);
+
+        client->socket = connect_to_server(client->hostname, client->port);
+        if(client->socket < 0){
+            continue;
+        }
+
+        if(send_msg(client->socket, MSG_RESUME, client->token) < 0 ||
+           recv_msg(client->socket, type, data) < 0){
+            clean_up_socket(client->socket);
+            client->socket = -1;
+            continue;
+        }
+
+        // Risposta: "nickname tema domanda"
+        if(strcmp(type, MSG_OK) != 0 ||
+           sscanf(data, "%31s %d %d", nickname, &theme, question) != 3 || theme < 0){
+            printf("Impossibile riprendere il quiz: %s\n", data);
+            return -1;
+        }
+
+        printf("Sessione ripresa! Si riparte dalla domanda %d.\n", *question + 1);
+        return 0;
+    }
+    return -1;
+}
+
 /**
  * Mostra il risultato della risposta del client
  * @param result La stringa di risultato ricevuta dal server
  * @return 1 se il quiz è completato, 0 altrimenti
  */
 int show_result(const char* result){
-    if(strcmp(result, RESP_CORRECT) == 0){
-        printf("Risposta esatta!\n");
+    // Risposta esatta: "CORRECT punti", più punti quanto prima arriva la risposta
+    if(strncmp(result, RESP_CORRECT, strlen(RESP_CORRECT)) == 0){
+        int points = atoi(result + strlen(RESP_CORRECT));
+        printf("Risposta esatta! +%d punti\n", points);
+        sleep(1); // Pausa per leggere il feedback
+        return 0;
+    }
+    else if(strcmp(result, RESP_TIMEOUT) == 0){
+        printf("Tempo scaduto! La risposta non è stata conteggiata.\n");
         sleep(1); // Pausa per leggere il feedback
         return 0;
     }
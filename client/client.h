@@ -10,13 +10,21 @@ typedef struct
     int theme;
     int score;
     int quiz_active;
+    char token[SESSION_TOKEN_LEN + 1]; // Token per riprendere la sessione dopo una disconnessione
+    char hostname[16];
+    int port;
 } ClientStatus;
 
+#define RESUME_ATTEMPTS 5 // Tentativi di riconnessione, uno al secondo
+
 int connect_to_server(char* hostname, int port);
 void menu();
 int register_nickname(ClientStatus *client);
 int select_theme(ClientStatus* client);
 int play(ClientStatus* client);
+int play_room(ClientStatus* client);
+int follow_ranks(ClientStatus* client);
+int resume_session(ClientStatus* client, int* question);
 int show_result(const char* result);
 
 #endif
\ No newline at end of file
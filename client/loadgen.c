@@ -0,0 +1,742 @@
+#include "../shared/protocol.h"
+#include "../shared/histogram.h"
+#include "../shared/clock.h"
+#include <errno.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+
+/*
+ * Generatore di carico senza interfaccia
+ * Un solo processo guida molte sessioni in parallelo da un ciclo epoll:
+ * registrazione, selezione dei temi, risposte con un tasso di correttezza configurabile
+ * e richieste di classifica, con un tempo di riflessione tra una richiesta e l'altra.
+ * Al termine riporta connessioni/s, messaggi/s e le latenze p50/p99/p999 per tipo di richiesta.
+ */
+
+#define LOADGEN_MAX_EVENTS 256
+#define LOADGEN_INBUF (4 * MAX_MSG_LEN)
+#define LOADGEN_REPORT_MS 1000
+
+// Richieste cronometrate: latenza tra l'invio e la prima risposta
+typedef enum {
+    REQ_CONNECT,
+    REQ_NICK,
+    REQ_THEMES,
+    REQ_THEMES_LIST,
+    REQ_THEME,
+    REQ_QUIZ_START,
+    REQ_ANSWER,
+    REQ_SCORE,      // Ogni scambio della classifica (SCORE o OK -> SCORELIST / END_SCORE)
+    REQ_END,
+    REQ_COUNT
+} RequestKind;
+
+static const char* request_names[REQ_COUNT] = {
+    "CONNECT", "NICK", "THEMES", "THEMES_LIST", "THEME", "QUIZ_START", "ANSWER", "SCORE", "END"
+};
+
+// Risposta attesa dalla sessione
+typedef enum {
+    PHASE_CONNECT,
+    PHASE_NICK,
+    PHASE_THEMES,
+    PHASE_LIST,
+    PHASE_THEME,
+    PHASE_QUESTION,
+    PHASE_RESULT,
+    PHASE_SCORE,
+    PHASE_END
+} Phase;
+
+typedef struct {
+    int fd;                         // -1 se lo slot è libero
+    unsigned generation;            // Invalida i timer di una sessione già chiusa o di una richiesta annullata
+    Phase phase;
+    RequestKind pending;            // Richiesta in attesa di risposta
+    uint64_t sent_at;               // Istante di invio della richiesta in attesa (ns)
+    char nickname[MAX_NICKNAME_LEN];
+    int theme;                      // Tema del quiz in corso
+    int answered;                   // Risposte date nel quiz in corso
+    int quizzes;                    // Quiz completati nella sessione
+    int score_done;                 // Classifica già richiesta in questo giro di selezione
+    char next_type[MAX_TYPE_LEN];   // Richiesta differita dal tempo di riflessione
+    char next_data[MAX_ANSWER_LEN];
+    RequestKind next_kind;
+    int ack;                        // Conferma (OK) da anteporre alla prossima richiesta
+    char inbuf[LOADGEN_INBUF];
+    int inlen;
+    char outbuf[MAX_MSG_LEN];
+    int outlen;
+    int outoff;
+} Session;
+
+// Timer del tempo di riflessione: min-heap ordinato per scadenza
+typedef struct {
+    uint64_t at;
+    int slot;
+    unsigned generation;
+} Timer;
+
+typedef struct {
+    char host[64];
+    int port;
+    int connections;                // Sessioni contemporanee
+    long sessions;                  // Sessioni totali (0 = fino alla scadenza)
+    int duration;                   // Durata massima in secondi
+    int think_ms;                   // Tempo medio di riflessione tra due richieste
+    double correct_rate;            // Probabilità di rispondere correttamente
+    double score_rate;              // Probabilità di chiedere la classifica a ogni selezione del tema
+    int quizzes;                    // Quiz giocati per sessione
+    char quiz_dir[256];
+} Config;
+
+typedef struct {
+    char name[MAX_THEME_LEN];
+    Quiz quiz;
+} ThemeKey;
+
+static Config config = {
+    .host = "127.0.0.1",
+    .port = 8080,
+    .connections = 16,
+    .sessions = 0,
+    .duration = 10,
+    .think_ms = 0,
+    .correct_rate = 0.5,
+    .score_rate = 0.2,
+    .quizzes = 1,
+    .quiz_dir = "src"
+};
+
+static Session* sessions;
+static int epoll_fd = -1;
+static ThemeKey keys[MAX_THEMES];
+static int keys_count = 0;
+
+static Timer* timers;
+static int timers_count = 0;
+static int timers_capacity = 0;
+
+static Histogram latency[REQ_COUNT];
+static long started = 0, connects = 0, connect_errors = 0, completed = 0, disconnects = 0, server_errors = 0;
+static long timeouts = 0;
+static long admission_waits = 0;
+static long msgs_sent = 0, msgs_recv = 0;
+static int stopping = 0;
+
+static double random_unit(void) {
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+/**
+ * Carica le risposte corrette di tutti i temi (stesso formato letto dal server)
+ * @return Numero di temi caricati
+ */
+static int load_answer_keys(void) {
+    char path[512], line[MAX_QUESTION_LEN];
+
+    snprintf(path, sizeof(path), "%s/temi.txt", config.quiz_dir);
+    FILE* themes = fopen(path, "r");
+    if (!themes) {
+        return 0;
+    }
+
+    while (keys_count < MAX_THEMES && fgets(line, sizeof(line), themes)) {
+        trim_newline(line);
+        if (strlen(line) == 0) {
+            continue;
+        }
+        ThemeKey* key = &keys[keys_count++];
+        snprintf(key->name, sizeof(key->name), "%.*s", MAX_THEME_LEN - 1, line);
+
+        snprintf(path, sizeof(path), "%s/%s.txt", config.quiz_dir, key->name);
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            continue;
+        }
+        while (key->quiz.count < QUIZ_QUESTIONS && fgets(line, sizeof(line), file)) {
+            trim_newline(line);
+            if (strlen(line) == 0 || strcmp(line, "---") == 0) {
+                continue;
+            }
+            Question* q = &key->quiz.questions[key->quiz.count++];
+            snprintf(q->question, sizeof(q->question), "%s", line);
+            if (fgets(line, sizeof(line), file)) {
+                trim_newline(line);
+                snprintf(q->correct_answer, sizeof(q->correct_answer), "%.*s", MAX_ANSWER_LEN - 1, line);
+            }
+        }
+        fclose(file);
+    }
+    fclose(themes);
+    return keys_count;
+}
+
+static const char* find_answer(int theme_index, const char* question) {
+    if (theme_index < 0 || theme_index >= keys_count) {
+        return NULL;
+    }
+    Quiz* quiz = &keys[theme_index].quiz;
+    for (int i = 0; i < quiz->count; i++) {
+        if (strcmp(quiz->questions[i].question, question) == 0) {
+            return quiz->questions[i].correct_answer;
+        }
+    }
+    return NULL;
+}
+
+static int quiz_length(int theme_index) {
+    if (theme_index >= 0 && theme_index < keys_count && keys[theme_index].quiz.count > 0) {
+        return keys[theme_index].quiz.count;
+    }
+    return QUIZ_QUESTIONS;
+}
+
+// --- Timer (min-heap) ---
+
+static void timer_push(uint64_t at, int slot) {
+    // I timer delle sessioni chiuse restano nel heap fino alla scadenza: può servire spazio extra
+    if (timers_count == timers_capacity) {
+        timers_capacity *= 2;
+        timers = realloc(timers, timers_capacity * sizeof(Timer));
+        if (!timers) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    int i = timers_count++;
+    timers[i] = (Timer){ at, slot, sessions[slot].generation };
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (timers[parent].at <= timers[i].at) {
+            break;
+        }
+        Timer tmp = timers[parent];
+        timers[parent] = timers[i];
+        timers[i] = tmp;
+        i = parent;
+    }
+}
+
+static Timer timer_pop(void) {
+    Timer top = timers[0];
+    timers[0] = timers[--timers_count];
+    int i = 0;
+    while (1) {
+        int smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < timers_count && timers[left].at < timers[smallest].at) smallest = left;
+        if (right < timers_count && timers[right].at < timers[smallest].at) smallest = right;
+        if (smallest == i) {
+            break;
+        }
+        Timer tmp = timers[smallest];
+        timers[smallest] = timers[i];
+        timers[i] = tmp;
+        i = smallest;
+    }
+    return top;
+}
+
+// --- Sessioni ---
+
+static void close_session(int slot) {
+    Session* s = &sessions[slot];
+    if (s->fd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+        close(s->fd);
+    }
+    s->fd = -1;
+    s->generation++;
+}
+
+static void watch_output(Session* s, int slot, int enable) {
+    struct epoll_event ev = { .events = EPOLLIN | (enable ? EPOLLOUT : 0), .data.u32 = (uint32_t)slot };
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s->fd, &ev);
+}
+
+/**
+ * Scrive il più possibile del messaggio in uscita
+ * @return 0 se il messaggio è stato scritto (anche parzialmente), -1 se la connessione è persa
+ */
+static int flush_output(Session* s, int slot) {
+    while (s->outoff < s->outlen) {
+        ssize_t n = send(s->fd, s->outbuf + s->outoff, s->outlen - s->outoff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                watch_output(s, slot, 1);
+                return 0;
+            }
+            return -1;
+        }
+        s->outoff += n;
+    }
+    watch_output(s, slot, 0);
+    return 0;
+}
+
+static int send_request(int slot, RequestKind kind, const char* type, const char* data) {
+    Session* s = &sessions[slot];
+    s->outlen = 0;
+    if (s->ack) {
+        s->outlen = format_msg(s->outbuf, sizeof(s->outbuf), MSG_OK, "");
+        s->ack = 0;
+        msgs_sent++;
+    }
+    s->outlen += format_msg(s->outbuf + s->outlen, sizeof(s->outbuf) - s->outlen, type, data);
+    s->outoff = 0;
+    s->pending = kind;
+    s->sent_at = clock_now_ns();
+    msgs_sent++;
+    return flush_output(s, slot);
+}
+
+/**
+ * Invia una richiesta dopo il tempo di riflessione (uniforme tra 0.5 e 1.5 volte la media)
+ */
+static int send_after_think(int slot, RequestKind kind, const char* type, const char* data) {
+    Session* s = &sessions[slot];
+    if (config.think_ms <= 0) {
+        return send_request(slot, kind, type, data);
+    }
+    snprintf(s->next_type, sizeof(s->next_type), "%s", type);
+    snprintf(s->next_data, sizeof(s->next_data), "%s", data);
+    s->next_kind = kind;
+    uint64_t think = (uint64_t)(config.think_ms * (0.5 + random_unit()) * 1000000.0);
+    timer_push(clock_now_ns() + think, slot);
+    return 0;
+}
+
+static void start_session(int slot) {
+    Session* s = &sessions[slot];
+    unsigned generation = s->generation;
+    memset(s, 0, sizeof(*s));
+    s->generation = generation;
+    s->fd = -1;
+
+    if (stopping || (config.sessions > 0 && started >= config.sessions)) {
+        return;
+    }
+    started++;
+    snprintf(s->nickname, sizeof(s->nickname), "lg%d_%ld", (int)(getpid() % 100000), started);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.host, &addr.sin_addr) <= 0) {
+        fprintf(stderr, "Indirizzo non valido: %s\n", config.host);
+        exit(1);
+    }
+
+    s->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (s->fd < 0) {
+        perror("socket");
+        connect_errors++;
+        return;
+    }
+    int one = 1;
+    setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    s->phase = PHASE_CONNECT;
+    s->pending = REQ_CONNECT;
+    s->sent_at = clock_now_ns();
+    if (connect(s->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        connect_errors++;
+        close(s->fd);
+        s->fd = -1;
+        return;
+    }
+
+    struct epoll_event ev = { .events = EPOLLOUT, .data.u32 = (uint32_t)slot };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->fd, &ev);
+}
+
+// Termina la sessione e ne avvia una nuova nello stesso slot
+static void restart_session(int slot) {
+    close_session(slot);
+    start_session(slot);
+}
+
+/**
+ * Sceglie un tema non completato dalla lista ricevuta ("N. nome [COMPLETATO]\n" per tema)
+ * @return Il numero del tema, -1 se sono tutti completati
+ */
+static int pick_theme(const char* list, int count) {
+    int done[MAX_THEMES] = {0};
+    for (int i = 0; i < count && i < MAX_THEMES; i++) {
+        char marker[16];
+        snprintf(marker, sizeof(marker), "%d. ", i);
+        const char* line = strstr(list, marker);
+        const char* end = line ? strstr(line, "\\n") : NULL;
+        const char* completed_mark = line ? strstr(line, "[COMPLETATO]") : NULL;
+        done[i] = completed_mark && (!end || completed_mark < end);
+    }
+
+    int start = rand() % (count > 0 ? count : 1);
+    for (int i = 0; i < count && i < MAX_THEMES; i++) {
+        int t = (start + i) % count;
+        if (!done[t]) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Avanza la macchina a stati della sessione con un messaggio ricevuto
+ * @return 0 se la sessione continua, -1 se va chiusa
+ */
+static int handle_message(int slot, char* type, char* data) {
+    Session* s = &sessions[slot];
+    uint64_t now = clock_now_ns();
+    msgs_recv++;
+
+    // Server pieno: la registrazione resta in attesa e la sua latenza include la coda
+    if (s->phase == PHASE_NICK && strcmp(type, MSG_WAIT) == 0) {
+        admission_waits++;
+        return 0;
+    }
+
+    if (s->pending != REQ_COUNT) {
+        histogram_record(&latency[s->pending], (now - s->sent_at) / 1000);
+        s->pending = REQ_COUNT;
+    }
+
+    if (strcmp(type, MSG_ERROR) == 0 && s->phase != PHASE_THEME) {
+        server_errors++;
+        return -1;
+    }
+
+    switch (s->phase) {
+        case PHASE_NICK:
+            s->phase = PHASE_THEMES;
+            return send_after_think(slot, REQ_THEMES, MSG_THEMES, "");
+
+        case PHASE_THEMES:
+            s->phase = PHASE_LIST;
+            s->theme = atoi(data); // Numero di temi, usato alla ricezione della lista
+            return send_request(slot, REQ_THEMES_LIST, MSG_OK, "");
+
+        case PHASE_LIST: {
+            int theme_index = pick_theme(data, s->theme);
+            if (s->quizzes >= config.quizzes || theme_index < 0) {
+                s->phase = PHASE_END;
+                return send_after_think(slot, REQ_END, MSG_END, "");
+            }
+            if (!s->score_done && random_unit() < config.score_rate) {
+                s->phase = PHASE_SCORE;
+                s->score_done = 1;
+                return send_after_think(slot, REQ_SCORE, MSG_SCORE, "");
+            }
+            char choice[16];
+            snprintf(choice, sizeof(choice), "%d", theme_index);
+            s->theme = theme_index;
+            s->phase = PHASE_THEME;
+            return send_after_think(slot, REQ_THEME, MSG_THEME, choice);
+        }
+
+        case PHASE_SCORE:
+            if (strcmp(type, MSG_END_SCORE) == 0) {
+                s->phase = PHASE_THEMES;
+                return send_after_think(slot, REQ_THEMES, MSG_THEMES, "");
+            }
+            return send_request(slot, REQ_SCORE, MSG_OK, "");
+
+        case PHASE_THEME:
+            if (strcmp(type, MSG_OK) != 0) {
+                // Tema non disponibile: si torna alla lista
+                s->phase = PHASE_THEMES;
+                return send_request(slot, REQ_THEMES, MSG_THEMES, "");
+            }
+            s->answered = 0;
+            s->score_done = 0;
+            s->phase = PHASE_QUESTION;
+            return send_after_think(slot, REQ_QUIZ_START, MSG_QUIZ_START, "");
+
+        case PHASE_QUESTION: {
+            const char* answer = find_answer(s->theme, data);
+            int correct = answer != NULL && random_unit() < config.correct_rate;
+            s->phase = PHASE_RESULT;
+            s->answered++;
+            return send_after_think(slot, REQ_ANSWER, MSG_ANSWER, correct ? answer : "risposta sbagliata");
+        }
+
+        case PHASE_RESULT:
+            if (strcmp(data, RESP_TIMEOUT) == 0) {
+                // Tempo scaduto: la risposta differita (o già inviata) non conta più. Il server
+                // attende la conferma prima di accettare la richiesta della domanda successiva
+                timeouts++;
+                s->generation++;
+                if (s->answered >= quiz_length(s->theme)) {
+                    // Dopo l'ultima domanda segue RESULT|QUIZ_COMPLETE
+                    return send_request(slot, REQ_COUNT, MSG_OK, "");
+                }
+                s->ack = 1;
+                s->phase = PHASE_QUESTION;
+                return send_request(slot, REQ_QUIZ_START, MSG_QUIZ_START, "");
+            }
+            if (strcmp(data, RESP_QUIZ_COMPLETE) == 0) {
+                s->quizzes++;
+                s->phase = PHASE_THEMES;
+                return send_after_think(slot, REQ_THEMES, MSG_THEMES, "");
+            }
+            if (s->answered >= quiz_length(s->theme)) {
+                // Dopo l'ultima risposta il server invia anche RESULT|QUIZ_COMPLETE
+                return 0;
+            }
+            s->phase = PHASE_QUESTION;
+            return send_request(slot, REQ_QUIZ_START, MSG_QUIZ_START, "");
+
+        default:
+            return 0;
+    }
+}
+
+static void handle_readable(int slot) {
+    Session* s = &sessions[slot];
+
+    while (1) {
+        ssize_t n = recv(s->fd, s->inbuf + s->inlen, sizeof(s->inbuf) - 1 - s->inlen, 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            n = 0;
+        }
+        if (n == 0) {
+            // Dopo END il server chiude la connessione: la sessione è completa
+            if (s->phase == PHASE_END) {
+                histogram_record(&latency[REQ_END], (clock_now_ns() - s->sent_at) / 1000);
+                completed++;
+            } else {
+                disconnects++;
+            }
+            restart_session(slot);
+            return;
+        }
+        s->inlen += n;
+
+        // Consuma tutte le righe complete presenti nel buffer
+        char* line = s->inbuf;
+        char* newline;
+        while ((newline = memchr(line, '\n', s->inlen - (line - s->inbuf))) != NULL) {
+            char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+            *newline = '\0';
+            if (parse_msg(line, type, data) < 0 || handle_message(slot, type, data) < 0) {
+                restart_session(slot);
+                return;
+            }
+            line = newline + 1;
+        }
+        s->inlen -= line - s->inbuf;
+        memmove(s->inbuf, line, s->inlen);
+        if (s->inlen >= (int)sizeof(s->inbuf) - 1) {
+            // Riga troppo lunga: flusso non sincronizzato
+            restart_session(slot);
+            return;
+        }
+    }
+}
+
+static void handle_writable(int slot) {
+    Session* s = &sessions[slot];
+
+    if (s->phase == PHASE_CONNECT) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            connect_errors++;
+            restart_session(slot);
+            return;
+        }
+        connects++;
+        histogram_record(&latency[REQ_CONNECT], (clock_now_ns() - s->sent_at) / 1000);
+        s->phase = PHASE_NICK;
+        if (send_request(slot, REQ_NICK, MSG_NICK, s->nickname) < 0) {
+            disconnects++;
+            restart_session(slot);
+        }
+        return;
+    }
+
+    if (flush_output(s, slot) < 0) {
+        disconnects++;
+        restart_session(slot);
+    }
+}
+
+static void fire_timers(uint64_t now) {
+    while (timers_count > 0 && timers[0].at <= now) {
+        Timer t = timer_pop();
+        Session* s = &sessions[t.slot];
+        if (s->generation != t.generation || s->fd < 0) {
+            continue;
+        }
+        if (send_request(t.slot, s->next_kind, s->next_type, s->next_data) < 0) {
+            disconnects++;
+            restart_session(t.slot);
+        }
+    }
+}
+
+static void print_report(double elapsed) {
+    printf("\n=== RISULTATI LOADGEN ===\n");
+    printf("Durata:              %.2f s\n", elapsed);
+    printf("Sessioni avviate:    %ld (completate %ld)\n", started, completed);
+    printf("Connessioni:         %ld (%.1f/s), errori %ld\n", connects, connects / elapsed, connect_errors);
+    printf("Messaggi inviati:    %ld (%.1f/s)\n", msgs_sent, msgs_sent / elapsed);
+    printf("Messaggi ricevuti:   %ld (%.1f/s)\n", msgs_recv, msgs_recv / elapsed);
+    printf("Errori del server:   %ld\n", server_errors);
+    printf("Domande scadute:     %ld\n", timeouts);
+    printf("Attese in coda:      %ld\n", admission_waits);
+    printf("Disconnessioni:      %ld\n", disconnects);
+    printf("\n%-12s %10s %10s %10s %10s %10s\n", "richiesta", "conteggio", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+    for (int i = 0; i < REQ_COUNT; i++) {
+        if (latency[i].count == 0) {
+            continue;
+        }
+        printf("%-12s %10llu %10llu %10llu %10llu %10llu\n", request_names[i],
+               (unsigned long long)latency[i].count,
+               (unsigned long long)histogram_percentile(&latency[i], 50.0),
+               (unsigned long long)histogram_percentile(&latency[i], 99.0),
+               (unsigned long long)histogram_percentile(&latency[i], 99.9),
+               (unsigned long long)latency[i].max);
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [-h host] [-p porta] [-c connessioni] [-n sessioni] [-d secondi]\n"
+                    "          [-t think_ms] [-r tasso_corrette] [-s tasso_classifica] [-q quiz_per_sessione] [-Q dir_quiz]\n", prog);
+    fprintf(stderr, "  -c  sessioni contemporanee (default %d)\n", config.connections);
+    fprintf(stderr, "  -n  sessioni totali, 0 = fino alla scadenza (default %ld)\n", config.sessions);
+    fprintf(stderr, "  -d  durata massima in secondi (default %d)\n", config.duration);
+    fprintf(stderr, "  -t  tempo medio di riflessione tra due richieste in ms (default %d)\n", config.think_ms);
+    fprintf(stderr, "  -r  probabilità di risposta corretta tra 0 e 1 (default %.2f)\n", config.correct_rate);
+    fprintf(stderr, "  -s  probabilità di chiedere la classifica prima di un tema (default %.2f)\n", config.score_rate);
+    fprintf(stderr, "  -q  quiz giocati per sessione (default %d)\n", config.quizzes);
+    fprintf(stderr, "  -Q  directory dei quiz per le risposte corrette (default %s)\n", config.quiz_dir);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:n:d:t:r:s:q:Q:")) != -1) {
+        switch (opt) {
+            case 'h': snprintf(config.host, sizeof(config.host), "%s", optarg); break;
+            case 'p': config.port = atoi(optarg); break;
+            case 'c': config.connections = atoi(optarg); break;
+            case 'n': config.sessions = atol(optarg); break;
+            case 'd': config.duration = atoi(optarg); break;
+            case 't': config.think_ms = atoi(optarg); break;
+            case 'r': config.correct_rate = atof(optarg); break;
+            case 's': config.score_rate = atof(optarg); break;
+            case 'q': config.quizzes = atoi(optarg); break;
+            case 'Q': snprintf(config.quiz_dir, sizeof(config.quiz_dir), "%s", optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (config.connections <= 0 || config.port <= 0 || config.port > 65535 || config.duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    srand((unsigned)(getpid() ^ clock_now_ns()));
+
+    if (load_answer_keys() == 0) {
+        fprintf(stderr, "Attenzione: risposte corrette non disponibili in %s, tutte le risposte saranno errate\n", config.quiz_dir);
+    }
+
+    sessions = calloc(config.connections, sizeof(Session));
+    timers_capacity = config.connections;
+    timers = calloc(timers_capacity, sizeof(Timer));
+    epoll_fd = epoll_create1(0);
+    if (!sessions || !timers || epoll_fd < 0) {
+        perror("Inizializzazione loadgen");
+        return 1;
+    }
+
+    printf("Loadgen: %d sessioni contemporanee verso %s:%d per %d s\n",
+           config.connections, config.host, config.port, config.duration);
+
+    uint64_t start = clock_now_ns();
+    uint64_t deadline = start + (uint64_t)config.duration * 1000000000ULL;
+    uint64_t next_report = start + LOADGEN_REPORT_MS * 1000000ULL;
+    long last_connects = 0, last_recv = 0;
+
+    for (int i = 0; i < config.connections; i++) {
+        sessions[i].fd = -1;
+        start_session(i);
+    }
+
+    struct epoll_event events[LOADGEN_MAX_EVENTS];
+    while (1) {
+        uint64_t now = clock_now_ns();
+        if (now >= deadline) {
+            break;
+        }
+
+        // Finite le sessioni richieste: si esce quando tutte sono chiuse
+        int active = 0;
+        for (int i = 0; i < config.connections && !active; i++) {
+            active = sessions[i].fd >= 0;
+        }
+        if (!active) {
+            break;
+        }
+
+        uint64_t wake = next_report < deadline ? next_report : deadline;
+        if (timers_count > 0 && timers[0].at < wake) {
+            wake = timers[0].at;
+        }
+        int timeout = wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+
+        int n = epoll_wait(epoll_fd, events, LOADGEN_MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int slot = (int)events[i].data.u32;
+            if (sessions[slot].fd < 0) {
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if (sessions[slot].phase == PHASE_CONNECT) {
+                    handle_writable(slot);
+                } else {
+                    handle_readable(slot);
+                }
+            } else if (events[i].events & EPOLLOUT) {
+                handle_writable(slot);
+            }
+        }
+
+        now = clock_now_ns();
+        fire_timers(now);
+
+        if (now >= next_report) {
+            printf("[%3.0fs] connessioni/s %ld, messaggi/s %ld, sessioni completate %ld\n",
+                   (now - start) / 1e9, connects - last_connects, msgs_recv - last_recv, completed);
+            fflush(stdout);
+            last_connects = connects;
+            last_recv = msgs_recv;
+            next_report += LOADGEN_REPORT_MS * 1000000ULL;
+        }
+    }
+
+    stopping = 1;
+    for (int i = 0; i < config.connections; i++) {
+        close_session(i);
+    }
+    close(epoll_fd);
+
+    print_report((clock_now_ns() - start) / 1e9);
+    free(sessions);
+    free(timers);
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "admin.h"
+#include "metrics.h"
+#include "session.h"
+#include "logger.h"
+#include "trace.h"
+#include "supervisor.h"
+#include "../shared/transport.h"
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static const char* state_names[] = { "libera", "attiva", "in attesa di ripresa" };
+
+/**
+ * Invia una riga della risposta
+ * @param fd Il socket del client di amministrazione
+ * @param format Il formato della riga (come printf)
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int reply_line(int fd, const char* format, ...) {
+    char line[MAX_MSG_LEN - MAX_TYPE_LEN];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    return send_msg(fd, ADMIN_REPLY_LINE, line);
+}
+
+/**
+ * Invia un testo su più righe, una riga della risposta per ogni '\n'
+ * @param fd Il socket del client di amministrazione
+ * @param text Il testo (viene modificato)
+ */
+static void reply_text(int fd, char* text) {
+    char* saveptr = NULL;
+    for (char* line = strtok_r(text, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)) {
+        if (send_msg(fd, ADMIN_REPLY_LINE, line) < 0) {
+            return;
+        }
+    }
+}
+
+static int cmd_help(int fd, char* arg) {
+    (void)arg;
+    reply_line(fd, "%-20s elenca le sessioni", ADMIN_CMD_SESSIONS);
+    reply_line(fd, "%-20s chiude la sessione di un giocatore", ADMIN_CMD_KICK " nickname");
+    reply_line(fd, "%-20s smette di accettare connessioni e termina a sessioni concluse", ADMIN_CMD_DRAIN);
+    reply_line(fd, "%-20s ricarica il catalogo dei temi per le nuove sessioni", ADMIN_CMD_RELOAD);
+    reply_line(fd, "%-20s metriche in formato Prometheus", ADMIN_CMD_METRICS);
+    reply_line(fd, "%-20s mostra o imposta il livello di log", ADMIN_CMD_LOGLEVEL " [livello]");
+    reply_line(fd, "%-20s punti di chiamata del lock con l'attesa maggiore (opzione -L)", ADMIN_CMD_LOCKS);
+    reply_line(fd, "%-20s traccia la sessione di un giocatore", ADMIN_CMD_TRACE " nickname");
+    reply_line(fd, "%-20s elenca i processi supervisionati", ADMIN_CMD_PROCESSES);
+    return 0;
+}
+
+static int cmd_sessions(int fd, char* arg) {
+    (void)arg;
+    Session sessions[MAX_CLIENTS];
+    int players;
+
+    // Copia breve sotto il lock, la formattazione avviene fuori dalla sezione critica
+    lock_shared_state();
+    memcpy(sessions, shared_state->sessions, sizeof(sessions));
+    players = shared_state->player_count;
+    unlock_shared_state();
+
+    int active = 0, detached = 0;
+    time_t now = time(NULL);
+    reply_line(fd, "%-*s %-8s %-22s %-5s %-8s %s", MAX_NICKNAME_LEN, "NICKNAME", "PID", "STATO", "TEMA",
+               "DOMANDA", "PUNTI");
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const Session* session = &sessions[i];
+        if (session->state == SESSION_FREE) {
+            continue;
+        }
+        char state[64];
+        if (session->state == SESSION_DETACHED) {
+            snprintf(state, sizeof(state), "%s (%lds)", state_names[session->state],
+                     (long)(now - session->detached_at));
+            detached++;
+        } else {
+            snprintf(state, sizeof(state), "%s", state_names[session->state]);
+            active++;
+        }
+        reply_line(fd, "%-*s %-8d %-22s %-5d %-8d %d", MAX_NICKNAME_LEN, session->nickname, (int)session->owner,
+                   state, session->theme, session->theme >= 0 ? session->current_question + 1 : 0, session->score);
+    }
+    return reply_line(fd, "%d sessioni attive, %d in attesa di ripresa, %d giocatori registrati",
+                      active, detached, players);
+}
+
+static int cmd_kick(int fd, char* arg) {
+    Session session;
+    if (session_find(arg, &session) < 0) {
+        send_msg(fd, MSG_ERROR, "Nessuna sessione per questo nickname");
+        return -1;
+    }
+
+    if (session.state == SESSION_DETACHED) {
+        if (session_release(arg) == 0) {
+            LOG_INFO("Sessione disconnessa di %s chiusa dall'amministratore", arg);
+            return reply_line(fd, "Sessione disconnessa di %s chiusa", arg);
+        }
+        // Ripresa nel frattempo: la sessione è di nuovo attiva
+        if (session_find(arg, &session) < 0) {
+            return reply_line(fd, "Sessione di %s già chiusa", arg);
+        }
+    }
+
+    if (kill(session.owner, ADMIN_KICK_SIGNAL) < 0) {
+        send_msg(fd, MSG_ERROR, "Processo della sessione non raggiungibile");
+        return -1;
+    }
+    LOG_INFO("Chiusura della sessione di %s (processo %d) richiesta dall'amministratore", arg, (int)session.owner);
+    return reply_line(fd, "Chiusura della sessione di %s richiesta al processo %d", arg, (int)session.owner);
+}
+
+static int cmd_drain(int fd, char* arg) {
+    (void)arg;
+    if (kill(getppid(), ADMIN_DRAIN_SIGNAL) < 0) {
+        send_msg(fd, MSG_ERROR, "Processo principale non raggiungibile");
+        return -1;
+    }
+    LOG_INFO("Drenaggio del server richiesto dall'amministratore");
+    return reply_line(fd, "Drenaggio avviato: nessuna nuova connessione, il server termina dopo %lld sessioni attive",
+                      (long long)__atomic_load_n(&shared_state->metrics.sessions_active, __ATOMIC_RELAXED));
+}
+
+static int cmd_reload(int fd, char* arg) {
+    (void)arg;
+    int generation = __atomic_load_n(&shared_state->catalog_generation, __ATOMIC_ACQUIRE);
+    if (kill(getppid(), ADMIN_RELOAD_SIGNAL) < 0) {
+        send_msg(fd, MSG_ERROR, "Processo principale non raggiungibile");
+        return -1;
+    }
+
+    // Il processo principale ricarica il catalogo appena esce dall'accept
+    for (int waited = 0; waited < ADMIN_RELOAD_WAIT_MS; waited += 10) {
+        if (__atomic_load_n(&shared_state->catalog_generation, __ATOMIC_ACQUIRE) != generation) {
+            return reply_line(fd, "Catalogo ricaricato: %d temi, validi per le nuove sessioni",
+                              __atomic_load_n(&shared_state->catalog_themes, __ATOMIC_RELAXED));
+        }
+        usleep(10000);
+    }
+    send_msg(fd, MSG_ERROR, "Il processo principale non ha confermato il ricaricamento");
+    return -1;
+}
+
+static int cmd_metrics(int fd, char* arg) {
+    (void)arg;
+    static char page[METRICS_PAGE_SIZE];
+    metrics_format(page, sizeof(page));
+    reply_text(fd, page);
+    return 0;
+}
+
+static int cmd_loglevel(int fd, char* arg) {
+    if (arg[0] != '\0') {
+        int level = parse_log_level(arg);
+        if (level < 0) {
+            send_msg(fd, MSG_ERROR, "Livello non valido (info, warning, error)");
+            return -1;
+        }
+        set_log_level(level);
+        LOG_WARNING("Livello di log impostato a %s dall'amministratore", log_level_name(level));
+    }
+    return reply_line(fd, "Livello di log: %s", log_level_name(shared_state->log_level));
+}
+
+static int cmd_locks(int fd, char* arg) {
+    (void)arg;
+    static char report[LOCK_MAX_SITES * 256];
+    if (!shared_state->locks.enabled) {
+        send_msg(fd, MSG_ERROR, "Profilo dei lock disattivato (avviare il server con -L)");
+        return -1;
+    }
+    if (lock_profile_report(report, sizeof(report), LOCK_MAX_SITES) == 0) {
+        return reply_line(fd, "Nessuna acquisizione registrata");
+    }
+    reply_text(fd, report);
+    return 0;
+}
+
+static int cmd_trace(int fd, char* arg) {
+    Session session;
+    if (session_find(arg, &session) < 0 || session.state != SESSION_ACTIVE) {
+        send_msg(fd, MSG_ERROR, "Nessuna sessione attiva per questo nickname");
+        return -1;
+    }
+    if (kill(session.owner, ADMIN_TRACE_SIGNAL) < 0) {
+        send_msg(fd, MSG_ERROR, "Processo della sessione non raggiungibile");
+        return -1;
+    }
+    return reply_line(fd, "Richiesta di traccia inviata al processo %d (file in %s/ a fine sessione, "
+                      "o subito a una seconda richiesta)", (int)session.owner, TRACE_DIR);
+}
+
+static int cmd_processes(int fd, char* arg) {
+    (void)arg;
+    // Le voci sono scritte solo dal processo principale: una copia senza lock basta per l'elenco
+    static ProcessEntry processes[PROCESS_TABLE_SIZE];
+    memcpy(processes, shared_state->processes, sizeof(processes));
+
+    int count = 0;
+    time_t now = time(NULL);
+    reply_line(fd, "%-16s %-8s %-8s %s", "TIPO", "PID", "DURATA", "GIOCATORE");
+    for (int i = 0; i < PROCESS_TABLE_SIZE; i++) {
+        const ProcessEntry* entry = &processes[i];
+        if (entry->kind == PROCESS_FREE || entry->pid <= 0) {
+            continue;
+        }
+        reply_line(fd, "%-16s %-8d %-8ld %s", process_kind_name(entry->kind), (int)entry->pid,
+                   (long)(now - entry->started_at), entry->nickname);
+        count++;
+    }
+    return reply_line(fd, "%d processi", count);
+}
+
+typedef struct {
+    const char* name;
+    int needs_arg;
+    int (*handler)(int fd, char* arg);
+} AdminCommand;
+
+static const AdminCommand commands[] = {
+    { ADMIN_CMD_HELP, 0, cmd_help },
+    { ADMIN_CMD_SESSIONS, 0, cmd_sessions },
+    { ADMIN_CMD_KICK, 1, cmd_kick },
+    { ADMIN_CMD_DRAIN, 0, cmd_drain },
+    { ADMIN_CMD_RELOAD, 0, cmd_reload },
+    { ADMIN_CMD_METRICS, 0, cmd_metrics },
+    { ADMIN_CMD_LOGLEVEL, 0, cmd_loglevel },
+    { ADMIN_CMD_LOCKS, 0, cmd_locks },
+    { ADMIN_CMD_TRACE, 1, cmd_trace },
+    { ADMIN_CMD_PROCESSES, 0, cmd_processes },
+};
+
+/**
+ * Crea il socket Unix del canale di amministrazione, accessibile solo al proprietario
+ * Il socket nasce già con i permessi 0600 (umask 0177 durante la bind): nessun altro utente
+ * può connettersi tra la bind e un chmod successivo
+ *
+ * @param path Il percorso del socket
+ * @return Il file descriptor del socket, -1 in caso di errore
+ */
+int admin_listen(const char* path) {
+    mode_t mask = umask(0177);
+    int fd = transport_unix_listen(path, 4);
+    umask(mask);
+    return fd;
+}
+
+/**
+ * Serve i comandi di un client di amministrazione finché questo non chiude la connessione
+ * (o resta inattivo per più di ADMIN_IO_TIMEOUT_SEC secondi), poi chiude il socket
+ *
+ * @param client_fd Il socket accettato
+ */
+void admin_serve(int client_fd) {
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+
+    struct timeval timeout = { ADMIN_IO_TIMEOUT_SEC, 0 };
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    while (recv_msg(client_fd, type, data) == 0) {
+        const AdminCommand* command = NULL;
+        for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+            if (strcasecmp(type, commands[i].name) == 0) {
+                command = &commands[i];
+                break;
+            }
+        }
+
+        if (command == NULL) {
+            send_msg(client_fd, MSG_ERROR, "Comando sconosciuto (HELP per l'elenco)");
+            continue;
+        }
+        if (command->needs_arg && data[0] == '\0') {
+            send_msg(client_fd, MSG_ERROR, "Argomento mancante");
+            continue;
+        }
+        // Un errore è già stato comunicato con MSG_ERROR: solo il successo chiude con MSG_END
+        if (command->handler(client_fd, data) == 0) {
+            send_msg(client_fd, MSG_END, "");
+        }
+    }
+    clean_up_socket(client_fd);
+}
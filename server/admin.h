@@ -0,0 +1,44 @@
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include "server.h"
+
+/*
+ * Canale di amministrazione su socket Unix (strumento quizctl_bin)
+ * - un processo dedicato serve i comandi, uno alla volta: il traffico di gioco non li attende mai
+ * - richieste e risposte usano lo stesso formato TIPO|LUNGHEZZA|DATI dei client:
+ *   il tipo è il comando, i dati il suo argomento
+ * - la risposta è una sequenza di righe ADMIN_REPLY_LINE chiusa da MSG_END,
+ *   oppure un MSG_ERROR con la descrizione dell'errore
+ * - drenaggio e ricaricamento del catalogo sono eseguiti dal processo principale,
+ *   che li riceve con un segnale (ADMIN_DRAIN_SIGNAL, ADMIN_RELOAD_SIGNAL)
+ */
+
+#define ADMIN_SOCKET_PATH "quiz-admin.sock" // Percorso predefinito del socket (opzione -A)
+#define ADMIN_IO_TIMEOUT_SEC 5              // Attesa massima di un comando e della sua risposta
+#define ADMIN_RELOAD_WAIT_MS 2000           // Attesa massima della conferma del ricaricamento
+
+#define ADMIN_DRAIN_SIGNAL SIGUSR2  // Al processo principale: smette di accettare connessioni
+#define ADMIN_RELOAD_SIGNAL SIGHUP  // Al processo principale: ricarica il catalogo dei temi
+#define ADMIN_KICK_SIGNAL SIGTERM   // Al processo figlio: chiude la sessione
+#define ADMIN_TRACE_SIGNAL SIGUSR1  // Al processo figlio: traccia la sessione (vedi trace.h)
+
+// Comandi
+#define ADMIN_CMD_HELP "HELP"
+#define ADMIN_CMD_SESSIONS "SESSIONS"
+#define ADMIN_CMD_KICK "KICK"
+#define ADMIN_CMD_DRAIN "DRAIN"
+#define ADMIN_CMD_RELOAD "RELOAD"
+#define ADMIN_CMD_METRICS "METRICS"
+#define ADMIN_CMD_LOGLEVEL "LOGLEVEL"
+#define ADMIN_CMD_LOCKS "LOCKS"
+#define ADMIN_CMD_TRACE "TRACE"
+#define ADMIN_CMD_PROCESSES "PROCESSES"
+
+// Riga della risposta a un comando
+#define ADMIN_REPLY_LINE "LINE"
+
+int admin_listen(const char* path);
+void admin_serve(int client_fd);
+
+#endif
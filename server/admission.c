@@ -0,0 +1,116 @@
+#include "admission.h"
+#include "logger.h"
+#include "timer.h"
+
+/**
+ * Mette in coda il processo di sessione corrente
+ * @return L'indice della voce in coda, -1 se la coda è piena
+ */
+int admission_enqueue(void) {
+    AdmissionQueue* queue = &shared_state->admission;
+
+    lock_shared_state();
+    for (int i = 0; i < ADMISSION_QUEUE_SIZE; i++) {
+        AdmissionEntry* entry = &queue->entries[i];
+        if (entry->pid == 0) {
+            entry->pid = getpid();
+            entry->ticket = ++queue->next_ticket;
+            queue->waiting++;
+            unlock_shared_state();
+            return i;
+        }
+    }
+    unlock_shared_state();
+    return -1;
+}
+
+/**
+ * Calcola la posizione in coda e l'attesa stimata
+ * @param index La voce in coda (vedi admission_enqueue)
+ * @param eta_sec Output: l'attesa stimata in secondi, -1 se ancora nessuno slot è stato liberato
+ * @return La posizione, 1 per il primo della coda
+ */
+int admission_position(int index, int* eta_sec) {
+    AdmissionQueue* queue = &shared_state->admission;
+    int position = 1;
+
+    lock_shared_state();
+    uint64_t ticket = queue->entries[index].ticket;
+    for (int i = 0; i < ADMISSION_QUEUE_SIZE; i++) {
+        if (queue->entries[i].pid != 0 && queue->entries[i].ticket < ticket) {
+            position++;
+        }
+    }
+    uint64_t interval = queue->release_interval_ms;
+    unlock_shared_state();
+
+    *eta_sec = interval > 0 ? (int)((position * interval + 999) / 1000) : -1;
+    return position;
+}
+
+/**
+ * Esce dalla coda (registrazione riuscita, disconnessione o nickname occupato)
+ * @param index La voce in coda
+ */
+void admission_leave(int index) {
+    AdmissionQueue* queue = &shared_state->admission;
+
+    lock_shared_state();
+    if (queue->entries[index].pid == getpid()) {
+        queue->entries[index].pid = 0;
+        queue->waiting--;
+    }
+    unlock_shared_state();
+}
+
+/**
+ * Indica se ci sono client in coda: un nuovo client non scavalca chi attende
+ * @return Il numero di client in coda
+ */
+int admission_waiting(void) {
+    return __atomic_load_n(&shared_state->admission.waiting, __ATOMIC_RELAXED);
+}
+
+/**
+ * Annota uno slot del giocatore appena liberato, per la stima dell'attesa
+ * (chiamata con il lock dello stato acquisito, vedi remove_player)
+ */
+void admission_slot_freed(void) {
+    AdmissionQueue* queue = &shared_state->admission;
+    uint64_t now = timer_now_ms();
+
+    if (queue->last_release_ms != 0) {
+        uint64_t sample = now - queue->last_release_ms;
+        if (sample > ADMISSION_INTERVAL_MAX_MS) {
+            sample = ADMISSION_INTERVAL_MAX_MS;
+        }
+        // Media mobile esponenziale con peso 1/8 al nuovo campione
+        queue->release_interval_ms = queue->release_interval_ms == 0
+            ? sample
+            : (queue->release_interval_ms * 7 + sample) / 8;
+    }
+    queue->last_release_ms = now;
+}
+
+/**
+ * Libera le voci in coda di un processo di sessione terminato senza uscirne (processo principale)
+ * @param pid Il processo terminato
+ */
+void admission_reclaim(pid_t pid) {
+    AdmissionQueue* queue = &shared_state->admission;
+    int reclaimed = 0;
+
+    lock_shared_state();
+    for (int i = 0; i < ADMISSION_QUEUE_SIZE; i++) {
+        if (queue->entries[i].pid == pid) {
+            queue->entries[i].pid = 0;
+            queue->waiting--;
+            reclaimed++;
+        }
+    }
+    unlock_shared_state();
+
+    if (reclaimed > 0) {
+        LOG_WARNING("Voce della coda di ammissione del processo %d liberata", (int)pid);
+    }
+}
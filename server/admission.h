@@ -0,0 +1,31 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "server.h"
+
+/*
+ * Coda di ammissione dei client oltre la capienza (MAX_CLIENTS giocatori)
+ * - il client che si registra a server pieno non viene più disconnesso: il processo di sessione
+ *   entra in coda con un biglietto progressivo e invia WAIT|posizione,attesa stimata in secondi
+ *   a ogni cambio di posizione
+ * - solo il primo della coda tenta la registrazione, a ogni ADMISSION_POLL_MS: gli slot liberati
+ *   vanno ai client in ordine di arrivo, e un nuovo client non scavalca la coda
+ * - l'attesa stimata è la posizione per la media mobile dell'intervallo tra due slot liberati
+ * - l'attesa in coda è limitata a ADMISSION_TIMEOUT_SEC: la scadenza della registrazione non vale
+ *   in coda, ma un client non registrato non resta connesso indefinitamente
+ * - a coda piena il client riceve "Server pieno" come prima; la voce di un processo terminato
+ *   senza uscire dalla coda viene liberata dal processo principale (vedi supervisor.c)
+ */
+
+#define ADMISSION_POLL_MS 250           // Intervallo tra due tentativi di registrazione del primo in coda
+#define ADMISSION_INTERVAL_MAX_MS 60000 // Campione massimo dell'intervallo tra due slot liberati
+#define ADMISSION_TIMEOUT_SEC 600       // Attesa massima in coda prima della disconnessione
+
+int admission_enqueue(void);
+int admission_position(int index, int* eta_sec);
+void admission_leave(int index);
+int admission_waiting(void);
+void admission_slot_freed(void);
+void admission_reclaim(pid_t pid);
+
+#endif
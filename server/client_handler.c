@@ -2,13 +2,314 @@
 #include "quiz.h"
 #include "server.h"
 #include "logger.h"
+#include "session.h"
+#include "metrics.h"
+#include "trace.h"
+#include "admin.h"
+#include "supervisor.h"
+#include "room.h"
+#include "timer.h"
+#include "ratelimit.h"
+#include "admission.h"
+#include "config.h"
+#include "../shared/transport.h"
 #include <ctype.h>
+#include <errno.h>
 
-// Gestore di segnali semplice per i processi client
-static void client_signal_handler(int sig) {
-    if (sig == SIGPIPE) {
-        // Client disconnesso - termina silenziosamente
-        exit(0);
+#define CLIENT_RECV_EXPIRED 1 // client_recv: è scaduto un timer della sessione prima di un messaggio
+
+// Stato di una connessione servita da handle_client
+typedef struct {
+    int socket;
+    char nickname[MAX_NICKNAME_LEN];
+    int slot;           // Slot della sessione in memoria condivisa, -1 prima della registrazione
+    int registered;     // 1 dopo la registrazione del nickname
+    int request_type;   // MetricType della richiesta in servizio, -1 se in attesa del client
+    uint64_t request_start;
+    size_t request_bytes;
+    Timer question_timer;   // Scadenza della domanda aperta (vedi timer.h)
+    uint64_t question_sent; // Istante di invio della domanda aperta, in ms (orologio dei timer)
+    int question_open;      // 1 dopo l'invio della domanda, fino alla risposta o alla scadenza
+    int question_expired;   // Impostato dal timer: la domanda aperta è scaduta
+    int timeout_unacked;    // RESULT|TIMEOUT inviato, in attesa dell'OK del client
+    Timer deadline_timer;   // Scadenza della registrazione, poi dell'inattività tra due richieste
+    Timer message_timer;    // Scadenza del messaggio iniziato e non ancora completo
+    int passive;            // 1 mentre il client riceve dal processo delle stanze senza dover inviare richieste
+    int evicted;            // EvictReason + 1 quando una scadenza della connessione è passata, 0 altrimenti
+    RateKey rate_key;       // Indirizzo del client per i limiti di frequenza
+    int rate_limited;       // 1 se i messaggi del client sono soggetti ai limiti (vedi ratelimit.h)
+} ClientContext;
+
+// Scadenze delle connessioni in secondi, 0 se disattivate (vedi set_client_timeouts)
+static int handshake_timeout_sec = HANDSHAKE_TIMEOUT_SEC;
+static int idle_timeout_sec = IDLE_TIMEOUT_SEC;
+static int message_timeout_sec = MESSAGE_TIMEOUT_SEC;
+
+// Chiamata a fine sessione al posto di exit(0) (vedi set_session_exit_hook)
+static void (*session_exit_hook)(void) = NULL;
+
+// Chiusura della sessione richiesta dal canale di amministrazione (ADMIN_KICK_SIGNAL)
+static volatile sig_atomic_t kicked = 0;
+static int kick_socket = -1;
+
+/**
+ * Gestore di ADMIN_KICK_SIGNAL e SESSION_TAKEOVER_SIGNAL: chiude il lato di lettura del socket,
+ * così la ricezione in corso (o la prossima) fallisce e la sessione termina dal percorso di uscita
+ * consueto. Con SESSION_TAKEOVER_SIGNAL (ripresa da un'altra connessione) la sessione viene
+ * sospesa come per una disconnessione, invece di essere chiusa
+ */
+static void kick_handler(int sig)
+{
+    if (sig == ADMIN_KICK_SIGNAL)
+    {
+        kicked = 1;
+    }
+    if (kick_socket >= 0)
+    {
+        shutdown(kick_socket, SHUT_RD);
+    }
+}
+
+/**
+ * Imposta la funzione chiamata alla fine di ogni sessione
+ * Il processo figlio termina con exit(0); chi esegue più sessioni nello stesso processo
+ * (simulazione su trasporto in memoria) passa qui una funzione che non ritorna
+ *
+ * @param hook La funzione, NULL per il comportamento predefinito
+ */
+void set_session_exit_hook(void (*hook)(void))
+{
+    session_exit_hook = hook;
+}
+
+/**
+ * Imposta le scadenze delle connessioni dei client (prima di accettarne)
+ * Una connessione che non si registra, un client registrato inattivo e un messaggio iniziato e
+ * non completato (client lento o slowloris) non trattengono più un processo figlio e uno slot
+ * del giocatore: allo scadere la connessione viene chiusa come una disconnessione.
+ *
+ * @param handshake_sec Attesa massima della registrazione dopo la connessione
+ * @param idle_sec Inattività massima di un client registrato tra due richieste
+ * @param message_sec Tempo massimo per completare un messaggio iniziato
+ */
+void set_client_timeouts(int handshake_sec, int idle_sec, int message_sec)
+{
+    handshake_timeout_sec = handshake_sec;
+    idle_timeout_sec = idle_sec;
+    message_timeout_sec = message_sec;
+}
+
+// Timer della registrazione e dell'inattività
+static void deadline_expired(void *arg)
+{
+    ClientContext *ctx = arg;
+    ctx->evicted = (ctx->registered ? EVICT_IDLE : EVICT_HANDSHAKE) + 1;
+}
+
+// Timer del messaggio incompleto
+static void message_expired(void *arg)
+{
+    ((ClientContext *)arg)->evicted = EVICT_MESSAGE + 1;
+}
+
+/**
+ * Chiude la misura della richiesta in servizio (vedi metrics.h)
+ * @param ctx La connessione del client
+ */
+static void finish_request(ClientContext *ctx)
+{
+    if (ctx->request_type >= 0)
+    {
+        metrics_record(ctx->request_type, clock_now_ns() - ctx->request_start, ctx->request_bytes);
+        TRACE_END(ctx->request_start, "request", "request", metric_name(ctx->request_type));
+        ctx->request_type = -1;
+    }
+}
+
+/**
+ * Attende che il client abbia inviato un messaggio completo, eseguendo i timer che scadono
+ * nel frattempo. I byte vengono letti man mano che arrivano: un messaggio iniziato deve
+ * completarsi entro message_timeout_sec.
+ *
+ * @param ctx La connessione del client
+ * @param question 1 per interrompere l'attesa alla scadenza della domanda aperta
+ * @return 0 se recv_msg non attenderebbe, -1 se l'attesa è fallita o è scaduta una delle
+ *         scadenze della connessione, CLIENT_RECV_EXPIRED se è scaduta la domanda aperta
+ */
+static int client_wait(ClientContext *ctx, int question)
+{
+    // Senza timer attivi transport_wait ritorna subito e la recv attende da sola, salvo con la
+    // scadenza dei messaggi: anche chi riceve senza altre scadenze (classifiche seguite, stanze,
+    // idle_timeout 0) legge i byte man mano, per avviare message_timer su un messaggio iniziato
+    while (1)
+    {
+        int wait = timer_next_ms();
+        if (wait < 0 && message_timeout_sec > 0)
+        {
+            wait = message_timeout_sec * 1000;
+        }
+        int ready = transport_wait(ctx->socket, wait);
+        if (ready < 0)
+        {
+            return -1;
+        }
+        if (ready > 0)
+        {
+            if (wait < 0 || transport_fill(ctx->socket))
+            {
+                timer_cancel(&ctx->message_timer);
+                return 0;
+            }
+            if (message_timeout_sec > 0 && !timer_pending(&ctx->message_timer))
+            {
+                timer_start(&ctx->message_timer, (uint64_t)message_timeout_sec * 1000, message_expired, ctx);
+            }
+            continue;
+        }
+
+        timer_run();
+        if (ctx->evicted)
+        {
+            EvictReason reason = ctx->evicted - 1;
+            LOG_EVENT(LOG_INFO, EV_SESSION_EVICTED, ctx->registered ? ctx->nickname : "(non registrato)", reason);
+            metrics_session_evicted(reason);
+            return -1;
+        }
+        if (question && ctx->question_expired)
+        {
+            return CLIENT_RECV_EXPIRED;
+        }
+    }
+}
+
+/**
+ * Preleva il token del messaggio appena ricevuto: oltre il limite dell'indirizzo la sessione
+ * attende il token prima di elaborarlo, e chiude la connessione se l'attesa supererebbe
+ * RATE_MAX_DELAY_MS (il client invia più in fretta di quanto il limite consenta)
+ *
+ * @param ctx La connessione del client
+ * @return 0 se il messaggio va elaborato, -1 se la connessione va chiusa
+ */
+static int client_throttle(ClientContext *ctx)
+{
+    if (!ctx->rate_limited)
+    {
+        return 0;
+    }
+    int delay_ms = rate_message_delay_ms(&ctx->rate_key);
+    if (delay_ms < 0)
+    {
+        ctx->evicted = EVICT_FLOOD + 1;
+        LOG_EVENT(LOG_INFO, EV_SESSION_EVICTED, ctx->registered ? ctx->nickname : "(non registrato)", EVICT_FLOOD);
+        metrics_session_evicted(EVICT_FLOOD);
+        return -1;
+    }
+    if (delay_ms > 0)
+    {
+        usleep((useconds_t)delay_ms * 1000);
+    }
+    return 0;
+}
+
+/**
+ * Riceve la prossima richiesta del client e ne avvia la misura
+ * Le risposte interne a uno scambio (conferme delle classifiche e della lista temi)
+ * si ricevono con client_reply e restano nel tempo della richiesta che le ha originate.
+ * Con un timer attivo l'attesa dura al più fino alla scadenza successiva; i messaggi già
+ * arrivati hanno la precedenza sulle scadenze.
+ *
+ * @param ctx La connessione del client
+ * @param type Output: il tipo del messaggio
+ * @param data Output: il payload del messaggio
+ * @return 0 se successo, -1 se il client si è disconnesso o è scaduta una delle scadenze della
+ *         connessione, CLIENT_RECV_EXPIRED se è scaduta la domanda aperta (nessun messaggio ricevuto)
+ */
+static int client_recv(ClientContext *ctx, char *type, char *data)
+{
+    finish_request(ctx);
+    trace_poll_dump();
+
+    // Prima della registrazione vale la scadenza della connessione (avviata da handle_client);
+    // chi segue le classifiche o una stanza riceve senza dover inviare richieste
+    if (ctx->registered)
+    {
+        if (idle_timeout_sec > 0 && !ctx->passive)
+            timer_start(&ctx->deadline_timer, (uint64_t)idle_timeout_sec * 1000, deadline_expired, ctx);
+        else
+            timer_cancel(&ctx->deadline_timer);
+    }
+
+    // Domanda scaduta durante uno scambio interno (classifiche chieste a metà quiz)
+    if (ctx->question_expired)
+    {
+        return CLIENT_RECV_EXPIRED;
+    }
+
+    int ready = client_wait(ctx, 1);
+    if (ready != 0)
+    {
+        return ready;
+    }
+    if (recv_msg(ctx->socket, type, data) < 0 || client_throttle(ctx) < 0)
+    {
+        return -1;
+    }
+    ctx->request_type = metric_type(type);
+    ctx->request_start = clock_now_ns();
+    ctx->request_bytes = strlen(data);
+    return 0;
+}
+
+/**
+ * Riceve la risposta del client all'interno di uno scambio, con le stesse scadenze di client_recv
+ * (la domanda aperta che scade nel frattempo viene gestita alla richiesta successiva)
+ *
+ * @param ctx La connessione del client
+ * @param type Output: il tipo del messaggio
+ * @param data Output: il payload del messaggio
+ * @return 0 se successo, -1 se il client si è disconnesso o è scaduta una delle scadenze della connessione
+ */
+static int client_reply(ClientContext *ctx, char *type, char *data)
+{
+    if (client_wait(ctx, 0) < 0 || recv_msg(ctx->socket, type, data) < 0)
+    {
+        return -1;
+    }
+    return client_throttle(ctx);
+}
+
+static void end_session(ClientContext *ctx)
+{
+    // La ruota dei timer è del processo: nella simulazione sopravvive alla sessione
+    timer_cancel(&ctx->question_timer);
+    timer_cancel(&ctx->deadline_timer);
+    timer_cancel(&ctx->message_timer);
+
+    // Sessione chiusa o sospesa in modo ordinato: il processo principale non deve recuperarla
+    process_finished();
+    if (trace_active)
+    {
+        trace_dump();
+    }
+    metrics_session_change(-1);
+    if (session_exit_hook)
+    {
+        session_exit_hook();
+    }
+    // Termina il processo figlio (non influenza il server principale)
+    exit(0);
+}
+
+/**
+ * Registra la chiusura della connessione da parte della coda di uscita, se il client non leggeva
+ * @param ctx La connessione del client
+ */
+static void note_slow_consumer(ClientContext *ctx)
+{
+    if (transport_output_stalled(ctx->socket))
+    {
+        LOG_WARNING("Connessione di %s chiusa: il client non legge i messaggi", ctx->registered ? ctx->nickname : "(non registrato)");
+        metrics_slow_consumer();
     }
 }
 
@@ -16,27 +317,587 @@ static void client_signal_handler(int sig) {
  * Pulisce le risorse associate a un client e termina il processo figlio
  * Chiamata quando un client si disconnette o si verifica un errore
  * 
- * @param socket Il socket del client da chiudere
- * @param nickname Il nickname del client da rimuovere dalla memoria condivisa
- * @param registered Flag che indica se il client era registrato (1) o no (0)
+ * @param ctx La connessione: socket da chiudere, nickname da rimuovere dalla memoria condivisa
+ *            se il client era registrato
  */
-static void cleanup_and_exit(int socket, const char *nickname, int registered)
+static void cleanup_and_exit(ClientContext *ctx)
 {
+    finish_request(ctx);
+    note_slow_consumer(ctx);
+
+    if (kicked)
+    {
+        LOG_INFO("Sessione di %s chiusa dall'amministratore", ctx->registered ? ctx->nickname : "(non registrato)");
+        send_msg(ctx->socket, MSG_ERROR, "Sessione chiusa dall'amministratore");
+    }
+    else if (ctx->evicted == EVICT_HANDSHAKE + 1)
+    {
+        send_msg(ctx->socket, MSG_ERROR, "Tempo scaduto per la registrazione");
+    }
+    else if (ctx->evicted == EVICT_FLOOD + 1)
+    {
+        send_msg(ctx->socket, MSG_ERROR, "Troppi messaggi, connessione chiusa");
+    }
+
     // Chiude il socket del client
-    clean_up_socket(socket);
+    clean_up_socket(ctx->socket);
 
     // Se il client era registrato, rimuovilo dalla lista dei giocatori attivi
-    if (registered && nickname && strlen(nickname) > 0)
+    if (ctx->registered && strlen(ctx->nickname) > 0)
     {
-        LOG_INFO("Chiusura connessione per il client %s", nickname);
-        remove_player(nickname);
+        LOG_EVENT(LOG_INFO, EV_SESSION_END, ctx->nickname);
+        // Una sessione ripresa nel frattempo da un'altra connessione appartiene al nuovo processo,
+        // insieme al giocatore
+        if (session_close(ctx->slot))
+        {
+            remove_player(ctx->nickname);
+        }
         
         // Aggiorna la visualizzazione dello stato dei giocatori sulla console del server
         print_players_status();
     }
 
-    // Termina il processo figlio (non influenza il server principale)
-    exit(0);
+    end_session(ctx);
+}
+
+/**
+ * Gestisce la caduta della connessione di un client registrato
+ * La sessione (e il nickname) restano riservati per SESSION_GRACE_SEC secondi,
+ * in attesa che il client si riconnetta con il token di ripresa
+ *
+ * @param ctx La connessione del client
+ * @param theme Il tema del quiz in corso, -1 se nessun quiz è in corso
+ * @param current_question La prossima domanda da porre
+ */
+static void detach_and_exit(ClientContext *ctx, int theme, int current_question)
+{
+    // Una sessione chiusa dall'amministratore non resta in attesa di ripresa
+    if (ctx->slot < 0 || kicked)
+    {
+        cleanup_and_exit(ctx);
+    }
+    note_slow_consumer(ctx);
+    if (ctx->evicted == EVICT_FLOOD + 1)
+    {
+        send_msg(ctx->socket, MSG_ERROR, "Troppi messaggi, connessione chiusa");
+    }
+
+    clean_up_socket(ctx->socket);
+    LOG_EVENT(LOG_INFO, EV_SESSION_DETACHED, ctx->nickname, theme, current_question + 1);
+    session_detach(ctx->slot);
+    end_session(ctx);
+}
+
+/**
+ * Invia al client le classifiche di tutti i temi, attendendo un OK dopo ciascuna
+ * @param ctx La connessione del client
+ * @param theme Il tema del quiz in corso (per la ripresa in caso di disconnessione), -1 se nessuno
+ * @param current_question La domanda corrente del quiz in corso
+ */
+static void send_leaderboards(ClientContext *ctx, int theme, int current_question)
+{
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+
+    LOG_EVENT(LOG_INFO, EV_SCORE_REQUEST, ctx->nickname);
+
+    // Invia le classifiche per ogni tema disponibile
+    for (int i = 0; i < themes_count; i++)
+    {
+        // Recupera la classifica per questo tema
+        get_leaderboard(i, data);
+
+        if (strlen(data) > 0)
+        {
+            // Invia la classifica al client
+            send_msg(ctx->socket, MSG_SCORELIST, data);
+        }
+        else
+        {
+            // Nessun punteggio disponibile, invia classifica vuota con solo il numero del tema
+            char empty_score[16];
+            snprintf(empty_score, sizeof(empty_score), "%d", i);
+            send_msg(ctx->socket, MSG_SCORELIST, empty_score);
+        }
+
+        // Attendi conferma di ricezione dal client prima di inviare la prossima
+        if (client_reply(ctx, type, data) < 0)
+        {
+            LOG_WARNING("Client %s disconnesso durante la ricezione della classifica", ctx->nickname);
+            detach_and_exit(ctx, theme, current_question);
+        }
+        if (strcmp(type, MSG_OK) != 0)
+        {
+            LOG_WARNING("Client %s ha inviato un messaggio inatteso durante la ricezione della classifica", ctx->nickname);
+        }
+    }
+
+    // Invia un messaggio finale per indicare che tutte le classifiche sono state inviate
+    send_msg(ctx->socket, MSG_END_SCORE, "");
+}
+
+// Timer della domanda aperta: la scadenza viene gestita da client_recv
+static void question_expired(void *arg)
+{
+    ((ClientContext *)arg)->question_expired = 1;
+}
+
+/**
+ * Chiude la domanda corrente (risposta o tempo scaduto) e salva il punteggio
+ * @param ctx La connessione del client
+ * @param choice Il tema del quiz
+ * @param quiz Il quiz
+ * @param current_question La domanda corrente, avanzata alla successiva
+ * @param score Il punteggio accumulato
+ */
+static void close_question(ClientContext *ctx, int choice, Quiz *quiz, int *current_question, int score)
+{
+    timer_cancel(&ctx->question_timer);
+    ctx->question_open = 0;
+    ctx->question_expired = 0;
+    (*current_question)++;
+
+    // Verifica se il quiz è stato completato (tutte le domande risposte)
+    int quiz_completed = (*current_question >= quiz->count);
+
+    // Salva il punteggio nella memoria condivisa
+    // Se quiz_completed=1, il tema viene marcato come completato
+    TRACE_BEGIN(save_start);
+    save_score(choice, ctx->nickname, score, quiz_completed);
+    TRACE_END(save_start, "quiz", "save_score", NULL);
+    session_update(ctx->slot, choice, *current_question, score);
+}
+
+/**
+ * Gestisce il ciclo delle domande di un quiz, a partire da current_question
+ * (0 per un quiz nuovo, la domanda salvata nella sessione per un quiz ripreso)
+ * Ogni domanda ha QUESTION_TIME_SEC secondi dall'invio: una risposta corretta vale più punti
+ * quanto prima arriva (vedi answer_points); allo scadere il server invia RESULT|TIMEOUT e
+ * ignora risposte e richieste del client fino alla conferma (OK).
+ *
+ * @param ctx La connessione del client
+ * @param choice Il tema del quiz
+ * @param quiz Il quiz caricato
+ * @param current_question La prima domanda da porre
+ * @param score Il punteggio già accumulato nel quiz
+ * @return 1 se il client resta in sessione, 0 se ha chiesto di terminare
+ */
+static int run_quiz(ClientContext *ctx, int choice, Quiz *quiz, int current_question, int score)
+{
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+    Question *q = NULL;
+
+    session_update(ctx->slot, choice, current_question, score);
+
+    // QUIZ - Ciclo principale che gestisce tutte le domande del quiz
+    ctx->question_open = 0;
+    ctx->timeout_unacked = 0;
+    while (current_question < quiz->count)
+    {
+        int received = client_recv(ctx, type, data);
+        if (received < 0)
+        {
+            LOG_WARNING("Client %s disconnesso durante il quiz alla domanda %d", ctx->nickname, current_question + 1);
+            detach_and_exit(ctx, choice, current_question);
+        }
+
+        if (received == CLIENT_RECV_EXPIRED)
+        {
+            // Tempo scaduto: la domanda vale come risposta sbagliata
+            send_msg(ctx->socket, MSG_RESULT, RESP_TIMEOUT);
+            LOG_EVENT(LOG_INFO, EV_QUESTION_TIMEOUT, ctx->nickname, choice, current_question + 1);
+            ctx->timeout_unacked = 1;
+            close_question(ctx, choice, quiz, &current_question, score);
+            continue;
+        }
+
+        print_players_status();
+
+        if (ctx->timeout_unacked)
+        {
+            // Risposta in ritardo o richiesta partita prima di ricevere TIMEOUT: il client
+            // ha già il suo risultato e chiederà la domanda successiva dopo la conferma
+            if (strcmp(type, MSG_OK) == 0)
+            {
+                ctx->timeout_unacked = 0;
+            }
+            if (strcmp(type, MSG_ANSWER) == 0 || strcmp(type, MSG_QUIZ_START) == 0 || strcmp(type, MSG_OK) == 0)
+            {
+                continue;
+            }
+        }
+
+        if (strcmp(type, MSG_QUIZ_START) == 0)
+        {
+            // Il client richiede la prossima domanda (o la stessa se ha chiesto la classifica)
+            q = get_question(quiz, current_question);
+            if (!q)
+                break;
+
+            send_msg(ctx->socket, MSG_QUESTION, q->question);
+
+            // La scadenza parte dal primo invio: richiedere di nuovo la domanda non la sposta
+            if (!ctx->question_open)
+            {
+                ctx->question_open = 1;
+                ctx->question_sent = timer_now_ms();
+                timer_start(&ctx->question_timer, QUESTION_TIME_SEC * 1000, question_expired, ctx);
+            }
+        }
+        else if (strcmp(type, MSG_ANSWER) == 0)
+        {
+            // La risposta si riferisce sempre alla domanda corrente, anche se non è stata richiesta
+            q = get_question(quiz, current_question);
+            if (!q)
+                break;
+
+            // Il client ha inviato una risposta, verificala
+            TRACE_BEGIN(check_start);
+            int correct = check_answer(q, data);
+            TRACE_END(check_start, "quiz", "check_answer", NULL);
+
+            if (correct)
+            {
+                // Una risposta a una domanda mai inviata (client che non chiede QUIZ_START) vale il minimo
+                int points = ctx->question_open ? answer_points(timer_now_ms() - ctx->question_sent) : QUIZ_POINTS_MIN;
+                char result[32];
+                snprintf(result, sizeof(result), "%s %d", RESP_CORRECT, points);
+                score += points;
+                send_msg(ctx->socket, MSG_RESULT, result);
+            }
+            else
+            {
+                send_msg(ctx->socket, MSG_RESULT, RESP_WRONG);
+            }
+            LOG_EVENT(LOG_INFO, EV_ANSWER, ctx->nickname, choice, current_question + 1, correct);
+
+            close_question(ctx, choice, quiz, &current_question, score);
+        }
+        else if (strcmp(type, MSG_SCORE) == 0)
+        {
+            // Il client ha richiesto la classifica durante il quiz
+            send_leaderboards(ctx, choice, current_question);
+        }
+        else if (strcmp(type, MSG_END) == 0)
+        {
+            // Il client ha scelto di terminare il quiz prematuramente
+            LOG_EVENT(LOG_INFO, EV_QUIZ_ABORTED, ctx->nickname, choice, current_question + 1);
+            timer_cancel(&ctx->question_timer);
+            return 0;
+        }
+    }
+    timer_cancel(&ctx->question_timer);
+
+    if (current_question >= quiz->count)
+    {
+        // Quiz completato: tutte le domande sono state risposte
+        send_msg(ctx->socket, MSG_RESULT, RESP_QUIZ_COMPLETE);
+        LOG_EVENT(LOG_INFO, EV_QUIZ_COMPLETED, ctx->nickname, choice, score);
+    }
+    session_update(ctx->slot, -1, 0, 0);
+    return 1;
+}
+
+/**
+ * Partecipa all'evento della stanza dal vivo di un tema (vedi room.h)
+ * Dopo l'ingresso i messaggi della stanza li invia il processo delle stanze: questo processo
+ * riceve soltanto le risposte e non scrive sul socket finché il socket non gli viene restituito.
+ * Il client conferma MSG_ROOM_END con MSG_OK e riceve le proprie risposte corrette.
+ *
+ * @param ctx La connessione del client
+ * @param room Il tema della stanza
+ */
+static void run_room(ClientContext *ctx, int room)
+{
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+    int correct = 0;
+
+    int seat = room_join(room, ctx->socket, ctx->nickname);
+    if (seat < 0)
+    {
+        send_msg(ctx->socket, MSG_ERROR, "Stanza non disponibile");
+        return;
+    }
+    LOG_INFO("Cliente %s è entrato nella stanza del tema %d", ctx->nickname, room);
+    ctx->passive = 1;
+
+    while (1)
+    {
+        if (client_recv(ctx, type, data) < 0)
+        {
+            // Il socket deve tornare a questo processo prima di chiudere la sessione
+            room_leave(seat, 1);
+            LOG_WARNING("Client %s disconnesso nella stanza del tema %d", ctx->nickname, room);
+            detach_and_exit(ctx, -1, 0);
+        }
+
+        // Il client conferma MSG_ROOM_END: il processo delle stanze ha inviato la fine e sta
+        // rilasciando il socket (un OK anticipato vale come uscita dalla stanza)
+        if (strcmp(type, MSG_OK) == 0)
+        {
+            room_leave(seat, 1);
+            break;
+        }
+        if (room_released(seat))
+        {
+            // Risposte arrivate dopo la fine dell'evento
+            continue;
+        }
+
+        if (strcmp(type, MSG_ANSWER) == 0)
+        {
+            correct += room_answer(seat, data) > 0;
+        }
+        else if (strcmp(type, MSG_ROOM_LEAVE) == 0 || strcmp(type, MSG_END) == 0)
+        {
+            room_leave(seat, 0);
+        }
+    }
+
+    ctx->passive = 0;
+    snprintf(data, sizeof(data), "%d", correct);
+    send_msg(ctx->socket, MSG_OK, data);
+    LOG_INFO("Cliente %s è uscito dalla stanza del tema %d con %d risposte corrette", ctx->nickname, room, correct);
+}
+
+/**
+ * Segue le classifiche di alcuni temi (vedi room_subscribe): gli aggiornamenti li invia il
+ * processo delle stanze, questo processo attende soltanto la richiesta di uscita.
+ * Il client conferma MSG_RANK_END con MSG_OK e riceve a sua volta MSG_OK.
+ *
+ * @param ctx La connessione del client
+ * @param themes I temi seguiti, un bit per tema
+ */
+static void run_subscription(ClientContext *ctx, int themes)
+{
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+
+    int seat = room_subscribe(themes, ctx->socket, ctx->nickname);
+    if (seat < 0)
+    {
+        send_msg(ctx->socket, MSG_ERROR, "Classifiche non disponibili");
+        return;
+    }
+    LOG_INFO("Cliente %s segue le classifiche", ctx->nickname);
+    ctx->passive = 1;
+
+    while (1)
+    {
+        if (client_recv(ctx, type, data) < 0)
+        {
+            room_leave(seat, 1);
+            LOG_WARNING("Client %s disconnesso mentre seguiva le classifiche", ctx->nickname);
+            detach_and_exit(ctx, -1, 0);
+        }
+
+        // Conferma di MSG_RANK_END, come per le stanze
+        if (strcmp(type, MSG_OK) == 0)
+        {
+            room_leave(seat, 1);
+            break;
+        }
+        if (!room_released(seat) && (strcmp(type, MSG_UNSUBSCRIBE) == 0 || strcmp(type, MSG_END) == 0))
+        {
+            room_leave(seat, 0);
+        }
+    }
+
+    ctx->passive = 0;
+    send_msg(ctx->socket, MSG_OK, "");
+    LOG_INFO("Cliente %s non segue più le classifiche", ctx->nickname);
+}
+
+/**
+ * Interpreta l'elenco dei temi di un'iscrizione alle classifiche
+ * @param data I numeri dei temi separati da spazi
+ * @return I temi, un bit per tema; -1 se l'elenco è vuoto o contiene un tema non valido
+ */
+static int parse_themes(char *data)
+{
+    int themes = 0;
+    char *saveptr = NULL;
+
+    for (char *token = strtok_r(data, " ", &saveptr); token != NULL; token = strtok_r(NULL, " ", &saveptr))
+    {
+        int theme_num = atoi(token);
+        if (!is_numeric(token) || theme_num < 0 || theme_num >= themes_count)
+        {
+            return -1;
+        }
+        themes |= 1 << theme_num;
+    }
+    return themes != 0 ? themes : -1;
+}
+
+/**
+ * Carica il file del quiz di un tema
+ * @param choice Il numero del tema
+ * @param quiz Output: il quiz caricato
+ * @return Numero di domande caricate, -1 in caso di errore
+ */
+static int load_theme_quiz(int choice, Quiz *quiz)
+{
+    char filename[CONFIG_VALUE_LEN + MAX_THEME_LEN + 8];
+    quiz_path(filename, sizeof(filename), theme[choice]);
+    memset(quiz, 0, sizeof(Quiz));
+    return load_quiz(filename, quiz);
+}
+
+
+/**
+ * Riprende una sessione ancora servita da un altro processo (connessione precedente non ancora
+ * caduta): gli chiede di sospenderla con SESSION_TAKEOVER_SIGNAL e attende fino a
+ * SESSION_TAKEOVER_MS che risulti disconnessa. Un processo terminato senza sospenderla viene
+ * recuperato dal supervisore, che la sospende al suo posto
+ *
+ * @param token Il token di ripresa ricevuto
+ * @param session Stato della sessione ancora attiva (proprietario), output: stato della sessione ripresa
+ * @return Lo slot della sessione ripresa, -1 se la sessione non è stata sospesa in tempo o è stata chiusa
+ */
+static int take_over_session(const char *token, Session *session)
+{
+    // Nella simulazione tutte le sessioni condividono il processo: nessuno sospenderebbe la sessione
+    if (session->owner == getpid() || (kill(session->owner, SESSION_TAKEOVER_SIGNAL) < 0 && errno != ESRCH))
+    {
+        return -1;
+    }
+
+    for (int waited = 0; waited < SESSION_TAKEOVER_MS; waited += 20)
+    {
+        usleep(20 * 1000);
+        int slot = session_resume(token, session);
+        if (slot != SESSION_RESUME_BUSY)
+        {
+            return slot;
+        }
+    }
+    LOG_WARNING("Sessione di %s non sospesa dal processo %d: ripresa rifiutata", session->nickname, (int)session->owner);
+    return -1;
+}
+
+/**
+ * Riprende una sessione interrotta: risponde OK con "nickname tema domanda"
+ * e, se un quiz era in corso, lo ricarica per continuare dalla stessa domanda
+ *
+ * @param ctx La connessione del client (riceve nickname e slot della sessione ripresa)
+ * @param token Il token di ripresa ricevuto
+ * @param quiz Output: il quiz in corso (se presente)
+ * @param session Output: lo stato della sessione ripresa
+ * @return 0 se la sessione è stata ripresa, -1 se il token non è valido
+ */
+static int resume_session(ClientContext *ctx, const char *token, Quiz *quiz, Session *session)
+{
+    char data[MAX_MSG_LEN];
+
+    ctx->slot = session_resume(token, session);
+    if (ctx->slot == SESSION_RESUME_BUSY)
+    {
+        ctx->slot = take_over_session(token, session);
+    }
+    if (ctx->slot < 0)
+    {
+        send_msg(ctx->socket, MSG_ERROR, RESP_RESUME_INVALID);
+        return -1;
+    }
+
+    strcpy(ctx->nickname, session->nickname);
+    trace_set_nickname(ctx->nickname);
+    process_set_session(ctx->nickname, ctx->slot);
+
+    // Il file del quiz potrebbe non essere più leggibile: si riparte dalla selezione del tema
+    if (session->theme >= 0 && load_theme_quiz(session->theme, quiz) < 0)
+    {
+        LOG_WARNING("Impossibile ricaricare il quiz del tema %d per %s", session->theme, ctx->nickname);
+        session->theme = -1;
+        session_update(ctx->slot, -1, 0, 0);
+    }
+
+    snprintf(data, sizeof(data), "%s %d %d", ctx->nickname, session->theme, session->current_question);
+    send_msg(ctx->socket, MSG_OK, data);
+    LOG_EVENT(LOG_INFO, EV_SESSION_RESUMED, ctx->nickname, session->theme, session->current_question + 1);
+    return 0;
+}
+
+/**
+ * Attende in coda di ammissione uno slot del giocatore (server pieno)
+ * Il client riceve WAIT|posizione,attesa a ogni cambio di posizione; quando è il primo della coda
+ * e uno slot si libera il giocatore viene registrato. I messaggi del client durante l'attesa sono
+ * ignorati, salvo END, ma soggetti al limite di frequenza come nel resto della sessione; la scadenza della registrazione non vale in coda, sostituita da quella
+ * della coda (ADMISSION_TIMEOUT_SEC): un client che non viene ammesso in tempo è disconnesso.
+ *
+ * @param ctx La connessione del client
+ * @param nickname Il nickname richiesto
+ * @return 0 se il giocatore è registrato, 1 se il nickname è stato occupato nel frattempo
+ *         (il client ne sceglie un altro), -1 se il client va disconnesso
+ */
+static int wait_admission(ClientContext *ctx, const char *nickname)
+{
+    int index = admission_enqueue();
+    if (index < 0)
+    {
+        LOG_WARNING("Server pieno e coda di ammissione piena: %s rifiutato", nickname);
+        send_msg(ctx->socket, MSG_ERROR, "Server pieno");
+        metrics_admission(ADMISSION_REJECTED, 0);
+        metrics_connection_rejected();
+        return -1;
+    }
+    metrics_admission(ADMISSION_QUEUED, 0);
+    timer_cancel(&ctx->deadline_timer);
+
+    uint64_t start = timer_now_ms();
+    int last_position = 0;
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+    while (1)
+    {
+        if (timer_now_ms() - start >= (uint64_t)ADMISSION_TIMEOUT_SEC * 1000)
+        {
+            admission_leave(index);
+            metrics_admission(ADMISSION_ABANDONED, 0);
+            LOG_INFO("Client %s non ammesso entro %d secondi: uscito dalla coda", nickname, ADMISSION_TIMEOUT_SEC);
+            send_msg(ctx->socket, MSG_ERROR, "Tempo scaduto in coda di ammissione");
+            return -1;
+        }
+
+        if (taken_nickname(nickname))
+        {
+            admission_leave(index);
+            metrics_admission(ADMISSION_ABANDONED, 0);
+            send_msg(ctx->socket, MSG_ERROR, RESP_NICK_TAKEN);
+            return 1;
+        }
+
+        int eta_sec;
+        int position = admission_position(index, &eta_sec);
+        if (position == 1 && init_player(nickname) == 0)
+        {
+            admission_leave(index);
+            uint64_t waited = timer_now_ms() - start;
+            metrics_admission(ADMISSION_ADMITTED, waited);
+            LOG_INFO("Client %s ammesso dopo %llu ms in coda", nickname, (unsigned long long)waited);
+            return 0;
+        }
+        if (position != last_position)
+        {
+            char status[32];
+            snprintf(status, sizeof(status), "%d,%d", position, eta_sec);
+            send_msg(ctx->socket, MSG_WAIT, status);
+            last_position = position;
+        }
+
+        int ready = transport_wait(ctx->socket, ADMISSION_POLL_MS);
+        if (ready > 0 && transport_fill(ctx->socket))
+        {
+            // Anche in coda i messaggi consumano i token dell'indirizzo (vedi client_throttle)
+            ready = recv_msg(ctx->socket, type, data) < 0 || client_throttle(ctx) < 0 ||
+                    strcmp(type, MSG_END) == 0 ? -1 : 0;
+        }
+        if (ready < 0)
+        {
+            admission_leave(index);
+            metrics_admission(ADMISSION_ABANDONED, 0);
+            LOG_INFO("Client %s uscito dalla coda di ammissione", nickname);
+            return -1;
+        }
+    }
 }
 
 /**
@@ -46,32 +907,64 @@ static void cleanup_and_exit(int socket, const char *nickname, int registered)
 extern void handle_client(int client_socket)
 {
     char type[64], data[MAX_MSG_LEN];
-    char nickname[MAX_NICKNAME_LEN] = {0};
-    int score[MAX_THEMES] = {0};
-    int current_question = 0;
+    ClientContext ctx = { .socket = client_socket, .slot = -1, .request_type = -1 };
+    char *nickname = ctx.nickname;
+    char token[SESSION_TOKEN_LEN + 1];
     int count = 0;
     int quiz_active = 1;
     Quiz quiz = {0};
+    Session resumed = {0};
 
-    // Registra gestore segnali per questo processo client
-    signal(SIGPIPE, client_signal_handler);
-
-    // Per gestire la pulizia quando il client si disconnette
-    int client_registered = 0;
+    // Una scrittura su un client disconnesso fallisce con EPIPE invece di terminare il processo:
+    // la successiva recv_msg fallisce e la sessione viene conservata per la ripresa
+    signal(SIGPIPE, SIG_IGN);
+    kick_socket = client_socket;
+    signal(ADMIN_KICK_SIGNAL, kick_handler);
+    signal(SESSION_TAKEOVER_SIGNAL, kick_handler);
 
-    LOG_INFO("Gestione client iniziata");
+    // Ogni processo figlio gestisce una sessione: il pid la identifica nei log strutturati
+    log_set_session_id((uint32_t)getpid());
+    LOG_EVENT(LOG_INFO, EV_SESSION_START, NULL);
+    metrics_session_change(1);
+    trace_session_start(shared_state->trace_sample, &shared_state->trace_sessions);
+    // Le risposte non attendono il client: oltre send_high_water byte non letti la sessione
+    // attende fino a send_low_water e, dopo send_timeout secondi, chiude la connessione
+    // (nella simulazione il loopback ha già il proprio buffer)
+    transport_output_buffer(client_socket, server_config.send_high_water, server_config.send_low_water,
+                            server_config.send_timeout * 1000);
+    // I limiti dei messaggi valgono per l'indirizzo, condivisi da tutte le sue connessioni
+    // (la simulazione non ha indirizzi: getpeername fallisce e nessun limite si applica)
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    if (getpeername(client_socket, (struct sockaddr *)&peer, &peer_len) == 0)
+    {
+        ctx.rate_limited = rate_key((struct sockaddr *)&peer, &ctx.rate_key) == 0;
+    }
+    if (handshake_timeout_sec > 0)
+    {
+        timer_start(&ctx.deadline_timer, (uint64_t)handshake_timeout_sec * 1000, deadline_expired, &ctx);
+    }
 
-    // Registrazione nickname
+    // Registrazione nickname o ripresa di una sessione interrotta
     while (1)
     {
-        if (recv_msg(client_socket, type, data) < 0)
+        if (client_recv(&ctx, type, data) < 0)
         {
             LOG_WARNING("Client disconnesso durante la registrazione");
-            cleanup_and_exit(client_socket, NULL, 0);
+            cleanup_and_exit(&ctx);
         }
 
         print_players_status();
 
+        if (strcmp(type, MSG_RESUME) == 0)
+        {
+            if (resume_session(&ctx, data, &quiz, &resumed) == 0)
+            {
+                break;
+            }
+            continue;
+        }
+
         if (strcmp(type, MSG_NICK) == 0)
         {
             if (!valid_nickname(data))
@@ -85,22 +978,47 @@ extern void handle_client(int client_socket)
                 continue;
             }
 
+            // Il giocatore e la sessione vengono creati prima dell'OK, che trasporta il token di ripresa.
+            // A server pieno, o con altri client già in coda, si attende il proprio turno
+            if (admission_waiting() > 0 || init_player(data) != 0)
+            {
+                int admitted = wait_admission(&ctx, data);
+                if (admitted < 0)
+                {
+                    cleanup_and_exit(&ctx);
+                }
+                if (admitted > 0)
+                {
+                    continue;
+                }
+            }
             strcpy(nickname, data);
-            send_msg(client_socket, MSG_OK, "Nickname registrato con successo.");
-            LOG_INFO("Nickname registrato: %s", nickname);
+            trace_set_nickname(nickname);
+
+            ctx.slot = session_create(nickname, token);
+            if (ctx.slot < 0)
+            {
+                LOG_WARNING("Sessione di %s non riprendibile", nickname);
+                token[0] = '\0';
+            }
+            process_set_session(nickname, ctx.slot);
+
+            send_msg(client_socket, MSG_OK, token);
+            LOG_EVENT(LOG_INFO, EV_NICK_REGISTERED, nickname);
             break;
         }
     }
 
-    if (init_player(nickname) != 0)
+    // Segna il client come registrato
+    ctx.registered = 1;
+
+    // Sessione ripresa a metà quiz: si continua dalla domanda salvata
+    if (resumed.theme >= 0 && quiz.count > 0)
     {
-        LOG_ERROR("Errore nella registrazione del giocatore: %s", nickname);
-        exit(0);
+        quiz_active = run_quiz(&ctx, resumed.theme, &quiz, resumed.current_question, resumed.score);
+        print_players_status();
     }
 
-    // Segna il client come registrato
-    client_registered = 1;
-
     while (quiz_active)
     {
         // Invio lista temi
@@ -108,20 +1026,25 @@ extern void handle_client(int client_socket)
         {
             LOG_ERROR("Errore nel recupero dei temi");
             send_msg(client_socket, MSG_ERROR, "Nessun tema disponibile");
-            cleanup_and_exit(client_socket, nickname, client_registered);
+            cleanup_and_exit(&ctx);
         }
 
-        if (recv_msg(client_socket, type, data) < 0)
+        if (client_recv(&ctx, type, data) < 0)
         {
             LOG_WARNING("Client %s disconnesso durante la richiesta dei temi", nickname);
-            cleanup_and_exit(client_socket, nickname, client_registered);
+            detach_and_exit(&ctx, -1, 0);
         }
 
         print_players_status();
 
         if (strcmp(type, MSG_THEMES) != 0)
         {
-            printf("Errore: richiesta temi non valida da %s\n", nickname);
+            // Conferme, richieste e risposte in ritardo rimaste dall'ultima domanda del quiz appena
+            // concluso (risposta partita prima di ricevere TIMEOUT sull'ultima domanda)
+            if (strcmp(type, MSG_OK) != 0 && strcmp(type, MSG_QUIZ_START) != 0 && strcmp(type, MSG_ANSWER) != 0)
+            {
+                printf("Errore: richiesta temi non valida da %s\n", nickname);
+            }
             continue; 
         }
 
@@ -129,9 +1052,9 @@ extern void handle_client(int client_socket)
         sprintf(data, "%d", themes_count);
         send_msg(client_socket, MSG_OK, data);
 
-        if(recv_msg(client_socket, type, data)<0){
+        if(client_reply(&ctx, type, data)<0){
             LOG_WARNING("Client %s disconnesso durante la selezione del tema", nickname);
-            cleanup_and_exit(client_socket, nickname, client_registered);
+            detach_and_exit(&ctx, -1, 0);
         }
         if(strcmp(type, MSG_OK) != 0){
             // printf("Errore: Lista temi non ricevuta\n");
@@ -175,10 +1098,10 @@ extern void handle_client(int client_socket)
         send_msg(client_socket, MSG_THEMES_LIST, themes_list);
 
         // Riceve il tema scelto o un comando speciale
-        if (recv_msg(client_socket, type, data) < 0)
+        if (client_recv(&ctx, type, data) < 0)
         {
             LOG_WARNING("Client %s disconnesso durante la selezione del tema", nickname);
-            cleanup_and_exit(client_socket, nickname, client_registered);
+            detach_and_exit(&ctx, -1, 0);
         }
 
         print_players_status();
@@ -187,43 +1110,7 @@ extern void handle_client(int client_socket)
         // Il client può richiedere di vedere le classifiche senza selezionare un tema
         if (strcmp(type, MSG_SCORE) == 0)
         {
-
-            LOG_INFO("Client %s ha richiesto la classifica", nickname);
-
-            // Invia le classifiche per ogni tema disponibile
-            for (int i = 0; i < themes_count; i++)
-            {
-                // Recupera la classifica per questo tema
-                get_leaderboard(i, data);
-                
-                if (strlen(data) > 0)
-                {
-                    // Invia la classifica al client
-                    send_msg(client_socket, MSG_SCORELIST, data);
-                }
-                else
-                {
-                    // Nessun punteggio disponibile, invia classifica vuota con solo il numero del tema
-                    char empty_score[16];
-                    snprintf(empty_score, sizeof(empty_score), "%d", i);
-                    send_msg(client_socket, MSG_SCORELIST, empty_score);
-                }
-                
-                // Attendi conferma di ricezione dal client prima di inviare la prossima
-                if (recv_msg(client_socket, type, data) < 0)
-                {
-                    LOG_WARNING("Client %s disconnesso durante la ricezione della classifica", nickname);
-                    cleanup_and_exit(client_socket, nickname, client_registered);
-                }
-                if (strcmp(type, MSG_OK) != 0)
-                {
-                    LOG_WARNING("Client %s ha inviato un messaggio inatteso durante la ricezione della classifica", nickname);
-                }
-            }
-            
-            // Invia un messaggio finale per indicare che tutte le classifiche sono state inviate
-            send_msg(client_socket, MSG_END_SCORE, "");
-
+            send_leaderboards(&ctx, -1, 0);
             continue; // Torna alla selezione del tema
         }
         
@@ -231,7 +1118,33 @@ extern void handle_client(int client_socket)
         if (strcmp(type, MSG_END) == 0)
         {
             LOG_INFO("Client %s ha richiesto di terminare la sessione durante la selezione tema", nickname);
-            cleanup_and_exit(client_socket, nickname, client_registered);
+            cleanup_and_exit(&ctx);
+        }
+
+        // Ingresso nella stanza dal vivo di un tema
+        if (strcmp(type, MSG_ROOM) == 0)
+        {
+            int room = atoi(data);
+            if (!is_numeric(data) || room < 0 || room >= themes_count)
+            {
+                send_msg(client_socket, MSG_ERROR, RESP_INVALID_THEME);
+                continue;
+            }
+            run_room(&ctx, room);
+            continue;
+        }
+
+        // Aggiornamenti delle classifiche di uno o più temi
+        if (strcmp(type, MSG_SUBSCRIBE) == 0)
+        {
+            int themes = parse_themes(data);
+            if (themes < 0)
+            {
+                send_msg(client_socket, MSG_ERROR, RESP_INVALID_THEME);
+                continue;
+            }
+            run_subscription(&ctx, themes);
+            continue;
         }
 
         if (strcmp(type, MSG_THEME) != 0)
@@ -240,7 +1153,7 @@ extern void handle_client(int client_socket)
         }
 
         int choice = atoi(data);
-        LOG_INFO("Cliente %s ha scelto il tema numero: %d", nickname, choice);
+        LOG_EVENT(LOG_INFO, EV_THEME_CHOSEN, nickname, choice);
         
         if (choice < 0 || choice >= themes_count)
         {
@@ -254,109 +1167,19 @@ extern void handle_client(int client_socket)
             continue;
         }
 
-        char filename[MAX_THEME_LEN + 8];
-        snprintf(filename, sizeof(filename), "src/%s.txt", theme[choice]);
         LOG_INFO("Cliente %s ha scelto il tema: %s", nickname, theme[choice]);
 
-        if (load_quiz(filename, &quiz) < 0)
+        if (load_theme_quiz(choice, &quiz) < 0)
         {
             send_msg(client_socket, MSG_ERROR, RESP_INVALID_THEME);
             continue;
         }
         send_msg(client_socket, MSG_OK, "");
-        Question *q;
-        current_question = 0;
 
-        // QUIZ - Ciclo principale che gestisce tutte le domande del quiz
-        while (current_question < quiz.count)
-        {
-            if (recv_msg(client_socket, type, data) < 0)
-            {
-                LOG_WARNING("Client %s disconnesso durante il quiz alla domanda %d", nickname, current_question + 1);
-                cleanup_and_exit(client_socket, nickname, client_registered);
-            }
+        quiz_active = run_quiz(&ctx, choice, &quiz, 0, 0);
 
-            print_players_status();
-            
-            if (strcmp(type, MSG_QUIZ_START) == 0)
-            {
-                // Il client richiede la prossima domanda (o la stessa se ha chiesto la classifica)
-                q = get_question(&quiz, current_question);
-                if (!q)
-                    break;
-
-                send_msg(client_socket, MSG_QUESTION, q->question);
-            }
-            else if (strcmp(type, MSG_ANSWER) == 0)
-            {
-                // Il client ha inviato una risposta, verificala
-                int correct = check_answer(q, data);
-
-                if (correct)
-                {
-                    score[choice]++;
-                    send_msg(client_socket, MSG_RESULT, RESP_CORRECT);
-                    LOG_INFO("Client %s ha risposto alla domanda CORRETTAMENTE. ", nickname);
-                }
-                else
-                {
-                    send_msg(client_socket, MSG_RESULT, RESP_WRONG);
-                    LOG_INFO("Client %s ha risposto in modo ERRATO alla domanda. ", nickname);
-                }
-                
-                current_question++;
-                
-                // Verifica se il quiz è stato completato (tutte le domande risposte)
-                int quiz_completed = (current_question >= quiz.count);
-                
-                // Salva il punteggio nella memoria condivisa
-                // Se quiz_completed=1, il tema viene marcato come completato
-                save_score(choice, nickname, score[choice], quiz_completed);
-            }
-            else if (strcmp(type, MSG_SCORE) == 0)
-            {
-                // Il client ha richiesto la classifica durante il quiz
-                LOG_INFO("Client %s ha richiesto la classifica", nickname);
-
-                // Invia le classifiche per ogni tema
-                for (int i = 0; i < themes_count; i++)
-                {
-                    get_leaderboard(i, data);
-                    if (strlen(data) > 0)
-                    {
-                        send_msg(client_socket, MSG_SCORELIST, data);
-                    }
-                    if (recv_msg(client_socket, type, data) < 0)
-                    {
-                        LOG_WARNING("Client %s disconnesso durante la ricezione della classifica", nickname);
-                        cleanup_and_exit(client_socket, nickname, client_registered);
-                    }
-                    if (strcmp(type, MSG_OK) != 0)
-                    {
-                        LOG_WARNING("Client %s ha inviato un messaggio inatteso durante la ricezione della classifica", nickname);
-                        cleanup_and_exit(client_socket, nickname, client_registered);
-                    }
-                }
-                // Invia un messaggio finale per indicare che tutte le classifiche sono state inviate
-                send_msg(client_socket, MSG_END_SCORE, "");
-            }
-            else if (strcmp(type, MSG_END) == 0)
-            {
-                // Il client ha scelto di terminare il quiz prematuramente
-                LOG_INFO("Il client %s ha voluto chiudere il quiz", nickname);
-                quiz_active = 0;
-                break;
-            }
-        }
-
-        if(quiz_active && current_question >= quiz.count){
-            // Quiz completato: tutte le domande sono state risposte
-            send_msg(client_socket, MSG_RESULT, RESP_QUIZ_COMPLETE);
-        }
         // Fine del quiz, reset stato
-        current_question = 0;
         memset(&quiz, 0, sizeof(Quiz));
-        memset(score, 0, sizeof(score));
         
         // Aggiorna lo stato e mostra la lista giocatori aggiornata
         print_players_status();
@@ -368,5 +1191,5 @@ extern void handle_client(int client_socket)
     }
 
     // Pulisci e termina il processo client
-    cleanup_and_exit(client_socket, nickname, client_registered);
+    cleanup_and_exit(&ctx);
 }
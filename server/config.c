@@ -0,0 +1,231 @@
+#include "config.h"
+#include "admin.h"
+#include "ratelimit.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <strings.h>
+
+// Configurazione del processo: valori predefiniti, poi file e riga di comando (processo principale)
+ServerConfig server_config = {
+    .port = SERVER_PORT,
+    .backlog = SERVER_BACKLOG,
+    .reuse_addr = 1,
+    .tcp_nodelay = 1,
+    .instance_dir = INSTANCE_DIR,
+    .log_file = LOG_FILE_PATH,
+    .binlog_file = BINLOG_FILE_PATH,
+    .quiz_dir = QUIZ_DIR,
+    .admin_socket = ADMIN_SOCKET_PATH,
+    .log_level = "info",
+    .log_rotate_mb = (int)(LOG_ROTATE_DEFAULT_BYTES / (1024 * 1024)),
+    .handshake_timeout = HANDSHAKE_TIMEOUT_SEC,
+    .idle_timeout = IDLE_TIMEOUT_SEC,
+    .message_timeout = MESSAGE_TIMEOUT_SEC,
+    .send_high_water = SEND_HIGH_WATER,
+    .send_low_water = SEND_LOW_WATER,
+    .send_timeout = SEND_TIMEOUT_SEC,
+    .rank_policy = "coalesce",
+    .rate_connect = RATE_CONNECT_PER_SEC,
+    .rate_message = RATE_MESSAGE_PER_SEC,
+};
+
+typedef enum {
+    OPTION_INT,
+    OPTION_BOOL,
+    OPTION_STRING
+} OptionType;
+
+typedef struct {
+    const char* key;
+    OptionType type;
+    size_t offset;
+    int min;            // Intervallo ammesso (OPTION_INT)
+    int max;
+} ConfigOption;
+
+#define INT_OPTION(key, field, min, max) { key, OPTION_INT, offsetof(ServerConfig, field), min, max }
+#define BOOL_OPTION(key, field) { key, OPTION_BOOL, offsetof(ServerConfig, field), 0, 1 }
+#define STRING_OPTION(key, field) { key, OPTION_STRING, offsetof(ServerConfig, field), 0, 0 }
+
+static const ConfigOption options[] = {
+    INT_OPTION("port", port, 1, 65535),
+    INT_OPTION("backlog", backlog, 1, 65535),
+    STRING_OPTION("unix_socket", unix_socket),
+    BOOL_OPTION("reuse_addr", reuse_addr),
+    BOOL_OPTION("tcp_nodelay", tcp_nodelay),
+    INT_OPTION("tcp_defer_accept", tcp_defer_accept, 0, 3600),
+    INT_OPTION("tcp_fastopen", tcp_fastopen, 0, 65535),
+    INT_OPTION("rcvbuf", rcvbuf, 0, INT_MAX),
+    INT_OPTION("sndbuf", sndbuf, 0, INT_MAX),
+    STRING_OPTION("instance_dir", instance_dir),
+    INT_OPTION("shm_key", shm_key, INT_MIN, INT_MAX),
+    INT_OPTION("sem_key", sem_key, INT_MIN, INT_MAX),
+    STRING_OPTION("log_file", log_file),
+    STRING_OPTION("binlog_file", binlog_file),
+    STRING_OPTION("quiz_dir", quiz_dir),
+    STRING_OPTION("admin_socket", admin_socket),
+    STRING_OPTION("metrics", metrics),
+    BOOL_OPTION("binary_log", binary_log),
+    STRING_OPTION("log_level", log_level),
+    INT_OPTION("log_rotate_mb", log_rotate_mb, 0, INT_MAX),
+    INT_OPTION("log_rotate_sec", log_rotate_sec, 0, INT_MAX),
+    BOOL_OPTION("lock_profile", lock_profile),
+    INT_OPTION("trace_sample", trace_sample, 0, INT_MAX),
+    INT_OPTION("handshake_timeout", handshake_timeout, 0, 86400),
+    INT_OPTION("idle_timeout", idle_timeout, 0, 86400),
+    INT_OPTION("message_timeout", message_timeout, 0, 86400),
+    INT_OPTION("send_high_water", send_high_water, 1024, 64 * 1024 * 1024),
+    INT_OPTION("send_low_water", send_low_water, 0, 64 * 1024 * 1024),
+    INT_OPTION("send_timeout", send_timeout, 1, 3600),
+    STRING_OPTION("rank_policy", rank_policy),
+    INT_OPTION("rate_connect", rate_connect, 0, 1000000),
+    INT_OPTION("rate_message", rate_message, 0, 1000000),
+    BOOL_OPTION("rate_loopback", rate_loopback),
+    INT_OPTION("replica_port", replica_port, 0, 65535),
+    STRING_OPTION("replica_peers", replica_peers),
+};
+
+#define OPTION_COUNT ((int)(sizeof(options) / sizeof(options[0])))
+
+static int parse_bool(const char* value) {
+    static const char* yes[] = { "1", "yes", "on", "true", "si" };
+    static const char* no[] = { "0", "no", "off", "false" };
+    for (size_t i = 0; i < sizeof(yes) / sizeof(yes[0]); i++) {
+        if (strcasecmp(value, yes[i]) == 0) {
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < sizeof(no) / sizeof(no[0]); i++) {
+        if (strcasecmp(value, no[i]) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Imposta un valore della configurazione
+ * @param key La chiave (vedi options)
+ * @param value Il valore; gli interi accettano anche la notazione esadecimale (0x...)
+ * @return 0 se successo, -1 se la chiave è sconosciuta o il valore non è valido (messaggio su stderr)
+ */
+int config_set(const char* key, const char* value) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        const ConfigOption* option = &options[i];
+        if (strcmp(option->key, key) != 0) {
+            continue;
+        }
+
+        void* field = (char*)&server_config + option->offset;
+        if (option->type == OPTION_STRING) {
+            if (strlen(value) >= CONFIG_VALUE_LEN) {
+                fprintf(stderr, "Valore troppo lungo per %s\n", key);
+                return -1;
+            }
+            strcpy(field, value);
+            return 0;
+        }
+
+        long number;
+        if (option->type == OPTION_BOOL) {
+            number = parse_bool(value);
+        } else {
+            char* end;
+            errno = 0;
+            number = strtol(value, &end, 0);
+            if (errno != 0 || end == value || *end != '\0') {
+                number = (long)option->min - 1;
+            }
+        }
+        if (number < option->min || number > option->max) {
+            fprintf(stderr, "Valore non valido per %s: %s\n", key, value);
+            return -1;
+        }
+        *(int*)field = (int)number;
+        return 0;
+    }
+
+    fprintf(stderr, "Chiave di configurazione sconosciuta: %s\n", key);
+    return -1;
+}
+
+static char* trim(char* text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    char* end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    *end = '\0';
+    return text;
+}
+
+/**
+ * Imposta un valore nella forma "chiave=valore" (opzione -o)
+ * @param option La coppia chiave e valore
+ * @return 0 se successo, -1 in caso di errore
+ */
+int config_set_option(const char* option) {
+    char line[2 * CONFIG_VALUE_LEN];
+    snprintf(line, sizeof(line), "%s", option);
+
+    char* equals = strchr(line, '=');
+    if (equals == NULL) {
+        fprintf(stderr, "Opzione non valida (attesa chiave=valore): %s\n", option);
+        return -1;
+    }
+    *equals = '\0';
+    return config_set(trim(line), trim(equals + 1));
+}
+
+/**
+ * Legge un file di configurazione
+ * @param path Il percorso del file
+ * @return 0 se successo, -1 se il file non è leggibile o contiene errori (tutti segnalati su stderr)
+ */
+int config_load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Impossibile aprire il file di configurazione %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char buffer[2 * CONFIG_VALUE_LEN];
+    int line = 0;
+    int errors = 0;
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        line++;
+        char* comment = strchr(buffer, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char* text = trim(buffer);
+        if (*text == '\0') {
+            continue;
+        }
+        if (config_set_option(text) < 0) {
+            fprintf(stderr, "%s:%d: riga non valida\n", path, line);
+            errors++;
+        }
+    }
+    fclose(file);
+    return errors > 0 ? -1 : 0;
+}
+
+/**
+ * Scrive nel log la configurazione in uso, una chiave per riga
+ */
+void config_log(void) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        const ConfigOption* option = &options[i];
+        const void* field = (const char*)&server_config + option->offset;
+        if (option->type == OPTION_STRING) {
+            LOG_INFO("Configurazione: %s = %s", option->key, (const char*)field);
+        } else {
+            LOG_INFO("Configurazione: %s = %d", option->key, *(const int*)field);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "server.h"
+
+/*
+ * Configurazione del server
+ * - i valori predefiniti sono le costanti di server.h e dei moduli (porta, chiavi IPC, scadenze...)
+ * - un file di configurazione (opzione -c) li sostituisce: righe "chiave = valore", commenti
+ *   con '#', chiavi sconosciute e valori fuori intervallo sono errori con il numero di riga
+ * - le opzioni della riga di comando (incluso -o chiave=valore) valgono sul file,
+ *   in qualunque ordine compaiano
+ * - la configurazione è impostata dal processo principale prima delle fork: ogni figlio ne
+ *   eredita una copia
+ */
+
+#define CONFIG_VALUE_LEN 256
+#define SERVER_BACKLOG MAX_CLIENTS  // Connessioni in attesa di accept (chiave backlog)
+
+typedef struct {
+    // Ascolto e opzioni dei socket
+    int port;
+    int backlog;
+    char unix_socket[CONFIG_VALUE_LEN];     // Socket Unix di ascolto, vuoto per TCP
+    int reuse_addr;                         // SO_REUSEADDR: riavvio immediato con connessioni in TIME_WAIT
+    int tcp_nodelay;                        // TCP_NODELAY sui client: nessun ritardo di Nagle sui messaggi brevi
+    int tcp_defer_accept;                   // TCP_DEFER_ACCEPT in secondi: accept solo quando arriva il primo messaggio, 0 disattiva
+    int tcp_fastopen;                       // TCP_FASTOPEN: coda delle connessioni con dati nel SYN, 0 disattiva
+    int rcvbuf;                             // SO_RCVBUF in byte, 0 per il default del kernel
+    int sndbuf;                             // SO_SNDBUF in byte, 0 per il default del kernel
+
+    // Memoria condivisa, file e directory
+    char instance_dir[CONFIG_VALUE_LEN];    // Directory da cui ftok ricava le chiavi IPC, base dei percorsi relativi
+    int shm_key;                            // Chiave della memoria condivisa, 0 per ricavarla da instance_dir
+    int sem_key;                            // Chiave del semaforo, 0 per ricavarla da instance_dir
+    char log_file[CONFIG_VALUE_LEN];
+    char binlog_file[CONFIG_VALUE_LEN];
+    char quiz_dir[CONFIG_VALUE_LEN];        // Directory di temi.txt e dei file dei quiz
+    char admin_socket[CONFIG_VALUE_LEN];
+    char metrics[CONFIG_VALUE_LEN];         // Porta o socket Unix delle metriche, vuoto se disattivate
+
+    // Log e diagnostica
+    int binary_log;
+    char log_level[CONFIG_VALUE_LEN];
+    int log_rotate_mb;
+    int log_rotate_sec;
+    int lock_profile;
+    int trace_sample;
+
+    // Connessioni dei client
+    int handshake_timeout;
+    int idle_timeout;
+    int message_timeout;
+    int send_high_water;
+    int send_low_water;
+    int send_timeout;
+    char rank_policy[CONFIG_VALUE_LEN];
+    int rate_connect;
+    int rate_message;
+    int rate_loopback;
+
+    // Replica della classifica verso altri nodi (vedi replica.h)
+    int replica_port;                       // Porta su cui ricevere gli aggiornamenti, 0 per non riceverne
+    char replica_peers[CONFIG_VALUE_LEN];   // Nodi a cui inviarli: host:porta separati da virgole
+} ServerConfig;
+
+extern ServerConfig server_config;
+
+int config_set(const char* key, const char* value);
+int config_set_option(const char* option);
+int config_load(const char* path);
+void config_log(void);
+
+#endif
@@ -0,0 +1,363 @@
+#include <sys/shm.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <errno.h>
+#include "server.h"
+#include "metrics.h"
+#include "trace.h"
+#include "config.h"
+
+/*
+ * Stato condiviso tra i processi del server e sua sincronizzazione
+ * Separato da server.c perché serve anche a strumenti che non avviano il server (es. benchmark)
+ */
+
+// Variabili globali per la memoria condivisa
+ServerState* shared_state = NULL;
+int shm_id = -1;
+int sem_id = -1;  // Semaforo per sincronizzazione
+
+// Voce del profilo dei lock in possesso di questo processo, -1 se nessuna o profilo spento
+static int held_site = -1;
+static uint64_t held_since = 0;
+
+/**
+ * Cerca o registra un punto di chiamata nel profilo dei lock
+ * Va chiamata con il lock acquisito: la tabella è modificata solo sotto il semaforo. Il report
+ * la legge senza lock (lock_profile_snapshot): la voce nuova viene compilata prima di essere
+ * pubblicata dall'incremento di count, con semantica release
+ *
+ * @return L'indice della voce, -2 se la tabella è piena (il punto non viene più cercato)
+ */
+static int lock_site_register(const char* file, int line, const char* func) {
+    LockProfile* profile = &shared_state->locks;
+    const char* base = strrchr(file, '/');
+    base = base ? base + 1 : file;
+
+    int count = profile->count;
+    for (int i = 0; i < count; i++) {
+        if (profile->sites[i].line == line && strcmp(profile->sites[i].file, base) == 0) {
+            return i;
+        }
+    }
+    if (count >= LOCK_MAX_SITES) {
+        return -2;
+    }
+
+    LockSite* entry = &profile->sites[count];
+    snprintf(entry->file, sizeof(entry->file), "%s", base);
+    snprintf(entry->func, sizeof(entry->func), "%s", func);
+    entry->line = line;
+    __atomic_store_n(&profile->count, count + 1, __ATOMIC_RELEASE);
+    return count;
+}
+
+/**
+ * Acquisisce il lock sulla memoria condivisa usando un semaforo POSIX
+ * Implementa l'operazione P (wait) su un semaforo binario
+ * Blocca il processo chiamante finché il semaforo non è disponibile
+ * Il tempo di attesa finisce nelle metriche (istogramma lock_wait); con il profilo dei lock
+ * attivo anche attesa e possesso del punto di chiamata (usare la macro lock_shared_state())
+ *
+ * @param site Cache della voce del punto di chiamata nel profilo (-1 se non ancora cercata)
+ * @param file Il file sorgente del punto di chiamata
+ * @param line La riga del punto di chiamata
+ * @param func La funzione chiamante
+ */
+void lock_shared_state_at(int* site, const char* file, int line, const char* func) {
+    uint64_t start = clock_now_ns();
+    struct sembuf sem_op;
+    sem_op.sem_num = 0;    // Numero del semaforo (usiamo il primo del set)
+    sem_op.sem_op = -1;    // Operazione P (wait/lock): decrementa il semaforo
+    sem_op.sem_flg = SEM_UNDO; // Se il processo muore con il lock acquisito il kernel lo rilascia
+    
+    // semop non riparte da sola dopo un segnale (es. richieste del canale di amministrazione)
+    while (semop(sem_id, &sem_op, 1) == -1) {
+        if (errno != EINTR) {
+            perror("Errore lock semaforo");
+            return;
+        }
+    }
+    shared_state->lock_owner = getpid();
+    uint64_t now = clock_now_ns();
+    histogram_record_atomic(&shared_state->metrics.lock_wait, now - start);
+    TRACE_END(start, "lock", "lock_wait", func);
+
+    if (shared_state->locks.enabled) {
+        if (*site == -1) {
+            *site = lock_site_register(file, line, func);
+        }
+        // Le voci del profilo si aggiornano solo con il lock acquisito: bastano scritture semplici
+        if (*site >= 0) {
+            histogram_record(&shared_state->locks.sites[*site].wait, now - start);
+            held_site = *site;
+            held_since = now;
+        }
+    }
+}
+
+/**
+ * Rilascia il lock sulla memoria condivisa
+ * Implementa l'operazione V (signal) su un semaforo binario
+ * Consente ad altri processi in attesa di acquisire il lock
+ */
+void unlock_shared_state() {
+    if (held_site >= 0) {
+        histogram_record(&shared_state->locks.sites[held_site].hold, clock_now_ns() - held_since);
+        held_site = -1;
+    }
+    shared_state->lock_owner = 0;
+
+    struct sembuf sem_op;
+    sem_op.sem_num = 0;    // Numero del semaforo
+    sem_op.sem_op = 1;     // Operazione V (signal/unlock): incrementa il semaforo
+    sem_op.sem_flg = SEM_UNDO;
+    
+    if (semop(sem_id, &sem_op, 1) == -1) {
+        perror("Errore unlock semaforo");
+    }
+}
+
+/**
+ * Ricava le chiavi IPC dell'istanza (processo principale, prima di creare o collegare lo stato)
+ * Le chiavi a 0 sono ricavate con ftok dalla directory dell'istanza: server avviati da directory
+ * diverse (che hanno anche data/ e log propri) non condividono memoria né semaforo
+ *
+ * @return 0 se successo, -1 se la directory dell'istanza non esiste
+ */
+int ipc_resolve_keys(void) {
+    if (server_config.shm_key == 0) {
+        key_t key = ftok(server_config.instance_dir, IPC_PROJ_SHM);
+        if (key == -1) {
+            fprintf(stderr, "Directory dell'istanza %s non valida: %s\n", server_config.instance_dir, strerror(errno));
+            return -1;
+        }
+        server_config.shm_key = key;
+    }
+    if (server_config.sem_key == 0) {
+        key_t key = ftok(server_config.instance_dir, IPC_PROJ_SEM);
+        if (key == -1) {
+            fprintf(stderr, "Directory dell'istanza %s non valida: %s\n", server_config.instance_dir, strerror(errno));
+            return -1;
+        }
+        server_config.sem_key = key;
+    }
+    return 0;
+}
+
+/**
+ * Sposta il processo principale nella directory dell'istanza (dopo ipc_resolve_keys)
+ * Log, dati, archivio dei profili, tracce, socket e temi indicati con percorsi relativi
+ * appartengono così all'istanza: server avviati dalla stessa directory con instance_dir
+ * diverse non si sovrascrivono file né socket
+ *
+ * @return 0 se successo, -1 se la directory non è accessibile
+ */
+int ipc_enter_instance(void) {
+    if (chdir(server_config.instance_dir) < 0) {
+        fprintf(stderr, "Directory dell'istanza %s non accessibile: %s\n", server_config.instance_dir, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Rimuove la memoria condivisa e il semaforo dell'istanza se nessun server li usa più
+ * (server terminato senza pulizia: kill -9, crash). Il segmento è in uso finché qualche
+ * processo vi è collegato; il processo principale registrato nel segmento serve solo al messaggio
+ * (un processo terminato ma non ancora raccolto risponde ancora a kill).
+ *
+ * @return 0 se non restano IPC dell'istanza, -1 se sono in uso (messaggio su stderr)
+ */
+int ipc_remove_stale(void) {
+    int id = shmget(server_config.shm_key, 0, 0);
+    if (id >= 0) {
+        struct shmid_ds info;
+        if (shmctl(id, IPC_STAT, &info) < 0) {
+            perror("Errore lettura della memoria condivisa");
+            return -1;
+        }
+
+        // master_pid segue l'intestazione in ogni versione del formato
+        pid_t master = 0;
+        if (info.shm_segsz >= sizeof(ServerStateHeader) + sizeof(pid_t)) {
+            const ServerState* state = shmat(id, NULL, SHM_RDONLY);
+            if (state != (const ServerState*)-1) {
+                if (state->header.magic == SERVER_STATE_MAGIC) {
+                    master = state->master_pid;
+                }
+                shmdt(state);
+            }
+        }
+
+        int master_alive = master > 0 && (kill(master, 0) == 0 || errno == EPERM);
+        if (info.shm_nattch > 0 && master_alive) {
+            fprintf(stderr, "Un server è già in esecuzione su questa istanza (processo %d, chiave 0x%x): "
+                    "usa un'altra directory dell'istanza o -u per l'aggiornamento a caldo\n",
+                    (int)master, (unsigned)server_config.shm_key);
+            return -1;
+        }
+        if (info.shm_nattch > 0) {
+            fprintf(stderr, "%lu processi di un server terminato sono ancora collegati alla memoria condivisa "
+                    "(chiave 0x%x): attendi la loro fine o terminali\n",
+                    (unsigned long)info.shm_nattch, (unsigned)server_config.shm_key);
+            return -1;
+        }
+        if (shmctl(id, IPC_RMID, NULL) < 0) {
+            perror("Errore rimozione della memoria condivisa orfana");
+            return -1;
+        }
+        printf("Memoria condivisa orfana rimossa (chiave 0x%x)\n", (unsigned)server_config.shm_key);
+    }
+
+    // Senza segmento in uso il semaforo dell'istanza non ha altri utenti
+    id = semget(server_config.sem_key, 1, 0);
+    if (id >= 0) {
+        if (semctl(id, 0, IPC_RMID) < 0) {
+            perror("Errore rimozione del semaforo orfano");
+            return -1;
+        }
+        printf("Semaforo orfano rimosso (chiave 0x%x)\n", (unsigned)server_config.sem_key);
+    }
+    return 0;
+}
+
+/**
+ * Crea e inizializza la memoria condivisa dell'istanza, rimuovendo quella di un server terminato
+ * senza pulizia; un server in esecuzione sulla stessa istanza non viene mai toccato
+ *
+ * @return 0 se successo, -1 in caso di errore (messaggio su stderr)
+ */
+int create_shared_state(void) {
+    // IPC_EXCL: due server avviati insieme non possono inizializzare lo stesso segmento
+    shm_id = shmget(server_config.shm_key, sizeof(ServerState), IPC_CREAT | IPC_EXCL | 0600);
+    if (shm_id < 0 && errno == EEXIST) {
+        if (ipc_remove_stale() < 0) {
+            return -1;
+        }
+        shm_id = shmget(server_config.shm_key, sizeof(ServerState), IPC_CREAT | IPC_EXCL | 0600);
+    }
+    if (shm_id < 0) {
+        perror("Errore creazione della memoria condivisa");
+        return -1;
+    }
+
+    shared_state = (ServerState*)shmat(shm_id, NULL, 0);
+    if (shared_state == (ServerState*)-1) {
+        perror("Errore collegamento della memoria condivisa");
+        shmctl(shm_id, IPC_RMID, NULL);
+        shared_state = NULL;
+        shm_id = -1;
+        return -1;
+    }
+
+    memset(shared_state, 0, sizeof(ServerState));
+    shared_state->header.magic = SERVER_STATE_MAGIC;
+    shared_state->header.version = SERVER_STATE_VERSION;
+    shared_state->header.size = sizeof(ServerState);
+    return 0;
+}
+
+/**
+ * Inizializza il semaforo per la sincronizzazione
+ * Il chiamante possiede già la memoria condivisa dell'istanza: un semaforo esistente con la
+ * stessa chiave è di un server terminato e viene sostituito
+ *
+ * @return 0 se successo, -1 in caso di errore
+ */
+int init_semaphore() {
+    // Crea il semaforo
+    sem_id = semget(server_config.sem_key, 1, IPC_CREAT | IPC_EXCL | 0600);
+    if (sem_id == -1 && errno == EEXIST) {
+        int stale = semget(server_config.sem_key, 1, 0);
+        if (stale >= 0 && semctl(stale, 0, IPC_RMID) == 0) {
+            LOG_WARNING("Semaforo orfano rimosso (chiave 0x%x)", (unsigned)server_config.sem_key);
+        }
+        sem_id = semget(server_config.sem_key, 1, IPC_CREAT | IPC_EXCL | 0600);
+    }
+    if (sem_id == -1) {
+        perror("Errore creazione semaforo");
+        return -1;
+    }
+    
+    // Inizializza il semaforo a 1 (mutex libero)
+    if (semctl(sem_id, 0, SETVAL, 1) == -1) {
+        perror("Errore inizializzazione semaforo");
+        return -1;
+    }
+    
+    LOG_INFO("Semaforo inizializzato con ID: %d", sem_id);
+    return 0;
+}
+/**
+ * Si collega al semaforo di un server già attivo, senza reinizializzarlo
+ * (un processo del vecchio server potrebbe possedere il lock)
+ *
+ * @return 0 se successo, -1 in caso di errore
+ */
+int attach_semaphore(void) {
+    sem_id = semget(server_config.sem_key, 1, 0);
+    if (sem_id == -1) {
+        perror("Errore collegamento al semaforo");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Si collega alla memoria condivisa di un server già attivo (aggiornamento a caldo)
+ * e ne verifica l'intestazione: formato, versione e dimensione devono coincidere
+ *
+ * @return 0 se successo, -1 se il segmento non esiste o non è compatibile
+ */
+int attach_shared_state(void) {
+    shm_id = shmget(server_config.shm_key, 0, 0);
+    if (shm_id < 0) {
+        perror("Nessuna memoria condivisa da riutilizzare");
+        return -1;
+    }
+
+    struct shmid_ds info;
+    if (shmctl(shm_id, IPC_STAT, &info) < 0 || info.shm_segsz < sizeof(ServerState)) {
+        fprintf(stderr, "Memoria condivisa di dimensione incompatibile (%zu byte, attesi %zu)\n",
+                (size_t)info.shm_segsz, sizeof(ServerState));
+        shm_id = -1;
+        return -1;
+    }
+
+    ServerState* state = (ServerState*)shmat(shm_id, NULL, 0);
+    if (state == (ServerState*)-1) {
+        perror("shmat");
+        shm_id = -1;
+        return -1;
+    }
+
+    const ServerStateHeader* header = &state->header;
+    if (header->magic != SERVER_STATE_MAGIC || header->version != SERVER_STATE_VERSION ||
+        header->size != sizeof(ServerState)) {
+        fprintf(stderr, "Memoria condivisa incompatibile (versione %u, %u byte; attesa versione %d, %zu byte)\n",
+                header->version, header->size, SERVER_STATE_VERSION, sizeof(ServerState));
+        shmdt(state);
+        shm_id = -1;
+        return -1;
+    }
+
+    shared_state = state;
+    return 0;
+}
+
+/**
+ * Rimuove il semaforo dal sistema
+ * Deve essere chiamato solo dal processo server principale alla terminazione
+ * Tutti i processi che usano questo semaforo devono essere terminati prima
+ */
+void cleanup_semaphore() {
+    if (sem_id != -1) {
+        // IPC_RMID rimuove il semaforo dal sistema operativo
+        if (semctl(sem_id, 0, IPC_RMID) == -1) {
+            perror("Errore rimozione semaforo");
+        } else {
+            LOG_INFO("Semaforo rimosso con successo");
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef LOG_EVENTS_H
+#define LOG_EVENTS_H
+
+/*
+ * Tabella degli eventi strutturati del server.
+ * Condivisa tra il logger (modalità testo e binaria) e il decoder offline logdump.
+ *
+ * Ogni voce: X(identificatore, nome, nomi degli argomenti, formato testuale)
+ * Convenzione sul formato: la prima conversione consuma sempre la stringa del record
+ * (usare "%.0s" se l'evento non la mostra), le successive sono %lld per gli argomenti interi.
+ * I nuovi eventi vanno aggiunti SOLO in coda, l'identificatore è scritto nei file di log.
+ */
+#define LOG_EVENT_LIST(X) \
+    X(EV_SESSION_START,    "session_start",    "",                          "%.0sGestione client iniziata") \
+    X(EV_NICK_REGISTERED,  "nick_registered",  "",                          "Nickname registrato: %s") \
+    X(EV_THEME_CHOSEN,     "theme_chosen",     "theme",                     "Cliente %s ha scelto il tema numero: %lld") \
+    X(EV_ANSWER,           "answer",           "theme,question,correct",    "Client %s ha risposto sul tema %lld alla domanda %lld (corretta: %lld)") \
+    X(EV_SCORE_REQUEST,    "score_request",    "",                          "Client %s ha richiesto la classifica") \
+    X(EV_QUIZ_ABORTED,     "quiz_aborted",     "theme,question",            "Il client %s ha voluto chiudere il quiz del tema %lld alla domanda %lld") \
+    X(EV_QUIZ_COMPLETED,   "quiz_completed",   "theme,score",               "Client %s ha completato il tema %lld con %lld punti") \
+    X(EV_SESSION_END,      "session_end",      "",                          "Chiusura connessione per il client %s") \
+    X(EV_SESSION_DETACHED, "session_detached", "theme,question",            "Client %s disconnesso, sessione conservata (tema %lld, domanda %lld)") \
+    X(EV_SESSION_RESUMED,  "session_resumed",  "theme,question",            "Client %s ha ripreso la sessione (tema %lld, domanda %lld)") \
+    X(EV_QUESTION_TIMEOUT, "question_timeout", "theme,question",            "Client %s non ha risposto in tempo sul tema %lld alla domanda %lld") \
+    X(EV_SESSION_EVICTED,  "session_evicted",  "reason",                    "Connessione di %s chiusa dal server (motivo %lld)"     )
+
+#define LOG_EVENT_ENUM(id, name, args, fmt) id,
+typedef enum {
+    LOG_EVENT_LIST(LOG_EVENT_ENUM)
+    LOG_EVENT_COUNT
+} LogEventId;
+#undef LOG_EVENT_ENUM
+
+typedef struct {
+    const char* name;       // Nome stabile dell'evento (usato nell'output JSON)
+    const char* arg_names;  // Nomi degli argomenti interi separati da virgola
+    const char* format;     // Formato testuale equivalente al vecchio LOG_INFO
+} LogEventInfo;
+
+#define LOG_EVENT_INFO(id, name, args, fmt) { name, args, fmt },
+static const LogEventInfo log_event_info[LOG_EVENT_COUNT] = {
+    LOG_EVENT_LIST(LOG_EVENT_INFO)
+};
+#undef LOG_EVENT_INFO
+
+#endif /* LOG_EVENTS_H */
@@ -4,86 +4,463 @@
 #include <stdarg.h>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
 
-static FILE* log_file = NULL;
+// Dimensione massima di una riga del log testuale
+#define LOG_LINE_MAX 1024
+
+/*
+ * File di log con rotazione.
+ * Ogni processo (server principale e figli) tiene il proprio descrittore aperto in O_APPEND:
+ * una riga o un blocco di record corrisponde a una sola write(), quindi i processi non si
+ * interlacciano e nessuno resta in attesa di un lock per scrivere.
+ */
+typedef struct {
+    char path[256];
+    int fd;
+    ino_t ino;          // Inode aperto: se il percorso punta ad altro, un processo ha ruotato il file
+    time_t period;      // Periodo di rotazione temporale in cui il file è stato aperto
+    int binary;         // 1 se il file inizia con un BinLogHeader
+} LogSink;
+
+static LogSink text_sink = { "", -1, 0, 0, 0 };
+static LogSink binary_sink = { "", -1, 0, 0, 1 };
+
+// Soglia dei livelli: di default locale al processo, il server la sposta in memoria condivisa
+static volatile int default_min_level = LOG_INFO;
+volatile int* log_min_level = &default_min_level;
+
+// Righe e record persi per scritture fallite: locale al processo finché il server non lo condivide
+static uint64_t default_dropped = 0;
+static uint64_t* log_dropped = &default_dropped;
+
+// Parametri di rotazione
+static long long rotate_max_bytes = LOG_ROTATE_DEFAULT_BYTES;
+static int rotate_interval = 0;
+static int rotate_keep = LOG_ROTATE_DEFAULT_KEEP;
+
+// Prefisso temporale formattato una volta al secondo e riutilizzato
+static time_t cached_second = -1;
+static char cached_timestamp[32];
+
+// Stato della modalità binaria: buffer di record locale al processo
+static LogFormat event_format = LOG_FORMAT_TEXT;
+static BinLogRecord binlog_buffer[BINLOG_BUFFER_RECORDS];
+static int binlog_buffered = 0;
+static uint32_t binlog_session_id = 0;
+
+static const char* level_names[] = { "INFO", "WARNING", "ERROR" };
+
+/**
+ * Apre (o riapre) il file di un sink e ne registra inode e periodo di rotazione
+ * @param sink Il sink da aprire
+ * @param now Istante corrente
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int sink_open(LogSink* sink, time_t now) {
+    // Un file binario nuovo deve comparire già con l'intestazione letta da logdump:
+    // lo si prepara in un file temporaneo e lo si pubblica con link(), che fallisce
+    // se un altro processo lo ha già creato
+    if (sink->binary && access(sink->path, F_OK) < 0) {
+        char tmp[sizeof(sink->path) + 32];
+        snprintf(tmp, sizeof(tmp), "%s.tmp.%d", sink->path, (int)getpid());
+
+        int tmp_fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (tmp_fd >= 0) {
+            BinLogHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, BINLOG_MAGIC, sizeof(header.magic));
+            header.version = BINLOG_VERSION;
+            header.record_size = sizeof(BinLogRecord);
+            if (write(tmp_fd, &header, sizeof(header)) == (ssize_t)sizeof(header)) {
+                link(tmp, sink->path);
+            }
+            close(tmp_fd);
+            unlink(tmp);
+        }
+    }
+
+    int fd = open(sink->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (sink->fd >= 0) {
+        close(sink->fd);
+    }
+    sink->fd = fd;
+    sink->ino = st.st_ino;
+    sink->period = rotate_interval > 0 ? now / rotate_interval : 0;
+    return 0;
+}
+
+/**
+ * Scrive un blocco sul file del sink con una singola write()
+ * @param sink Il sink di destinazione
+ * @param buf I dati da scrivere
+ * @param len Numero di byte
+ * @return 0 se il blocco è stato scritto per intero, -1 altrimenti
+ */
+static int sink_write(LogSink* sink, const void* buf, size_t len) {
+    if (sink->fd < 0 || write(sink->fd, buf, len) != (ssize_t)len) {
+        return -1;
+    }
+    return 0;
+}
+
+// Conta le voci perse (il contatore può essere condiviso tra processi: incremento atomico)
+static void log_drop(uint64_t entries) {
+    __atomic_fetch_add(log_dropped, entries, __ATOMIC_RELAXED);
+}
+
+static void sink_close(LogSink* sink) {
+    if (sink->fd >= 0) {
+        close(sink->fd);
+        sink->fd = -1;
+    }
+}
+
+/**
+ * Indica se il file del sink va ruotato: dimensione massima superata o nuovo periodo
+ * @param sink Il sink
+ * @param st Lo stato del file sul percorso del sink
+ * @param now Istante corrente
+ * @return 1 se il file va ruotato
+ */
+static int sink_rotation_due(const LogSink* sink, const struct stat* st, time_t now) {
+    return (rotate_max_bytes > 0 && st->st_size >= rotate_max_bytes) ||
+           (rotate_interval > 0 && now / rotate_interval != sink->period);
+}
+
+/**
+ * Ruota il file di un sink: path.N-1 -> path.N, ..., path -> path.1, poi riapre path
+ * Il flock è preso su un'apertura propria del percorso: il descrittore del sink è ereditato
+ * dai figli nati dopo la sua apertura (stessa descrizione di file aperto) e un flock su di
+ * esso non escluderebbe gli altri processi. Il lock è non bloccante: se un altro processo sta
+ * già ruotando si continua a scrivere sul vecchio file e lo si abbandona al controllo successivo
+ *
+ * @param sink Il sink da ruotare
+ * @param now Istante corrente
+ */
+static void sink_rotate(LogSink* sink, time_t now) {
+    int lock_fd = open(sink->path, O_RDONLY);
+    if (lock_fd < 0) {
+        return;
+    }
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) < 0) {
+        close(lock_fd);
+        return;
+    }
+
+    // Ricontrolla sotto lock: il percorso deve essere ancora il nostro file e da ruotare
+    // (un altro processo può averlo appena ruotato e sostituito con uno nuovo)
+    struct stat st;
+    if (stat(sink->path, &st) == 0 && st.st_ino == sink->ino && sink_rotation_due(sink, &st, now)) {
+        char from[sizeof(sink->path) + 16], to[sizeof(sink->path) + 16];
+        for (int i = rotate_keep - 1; i >= 1; i--) {
+            snprintf(from, sizeof(from), "%s.%d", sink->path, i);
+            snprintf(to, sizeof(to), "%s.%d", sink->path, i + 1);
+            rename(from, to);
+        }
+        snprintf(to, sizeof(to), "%s.1", sink->path);
+        rename(sink->path, to);
+    }
+
+    // La chiusura rilascia il lock
+    close(lock_fd);
+    sink_open(sink, now);
+}
+
+/**
+ * Controllo periodico (una volta al secondo) di un sink
+ * Riapre il file se è stato ruotato da un altro processo, lo ruota se ha superato
+ * la dimensione massima o se è iniziato un nuovo periodo di rotazione
+ *
+ * @param sink Il sink da controllare
+ * @param now Istante corrente
+ */
+static void sink_check(LogSink* sink, time_t now) {
+    if (sink->fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (stat(sink->path, &st) < 0 || st.st_ino != sink->ino) {
+        sink_open(sink, now);
+        return;
+    }
+
+    if (sink_rotation_due(sink, &st, now)) {
+        sink_rotate(sink, now);
+    }
+}
+
+/**
+ * Aggiorna il prefisso temporale in cache ed esegue i controlli di rotazione
+ * Viene invocata solo quando cambia il secondo corrente
+ *
+ * @param now Istante corrente
+ */
+static void log_tick(time_t now) {
+    struct tm t;
+    localtime_r(&now, &t);
+    strftime(cached_timestamp, sizeof(cached_timestamp), "%Y-%m-%d %H:%M:%S", &t);
+    cached_second = now;
+
+    sink_check(&text_sink, now);
+    sink_check(&binary_sink, now);
+}
+
+/**
+ * Scrive una riga di servizio (avvio/terminazione) sul log testuale
+ * @param text Il testo della riga, senza timestamp
+ */
+static void write_banner(const char* text) {
+    time_t now = time(NULL);
+    if (now != cached_second) {
+        log_tick(now);
+    }
+
+    char line[128];
+    int len = snprintf(line, sizeof(line), "[%s] %s\n", cached_timestamp, text);
+    if (len > 0) {
+        sink_write(&text_sink, line, len);
+    }
+}
 
 void init_logger(const char* filename) {
     // Chiudi un eventuale file già aperto
-    if (log_file != NULL) {
-        fclose(log_file);
-    }
-    
+    sink_close(&text_sink);
+
     // Apri il file di log in modalità append
-    log_file = fopen(filename, "a");
-    if (log_file == NULL) {
+    strncpy(text_sink.path, filename, sizeof(text_sink.path) - 1);
+    if (sink_open(&text_sink, time(NULL)) < 0) {
         fprintf(stderr, "ERRORE: Impossibile aprire il file di log %s\n", filename);
         return;
     }
-    
+
     // Scrivi intestazione all'avvio
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char timestamp[64];
-    
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", t);
-    fprintf(log_file, "\n[%s] === SERVER AVVIATO ===\n", timestamp);
-    fflush(log_file);
+    write_banner("=== SERVER AVVIATO ===");
+}
+
+/**
+ * Attiva la modalità binaria per gli eventi strutturati
+ * Ogni flush è una singola write() di record interi, quindi i processi figli
+ * possono scrivere sullo stesso file senza interlacciare i record
+ *
+ * @param filename Percorso del file di log binario
+ * @return 0 se successo, -1 in caso di errore
+ */
+int init_binary_logger(const char* filename) {
+    int first = (binary_sink.fd < 0);
+
+    flush_logger();
+    strncpy(binary_sink.path, filename, sizeof(binary_sink.path) - 1);
+    if (sink_open(&binary_sink, time(NULL)) < 0) {
+        fprintf(stderr, "ERRORE: Impossibile aprire il file di log binario %s\n", filename);
+        return -1;
+    }
+
+    if (first) {
+        // I processi figli terminano con exit(): il buffer residuo viene scritto all'uscita
+        atexit(flush_logger);
+    }
+    event_format = LOG_FORMAT_BINARY;
+    return 0;
+}
+
+/**
+ * Configura la rotazione dei file di log
+ * @param max_bytes Dimensione oltre la quale il file viene ruotato (0 per disattivare)
+ * @param interval_seconds Periodo di rotazione temporale in secondi (0 per disattivare)
+ * @param keep Numero di file ruotati da conservare (almeno 1)
+ */
+void set_log_rotation(long long max_bytes, int interval_seconds, int keep) {
+    rotate_max_bytes = max_bytes;
+    rotate_interval = interval_seconds;
+    rotate_keep = keep > 0 ? keep : 1;
+}
+
+/**
+ * Imposta il livello minimo dei messaggi registrati
+ * @param level Il nuovo livello minimo
+ */
+void set_log_level(LogLevel level) {
+    *log_min_level = level;
+}
+
+/**
+ * Sposta la soglia dei livelli su una variabile esterna (es. in memoria condivisa),
+ * così che una modifica sia vista subito da tutti i processi
+ *
+ * @param storage La variabile che conterrà la soglia, inizializzata col valore corrente
+ */
+void log_attach_level(volatile int* storage) {
+    *storage = *log_min_level;
+    log_min_level = storage;
+}
+
+/**
+ * Sposta il contatore delle voci di log perse in una variabile fornita dal chiamante
+ * (il server lo mette in memoria condivisa per esporlo nelle metriche)
+ *
+ * @param storage La variabile che conterrà il contatore, inizializzata col valore corrente
+ */
+void log_attach_drop_counter(uint64_t* storage) {
+    *storage = *log_dropped;
+    log_dropped = storage;
+}
+
+/**
+ * Converte il nome di un livello (case-insensitive) nel valore corrispondente
+ * @param name Il nome del livello (info, warning, error)
+ * @return Il livello, -1 se il nome non è valido
+ */
+int parse_log_level(const char* name) {
+    for (int i = 0; i < (int)(sizeof(level_names) / sizeof(level_names[0])); i++) {
+        if (strcasecmp(name, level_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Restituisce il nome di un livello di log
+ * @param level Il livello
+ * @return Il nome del livello
+ */
+const char* log_level_name(LogLevel level) {
+    if ((int)level < 0 || level > LOG_ERROR) {
+        return "UNKNOWN";
+    }
+    return level_names[level];
+}
+
+/**
+ * Scrive su disco i record binari accumulati nel buffer del processo
+ * Va chiamata prima di fork(), altrimenti il figlio erediterebbe una copia del buffer
+ */
+void flush_logger(void) {
+    if (binary_sink.fd >= 0 && binlog_buffered > 0) {
+        if (sink_write(&binary_sink, binlog_buffer, binlog_buffered * sizeof(BinLogRecord)) < 0) {
+            fprintf(stderr, "ERRORE: scrittura del log binario incompleta\n");
+            log_drop(binlog_buffered);
+        }
+    }
+    binlog_buffered = 0;
+}
+
+/**
+ * Imposta l'identificativo di sessione dei record successivi
+ * @param session_id Identificativo (il server usa il pid del processo figlio)
+ */
+void log_set_session_id(uint32_t session_id) {
+    binlog_session_id = session_id;
+}
+
+/**
+ * Registra un evento strutturato
+ * In modalità testo equivale a log_message() con il formato della tabella degli eventi,
+ * in modalità binaria copia un record a dimensione fissa nel buffer senza formattare nulla
+ *
+ * @param level Livello di log
+ * @param event Identificativo dell'evento
+ * @param str Argomento stringa (può essere NULL)
+ * @param args Array di BINLOG_MAX_ARGS argomenti interi
+ */
+void log_event(LogLevel level, LogEventId event, const char* str, const int64_t* args) {
+    const LogEventInfo* info = &log_event_info[event];
+
+    if (event_format == LOG_FORMAT_TEXT || binary_sink.fd < 0) {
+        log_message(level, info->format, str ? str : "",
+                    (long long)args[0], (long long)args[1], (long long)args[2], (long long)args[3]);
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (ts.tv_sec != cached_second) {
+        log_tick(ts.tv_sec);
+    }
+
+    BinLogRecord* rec = &binlog_buffer[binlog_buffered++];
+    rec->timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    rec->session_id = binlog_session_id;
+    rec->event_id = (uint16_t)event;
+    rec->level = (uint8_t)level;
+    rec->argc = 0;
+    for (const char* p = info->arg_names; *p; p++) {
+        if (*p == ',' || rec->argc == 0) {
+            rec->argc++;
+        }
+    }
+    memcpy(rec->args, args, sizeof(rec->args));
+    strncpy(rec->str, str ? str : "", BINLOG_STR_LEN - 1);
+    rec->str[BINLOG_STR_LEN - 1] = '\0';
+
+    // Avvisi ed errori vengono resi persistenti subito, il resto a blocchi
+    if (binlog_buffered == BINLOG_BUFFER_RECORDS || level != LOG_INFO) {
+        flush_logger();
+    }
 }
 
 void close_logger(void) {
-    if (log_file != NULL) {
-        time_t now = time(NULL);
-        struct tm *t = localtime(&now);
-        char timestamp[64];
-        
-        strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", t);
-        fprintf(log_file, "[%s] === SERVER TERMINATO ===\n", timestamp);
-        fclose(log_file);
-        log_file = NULL;
+    if (binary_sink.fd >= 0) {
+        flush_logger();
+        sink_close(&binary_sink);
+        event_format = LOG_FORMAT_TEXT;
+    }
+    if (text_sink.fd >= 0) {
+        write_banner("=== SERVER TERMINATO ===");
+        sink_close(&text_sink);
     }
 }
 
 void log_message(LogLevel level, const char* format, ...) {
-    if (log_file == NULL) {
+    if (text_sink.fd < 0 || !log_enabled(level)) {
         return;
     }
-    
-    // Ottieni timestamp
+
+    // Il timestamp viene riformattato solo quando cambia il secondo
     time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", t);
-    
-    // Prefisso basato sul livello
-    const char* level_str;
-    switch(level) {
-        case LOG_INFO:
-            level_str = "INFO";
-            break;
-        case LOG_WARNING:
-            level_str = "WARNING";
-            break;
-        case LOG_ERROR:
-            level_str = "ERROR";
-            break;
-        default:
-            level_str = "UNKNOWN";
-    }
-    
-    // Scrivi l'intestazione del messaggio
-    fprintf(log_file, "[%s] [%s] ", timestamp, level_str);
-    
-    // Scrivi il messaggio formattato
+    if (now != cached_second) {
+        log_tick(now);
+    }
+
+    // Compone l'intera riga in memoria: intestazione, messaggio e newline
+    char line[LOG_LINE_MAX];
+    int len = snprintf(line, sizeof(line), "[%s] [%s] ", cached_timestamp, log_level_name(level));
+
     va_list args;
     va_start(args, format);
-    vfprintf(log_file, format, args);
+    int written = vsnprintf(line + len, sizeof(line) - len, format, args);
     va_end(args);
-    
+
+    if (written > 0) {
+        len += written;
+    }
+    if (len > (int)sizeof(line) - 2) {
+        len = sizeof(line) - 2;
+    }
+
     // Aggiungi newline se necessario
-    if (format[strlen(format) - 1] != '\n') {
-        fprintf(log_file, "\n");
+    if (line[len - 1] != '\n') {
+        line[len++] = '\n';
     }
-    
-    // Flush immediato per assicurarci che il messaggio venga scritto
-    fflush(log_file);
-}
\ No newline at end of file
+
+    // Una sola write() per riga: atomica rispetto agli altri processi in O_APPEND
+    if (sink_write(&text_sink, line, len) < 0) {
+        log_drop(1);
+    }
+}
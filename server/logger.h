@@ -1,6 +1,9 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <stdint.h>
+#include "log_events.h"
+
 // Livelli di log
 typedef enum {
     LOG_INFO,
@@ -8,18 +11,86 @@ typedef enum {
     LOG_ERROR
 } LogLevel;
 
+// Formato degli eventi strutturati (LOG_EVENT)
+typedef enum {
+    LOG_FORMAT_TEXT,    // Stringa leggibile nel file di log principale
+    LOG_FORMAT_BINARY   // Record binari a dimensione fissa, decodificati offline da logdump
+} LogFormat;
+
+// Formato del file di log binario: intestazione seguita da record BinLogRecord
+#define BINLOG_MAGIC "QUIZBLOG"
+#define BINLOG_VERSION 1
+#define BINLOG_MAX_ARGS 4
+#define BINLOG_STR_LEN 32
+#define BINLOG_BUFFER_RECORDS 64 // Record accumulati in memoria prima di una write()
+
+// Rotazione dei file di log
+#define LOG_ROTATE_DEFAULT_BYTES (10LL * 1024 * 1024) // Dimensione massima prima della rotazione
+#define LOG_ROTATE_DEFAULT_KEEP 5                      // File ruotati conservati (file.1 ... file.N)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} BinLogHeader;
+
+typedef struct {
+    uint64_t timestamp_ns;              // CLOCK_REALTIME in nanosecondi
+    uint32_t session_id;                // Identificativo della sessione (pid del processo figlio)
+    uint16_t event_id;                  // LogEventId
+    uint8_t level;                      // LogLevel
+    uint8_t argc;                       // Argomenti interi significativi
+    int64_t args[BINLOG_MAX_ARGS];      // Argomenti interi tipizzati
+    char str[BINLOG_STR_LEN];           // Argomento stringa (tipicamente il nickname)
+} BinLogRecord;
+
+// Soglia corrente dei livelli: i messaggi sotto soglia non vengono nemmeno formattati
+extern volatile int* log_min_level;
+
+static inline int log_enabled(LogLevel level) {
+    return (int)level >= *log_min_level;
+}
+
 // Inizializza il logger
 void init_logger(const char* log_file);
 
+// Attiva la modalità binaria per gli eventi strutturati, scrivendo su binlog_file
+int init_binary_logger(const char* binlog_file);
+
 // Chiude il logger
 void close_logger(void);
 
+// Svuota i buffer del logger (da chiamare prima di fork() per non duplicare record)
+void flush_logger(void);
+
+// Imposta l'identificativo di sessione scritto nei record binari
+void log_set_session_id(uint32_t session_id);
+
+// Configurazione a runtime: livello minimo e rotazione dei file
+void set_log_level(LogLevel level);
+void log_attach_level(volatile int* storage);
+void log_attach_drop_counter(uint64_t* storage);
+int parse_log_level(const char* name);
+const char* log_level_name(LogLevel level);
+void set_log_rotation(long long max_bytes, int interval_seconds, int keep);
+
 // Funzioni di logging
 void log_message(LogLevel level, const char* format, ...);
+void log_event(LogLevel level, LogEventId event, const char* str, const int64_t* args);
 
 // Macro helper per semplificare l'uso
-#define LOG_INFO(format, ...) log_message(LOG_INFO, format, ##__VA_ARGS__)
-#define LOG_WARNING(format, ...) log_message(LOG_WARNING, format, ##__VA_ARGS__)
-#define LOG_ERROR(format, ...) log_message(LOG_ERROR, format, ##__VA_ARGS__)
+// Il livello viene controllato prima della chiamata, così gli argomenti non vengono valutati
+#define LOG_AT(level, format, ...) \
+    do { if (log_enabled(level)) log_message(level, format, ##__VA_ARGS__); } while (0)
+#define LOG_INFO(format, ...) LOG_AT(LOG_INFO, format, ##__VA_ARGS__)
+#define LOG_WARNING(format, ...) LOG_AT(LOG_WARNING, format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(LOG_ERROR, format, ##__VA_ARGS__)
+
+// Evento strutturato: fino a BINLOG_MAX_ARGS argomenti interi, i mancanti valgono 0
+#define LOG_EVENT(level, event, str, ...) \
+    do { \
+        if (log_enabled(level)) \
+            log_event(level, event, str, (const int64_t[BINLOG_MAX_ARGS + 1]){0, ##__VA_ARGS__} + 1); \
+    } while (0)
 
-#endif /* LOGGER_H */
\ No newline at end of file
+#endif /* LOGGER_H */
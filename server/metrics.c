@@ -0,0 +1,615 @@
+#include "metrics.h"
+#include "logger.h"
+#include "../shared/transport.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+// Limiti superiori (in secondi) dei bucket esposti per gli istogrammi Prometheus
+static const double exposed_bounds[] = {
+    0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005,
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+// Tipo di messaggio del protocollo corrispondente a ogni MetricType
+static const char* metric_names[METRIC_TYPES] = {
+    MSG_NICK, MSG_RESUME, MSG_THEMES, MSG_THEME, MSG_QUIZ_START, MSG_ANSWER, MSG_SCORE, MSG_END, "OTHER"
+};
+
+/**
+ * Classifica un messaggio ricevuto dal client
+ * @param type Il tipo del messaggio
+ * @return Il tipo di richiesta, METRIC_OTHER se non è una richiesta misurata
+ */
+MetricType metric_type(const char* type) {
+    for (int i = 0; i < METRIC_OTHER; i++) {
+        if (strcmp(type, metric_names[i]) == 0) {
+            return (MetricType)i;
+        }
+    }
+    return METRIC_OTHER;
+}
+
+/**
+ * Restituisce il nome di un tipo di richiesta
+ * @param type Il tipo di richiesta
+ * @return Il nome (il tipo di messaggio del protocollo)
+ */
+const char* metric_name(MetricType type) {
+    return type >= 0 && type < METRIC_TYPES ? metric_names[type] : "OTHER";
+}
+
+/**
+ * Registra una richiesta servita
+ * @param type Il tipo di richiesta
+ * @param latency_ns Il tempo di servizio in nanosecondi
+ * @param bytes I byte di payload della richiesta
+ */
+void metrics_record(MetricType type, uint64_t latency_ns, size_t bytes) {
+    Metrics* metrics = &shared_state->metrics;
+    histogram_record_atomic(&metrics->latency[type], latency_ns);
+    __atomic_fetch_add(&metrics->bytes_in[type], bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta una connessione accettata dal processo principale
+ */
+void metrics_connection_accepted(void) {
+    __atomic_fetch_add(&shared_state->metrics.connections_accepted, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta una connessione rifiutata (server pieno, processo figlio non creato)
+ */
+void metrics_connection_rejected(void) {
+    __atomic_fetch_add(&shared_state->metrics.connections_rejected, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Aggiorna il numero di sessioni servite in questo momento
+ * @param delta +1 all'avvio di una sessione, -1 alla sua fine
+ */
+void metrics_session_change(int delta) {
+    __atomic_fetch_add(&shared_state->metrics.sessions_active, delta, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta un messaggio delle stanze dal vivo, codificato una volta e consegnato a più partecipanti
+ * @param recipients I partecipanti a cui è stato accodato
+ */
+void metrics_room_broadcast(int recipients) {
+    __atomic_fetch_add(&shared_state->metrics.room_frames_encoded, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shared_state->metrics.room_frames_sent, recipients, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta una modifica della classifica globale di un tema
+ */
+void metrics_rank_update(void) {
+    __atomic_fetch_add(&shared_state->metrics.rank_updates, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta un aggiornamento della classifica, codificato una volta e consegnato a più iscritti
+ * @param recipients Gli iscritti a cui è stato accodato
+ */
+void metrics_rank_push(int recipients) {
+    __atomic_fetch_add(&shared_state->metrics.rank_frames_sent, recipients, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta una connessione chiusa per tempo scaduto
+ * @param reason Il motivo
+ */
+void metrics_session_evicted(EvictReason reason) {
+    __atomic_fetch_add(&shared_state->metrics.sessions_evicted[reason], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta una connessione chiusa perché il client non leggeva i messaggi in uscita
+ */
+void metrics_slow_consumer(void) {
+    __atomic_fetch_add(&shared_state->metrics.slow_consumers, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta gli aggiornamenti delle classifiche non inviati a un iscritto oltre la soglia alta
+ * @param count Gli aggiornamenti (uno per tema)
+ * @param coalesced 1 se saranno riassunti nella classifica intera, 0 se scartati
+ */
+void metrics_push_skipped(int count, int coalesced) {
+    uint64_t* counter = coalesced ? &shared_state->metrics.pushes_coalesced : &shared_state->metrics.pushes_dropped;
+    __atomic_fetch_add(counter, count, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta una richiesta oltre il limite di frequenza del suo indirizzo
+ * @param kind RATE_CONNECT per una connessione rifiutata, RATE_MESSAGE per un messaggio rallentato o rifiutato
+ */
+void metrics_rate_limited(RateKind kind) {
+    __atomic_fetch_add(&shared_state->metrics.rate_limited[kind], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Conta un client arrivato a server pieno, per esito
+ * @param outcome L'esito
+ * @param wait_ms L'attesa in coda, per ADMISSION_ADMITTED
+ */
+void metrics_admission(AdmissionOutcome outcome, uint64_t wait_ms) {
+    __atomic_fetch_add(&shared_state->metrics.admissions[outcome], 1, __ATOMIC_RELAXED);
+    if (outcome == ADMISSION_ADMITTED) {
+        __atomic_fetch_add(&shared_state->metrics.admission_wait_ms, wait_ms, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Conta i registri della classifica scambiati con i peer (vedi replica.h)
+ * @param sent Registri inviati
+ * @param received Registri ricevuti
+ * @param merged Registri ricevuti che hanno modificato la classifica locale
+ */
+void metrics_replica_records(int sent, int received, int merged) {
+    __atomic_fetch_add(&shared_state->metrics.replica_sent, sent, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shared_state->metrics.replica_received, received, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shared_state->metrics.replica_merged, merged, __ATOMIC_RELAXED);
+}
+
+/**
+ * Registra il numero di peer a cui il processo di replica è connesso
+ * @param connected I peer connessi
+ */
+void metrics_replica_peers(int connected) {
+    __atomic_store_n(&shared_state->metrics.replica_peers, connected, __ATOMIC_RELAXED);
+}
+
+/**
+ * Copia le metriche correnti senza fermare i processi che le aggiornano
+ * @param snapshot Output: la copia
+ */
+void metrics_snapshot(MetricsSnapshot* snapshot) {
+    Metrics* metrics = &shared_state->metrics;
+    for (int i = 0; i < METRIC_TYPES; i++) {
+        histogram_snapshot(&snapshot->latency[i], &metrics->latency[i]);
+        snapshot->bytes_in[i] = __atomic_load_n(&metrics->bytes_in[i], __ATOMIC_RELAXED);
+    }
+    histogram_snapshot(&snapshot->lock_wait, &metrics->lock_wait);
+    snapshot->connections_accepted = __atomic_load_n(&metrics->connections_accepted, __ATOMIC_RELAXED);
+    snapshot->connections_rejected = __atomic_load_n(&metrics->connections_rejected, __ATOMIC_RELAXED);
+    snapshot->sessions_active = __atomic_load_n(&metrics->sessions_active, __ATOMIC_RELAXED);
+    snapshot->log_dropped = __atomic_load_n(&metrics->log_dropped, __ATOMIC_RELAXED);
+    snapshot->room_frames_encoded = __atomic_load_n(&metrics->room_frames_encoded, __ATOMIC_RELAXED);
+    snapshot->room_frames_sent = __atomic_load_n(&metrics->room_frames_sent, __ATOMIC_RELAXED);
+    snapshot->rank_updates = __atomic_load_n(&metrics->rank_updates, __ATOMIC_RELAXED);
+    snapshot->rank_frames_sent = __atomic_load_n(&metrics->rank_frames_sent, __ATOMIC_RELAXED);
+    for (int i = 0; i < EVICT_REASONS; i++) {
+        snapshot->sessions_evicted[i] = __atomic_load_n(&metrics->sessions_evicted[i], __ATOMIC_RELAXED);
+    }
+    snapshot->slow_consumers = __atomic_load_n(&metrics->slow_consumers, __ATOMIC_RELAXED);
+    snapshot->pushes_dropped = __atomic_load_n(&metrics->pushes_dropped, __ATOMIC_RELAXED);
+    snapshot->pushes_coalesced = __atomic_load_n(&metrics->pushes_coalesced, __ATOMIC_RELAXED);
+    for (int i = 0; i < RATE_KINDS; i++) {
+        snapshot->rate_limited[i] = __atomic_load_n(&metrics->rate_limited[i], __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < ADMISSION_OUTCOMES; i++) {
+        snapshot->admissions[i] = __atomic_load_n(&metrics->admissions[i], __ATOMIC_RELAXED);
+    }
+    snapshot->admission_wait_ms = __atomic_load_n(&metrics->admission_wait_ms, __ATOMIC_RELAXED);
+    snapshot->admission_waiting = __atomic_load_n(&shared_state->admission.waiting, __ATOMIC_RELAXED);
+    snapshot->replica_sent = __atomic_load_n(&metrics->replica_sent, __ATOMIC_RELAXED);
+    snapshot->replica_received = __atomic_load_n(&metrics->replica_received, __ATOMIC_RELAXED);
+    snapshot->replica_merged = __atomic_load_n(&metrics->replica_merged, __ATOMIC_RELAXED);
+    snapshot->replica_peers = __atomic_load_n(&metrics->replica_peers, __ATOMIC_RELAXED);
+    snapshot->players_active = __atomic_load_n(&shared_state->player_count, __ATOMIC_RELAXED);
+}
+
+/**
+ * Scrive nel log un riepilogo delle latenze per tipo di richiesta (p50/p99/p999 in µs)
+ * e, con il profilo dei lock attivo, i punti di chiamata che attendono di più
+ */
+void metrics_log_summary(void) {
+    static MetricsSnapshot snapshot;
+    metrics_snapshot(&snapshot);
+
+    for (int i = 0; i < METRIC_TYPES; i++) {
+        const Histogram* hist = &snapshot.latency[i];
+        if (hist->count == 0) {
+            continue;
+        }
+        LOG_INFO("Latenza %s: %llu richieste, p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us",
+                 metric_name(i), (unsigned long long)hist->count,
+                 histogram_percentile(hist, 50) / 1000.0, histogram_percentile(hist, 99) / 1000.0,
+                 histogram_percentile(hist, 99.9) / 1000.0, hist->max / 1000.0);
+    }
+
+    if (shared_state->locks.enabled) {
+        static char report[METRICS_LOCK_REPORT_TOP * 256];
+        lock_profile_report(report, sizeof(report), METRICS_LOCK_REPORT_TOP);
+        for (char* line = strtok(report, "\n"); line; line = strtok(NULL, "\n")) {
+            LOG_INFO("Lock %s", line);
+        }
+    }
+}
+
+// Copia del profilo dei lock, ordinata per attesa totale decrescente
+static LockSite profile_copy[LOCK_MAX_SITES];
+
+static int compare_site_wait(const void* a, const void* b) {
+    const LockSite* x = a;
+    const LockSite* y = b;
+    return x->wait.sum < y->wait.sum ? 1 : x->wait.sum > y->wait.sum ? -1 : 0;
+}
+
+/**
+ * Copia il profilo dei lock senza acquisire il lock e lo ordina per attesa totale
+ * @return Il numero di punti di chiamata copiati in profile_copy
+ */
+static int lock_profile_snapshot(void) {
+    LockProfile* profile = &shared_state->locks;
+    int count = __atomic_load_n(&profile->count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        memcpy(profile_copy[i].file, profile->sites[i].file, sizeof(profile_copy[i].file));
+        memcpy(profile_copy[i].func, profile->sites[i].func, sizeof(profile_copy[i].func));
+        profile_copy[i].line = profile->sites[i].line;
+        histogram_snapshot(&profile_copy[i].wait, &profile->sites[i].wait);
+        histogram_snapshot(&profile_copy[i].hold, &profile->sites[i].hold);
+    }
+    qsort(profile_copy, count, sizeof(LockSite), compare_site_wait);
+    return count;
+}
+
+/**
+ * Descrive i punti di chiamata che attendono di più il lock dello stato (profilo attivo con -L)
+ * Una riga per punto: acquisizioni, attesa totale, p99 di attesa e possesso, possesso massimo
+ *
+ * @param buffer Il buffer di destinazione
+ * @param size La dimensione del buffer
+ * @param top Il numero massimo di punti di chiamata
+ * @return Il numero di righe scritte
+ */
+int lock_profile_report(char* buffer, size_t size, int top) {
+    int count = lock_profile_snapshot();
+    size_t len = 0;
+    int lines = 0;
+    buffer[0] = '\0';
+
+    for (int i = 0; i < count && lines < top; i++) {
+        const LockSite* site = &profile_copy[i];
+        if (site->wait.count == 0) {
+            continue;
+        }
+        int written = snprintf(buffer + len, size - len,
+                               "%s:%d %s: %llu acquisizioni, attesa %.3f ms (p99 %.1f us), "
+                               "possesso p99 %.1f us, max %.1f us\n",
+                               site->file, site->line, site->func, (unsigned long long)site->wait.count,
+                               site->wait.sum / 1e6, histogram_percentile(&site->wait, 99) / 1000.0,
+                               histogram_percentile(&site->hold, 99) / 1000.0, site->hold.max / 1000.0);
+        if (written < 0 || (size_t)written >= size - len) {
+            break;
+        }
+        len += written;
+        lines++;
+    }
+    return lines;
+}
+
+// Buffer di uscita della pagina delle metriche: le scritture oltre la capacità vengono troncate
+typedef struct {
+    char* data;
+    size_t size;
+    size_t len;
+} Page;
+
+static void page_printf(Page* page, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void page_printf(Page* page, const char* format, ...) {
+    if (page->len >= page->size) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(page->data + page->len, page->size - page->len, format, args);
+    va_end(args);
+    if (written > 0) {
+        page->len += (size_t)written < page->size - page->len ? (size_t)written : page->size - page->len - 1;
+    }
+}
+
+/**
+ * Scrive un istogramma in nanosecondi come istogramma Prometheus in secondi
+ * I bucket esposti sono fissi: ognuno conta i bucket log-lineari interamente sotto il suo limite
+ *
+ * @param page La pagina di destinazione
+ * @param name Il nome della metrica
+ * @param labels Le etichette (es. type="ANSWER",), stringa vuota se nessuna
+ * @param hist L'istogramma
+ */
+static void page_histogram(Page* page, const char* name, const char* labels, const Histogram* hist) {
+    int bucket = 0;
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i < sizeof(exposed_bounds) / sizeof(exposed_bounds[0]); i++) {
+        uint64_t bound_ns = (uint64_t)(exposed_bounds[i] * 1e9 + 0.5);
+        while (bucket < HIST_BUCKETS && histogram_bucket_limit(bucket) <= bound_ns) {
+            cumulative += hist->buckets[bucket++];
+        }
+        page_printf(page, "%s_bucket{%sle=\"%g\"} %llu\n", name, labels, exposed_bounds[i],
+                    (unsigned long long)cumulative);
+    }
+    page_printf(page, "%s_bucket{%sle=\"+Inf\"} %llu\n", name, labels, (unsigned long long)hist->count);
+
+    // _sum e _count senza la virgola finale delle etichette
+    char plain[64] = "";
+    size_t len = strlen(labels);
+    if (len > 0) {
+        snprintf(plain, sizeof(plain), "{%.*s}", (int)(len - 1), labels);
+    }
+    page_printf(page, "%s_sum%s %.9f\n", name, plain, hist->sum / 1e9);
+    page_printf(page, "%s_count%s %llu\n", name, plain, (unsigned long long)hist->count);
+}
+
+/**
+ * Genera la pagina delle metriche in formato testo Prometheus (versione 0.0.4)
+ * Legge solo i contatori atomici: non acquisisce il lock dello stato condiviso
+ *
+ * @param buffer Il buffer di destinazione
+ * @param size La dimensione del buffer
+ * @return La lunghezza della pagina
+ */
+int metrics_format(char* buffer, size_t size) {
+    static MetricsSnapshot snapshot;
+    Page page = { buffer, size, 0 };
+    metrics_snapshot(&snapshot);
+    buffer[0] = '\0';
+
+    page_printf(&page, "# HELP quiz_sessions_active Sessioni servite in questo momento.\n");
+    page_printf(&page, "# TYPE quiz_sessions_active gauge\n");
+    page_printf(&page, "quiz_sessions_active %lld\n", (long long)snapshot.sessions_active);
+
+    page_printf(&page, "# HELP quiz_connections_accepted_total Connessioni accettate.\n");
+    page_printf(&page, "# TYPE quiz_connections_accepted_total counter\n");
+    page_printf(&page, "quiz_connections_accepted_total %llu\n", (unsigned long long)snapshot.connections_accepted);
+
+    page_printf(&page, "# HELP quiz_connections_rejected_total Connessioni rifiutate (server pieno o fork fallita).\n");
+    page_printf(&page, "# TYPE quiz_connections_rejected_total counter\n");
+    page_printf(&page, "quiz_connections_rejected_total %llu\n", (unsigned long long)snapshot.connections_rejected);
+
+    page_printf(&page, "# HELP quiz_room_frames_encoded_total Messaggi delle stanze dal vivo codificati.\n");
+    page_printf(&page, "# TYPE quiz_room_frames_encoded_total counter\n");
+    page_printf(&page, "quiz_room_frames_encoded_total %llu\n", (unsigned long long)snapshot.room_frames_encoded);
+
+    page_printf(&page, "# HELP quiz_room_frames_sent_total Consegne dei messaggi delle stanze ai partecipanti.\n");
+    page_printf(&page, "# TYPE quiz_room_frames_sent_total counter\n");
+    page_printf(&page, "quiz_room_frames_sent_total %llu\n", (unsigned long long)snapshot.room_frames_sent);
+
+    page_printf(&page, "# HELP quiz_rank_updates_total Modifiche della classifica globale.\n");
+    page_printf(&page, "# TYPE quiz_rank_updates_total counter\n");
+    page_printf(&page, "quiz_rank_updates_total %llu\n", (unsigned long long)snapshot.rank_updates);
+
+    page_printf(&page, "# HELP quiz_rank_frames_sent_total Aggiornamenti della classifica consegnati agli iscritti.\n");
+    page_printf(&page, "# TYPE quiz_rank_frames_sent_total counter\n");
+    page_printf(&page, "quiz_rank_frames_sent_total %llu\n", (unsigned long long)snapshot.rank_frames_sent);
+
+    static const char* evict_names[EVICT_REASONS] = { "handshake", "idle", "message", "flood" };
+    page_printf(&page, "# HELP quiz_sessions_evicted_total Connessioni chiuse dal server (tempo scaduto o troppi messaggi), per motivo.\n");
+    page_printf(&page, "# TYPE quiz_sessions_evicted_total counter\n");
+    for (int i = 0; i < EVICT_REASONS; i++) {
+        page_printf(&page, "quiz_sessions_evicted_total{reason=\"%s\"} %llu\n", evict_names[i],
+                    (unsigned long long)snapshot.sessions_evicted[i]);
+    }
+
+    page_printf(&page, "# HELP quiz_slow_consumers_total Connessioni chiuse perché il client non leggeva i messaggi.\n");
+    page_printf(&page, "# TYPE quiz_slow_consumers_total counter\n");
+    page_printf(&page, "quiz_slow_consumers_total %llu\n", (unsigned long long)snapshot.slow_consumers);
+
+    page_printf(&page, "# HELP quiz_rank_pushes_skipped_total Aggiornamenti delle classifiche non inviati a iscritti lenti.\n");
+    page_printf(&page, "# TYPE quiz_rank_pushes_skipped_total counter\n");
+    page_printf(&page, "quiz_rank_pushes_skipped_total{policy=\"drop\"} %llu\n", (unsigned long long)snapshot.pushes_dropped);
+    page_printf(&page, "quiz_rank_pushes_skipped_total{policy=\"coalesce\"} %llu\n", (unsigned long long)snapshot.pushes_coalesced);
+
+    page_printf(&page, "# HELP quiz_players_active Giocatori registrati in questo momento (al più %d).\n", MAX_CLIENTS);
+    page_printf(&page, "# TYPE quiz_players_active gauge\n");
+    page_printf(&page, "quiz_players_active %d\n", snapshot.players_active);
+
+    page_printf(&page, "# HELP quiz_admission_waiting Client in coda di ammissione.\n");
+    page_printf(&page, "# TYPE quiz_admission_waiting gauge\n");
+    page_printf(&page, "quiz_admission_waiting %d\n", snapshot.admission_waiting);
+
+    static const char* admission_names[ADMISSION_OUTCOMES] = { "queued", "admitted", "abandoned", "rejected" };
+    page_printf(&page, "# HELP quiz_admissions_total Client arrivati a server pieno, per esito.\n");
+    page_printf(&page, "# TYPE quiz_admissions_total counter\n");
+    for (int i = 0; i < ADMISSION_OUTCOMES; i++) {
+        page_printf(&page, "quiz_admissions_total{outcome=\"%s\"} %llu\n", admission_names[i],
+                    (unsigned long long)snapshot.admissions[i]);
+    }
+
+    page_printf(&page, "# HELP quiz_admission_wait_seconds_total Attesa complessiva in coda dei client ammessi.\n");
+    page_printf(&page, "# TYPE quiz_admission_wait_seconds_total counter\n");
+    page_printf(&page, "quiz_admission_wait_seconds_total %.3f\n", snapshot.admission_wait_ms / 1e3);
+
+    page_printf(&page, "# HELP quiz_replica_peers_connected Peer a cui la classifica viene replicata.\n");
+    page_printf(&page, "# TYPE quiz_replica_peers_connected gauge\n");
+    page_printf(&page, "quiz_replica_peers_connected %lld\n", (long long)snapshot.replica_peers);
+
+    page_printf(&page, "# HELP quiz_replica_records_total Registri della classifica scambiati con i peer.\n");
+    page_printf(&page, "# TYPE quiz_replica_records_total counter\n");
+    page_printf(&page, "quiz_replica_records_total{direction=\"sent\"} %llu\n",
+                (unsigned long long)snapshot.replica_sent);
+    page_printf(&page, "quiz_replica_records_total{direction=\"received\"} %llu\n",
+                (unsigned long long)snapshot.replica_received);
+
+    page_printf(&page, "# HELP quiz_replica_merges_total Registri ricevuti dai peer che hanno modificato la classifica.\n");
+    page_printf(&page, "# TYPE quiz_replica_merges_total counter\n");
+    page_printf(&page, "quiz_replica_merges_total %llu\n", (unsigned long long)snapshot.replica_merged);
+
+    static const char* rate_names[RATE_KINDS] = { "connect", "message" };
+    page_printf(&page, "# HELP quiz_rate_limited_total Connessioni rifiutate e messaggi rallentati dai limiti per indirizzo.\n");
+    page_printf(&page, "# TYPE quiz_rate_limited_total counter\n");
+    for (int i = 0; i < RATE_KINDS; i++) {
+        page_printf(&page, "quiz_rate_limited_total{kind=\"%s\"} %llu\n", rate_names[i],
+                    (unsigned long long)snapshot.rate_limited[i]);
+    }
+
+    page_printf(&page, "# HELP quiz_requests_total Richieste ricevute per tipo di messaggio.\n");
+    page_printf(&page, "# TYPE quiz_requests_total counter\n");
+    for (int i = 0; i < METRIC_TYPES; i++) {
+        page_printf(&page, "quiz_requests_total{type=\"%s\"} %llu\n", metric_name(i),
+                    (unsigned long long)snapshot.latency[i].count);
+    }
+
+    page_printf(&page, "# HELP quiz_request_bytes_total Byte di payload ricevuti per tipo di messaggio.\n");
+    page_printf(&page, "# TYPE quiz_request_bytes_total counter\n");
+    for (int i = 0; i < METRIC_TYPES; i++) {
+        page_printf(&page, "quiz_request_bytes_total{type=\"%s\"} %llu\n", metric_name(i),
+                    (unsigned long long)snapshot.bytes_in[i]);
+    }
+
+    page_printf(&page, "# HELP quiz_request_duration_seconds Tempo di servizio delle richieste.\n");
+    page_printf(&page, "# TYPE quiz_request_duration_seconds histogram\n");
+    for (int i = 0; i < METRIC_TYPES; i++) {
+        char labels[48];
+        snprintf(labels, sizeof(labels), "type=\"%s\",", metric_name(i));
+        page_histogram(&page, "quiz_request_duration_seconds", labels, &snapshot.latency[i]);
+    }
+
+    page_printf(&page, "# HELP quiz_lock_wait_seconds Attesa per acquisire il lock dello stato condiviso.\n");
+    page_printf(&page, "# TYPE quiz_lock_wait_seconds histogram\n");
+    page_histogram(&page, "quiz_lock_wait_seconds", "", &snapshot.lock_wait);
+
+    int sites = shared_state->locks.enabled ? lock_profile_snapshot() : 0;
+    if (sites > 0) {
+        page_printf(&page, "# HELP quiz_lock_site_wait_seconds Attesa del lock per punto di chiamata.\n");
+        page_printf(&page, "# TYPE quiz_lock_site_wait_seconds summary\n");
+        for (int i = 0; i < sites; i++) {
+            page_printf(&page, "quiz_lock_site_wait_seconds_sum{site=\"%s:%d\",func=\"%s\"} %.9f\n",
+                        profile_copy[i].file, profile_copy[i].line, profile_copy[i].func,
+                        profile_copy[i].wait.sum / 1e9);
+            page_printf(&page, "quiz_lock_site_wait_seconds_count{site=\"%s:%d\",func=\"%s\"} %llu\n",
+                        profile_copy[i].file, profile_copy[i].line, profile_copy[i].func,
+                        (unsigned long long)profile_copy[i].wait.count);
+        }
+        page_printf(&page, "# HELP quiz_lock_site_hold_seconds Possesso del lock per punto di chiamata.\n");
+        page_printf(&page, "# TYPE quiz_lock_site_hold_seconds summary\n");
+        for (int i = 0; i < sites; i++) {
+            page_printf(&page, "quiz_lock_site_hold_seconds_sum{site=\"%s:%d\",func=\"%s\"} %.9f\n",
+                        profile_copy[i].file, profile_copy[i].line, profile_copy[i].func,
+                        profile_copy[i].hold.sum / 1e9);
+            page_printf(&page, "quiz_lock_site_hold_seconds_count{site=\"%s:%d\",func=\"%s\"} %llu\n",
+                        profile_copy[i].file, profile_copy[i].line, profile_copy[i].func,
+                        (unsigned long long)profile_copy[i].hold.count);
+        }
+    }
+
+    page_printf(&page, "# HELP quiz_log_dropped_total Righe e record di log persi.\n");
+    page_printf(&page, "# TYPE quiz_log_dropped_total counter\n");
+    page_printf(&page, "quiz_log_dropped_total %llu\n", (unsigned long long)snapshot.log_dropped);
+
+    return (int)page.len;
+}
+
+/**
+ * Verifica se l'indirizzo delle metriche è un numero di porta
+ * @param address L'indirizzo passato con l'opzione -m
+ * @return 1 se è una porta TCP, 0 se è il percorso di un socket Unix
+ */
+int metrics_address_is_port(const char* address) {
+    if (address[0] == '\0') {
+        return 0;
+    }
+    for (const char* p = address; *p; p++) {
+        if (!isdigit((unsigned char)*p)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Apre il socket di ascolto delle metriche
+ * @param address Un numero di porta (TCP, solo su 127.0.0.1) o il percorso di un socket Unix
+ * @return Il socket in ascolto, -1 in caso di errore
+ */
+int metrics_listen(const char* address) {
+    if (!metrics_address_is_port(address)) {
+        return transport_unix_listen(address, 16);
+    }
+
+    int port = atoi(address);
+    if (port <= 0 || port > 65535) {
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Serve una richiesta HTTP sul socket accettato e lo chiude
+ * Qualunque GET riceve la pagina delle metriche; le altre richieste ricevono 405
+ *
+ * @param client_fd Il socket accettato
+ */
+void metrics_serve(int client_fd) {
+    static char page[METRICS_PAGE_SIZE];
+    char request[1024];
+    size_t received = 0;
+
+    struct timeval timeout = { METRICS_IO_TIMEOUT_SEC, 0 };
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Legge fino alla fine delle intestazioni (o finché il buffer è pieno)
+    while (received < sizeof(request) - 1) {
+        ssize_t n = recv(client_fd, request + received, sizeof(request) - 1 - received, 0);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+            break;
+        }
+    }
+    request[received] = '\0';
+
+    char header[256];
+    int body_len = 0;
+    const char* body = page;
+    if (strncmp(request, "GET ", 4) == 0) {
+        body_len = metrics_format(page, sizeof(page));
+        snprintf(header, sizeof(header),
+                 "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %d\r\nConnection: close\r\n\r\n", body_len);
+    } else {
+        body = "";
+        snprintf(header, sizeof(header),
+                 "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    }
+
+    if (send(client_fd, header, strlen(header), MSG_NOSIGNAL) > 0 && body_len > 0) {
+        size_t sent = 0;
+        while (sent < (size_t)body_len) {
+            ssize_t n = send(client_fd, body + sent, body_len - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+    }
+    close(client_fd);
+}
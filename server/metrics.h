@@ -0,0 +1,76 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "server.h"
+
+/*
+ * Metriche delle richieste dei client
+ * - per ogni tipo di richiesta un istogramma log-lineare del tempo di servizio (in ns):
+ *   dalla ricezione della richiesta al momento in cui il processo figlio torna ad attendere
+ *   la successiva, inclusi gli scambi interni (liste temi, conferme delle classifiche)
+ * - i contatori vivono in memoria condivisa e ogni processo figlio li aggiorna con
+ *   incrementi atomici: nessun lock, nemmeno per leggerli
+ * - un processo dedicato, opzionale, le espone in formato testo Prometheus su una porta TCP
+ *   locale o su un socket Unix (GET /metrics), senza mai acquisire il lock dello stato
+ */
+
+#define METRICS_REPORT_INTERVAL_SEC 60 // Riepilogo periodico delle latenze nel log
+#define METRICS_PAGE_SIZE 65536         // Dimensione massima della pagina delle metriche
+#define METRICS_IO_TIMEOUT_SEC 2        // Attesa massima della richiesta e della risposta
+#define METRICS_LOCK_REPORT_TOP 5       // Punti di chiamata del lock nel riepilogo periodico
+
+// Copia coerente delle metriche, da leggere senza operazioni atomiche
+typedef struct {
+    Histogram latency[METRIC_TYPES];
+    uint64_t bytes_in[METRIC_TYPES];
+    Histogram lock_wait;
+    uint64_t connections_accepted;
+    uint64_t connections_rejected;
+    int64_t sessions_active;
+    uint64_t log_dropped;
+    uint64_t room_frames_encoded;
+    uint64_t room_frames_sent;
+    uint64_t rank_updates;
+    uint64_t rank_frames_sent;
+    uint64_t sessions_evicted[EVICT_REASONS];
+    uint64_t slow_consumers;
+    uint64_t pushes_dropped;
+    uint64_t pushes_coalesced;
+    uint64_t rate_limited[RATE_KINDS];
+    uint64_t admissions[ADMISSION_OUTCOMES];
+    uint64_t admission_wait_ms;
+    int admission_waiting;
+    int players_active;
+    uint64_t replica_sent;
+    uint64_t replica_received;
+    uint64_t replica_merged;
+    int64_t replica_peers;
+} MetricsSnapshot;
+
+MetricType metric_type(const char* type);
+const char* metric_name(MetricType type);
+void metrics_record(MetricType type, uint64_t latency_ns, size_t bytes);
+void metrics_connection_accepted(void);
+void metrics_connection_rejected(void);
+void metrics_session_change(int delta);
+void metrics_room_broadcast(int recipients);
+void metrics_rank_update(void);
+void metrics_rank_push(int recipients);
+void metrics_session_evicted(EvictReason reason);
+void metrics_slow_consumer(void);
+void metrics_push_skipped(int count, int coalesced);
+void metrics_rate_limited(RateKind kind);
+void metrics_admission(AdmissionOutcome outcome, uint64_t wait_ms);
+void metrics_replica_records(int sent, int received, int merged);
+void metrics_replica_peers(int connected);
+void metrics_snapshot(MetricsSnapshot* snapshot);
+void metrics_log_summary(void);
+int lock_profile_report(char* buffer, size_t size, int top);
+
+// Esposizione in formato Prometheus
+int metrics_format(char* buffer, size_t size);
+int metrics_address_is_port(const char* address);
+int metrics_listen(const char* address);
+void metrics_serve(int client_fd);
+
+#endif
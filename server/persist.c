@@ -0,0 +1,378 @@
+#include "persist.h"
+#include "quiz.h"
+#include "server.h"
+#include "logger.h"
+#include <errno.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// Descrittore del WAL usato dal processo corrente per accodare i record
+static int wal_fd = -1;
+static int wal_fd_generation = -1;
+
+// Descrittore usato dal processo di background per le fdatasync di gruppo
+static int sync_fd = -1;
+static int sync_fd_generation = -1;
+static time_t last_snapshot = 0;
+
+/**
+ * Calcola il CRC32 (polinomio IEEE 802.3) di un blocco di memoria
+ * @param crc Valore iniziale (0 per un nuovo calcolo)
+ * @param data I dati
+ * @param len Numero di byte
+ * @return Il CRC aggiornato
+ */
+static uint32_t crc32_update(uint32_t crc, const void* data, size_t len) {
+    static uint32_t table[256];
+    static int table_ready = 0;
+
+    if (!table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        table_ready = 1;
+    }
+
+    const unsigned char* p = data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Il CRC di un record copre tutti i campi successivi al campo crc
+static uint32_t wal_record_crc(const WalRecord* rec) {
+    return crc32_update(0, &rec->seq, sizeof(WalRecord) - offsetof(WalRecord, seq));
+}
+
+static void wal_path(char* path, size_t size, int generation) {
+    snprintf(path, size, "%s/%s%d", DATA_DIR, WAL_FILE_PREFIX, generation);
+}
+
+/**
+ * Rende durevole il contenuto della directory dei dati (rename/unlink)
+ */
+static void sync_data_dir(void) {
+    int dir_fd = open(DATA_DIR, O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+/**
+ * Accoda un aggiornamento di punteggio al WAL
+ * Deve essere chiamata con il lock sulla memoria condivisa acquisito: il numero di
+ * sequenza e l'ordine dei record nel file seguono l'ordine delle sezioni critiche.
+ * La durabilità è garantita dal processo di background entro WAL_SYNC_INTERVAL_MS.
+ *
+ * @param nickname Il nickname del giocatore
+ * @param theme Il numero del tema
+ * @param score Il punteggio
+ * @param completed 1 se il quiz è stato completato
+ */
+void persist_append_score(const char* nickname, int theme, int score, int completed) {
+    PersistState* ps = &shared_state->persist;
+
+    // Dopo uno snapshot i nuovi record vanno nel file WAL della generazione successiva
+    if (wal_fd < 0 || wal_fd_generation != ps->wal_generation) {
+        char path[256];
+        if (wal_fd >= 0) {
+            close(wal_fd);
+        }
+        wal_path(path, sizeof(path), ps->wal_generation);
+        wal_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (wal_fd < 0) {
+            LOG_ERROR("Impossibile aprire il WAL %s", path);
+            return;
+        }
+        wal_fd_generation = ps->wal_generation;
+    }
+
+    WalRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = WAL_RECORD_MAGIC;
+    rec.seq = ps->wal_seq + 1;
+    strncpy(rec.nickname, nickname, MAX_NICKNAME_LEN - 1);
+    rec.theme = theme;
+    rec.score = score;
+    rec.completed = completed;
+    rec.crc = wal_record_crc(&rec);
+
+    if (write(wal_fd, &rec, sizeof(rec)) != (ssize_t)sizeof(rec)) {
+        LOG_ERROR("Scrittura sul WAL fallita per %s", nickname);
+        return;
+    }
+    __atomic_store_n(&ps->wal_seq, rec.seq, __ATOMIC_RELEASE);
+}
+
+/**
+ * Carica lo snapshot della classifica nella memoria condivisa
+ * @param seq Output: numero di sequenza coperto dallo snapshot
+ * @param generation Output: primo file WAL da rigiocare
+ * @return 0 se lo snapshot è stato caricato o non esiste, -1 se è danneggiato
+ */
+static int load_snapshot(uint64_t* seq, int* generation) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", DATA_DIR, SNAPSHOT_FILE);
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    SnapshotHeader header;
+    int ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+             header.magic == SNAPSHOT_MAGIC &&
+             header.version == SNAPSHOT_VERSION &&
+             header.entry_size == sizeof(Player) &&
+             header.count <= MAX_BOARD_ENTRIES &&
+             fread(shared_state->board, sizeof(Player), header.count, fp) == header.count &&
+             crc32_update(0, shared_state->board, header.count * sizeof(Player)) == header.crc;
+    fclose(fp);
+
+    if (!ok) {
+        memset(shared_state->board, 0, sizeof(shared_state->board));
+        return -1;
+    }
+
+    shared_state->board_count = header.count;
+    board_rebuild();
+    *seq = header.seq;
+    *generation = header.wal_generation;
+    return 0;
+}
+
+/**
+ * Rigioca un file WAL sulla classifica, fermandosi al primo record non valido
+ * (tipicamente l'ultimo record di una scrittura interrotta da un crash)
+ *
+ * @param generation La generazione del file
+ * @param seq Input/output: ultimo numero di sequenza applicato
+ * @return Numero di record applicati
+ */
+static int replay_wal(int generation, uint64_t* seq) {
+    char path[256];
+    wal_path(path, sizeof(path), generation);
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    WalRecord rec;
+    int applied = 0;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        if (rec.magic != WAL_RECORD_MAGIC || rec.crc != wal_record_crc(&rec) ||
+            rec.theme < 0 || rec.theme >= MAX_THEMES) {
+            LOG_WARNING("Record non valido in %s dopo la sequenza %llu: coda scartata",
+                        path, (unsigned long long)*seq);
+            break;
+        }
+        // I record già coperti dallo snapshot vengono saltati
+        if (rec.seq <= *seq) {
+            continue;
+        }
+        rec.nickname[MAX_NICKNAME_LEN - 1] = '\0';
+        board_update(rec.theme, rec.nickname, rec.score, rec.completed);
+        *seq = rec.seq;
+        applied++;
+    }
+
+    fclose(fp);
+    return applied;
+}
+
+/**
+ * Inizializza la persistenza e ricostruisce la classifica globale (snapshot + coda del WAL)
+ * Va chiamata dal processo principale dopo l'inizializzazione della memoria condivisa
+ * e prima di creare qualsiasi processo figlio
+ *
+ * @return 0 se successo, -1 in caso di errore
+ */
+int persist_init(void) {
+    uint64_t start = clock_now_ns();
+
+    if (mkdir(DATA_DIR, 0755) < 0 && errno != EEXIST) {
+        perror("Errore creazione directory dati");
+        return -1;
+    }
+
+    uint64_t seq = 0;
+    int snapshot_generation = 0;
+    if (load_snapshot(&seq, &snapshot_generation) < 0) {
+        LOG_ERROR("Snapshot della classifica danneggiato, ricostruzione dai soli WAL");
+    }
+    uint64_t snapshot_seq = seq;
+
+    // Individua i file WAL presenti: quelli precedenti allo snapshot sono già coperti
+    int min_generation = -1, max_generation = -1;
+    DIR* dir = opendir(DATA_DIR);
+    if (dir != NULL) {
+        struct dirent* ent;
+        size_t prefix_len = strlen(WAL_FILE_PREFIX);
+        while ((ent = readdir(dir)) != NULL) {
+            if (strncmp(ent->d_name, WAL_FILE_PREFIX, prefix_len) != 0 || !is_numeric(ent->d_name + prefix_len)) {
+                continue;
+            }
+            int generation = atoi(ent->d_name + prefix_len);
+            if (generation < snapshot_generation) {
+                char path[256];
+                wal_path(path, sizeof(path), generation);
+                unlink(path);
+                continue;
+            }
+            if (min_generation < 0 || generation < min_generation) {
+                min_generation = generation;
+            }
+            if (generation > max_generation) {
+                max_generation = generation;
+            }
+        }
+        closedir(dir);
+    }
+
+    int replayed = 0;
+    for (int generation = min_generation; generation >= 0 && generation <= max_generation; generation++) {
+        replayed += replay_wal(generation, &seq);
+    }
+
+    // Si riparte sempre da un file nuovo, mai in coda a un record eventualmente troncato
+    PersistState* ps = &shared_state->persist;
+    ps->wal_seq = seq;
+    ps->synced_seq = seq;
+    ps->snapshot_seq = snapshot_seq;
+    ps->wal_generation = (max_generation >= snapshot_generation ? max_generation : snapshot_generation - 1) + 1;
+    last_snapshot = time(NULL);
+
+    long elapsed_ms = (long)((clock_now_ns() - start) / 1000000);
+    printf("Classifica recuperata: %d giocatori, %d record WAL rigiocati in %ld ms\n",
+           shared_state->board_count, replayed, elapsed_ms);
+    LOG_INFO("Classifica recuperata: %d giocatori, %d record WAL rigiocati in %ld ms",
+             shared_state->board_count, replayed, elapsed_ms);
+    return 0;
+}
+
+/**
+ * Scrive uno snapshot compatto della classifica e rimuove i file WAL che copre
+ * La copia avviene sotto lock insieme al cambio di generazione del WAL: i record
+ * successivi finiscono nel nuovo file e verranno rigiocati sopra questo snapshot
+ *
+ * @return 0 se successo, -1 in caso di errore
+ */
+int persist_snapshot(void) {
+    PersistState* ps = &shared_state->persist;
+    Player* entries = malloc(sizeof(Player) * MAX_BOARD_ENTRIES);
+    if (entries == NULL) {
+        return -1;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+
+    // SEZIONE CRITICA: copia della classifica e passaggio al WAL successivo
+    lock_shared_state();
+    header.count = shared_state->board_count;
+    memcpy(entries, shared_state->board, header.count * sizeof(Player));
+    header.seq = ps->wal_seq;
+    int covered_generation = ps->wal_generation;
+    ps->wal_generation = covered_generation + 1;
+    unlock_shared_state();
+
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.entry_size = sizeof(Player);
+    header.wal_generation = covered_generation + 1;
+    header.crc = crc32_update(0, entries, header.count * sizeof(Player));
+
+    // Scrittura su file temporaneo, fsync e rename atomico
+    char tmp_path[256], path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/%s.tmp", DATA_DIR, SNAPSHOT_FILE);
+    snprintf(path, sizeof(path), "%s/%s", DATA_DIR, SNAPSHOT_FILE);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    size_t body = header.count * sizeof(Player);
+    int ok = fd >= 0 &&
+             write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+             write(fd, entries, body) == (ssize_t)body &&
+             fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(entries);
+
+    if (!ok || rename(tmp_path, path) < 0) {
+        LOG_ERROR("Scrittura dello snapshot della classifica fallita");
+        unlink(tmp_path);
+        return -1;
+    }
+    sync_data_dir();
+
+    // I WAL fino alla generazione coperta non servono più
+    for (int generation = covered_generation; generation >= 0; generation--) {
+        char old_path[256];
+        wal_path(old_path, sizeof(old_path), generation);
+        if (unlink(old_path) < 0 && errno == ENOENT) {
+            break;
+        }
+    }
+
+    ps->snapshot_seq = header.seq;
+    last_snapshot = time(NULL);
+    LOG_INFO("Snapshot classifica: %u giocatori, sequenza %llu", header.count, (unsigned long long)header.seq);
+    return 0;
+}
+
+/**
+ * Passo periodico del processo di background
+ * Group commit: una sola fdatasync copre tutti i record accodati dall'ultimo passo;
+ * lo snapshot viene scritto a intervalli regolari o quando la coda del WAL si allunga troppo
+ */
+void persist_tick(void) {
+    PersistState* ps = &shared_state->persist;
+    unsigned long long written = __atomic_load_n(&ps->wal_seq, __ATOMIC_ACQUIRE);
+
+    if (written > ps->synced_seq) {
+        int generation = __atomic_load_n(&ps->wal_generation, __ATOMIC_ACQUIRE);
+        if (sync_fd < 0 || sync_fd_generation != generation) {
+            char path[256];
+            if (sync_fd >= 0) {
+                close(sync_fd);
+            }
+            wal_path(path, sizeof(path), generation);
+            sync_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+            sync_fd_generation = generation;
+        }
+        if (sync_fd >= 0 && fdatasync(sync_fd) == 0) {
+            ps->synced_seq = written;
+        }
+    }
+
+    if (written > ps->snapshot_seq &&
+        (written - ps->snapshot_seq >= SNAPSHOT_MAX_WAL_RECORDS ||
+         time(NULL) - last_snapshot >= SNAPSHOT_INTERVAL_SEC)) {
+        persist_snapshot();
+    }
+}
+
+/**
+ * Chiusura ordinata: rende durevole la coda del WAL e scrive uno snapshot finale
+ */
+void persist_shutdown(void) {
+    PersistState* ps = &shared_state->persist;
+    if (ps->wal_seq > ps->snapshot_seq) {
+        persist_snapshot();
+    }
+    if (sync_fd >= 0) {
+        close(sync_fd);
+        sync_fd = -1;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include "../shared/protocol.h"
+
+/*
+ * Persistenza della classifica globale
+ * - ogni save_score() accoda un record a dimensione fissa al WAL (write-ahead log)
+ * - il processo di background rende durevoli i record a gruppi (una fdatasync per intervallo)
+ * - periodicamente scrive uno snapshot compatto della classifica e scarta i WAL già coperti
+ * - all'avvio la classifica viene ricostruita da snapshot + coda del WAL
+ */
+
+#define WAL_SYNC_INTERVAL_MS 20         // Group commit: al massimo una fdatasync ogni 20 ms
+#define SNAPSHOT_INTERVAL_SEC 60        // Snapshot periodico della classifica
+#define SNAPSHOT_MAX_WAL_RECORDS 10000  // Snapshot anticipato: limita la coda da rigiocare all'avvio
+
+#define WAL_RECORD_MAGIC 0x51574c52     // "QWLR"
+#define SNAPSHOT_MAGIC 0x51534e50       // "QSNP"
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_FILE "scores.snap"
+#define WAL_FILE_PREFIX "scores.wal."
+
+// Record del WAL: un aggiornamento di punteggio
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;                       // CRC32 dei campi successivi (rileva record troncati)
+    uint64_t seq;
+    char nickname[MAX_NICKNAME_LEN];
+    int32_t theme;
+    int32_t score;
+    int32_t completed;
+    int32_t reserved;
+} WalRecord;
+
+// Intestazione dello snapshot, seguita da count voci Player
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t count;
+    uint64_t seq;                       // Ultimo record del WAL incluso nello snapshot
+    int32_t wal_generation;             // Primo file WAL da rigiocare dopo lo snapshot
+    uint32_t crc;                       // CRC32 delle voci
+} SnapshotHeader;
+
+int persist_init(void);
+void persist_append_score(const char* nickname, int theme, int score, int completed);
+void persist_tick(void);
+int persist_snapshot(void);
+void persist_shutdown(void);
+
+#endif
@@ -0,0 +1,513 @@
+#include "profiles.h"
+#include "server.h"
+#include "logger.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Mappatura dell'archivio nel processo corrente
+static ProfileHeader* profiles_map = NULL;
+static size_t profiles_map_size = 0;
+static int profiles_map_generation = -1;
+
+// Nuova tabella durante una crescita in background (vedi profiles_maintain)
+static ProfileHeader* next_map = NULL;
+static size_t next_map_size = 0;
+static int next_map_migration = -1;
+
+static size_t profiles_file_size(uint64_t capacity) {
+    return sizeof(ProfileHeader) + capacity * sizeof(ProfileRecord);
+}
+
+static ProfileRecord* profiles_slots(void) {
+    return (ProfileRecord*)(profiles_map + 1);
+}
+
+static void profiles_path(char* path, size_t size, const char* suffix) {
+    snprintf(path, size, "%s/%s%s", DATA_DIR, PROFILES_FILE, suffix);
+}
+
+/**
+ * Hash FNV-1a a 64 bit del nickname
+ * @param nickname Il nickname
+ * @return Il valore di hash
+ */
+uint64_t hash_nickname(const char* nickname) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (; *nickname; nickname++) {
+        hash ^= (unsigned char)*nickname;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Crea un archivio vuoto: il file è sparso, le pagine vengono allocate solo quando scritte
+ * @param path Percorso del file
+ * @param capacity Numero di slot (potenza di 2)
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int create_profiles_file(const char* path, uint64_t capacity) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ProfileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PROFILES_MAGIC;
+    header.version = PROFILES_VERSION;
+    header.record_size = sizeof(ProfileRecord);
+    header.capacity = capacity;
+
+    int ok = ftruncate(fd, profiles_file_size(capacity)) == 0 &&
+             pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static void unmap_profiles(void) {
+    if (profiles_map != NULL) {
+        munmap(profiles_map, profiles_map_size);
+        profiles_map = NULL;
+        profiles_map_size = 0;
+    }
+}
+
+/**
+ * Mappa un file dell'archivio e ne verifica l'intestazione
+ * @param path Il percorso del file
+ * @param size Output: la dimensione mappata
+ * @return L'intestazione mappata, NULL in caso di errore
+ */
+static ProfileHeader* map_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ProfileHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    void* addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    ProfileHeader* header = addr;
+    if (header->magic != PROFILES_MAGIC || header->version != PROFILES_VERSION ||
+        header->record_size != sizeof(ProfileRecord) ||
+        (header->capacity & (header->capacity - 1)) != 0 ||
+        profiles_file_size(header->capacity) > (size_t)st.st_size) {
+        munmap(addr, st.st_size);
+        return NULL;
+    }
+    *size = st.st_size;
+    return header;
+}
+
+/**
+ * Mappa l'archivio corrente
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int map_profiles(void) {
+    char path[256];
+    profiles_path(path, sizeof(path), "");
+
+    size_t size;
+    ProfileHeader* header = map_file(path, &size);
+    if (header == NULL) {
+        return -1;
+    }
+
+    unmap_profiles();
+    if (next_map != NULL) {
+        munmap(next_map, next_map_size);
+        next_map = NULL;
+    }
+    profiles_map = header;
+    profiles_map_size = size;
+    profiles_map_generation = shared_state->profiles_generation;
+    return 0;
+}
+
+/**
+ * Si assicura che il processo abbia mappato la versione corrente dell'archivio
+ * Dopo una crescita della tabella il file viene sostituito e la generazione incrementata
+ *
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int ensure_profiles_mapped(void) {
+    if (profiles_map != NULL && profiles_map_generation == shared_state->profiles_generation) {
+        return 0;
+    }
+    return map_profiles();
+}
+
+/**
+ * Trova lo slot di un nickname, oppure il primo slot libero della sua sequenza di sondaggio
+ * @param table Gli slot della tabella
+ * @param capacity Numero di slot
+ * @param nickname Il nickname cercato
+ * @return Lo slot trovato (libero se il nickname non è presente)
+ */
+static ProfileRecord* find_slot(ProfileRecord* table, uint64_t capacity, const char* nickname) {
+    uint64_t index = hash_nickname(nickname) & (capacity - 1);
+    while (table[index].nickname[0] != '\0' && strcmp(table[index].nickname, nickname) != 0) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &table[index];
+}
+
+/**
+ * Raddoppia la tabella sul posto, sotto lock: i profili vengono reinseriti in un nuovo file
+ * che sostituisce il precedente con un rename atomico; gli altri processi lo rimappano al
+ * prossimo accesso. Solo se la crescita richiesta non è stata avviata da un processo di
+ * background (ad esempio nella simulazione) e la tabella ha raggiunto PROFILES_HARD_LOAD_PERCENT
+ *
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int grow_profiles(void) {
+    uint64_t capacity = profiles_map->capacity * 2;
+    char path[256], tmp_path[256];
+    profiles_path(path, sizeof(path), "");
+    profiles_path(tmp_path, sizeof(tmp_path), ".tmp");
+
+    if (create_profiles_file(tmp_path, capacity) < 0) {
+        return -1;
+    }
+
+    int fd = open(tmp_path, O_RDWR);
+    if (fd < 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    size_t size = profiles_file_size(capacity);
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        unlink(tmp_path);
+        return -1;
+    }
+
+    ProfileHeader* header = addr;
+    ProfileRecord* table = (ProfileRecord*)(header + 1);
+    ProfileRecord* old_table = profiles_slots();
+    for (uint64_t i = 0; i < profiles_map->capacity; i++) {
+        if (old_table[i].nickname[0] != '\0') {
+            *find_slot(table, capacity, old_table[i].nickname) = old_table[i];
+        }
+    }
+    header->count = profiles_map->count;
+    unsigned long long count = header->count;
+
+    int ok = msync(addr, size, MS_SYNC) == 0;
+    munmap(addr, size);
+    if (!ok || rename(tmp_path, path) < 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+
+    shared_state->profiles_generation++;
+    shared_state->profiles_grow = PROFILES_GROW_IDLE;
+    LOG_INFO("Archivio profili ampliato a %llu slot (%llu giocatori)", (unsigned long long)capacity, count);
+    return map_profiles();
+}
+
+/**
+ * Rispecchia nella nuova tabella la scrittura di un profilo già copiato dal processo di
+ * background (gli slot non ancora copiati arriveranno con il loro blocco)
+ * Il chiamante deve possedere il lock sulla memoria condivisa
+ *
+ * @param rec Il record appena scritto nell'archivio corrente
+ */
+static void mirror_profile(const ProfileRecord* rec) {
+    if (shared_state->profiles_grow != PROFILES_GROW_MIGRATING ||
+        (uint64_t)(rec - profiles_slots()) >= shared_state->profiles_migrated) {
+        return;
+    }
+
+    if (next_map == NULL || next_map_migration != shared_state->profiles_migration) {
+        char path[256];
+        profiles_path(path, sizeof(path), ".grow");
+        if (next_map != NULL) {
+            munmap(next_map, next_map_size);
+        }
+        next_map = map_file(path, &next_map_size);
+        next_map_migration = shared_state->profiles_migration;
+        if (next_map == NULL) {
+            LOG_ERROR("Impossibile aprire l'archivio dei profili in crescita");
+            return;
+        }
+    }
+    ProfileRecord* table = (ProfileRecord*)(next_map + 1);
+    *find_slot(table, next_map->capacity, rec->nickname) = *rec;
+}
+
+/**
+ * Restituisce il profilo di un nickname, creandolo se non esiste
+ * @param nickname Il nickname
+ * @return Il record del profilo, NULL in caso di errore
+ */
+static ProfileRecord* get_or_create_profile(const char* nickname) {
+    if (ensure_profiles_mapped() < 0) {
+        return NULL;
+    }
+
+    ProfileRecord* rec = find_slot(profiles_slots(), profiles_map->capacity, nickname);
+    if (rec->nickname[0] != '\0') {
+        return rec;
+    }
+
+    // Nuovo profilo: oltre la soglia la crescita avviene in background; sul posto solo
+    // se nessuno l'ha avviata e la tabella è ormai piena
+    uint64_t load = (profiles_map->count + 1) * 100;
+    if (load > profiles_map->capacity * PROFILES_MAX_LOAD_PERCENT &&
+        shared_state->profiles_grow == PROFILES_GROW_IDLE) {
+        shared_state->profiles_grow = PROFILES_GROW_REQUESTED;
+    }
+    if (load > profiles_map->capacity * PROFILES_HARD_LOAD_PERCENT) {
+        if (shared_state->profiles_grow == PROFILES_GROW_MIGRATING) {
+            LOG_WARNING("Archivio dei profili pieno durante la crescita: profilo di %s non creato", nickname);
+            return NULL;
+        }
+        if (grow_profiles() < 0) {
+            LOG_ERROR("Impossibile ampliare l'archivio dei profili");
+            return NULL;
+        }
+        rec = find_slot(profiles_slots(), profiles_map->capacity, nickname);
+    }
+
+    strncpy(rec->nickname, nickname, MAX_NICKNAME_LEN - 1);
+    rec->nickname[MAX_NICKNAME_LEN - 1] = '\0';
+    for (int i = 0; i < MAX_THEMES; i++) {
+        rec->best_score[i] = -1;
+        rec->completed[i] = 0;
+    }
+    rec->sessions = 0;
+    rec->last_seen = 0;
+    profiles_map->count++;
+    mirror_profile(rec);
+    return rec;
+}
+
+/**
+ * Apre (o crea) l'archivio dei profili
+ * Va chiamata dal processo principale dopo persist_init(), prima di creare processi figli
+ *
+ * @return 0 se successo, -1 in caso di errore
+ */
+int profiles_init(void) {
+    char path[256];
+    profiles_path(path, sizeof(path), "");
+
+    if (access(path, F_OK) < 0 && create_profiles_file(path, PROFILES_INITIAL_CAPACITY) < 0) {
+        perror("Errore creazione archivio profili");
+        return -1;
+    }
+
+    shared_state->profiles_generation = 1;
+    if (map_profiles() < 0) {
+        LOG_ERROR("Archivio profili %s non valido", path);
+        return -1;
+    }
+
+    printf("Archivio profili: %llu giocatori registrati\n", (unsigned long long)profiles_map->count);
+    LOG_INFO("Archivio profili: %llu giocatori registrati", (unsigned long long)profiles_map->count);
+    return 0;
+}
+
+/**
+ * Cerca il profilo di un giocatore (O(1) in media)
+ * Il chiamante deve possedere il lock sulla memoria condivisa
+ *
+ * @param nickname Il nickname
+ * @param out Copia del profilo (può essere NULL)
+ * @return 1 se il giocatore è già noto, 0 altrimenti, -1 in caso di errore
+ */
+int profile_lookup(const char* nickname, ProfileRecord* out) {
+    if (ensure_profiles_mapped() < 0) {
+        return -1;
+    }
+
+    ProfileRecord* rec = find_slot(profiles_slots(), profiles_map->capacity, nickname);
+    if (rec->nickname[0] == '\0') {
+        return 0;
+    }
+    if (out != NULL) {
+        *out = *rec;
+    }
+    return 1;
+}
+
+/**
+ * Registra una nuova sessione per il giocatore (crea il profilo se necessario)
+ * Il chiamante deve possedere il lock sulla memoria condivisa
+ *
+ * @param nickname Il nickname
+ * @return 0 se successo, -1 in caso di errore
+ */
+int profile_touch(const char* nickname) {
+    ProfileRecord* rec = get_or_create_profile(nickname);
+    if (rec == NULL) {
+        return -1;
+    }
+    rec->sessions++;
+    rec->last_seen = time(NULL);
+    mirror_profile(rec);
+    return 0;
+}
+
+/**
+ * Aggiorna miglior punteggio e completamento di un tema nel profilo
+ * Il chiamante deve possedere il lock sulla memoria condivisa
+ *
+ * @param nickname Il nickname
+ * @param theme Il numero del tema
+ * @param score Il punteggio
+ * @param completed 1 se il quiz è stato completato
+ * @return 0 se successo, -1 in caso di errore
+ */
+int profile_record_score(const char* nickname, int theme, int score, int completed) {
+    ProfileRecord* rec = get_or_create_profile(nickname);
+    if (rec == NULL) {
+        return -1;
+    }
+    if (score > rec->best_score[theme]) {
+        rec->best_score[theme] = score;
+    }
+    if (completed) {
+        rec->completed[theme] = 1;
+    }
+    mirror_profile(rec);
+    return 0;
+}
+
+/**
+ * Avvia la scrittura su disco delle pagine modificate dell'archivio
+ * Chiamata periodicamente dal processo di background, fuori dal percorso critico
+ */
+void profiles_sync(void) {
+    lock_shared_state();
+    int mapped = ensure_profiles_mapped() == 0;
+    unlock_shared_state();
+
+    if (mapped) {
+        msync(profiles_map, profiles_map_size, MS_ASYNC);
+    }
+}
+
+/**
+ * Un passo della crescita in background dell'archivio (processo di background)
+ * Crea e mappa il file doppio fuori dal lock, poi copia PROFILES_MIGRATE_STEP blocchi con una
+ * sezione critica per blocco; a copia completata rende durevole il nuovo file fuori dal lock
+ * e lo pubblica con rename e incremento della generazione
+ */
+void profiles_maintain(void) {
+    static ProfileHeader* target = NULL;
+    static size_t target_size = 0;
+    static int migration = -1;
+    char path[256], grow_path[256];
+    profiles_path(path, sizeof(path), "");
+    profiles_path(grow_path, sizeof(grow_path), ".grow");
+
+    int state = __atomic_load_n(&shared_state->profiles_grow, __ATOMIC_ACQUIRE);
+    if (state == PROFILES_GROW_IDLE ||
+        (target != NULL && migration != __atomic_load_n(&shared_state->profiles_migration, __ATOMIC_ACQUIRE))) {
+        // Nessuna crescita, o crescita completata sul posto da una sessione
+        if (target != NULL) {
+            munmap(target, target_size);
+            target = NULL;
+        }
+        if (state == PROFILES_GROW_IDLE) {
+            return;
+        }
+    }
+
+    if (target == NULL) {
+        // Richiesta nuova, o crescita interrotta da un processo di background terminato
+        lock_shared_state();
+        int mapped = ensure_profiles_mapped() == 0;
+        uint64_t capacity = mapped ? profiles_map->capacity * 2 : 0;
+        int generation = shared_state->profiles_generation;
+        unlock_shared_state();
+
+        // Un nuovo inode: le sessioni che mappano il file di una crescita interrotta non lo vedono troncare
+        unlink(grow_path);
+        if (!mapped || create_profiles_file(grow_path, capacity) < 0 ||
+            (target = map_file(grow_path, &target_size)) == NULL) {
+            LOG_ERROR("Impossibile creare l'archivio dei profili ampliato");
+            return;
+        }
+
+        lock_shared_state();
+        if (shared_state->profiles_generation != generation ||
+            shared_state->profiles_grow == PROFILES_GROW_IDLE) {
+            unlock_shared_state();
+            munmap(target, target_size);
+            unlink(grow_path);
+            target = NULL;
+            return;
+        }
+        migration = ++shared_state->profiles_migration;
+        shared_state->profiles_migrated = 0;
+        shared_state->profiles_grow = PROFILES_GROW_MIGRATING;
+        unlock_shared_state();
+    }
+
+    ProfileRecord* table = (ProfileRecord*)(target + 1);
+    int done = 0;
+    for (int step = 0; step < PROFILES_MIGRATE_STEP && !done; step++) {
+        lock_shared_state();
+        if (ensure_profiles_mapped() < 0 || shared_state->profiles_migration != migration) {
+            unlock_shared_state();
+            return;
+        }
+        ProfileRecord* old_table = profiles_slots();
+        uint64_t start = shared_state->profiles_migrated;
+        uint64_t end = start + PROFILES_MIGRATE_CHUNK < profiles_map->capacity ?
+                       start + PROFILES_MIGRATE_CHUNK : profiles_map->capacity;
+        for (uint64_t i = start; i < end; i++) {
+            if (old_table[i].nickname[0] != '\0') {
+                *find_slot(table, target->capacity, old_table[i].nickname) = old_table[i];
+            }
+        }
+        shared_state->profiles_migrated = end;
+        done = end == profiles_map->capacity;
+        unlock_shared_state();
+    }
+    if (!done) {
+        return;
+    }
+
+    // Le sessioni continuano a rispecchiare le scritture mentre il file diventa durevole
+    if (msync(target, target_size, MS_SYNC) < 0) {
+        LOG_ERROR("Impossibile rendere durevole l'archivio dei profili ampliato");
+        return;
+    }
+
+    lock_shared_state();
+    int published = 0;
+    if (shared_state->profiles_migration == migration && ensure_profiles_mapped() == 0) {
+        target->count = profiles_map->count;
+        if (rename(grow_path, path) == 0) {
+            shared_state->profiles_generation++;
+            shared_state->profiles_grow = PROFILES_GROW_IDLE;
+            published = 1;
+        }
+    }
+    unsigned long long capacity = target->capacity, count = target->count;
+    unlock_shared_state();
+
+    munmap(target, target_size);
+    target = NULL;
+    if (published) {
+        LOG_INFO("Archivio profili ampliato a %llu slot (%llu giocatori)", capacity, count);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILES_H
+#define PROFILES_H
+
+#include <stdint.h>
+#include "../shared/protocol.h"
+
+/*
+ * Archivio su disco dei profili dei giocatori
+ * Tabella hash a indirizzamento aperto (sondaggio lineare) con record a dimensione fissa,
+ * mappata in memoria con mmap: ogni processo accede solo alle pagine che tocca, quindi
+ * l'archivio può contenere milioni di giocatori storici senza caricarli in memoria.
+ * Tutti gli accessi avvengono con il lock della memoria condivisa acquisito.
+ *
+ * Crescita: oltre PROFILES_MAX_LOAD_PERCENT una sessione chiede la crescita e il processo di
+ * background costruisce la tabella doppia fuori dal lock, copiando il vecchio archivio a blocchi
+ * di PROFILES_MIGRATE_CHUNK slot (un breve lock per blocco). Le scritture delle sessioni su slot
+ * già copiati vengono rispecchiate nella nuova tabella; a copia completata il nuovo file viene
+ * reso durevole fuori dal lock e sotto lock restano solo il rename e l'incremento della generazione.
+ */
+
+#define PROFILES_FILE "players.db"
+#define PROFILES_MAGIC 0x51504442       // "QPDB"
+#define PROFILES_VERSION 1
+#ifndef PROFILES_INITIAL_CAPACITY
+#define PROFILES_INITIAL_CAPACITY 65536 // Slot iniziali (potenza di 2)
+#endif
+#define PROFILES_MAX_LOAD_PERCENT 70    // Oltre questo riempimento la tabella raddoppia
+#define PROFILES_HARD_LOAD_PERCENT 90   // Riempimento massimo durante la crescita in background
+#define PROFILES_MIGRATE_CHUNK 1024     // Slot copiati per sezione critica durante la crescita
+#define PROFILES_MIGRATE_STEP 16        // Blocchi copiati a ogni passo del processo di background
+
+typedef enum {
+    PROFILES_GROW_IDLE,         // Nessuna crescita
+    PROFILES_GROW_REQUESTED,    // Richiesta da una sessione, in attesa del processo di background
+    PROFILES_GROW_MIGRATING     // Copia in corso: le scritture sugli slot copiati vanno rispecchiate
+} ProfilesGrow;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t capacity;                  // Numero di slot, potenza di 2
+    uint64_t count;                     // Slot occupati
+} ProfileHeader;
+
+typedef struct {
+    char nickname[MAX_NICKNAME_LEN];    // Stringa vuota: slot libero
+    int32_t best_score[MAX_THEMES];     // Miglior punteggio per tema, -1 se mai giocato
+    uint8_t completed[MAX_THEMES];      // 1 se il quiz del tema è stato completato
+    uint32_t sessions;                  // Sessioni registrate con questo nickname
+    int64_t last_seen;                  // Ultima registrazione (epoch in secondi)
+} ProfileRecord;
+
+uint64_t hash_nickname(const char* nickname);
+int profiles_init(void);
+int profile_lookup(const char* nickname, ProfileRecord* out);
+int profile_touch(const char* nickname);
+int profile_record_score(const char* nickname, int theme, int score, int completed);
+void profiles_sync(void);
+void profiles_maintain(void);
+
+#endif
@@ -1,12 +1,25 @@
 #include "quiz.h"
 #include "logger.h"
 #include "server.h"
+#include "persist.h"
+#include "profiles.h"
+#include "metrics.h"
+#include "admission.h"
+#include "config.h"
+#include "supervisor.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 #include <sys/sem.h>
 
+#if LEADERBOARD_MAX_ROWS > BOARD_TOP_ROWS
+#error "LEADERBOARD_MAX_ROWS non può superare BOARD_TOP_ROWS"
+#endif
+
+// Stampa dello stato dei giocatori sulla console (disattivata da chi esegue il server senza terminale)
+int players_console_enabled = 1;
+
 /**
  * Verifica se un nickname è già stato preso
  * @param nickname Il nickname da verificare
@@ -122,6 +135,217 @@ int check_answer (Question* question, const char* answer ){
     return(strcmp(start, correct_answer) == 0);
 }
 
+/**
+ * Calcola i punti di una risposta corretta in base al tempo impiegato:
+ * da QUIZ_POINTS_MAX per una risposta immediata a QUIZ_POINTS_MIN allo scadere del tempo
+ *
+ * @param elapsed_ms Il tempo trascorso dall'invio della domanda
+ * @return I punti
+ */
+int answer_points(uint64_t elapsed_ms){
+    uint64_t limit_ms = QUESTION_TIME_SEC * 1000ULL;
+    if (elapsed_ms >= limit_ms) {
+        return QUIZ_POINTS_MIN;
+    }
+    return QUIZ_POINTS_MIN + (int)((QUIZ_POINTS_MAX - QUIZ_POINTS_MIN) * (limit_ms - elapsed_ms) / limit_ms);
+}
+
+/**
+ * Cerca la voce di un giocatore nell'indice per nickname della classifica globale
+ * Il chiamante deve possedere il lock sulla memoria condivisa
+ *
+ * @param nickname Il nickname del giocatore
+ * @param slot Output (opzionale): slot dell'indice della voce, o primo slot libero se assente
+ * @return L'indice della voce, -1 se il giocatore non è in classifica
+ */
+static int board_find(const char* nickname, int* slot) {
+    // L'indice ha il doppio degli slot delle voci: c'è sempre uno slot libero che chiude la ricerca
+    int i = (int)(hash_nickname(nickname) & (BOARD_INDEX_SIZE - 1));
+    while (shared_state->board_index[i] != 0) {
+        int entry = shared_state->board_index[i] - 1;
+        if (strcmp(shared_state->board[entry].nickname, nickname) == 0) {
+            break;
+        }
+        i = (i + 1) & (BOARD_INDEX_SIZE - 1);
+    }
+    if (slot != NULL) {
+        *slot = i;
+    }
+    return shared_state->board_index[i] - 1;
+}
+
+/**
+ * Ordine della classifica di un tema: punteggio decrescente e, a parità,
+ * davanti chi è entrato prima in classifica
+ * @return 1 se la voce a precede la voce b
+ */
+static int board_ahead(int theme_num, int a, int b) {
+    int score_a = shared_state->board[a].score[theme_num];
+    int score_b = shared_state->board[b].score[theme_num];
+    return score_a > score_b || (score_a == score_b && a < b);
+}
+
+/**
+ * Aggiorna le prime voci di un tema dopo l'aumento del punteggio di una voce
+ * I punteggi non diminuiscono mai: la voce può solo entrare tra le prime o risalire
+ *
+ * @param theme_num Il numero del tema
+ * @param entry L'indice della voce
+ */
+static void board_top_update(int theme_num, int entry) {
+    int* top = shared_state->board_top[theme_num];
+    int* count = &shared_state->board_top_count[theme_num];
+
+    int pos = 0;
+    while (pos < *count && top[pos] != entry) {
+        pos++;
+    }
+    if (pos == *count) {
+        if (*count < BOARD_TOP_ROWS) {
+            (*count)++;
+        } else if (board_ahead(theme_num, entry, top[BOARD_TOP_ROWS - 1])) {
+            pos = BOARD_TOP_ROWS - 1;
+        } else {
+            return;
+        }
+        top[pos] = entry;
+    }
+
+    while (pos > 0 && board_ahead(theme_num, entry, top[pos - 1])) {
+        top[pos] = top[pos - 1];
+        top[--pos] = entry;
+    }
+}
+
+/**
+ * Aggiorna la classifica globale con un punteggio (semantica di massimo per tema)
+ * Il giocatore è cercato nell'indice per nickname; le prime voci del tema restano ordinate.
+ * Il chiamante deve possedere il lock sulla memoria condivisa. Un registro modificato riceve
+ * una nuova sequenza: il processo di replica lo invia ai peer (vedi replica.h)
+ *
+ * @param theme_num Il numero del tema
+ * @param nickname Il nickname del giocatore
+ * @param score Il punteggio da registrare
+ * @param completed 1 se il quiz del tema è stato completato
+ * @return 1 se la voce è cambiata, 0 se era già aggiornata, -1 se la classifica è piena
+ */
+int board_update(int theme_num, const char* nickname, int score, int completed){
+    int slot;
+    int index = board_find(nickname, &slot);
+
+    if (index < 0) {
+        if (shared_state->board_count >= MAX_BOARD_ENTRIES) {
+            return -1;
+        }
+        index = shared_state->board_count++;
+        Player* entry = &shared_state->board[index];
+        strncpy(entry->nickname, nickname, MAX_NICKNAME_LEN - 1);
+        entry->nickname[MAX_NICKNAME_LEN - 1] = '\0';
+        for (int i = 0; i < MAX_THEMES; i++) {
+            entry->score[i] = -1;
+            entry->completed[i] = 0;
+        }
+        shared_state->board_index[slot] = index + 1;
+    }
+
+    Player* entry = &shared_state->board[index];
+    int changed = 0;
+    if (score > entry->score[theme_num]) {
+        entry->score[theme_num] = score;
+        board_top_update(theme_num, index);
+        changed = 1;
+    }
+    if (completed && !entry->completed[theme_num]) {
+        entry->completed[theme_num] = 1;
+        changed = 1;
+    }
+    if (changed) {
+        // Letta senza lock dal processo di replica per sapere se ci sono nuovi delta
+        uint64_t seq = __atomic_add_fetch(&shared_state->board_seq_last, 1, __ATOMIC_RELEASE);
+        shared_state->board_seq[index][theme_num] = seq;
+    }
+    return changed;
+}
+
+/**
+ * Ricostruisce l'indice per nickname e le prime voci di ogni tema dalle voci della classifica,
+ * dopo che queste sono state scritte direttamente (caricamento dello snapshot)
+ * Il chiamante deve possedere il lock sulla memoria condivisa, o essere l'unico processo
+ */
+void board_rebuild(void){
+    memset(shared_state->board_index, 0, sizeof(shared_state->board_index));
+    memset(shared_state->board_top_count, 0, sizeof(shared_state->board_top_count));
+
+    for (int i = 0; i < shared_state->board_count; i++) {
+        int slot;
+        board_find(shared_state->board[i].nickname, &slot);
+        shared_state->board_index[slot] = i + 1;
+        for (int theme_num = 0; theme_num < MAX_THEMES; theme_num++) {
+            if (shared_state->board[i].score[theme_num] >= 0) {
+                board_top_update(theme_num, i);
+            }
+        }
+    }
+}
+
+/**
+ * Inserisce una riga nelle prime righe estratte, in ordine di punteggio decrescente
+ * A parità di punteggio la nuova riga va dopo quelle già presenti
+ *
+ * @return Il nuovo numero di righe
+ */
+static int rows_insert(LeaderboardRow* rows, int count, int max_rows, const char* nickname, int score, int completed) {
+    if (count == max_rows && score <= rows[count - 1].score) {
+        return count;
+    }
+    int pos = count < max_rows ? count : max_rows - 1;
+    while (pos > 0 && rows[pos - 1].score < score) {
+        rows[pos] = rows[pos - 1];
+        pos--;
+    }
+    strcpy(rows[pos].nickname, nickname);
+    rows[pos].score = score;
+    rows[pos].completed = completed;
+    return count < max_rows ? count + 1 : count;
+}
+
+/**
+ * Estrae le prime righe della classifica globale di un tema, in ordine di punteggio decrescente
+ * Le righe sono copiate dalle prime voci mantenute da board_update, senza scandire la classifica.
+ * Se la classifica è piena vi si aggiungono i giocatori connessi rimasti senza voce
+ *
+ * @param theme_num Il numero del tema
+ * @param rows Array di output
+ * @param max_rows Numero massimo di righe da estrarre (al più BOARD_TOP_ROWS)
+ * @return Numero di righe estratte
+ */
+int board_collect(int theme_num, LeaderboardRow* rows, int max_rows){
+    int count = 0;
+
+    // SEZIONE CRITICA: copia delle prime voci del tema
+    lock_shared_state();
+    for (int i = 0; i < shared_state->board_top_count[theme_num] && count < max_rows; i++) {
+        const Player* entry = &shared_state->board[shared_state->board_top[theme_num][i]];
+        strcpy(rows[count].nickname, entry->nickname);
+        rows[count].score = entry->score[theme_num];
+        rows[count].completed = entry->completed[theme_num];
+        count++;
+    }
+    if (shared_state->board_count >= MAX_BOARD_ENTRIES) {
+        for (int i = 0; i < shared_state->player_count; i++) {
+            const Player* player = &shared_state->players[i];
+            // score == -1 indica che il giocatore non ha mai giocato questo tema
+            if (player->score[theme_num] >= 0 && board_find(player->nickname, NULL) < 0) {
+                count = rows_insert(rows, count, max_rows, player->nickname,
+                                    player->score[theme_num], player->completed[theme_num]);
+            }
+        }
+    }
+    unlock_shared_state();
+
+    return count;
+}
+
 /**
  * Recupera la classifica per un tema specifico
  * @param theme_num Il numero del tema
@@ -135,44 +359,9 @@ void get_leaderboard(int theme_num, char* leaderboard){
     leaderboard[0] = theme_num + '0';
     leaderboard[1] = '\0';
     
-    // Copia locale dei dati dei giocatori per minimizzare il tempo di lock
-    // Questo evita di tenere bloccata la memoria condivisa durante l'ordinamento
-    Player local_players[MAX_CLIENTS];
-    int local_player_count;
-    
-    // SEZIONE CRITICA: acquisisce lock, copia dati rapidamente, rilascia lock
-    lock_shared_state();
-    local_player_count = shared_state->player_count;
-    for (int i = 0; i < local_player_count; i++) {
-        local_players[i] = shared_state->players[i];
-    }
-    unlock_shared_state();
-    
-    // Ora lavoriamo sui dati locali senza bisogno di lock
-    
-    // Crea un array temporaneo per ordinare i giocatori
-    Player sorted_players[MAX_CLIENTS];
-    int valid_players = 0;
-    
-    // Copia solo i giocatori che hanno un punteggio valido per questo tema
-    // (score != -1 indica che hanno giocato almeno una volta)
-    for (int i = 0; i < local_player_count; i++) {
-        if (local_players[i].score[theme_num] != -1) {
-            sorted_players[valid_players++] = local_players[i];
-        }
-    }
-    
-    // Bubble sort per punteggio decrescente (migliore punteggio prima)
-    Player temp;
-    for (int i = 0; i < valid_players - 1; i++) {
-        for (int j = 0; j < valid_players - i - 1; j++) {
-            if (sorted_players[j].score[theme_num] < sorted_players[j + 1].score[theme_num]) {
-                temp = sorted_players[j];
-                sorted_players[j] = sorted_players[j + 1];
-                sorted_players[j + 1] = temp;
-            }
-        }
-    }
+    // Solo le prime righe entrano in un messaggio: non serve ordinare tutta la classifica
+    LeaderboardRow rows[LEADERBOARD_MAX_ROWS];
+    int valid_players = board_collect(theme_num, rows, LEADERBOARD_MAX_ROWS);
 
     // Verifica se ci sono giocatori validi
     if (valid_players == 0) {
@@ -183,9 +372,9 @@ void get_leaderboard(int theme_num, char* leaderboard){
         for (int i = 0; i < valid_players && remaining > 0; i++) {
             int written = snprintf(entry, sizeof(entry), "%d. %s: %d punti%s\\n", 
                     i + 1,
-                    sorted_players[i].nickname, 
-                    sorted_players[i].score[theme_num],
-                    sorted_players[i].completed[theme_num] ? " (completato)" : "");
+                    rows[i].nickname, 
+                    rows[i].score,
+                    rows[i].completed ? " (completato)" : "");
             
             if (written > 0 && (size_t)written < remaining) {
                 strcat(leaderboard, entry);
@@ -202,6 +391,8 @@ void get_leaderboard(int theme_num, char* leaderboard){
 
 /**
  * Inizializza un nuovo giocatore nella memoria condivisa
+ * Se il nickname ha già un profilo su disco, ne ripristina punteggi e temi completati
+ *
  * @param nickname Il nickname del giocatore
  * @return 0 se il giocatore è stato aggiunto con successo, -1 se non è stato aggiunto
  */
@@ -209,13 +400,29 @@ int init_player(const char* nickname){
     lock_shared_state();
     
     if(shared_state->player_count < MAX_CLIENTS){
-        strcpy(shared_state->players[shared_state->player_count].nickname, nickname);
+        Player* player = &shared_state->players[shared_state->player_count];
+        ProfileRecord profile;
+        int returning = profile_lookup(nickname, &profile) == 1;
+
+        strcpy(player->nickname, nickname);
         for(int i = 0; i < MAX_THEMES; i++){
-            shared_state->players[shared_state->player_count].score[i] = -1;
-            shared_state->players[shared_state->player_count].completed[i] = 0;
+            // Un giocatore che ritorna non può rigiocare i temi già completati
+            player->score[i] = returning ? profile.best_score[i] : -1;
+            player->completed[i] = returning ? profile.completed[i] : 0;
         }
+        // Annotato prima della pubblicazione: se il processo muore da qui in poi,
+        // il processo principale sa quale giocatore rimuovere (vedi supervisor.h)
+        process_set_session(nickname, -1);
         shared_state->player_count++;
+
+        if (profile_touch(nickname) < 0) {
+            LOG_WARNING("Profilo di %s non aggiornato", nickname);
+        }
         unlock_shared_state();
+
+        if (returning) {
+            LOG_INFO("Giocatore %s ritornato (sessione %u)", nickname, profile.sessions + 1);
+        }
         return 0;
     }
     
@@ -256,6 +463,7 @@ void remove_player(const char* nickname){
         
         // Decrementa il contatore dei giocatori
         shared_state->player_count--;
+        admission_slot_freed();
         
         LOG_INFO("Giocatore %s rimosso. Giocatori attivi: %d", nickname, shared_state->player_count);
     }
@@ -277,6 +485,26 @@ void save_score(int theme_num, const char* nickname, int score, int completed){
         if(strcmp(shared_state->players[i].nickname, nickname) == 0){
             shared_state->players[i].score[theme_num] = score;
             shared_state->players[i].completed[theme_num] = completed;
+
+            // Classifica globale e WAL sono aggiornati nella stessa sezione critica,
+            // così l'ordine dei record nel WAL coincide con quello delle modifiche
+            // Con la classifica piena il punteggio resta comunque nel WAL e nel profilo,
+            // e il giocatore connesso compare in classifica finché resta in gioco (vedi board_collect)
+            int changed = board_update(theme_num, nickname, score, completed);
+            if (changed < 0) {
+                LOG_ERROR("Classifica globale piena (%d voci): %s resta fuori dalla classifica storica",
+                          MAX_BOARD_ENTRIES, nickname);
+            }
+            persist_append_score(nickname, theme_num, score, completed);
+            if (changed != 0) {
+                // Il processo delle stanze confronta la generazione a intervalli fissi:
+                // più modifiche nello stesso intervallo producono un solo aggiornamento per iscritto
+                shared_state->board_generation[theme_num]++;
+                metrics_rank_update();
+            }
+            if (profile_record_score(nickname, theme_num, score, completed) < 0) {
+                LOG_WARNING("Profilo di %s non aggiornato", nickname);
+            }
             
             unlock_shared_state();
             // Mostra la classifica aggiornata dopo ogni aggiornamento di punteggio
@@ -294,6 +522,10 @@ void save_score(int theme_num, const char* nickname, int score, int completed){
  * Usa una copia locale dei dati per minimizzare il tempo di lock
  */
 void print_players_status() {
+    if (!players_console_enabled) {
+        return;
+    }
+
     // Copia locale dei dati per evitare lock prolungato durante la visualizzazione
     Player local_players[MAX_CLIENTS];
     int local_player_count;
@@ -408,4 +640,55 @@ int has_completed_quiz(const char* nickname, int theme_index) {
     
     unlock_shared_state();
     return 0; // Giocatore non trovato o non completato
-}
\ No newline at end of file
+}
+
+/**
+ * Compone il percorso di un file della directory dei quiz (chiave quiz_dir)
+ * @param path Output: il percorso
+ * @param size La dimensione di path
+ * @param name Il nome del file senza estensione (un tema, o "temi")
+ */
+void quiz_path(char *path, size_t size, const char *name){
+    snprintf(path, size, "%s/%s.txt", server_config.quiz_dir, name);
+}
+
+/**
+ * Inizializza i temi caricandoli dal file temi.txt
+ */
+void init_themes(void){
+    FILE *fp;
+    char buffer[MAX_THEME_LEN];
+    char path[CONFIG_VALUE_LEN + 16];
+    int count = 0;
+
+    quiz_path(path, sizeof(path), "temi");
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("Errore: impossibile aprire il file dei temi\n");
+    } else {
+        while (fgets(buffer, MAX_THEME_LEN, fp) != NULL && count < MAX_THEMES) {
+            // Rimuovi il carattere newline se presente
+            size_t len = strlen(buffer);
+            if (len > 0 && buffer[len-1] == '\n')
+                buffer[len-1] = '\0';
+            
+            // Salva il tema nell'array globale
+            strncpy(theme[count], buffer, MAX_THEME_LEN);
+            count++;
+        }
+        fclose(fp);
+        
+        if (count == 0) {
+            printf("  Nessun tema disponibile\n");
+        } else {
+            printf("Trovati %d temi\n", count);
+            // Stampa i temi disponibili
+            for (int i = 0; i < count; i++) {
+                printf("  - %s\n", theme[i]);
+            }
+        }
+        
+        // Aggiorna il numero totale di temi
+        themes_count = count;
+    }
+}
@@ -3,15 +3,36 @@
 
 #include "../shared/protocol.h"
 
+// Righe di classifica estratte per messaggio: oltre questo numero il messaggio è comunque pieno
+#define LEADERBOARD_MAX_ROWS 64
+
+// Punti di una risposta corretta: il massimo se immediata, il minimo allo scadere del tempo
+#define QUIZ_POINTS_MAX 10
+#define QUIZ_POINTS_MIN 2
+
+typedef struct {
+    char nickname[MAX_NICKNAME_LEN];
+    int score;
+    int completed;
+} LeaderboardRow;
+
+extern int players_console_enabled;
+
 int taken_nickname(const char *nickname);
 int load_quiz(char *filename, Quiz* quiz);
+void quiz_path(char *path, size_t size, const char *name);
 Question* get_question(Quiz* quiz, int index);
 int check_answer (Question* question, const char* answer );
+int answer_points(uint64_t elapsed_ms);
 void get_leaderboard(int theme_num, char* leaderboard);
 void save_score(int theme_num, const char* nickname, int score, int completed);
+int board_update(int theme_num, const char* nickname, int score, int completed);
+int board_collect(int theme_num, LeaderboardRow* rows, int max_rows);
+void board_rebuild(void);
 int init_player(const char *nickname);
 void remove_player(const char *nickname);
 void print_players_status(void);
 int has_completed_quiz(const char* nickname, int theme_index);
+void init_themes(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "ratelimit.h"
+#include "metrics.h"
+#include <netinet/in.h>
+
+// Intervallo tra due token in µs, 0 se il limite è disattivato (vedi rate_configure)
+static uint64_t intervals[RATE_KINDS] = {
+    1000000 / RATE_CONNECT_PER_SEC,
+    1000000 / RATE_MESSAGE_PER_SEC
+};
+static int limit_loopback = 0;
+
+/**
+ * Imposta i limiti (processo principale, prima di accettare connessioni)
+ * @param connect_per_sec Connessioni al secondo per indirizzo, 0 per nessun limite
+ * @param message_per_sec Messaggi al secondo per indirizzo, 0 per nessun limite
+ * @param include_loopback 1 per limitare anche gli indirizzi locali
+ */
+void rate_configure(int connect_per_sec, int message_per_sec, int include_loopback) {
+    intervals[RATE_CONNECT] = connect_per_sec > 0 ? 1000000 / connect_per_sec : 0;
+    intervals[RATE_MESSAGE] = message_per_sec > 0 ? 1000000 / message_per_sec : 0;
+    limit_loopback = include_loopback;
+}
+
+/**
+ * Ricava la chiave dei limiti dall'indirizzo del client
+ * @param addr L'indirizzo (AF_INET o AF_INET6)
+ * @param key Output: la chiave
+ * @return 0 se l'indirizzo è soggetto ai limiti, -1 altrimenti (socket Unix, indirizzo locale)
+ */
+int rate_key(const struct sockaddr* addr, RateKey* key) {
+    static const uint8_t v4_prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+    if (addr->sa_family == AF_INET) {
+        memcpy(key->addr, v4_prefix, sizeof(v4_prefix));
+        memcpy(key->addr + 12, &((const struct sockaddr_in*)addr)->sin_addr, 4);
+    } else if (addr->sa_family == AF_INET6) {
+        memcpy(key->addr, &((const struct sockaddr_in6*)addr)->sin6_addr, 16);
+    } else {
+        return -1;
+    }
+
+    int v4_loopback = memcmp(key->addr, v4_prefix, sizeof(v4_prefix)) == 0 && key->addr[12] == 127;
+    int v6_loopback = memcmp(key->addr, &in6addr_loopback, 16) == 0;
+    return !limit_loopback && (v4_loopback || v6_loopback) ? -1 : 0;
+}
+
+static unsigned rate_hash(const RateKey* key) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 16; i++) {
+        hash = (hash ^ key->addr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Trova (o crea) la voce di un indirizzo
+ * Una voce libera viene occupata con una compare-and-swap; a tabella piena si riusa una voce
+ * il cui indirizzo ha tutti i bucket pieni (nessuna richiesta recente). Un processo che sta
+ * usando la voce riusata in quel momento la addebita al nuovo indirizzo: un token in più o in
+ * meno, mai un blocco.
+ *
+ * @param key L'indirizzo
+ * @return La voce, NULL se le voci esaminate sono tutte di indirizzi attivi (nessun limite)
+ */
+static RateEntry* rate_entry(const RateKey* key) {
+    unsigned start = rate_hash(key);
+    RateEntry* idle = NULL;
+    uint64_t now = clock_now_ns() / 1000;
+
+    for (int probe = 0; probe < RATE_PROBES; probe++) {
+        RateEntry* entry = &shared_state->rates[(start + probe) % RATE_TABLE_SIZE];
+        int state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+        while (state == RATE_WRITING) {
+            // Un altro processo sta scrivendo l'indirizzo: poche istruzioni
+            state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+        }
+        if (state == RATE_READY) {
+            if (memcmp(entry->addr, key->addr, sizeof(key->addr)) == 0) {
+                return entry;
+            }
+            if (idle == NULL &&
+                __atomic_load_n(&entry->full_at[RATE_CONNECT], __ATOMIC_RELAXED) <= now &&
+                __atomic_load_n(&entry->full_at[RATE_MESSAGE], __ATOMIC_RELAXED) <= now) {
+                idle = entry;
+            }
+            continue;
+        }
+
+        int expected = RATE_FREE;
+        if (__atomic_compare_exchange_n(&entry->state, &expected, RATE_WRITING, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            memcpy(entry->addr, key->addr, sizeof(key->addr));
+            entry->full_at[RATE_CONNECT] = 0;
+            entry->full_at[RATE_MESSAGE] = 0;
+            __atomic_store_n(&entry->state, RATE_READY, __ATOMIC_RELEASE);
+            return entry;
+        }
+        probe--;    // Voce appena occupata da un altro processo: si riesamina
+    }
+
+    int expected = RATE_READY;
+    if (idle != NULL &&
+        __atomic_compare_exchange_n(&idle->state, &expected, RATE_WRITING, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        memcpy(idle->addr, key->addr, sizeof(key->addr));
+        __atomic_store_n(&idle->state, RATE_READY, __ATOMIC_RELEASE);
+        return idle;
+    }
+    return NULL;
+}
+
+/**
+ * Preleva un token dal bucket (GCRA): il bucket ha capacità RATE_BURST_SEC secondi di token
+ * e full_at - now è il tempo che manca per riempirlo, cioè i token mancanti per l'intervallo
+ *
+ * @param entry La voce dell'indirizzo
+ * @param kind Il bucket
+ * @param max_wait_us Attesa accettabile del token: 0 per prelevarlo solo se disponibile subito
+ * @return L'attesa prima di poter usare il token (µs), -1 se oltre max_wait_us (nessun token prelevato)
+ */
+static int64_t rate_take(RateEntry* entry, RateKind kind, uint64_t max_wait_us) {
+    uint64_t interval = intervals[kind];
+    uint64_t tolerance = interval * (RATE_BURST_SEC * 1000000 / interval - 1);
+    uint64_t now = clock_now_ns() / 1000;
+    uint64_t full_at = __atomic_load_n(&entry->full_at[kind], __ATOMIC_RELAXED);
+
+    while (1) {
+        uint64_t base = full_at > now ? full_at : now;
+        uint64_t wait = base - now > tolerance ? base - now - tolerance : 0;
+        if (wait > max_wait_us) {
+            return -1;
+        }
+        if (__atomic_compare_exchange_n(&entry->full_at[kind], &full_at, base + interval, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return wait;
+        }
+    }
+}
+
+/**
+ * Verifica il limite di connessioni dell'indirizzo (processo principale, prima della fork)
+ * @param key L'indirizzo
+ * @return 1 se la connessione è ammessa, 0 se va rifiutata
+ */
+int rate_allow_connect(const RateKey* key) {
+    if (intervals[RATE_CONNECT] == 0) {
+        return 1;
+    }
+    RateEntry* entry = rate_entry(key);
+    if (entry == NULL || rate_take(entry, RATE_CONNECT, 0) >= 0) {
+        return 1;
+    }
+    metrics_rate_limited(RATE_CONNECT);
+    return 0;
+}
+
+/**
+ * Preleva il token di un messaggio ricevuto dal client (processo di sessione)
+ * @param key L'indirizzo
+ * @return L'attesa prima di elaborare il messaggio in ms (0 se entro il limite),
+ *         -1 se il client supera il limite oltre RATE_MAX_DELAY_MS (la connessione va chiusa)
+ */
+int rate_message_delay_ms(const RateKey* key) {
+    if (intervals[RATE_MESSAGE] == 0) {
+        return 0;
+    }
+    RateEntry* entry = rate_entry(key);
+    if (entry == NULL) {
+        return 0;
+    }
+    int64_t wait = rate_take(entry, RATE_MESSAGE, (uint64_t)RATE_MAX_DELAY_MS * 1000);
+    if (wait != 0) {
+        metrics_rate_limited(RATE_MESSAGE);
+    }
+    return wait < 0 ? -1 : (int)((wait + 999) / 1000);
+}
@@ -0,0 +1,36 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include "server.h"
+#include <sys/socket.h>
+
+/*
+ * Limiti di frequenza per indirizzo IP del client
+ * - per ogni indirizzo un token bucket per le connessioni e uno per i messaggi, in una tabella
+ *   hash in memoria condivisa: il processo principale e tutti i processi di sessione vedono
+ *   gli stessi contatori
+ * - ogni bucket è un solo istante a 64 bit (GCRA, la forma "a orario virtuale" del token
+ *   bucket): il momento in cui il bucket sarà di nuovo pieno. Prelevare un token è una
+ *   compare-and-swap, senza il lock dello stato
+ * - le connessioni oltre il limite sono chiuse dal processo principale prima della fork;
+ *   i messaggi oltre il limite rallentano la sessione (la lettura successiva attende il
+ *   token) e oltre RATE_MAX_DELAY_MS di ritardo la connessione viene chiusa
+ * - gli indirizzi locali (127.0.0.0/8, ::1) sono esclusi, salvo opzione -r
+ */
+
+#define RATE_CONNECT_PER_SEC 10     // Connessioni al secondo per indirizzo (opzione -R)
+#define RATE_MESSAGE_PER_SEC 100    // Messaggi al secondo per indirizzo (opzione -R)
+#define RATE_BURST_SEC 2            // Capacità del bucket: RATE_BURST_SEC secondi di richieste
+#define RATE_MAX_DELAY_MS 1000      // Ritardo massimo di un messaggio oltre il limite
+
+// Indirizzo del client come IPv6 (IPv4 in forma ::ffff:a.b.c.d)
+typedef struct {
+    uint8_t addr[16];
+} RateKey;
+
+void rate_configure(int connect_per_sec, int message_per_sec, int include_loopback);
+int rate_key(const struct sockaddr* addr, RateKey* key);
+int rate_allow_connect(const RateKey* key);
+int rate_message_delay_ms(const RateKey* key);
+
+#endif
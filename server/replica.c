@@ -0,0 +1,655 @@
+#include "replica.h"
+#include "config.h"
+#include "quiz.h"
+#include "persist.h"
+#include "metrics.h"
+#include "logger.h"
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <netinet/tcp.h>
+
+#define REPLICA_LINE_DATA (MAX_MSG_LEN - 32)    // Dati di una riga, lasciando spazio a tipo e lunghezza
+#define REPLICA_RECORD_MAX (MAX_NICKNAME_LEN + 32) // Un registro codificato, separatore incluso
+#define REPLICA_RECORDS (MAX_BOARD_ENTRIES * MAX_THEMES)
+#define REPLICA_OUT_SIZE (REPLICA_RECORDS * REPLICA_RECORD_MAX) // Stato intero della classifica, nel caso peggiore
+#define REPLICA_LINE_RECORDS (MAX_MSG_LEN / 6) // Registri in una riga ricevuta: il più corto è "N,0,0;"
+
+typedef enum {
+    PEER_IDLE,          // Non connesso: nuovo tentativo a retry_at
+    PEER_CONNECTING,    // connect non bloccante in corso
+    PEER_CONNECTED
+} PeerState;
+
+// Nodo a cui inviare gli aggiornamenti (connessione in uscita)
+typedef struct {
+    char name[CONFIG_VALUE_LEN];    // host:porta come configurato
+    struct sockaddr_in addr;
+    int fd;
+    int state;              // PeerState
+    char* out;              // Righe in attesa di invio
+    size_t out_len;
+    size_t out_sent;
+    int full;               // 1 finché il peer non ha ricevuto lo stato intero
+    uint64_t sent_seq;      // Sequenza dei registri già inviati
+    uint64_t retry_at;
+    int retry_ms;
+    int reported;           // Errore di connessione già scritto nel log
+} ReplicaPeer;
+
+// Nodo da cui ricevere gli aggiornamenti (connessione in entrata)
+typedef struct {
+    int fd;
+    int hello;              // 1 dopo un saluto valido
+    char name[INET_ADDRSTRLEN];
+    char in[2 * MAX_MSG_LEN];
+    size_t in_len;
+} ReplicaLink;
+
+// Registro della classifica raccolto per un peer
+typedef struct {
+    char nickname[MAX_NICKNAME_LEN];
+    int theme;
+    int score;
+    int completed;
+} ReplicaRecord;
+
+// Configurazione, letta dal processo principale ed ereditata dal processo di replica
+static ReplicaPeer peers[REPLICA_MAX_PEERS];
+static int peer_count;
+
+static ReplicaLink links[REPLICA_MAX_LINKS];
+static int listen_fd = -1;
+static int connected;
+static int catalog_generation;
+static uint64_t next_round;
+static ReplicaRecord records[REPLICA_RECORDS];
+
+/**
+ * Legge l'elenco dei peer e ne risolve gli indirizzi (processo principale)
+ * @param list I peer, host:porta separati da virgole; vuoto se nessuno
+ * @return 0 se successo, -1 se un peer non è valido (messaggio su stderr)
+ */
+int replica_configure(const char* list) {
+    char copy[CONFIG_VALUE_LEN];
+    char* save = NULL;
+
+    peer_count = 0;
+    snprintf(copy, sizeof(copy), "%s", list);
+    for (char* item = strtok_r(copy, ", ", &save); item != NULL; item = strtok_r(NULL, ", ", &save)) {
+        char* colon = strrchr(item, ':');
+        if (colon == NULL || colon == item || atoi(colon + 1) <= 0 || atoi(colon + 1) > 65535) {
+            fprintf(stderr, "Peer di replica non valido: %s (atteso host:porta)\n", item);
+            return -1;
+        }
+        if (peer_count == REPLICA_MAX_PEERS) {
+            fprintf(stderr, "Troppi peer di replica (al più %d)\n", REPLICA_MAX_PEERS);
+            return -1;
+        }
+
+        *colon = '\0';
+        struct addrinfo hints, *result;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        int err = getaddrinfo(item, colon + 1, &hints, &result);
+        if (err != 0) {
+            fprintf(stderr, "Peer di replica %s non risolto: %s\n", item, gai_strerror(err));
+            return -1;
+        }
+
+        ReplicaPeer* peer = &peers[peer_count++];
+        memset(peer, 0, sizeof(*peer));
+        memcpy(&peer->addr, result->ai_addr, sizeof(peer->addr));
+        snprintf(peer->name, sizeof(peer->name), "%s:%s", item, colon + 1);
+        peer->fd = -1;
+        freeaddrinfo(result);
+    }
+    return 0;
+}
+
+/**
+ * Indica se la replica è attiva: una porta su cui ricevere o almeno un peer a cui inviare
+ * @return 1 se attiva
+ */
+int replica_enabled(void) {
+    return server_config.replica_port > 0 || peer_count > 0;
+}
+
+/**
+ * Crea il socket su cui i peer inviano i loro aggiornamenti (tutte le interfacce)
+ * @param port La porta
+ * @return Il file descriptor del socket, -1 in caso di errore
+ */
+int replica_listen(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, REPLICA_MAX_LINKS) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Codifica il saluto di una connessione: versione del protocollo e catalogo dei temi
+ * @param data Buffer di output (almeno MAX_MSG_LEN byte)
+ */
+static void hello_encode(char* data) {
+    int len = snprintf(data, MAX_MSG_LEN, "%d", REPLICA_PROTOCOL_VERSION);
+    for (int i = 0; i < themes_count && len < MAX_MSG_LEN; i++) {
+        len += snprintf(data + len, MAX_MSG_LEN - len, ";%s", theme[i]);
+    }
+}
+
+/**
+ * Accoda una riga del protocollo alle righe in attesa di invio al peer
+ * @param peer Il peer
+ * @param type Il tipo del messaggio
+ * @param data I dati
+ */
+static void peer_queue(ReplicaPeer* peer, const char* type, const char* data) {
+    peer->out_len += format_msg(peer->out + peer->out_len, REPLICA_OUT_SIZE - peer->out_len, type, data);
+}
+
+static void publish_connected(int delta) {
+    connected += delta;
+    metrics_replica_peers(connected);
+}
+
+/**
+ * Chiude la connessione con un peer e pianifica il prossimo tentativo
+ * @param peer Il peer
+ * @param reason Il motivo, per il log
+ */
+static void peer_close(ReplicaPeer* peer, const char* reason) {
+    if (peer->state == PEER_CONNECTED) {
+        LOG_WARNING("Replica: connessione con %s chiusa (%s)", peer->name, reason);
+        publish_connected(-1);
+    } else if (!peer->reported) {
+        LOG_WARNING("Replica: %s non raggiungibile (%s), nuovi tentativi in corso", peer->name, reason);
+        peer->reported = 1;
+    }
+    close(peer->fd);
+    peer->fd = -1;
+    peer->state = PEER_IDLE;
+    peer->out_len = peer->out_sent = 0;
+    peer->retry_at = clock_now_ns() / 1000000 + peer->retry_ms;
+    peer->retry_ms = peer->retry_ms * 2 < REPLICA_RETRY_MAX_MS ? peer->retry_ms * 2 : REPLICA_RETRY_MAX_MS;
+}
+
+/**
+ * Completa la connessione con un peer: saluto, poi lo stato intero al prossimo giro
+ * @param peer Il peer
+ */
+static void peer_connected(ReplicaPeer* peer) {
+    int on = 1;
+    setsockopt(peer->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    char data[MAX_MSG_LEN];
+    hello_encode(data);
+    peer->state = PEER_CONNECTED;
+    peer->retry_ms = REPLICA_RETRY_MIN_MS;
+    peer->reported = 0;
+    peer->full = 1;
+    peer->sent_seq = 0;
+    peer->out_len = peer->out_sent = 0;
+    peer_queue(peer, MSG_REPLICA_HELLO, data);
+    publish_connected(1);
+    LOG_INFO("Replica: connesso a %s", peer->name);
+}
+
+/**
+ * Avvia una connessione non bloccante verso un peer
+ * @param peer Il peer
+ */
+static void peer_connect(ReplicaPeer* peer) {
+    peer->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (peer->fd < 0) {
+        peer->retry_at = clock_now_ns() / 1000000 + peer->retry_ms;
+        return;
+    }
+    if (connect(peer->fd, (struct sockaddr*)&peer->addr, sizeof(peer->addr)) == 0) {
+        peer_connected(peer);
+    } else if (errno == EINPROGRESS) {
+        peer->state = PEER_CONNECTING;
+    } else {
+        peer_close(peer, strerror(errno));
+    }
+}
+
+/**
+ * Invia quanto possibile delle righe in attesa, senza bloccare
+ * @param peer Il peer
+ */
+static void peer_flush(ReplicaPeer* peer) {
+    while (peer->out_sent < peer->out_len) {
+        ssize_t sent = send(peer->fd, peer->out + peer->out_sent, peer->out_len - peer->out_sent,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                peer_close(peer, strerror(errno));
+            }
+            return;
+        }
+        peer->out_sent += sent;
+    }
+    peer->out_len = peer->out_sent = 0;
+}
+
+/**
+ * Raccoglie i registri da inviare a un peer: tutti se non ha ancora lo stato intero,
+ * altrimenti quelli modificati dopo l'ultimo invio. Un'unica scansione sotto lock,
+ * ordinata per tema, senza codifica
+ *
+ * @param peer Il peer
+ * @param upto Output: la sequenza coperta dai registri raccolti
+ * @return Il numero di registri raccolti
+ */
+static int collect_changes(const ReplicaPeer* peer, uint64_t* upto) {
+    int count = 0;
+
+    lock_shared_state();
+    *upto = shared_state->board_seq_last;
+    for (int theme_num = 0; theme_num < themes_count; theme_num++) {
+        for (int i = 0; i < shared_state->board_count; i++) {
+            const Player* entry = &shared_state->board[i];
+            if (entry->score[theme_num] == -1 && !entry->completed[theme_num]) {
+                continue;
+            }
+            if (!peer->full && shared_state->board_seq[i][theme_num] <= peer->sent_seq) {
+                continue;
+            }
+            ReplicaRecord* record = &records[count++];
+            memcpy(record->nickname, entry->nickname, MAX_NICKNAME_LEN);
+            record->theme = theme_num;
+            record->score = entry->score[theme_num];
+            record->completed = entry->completed[theme_num];
+        }
+    }
+    unlock_shared_state();
+
+    return count;
+}
+
+/**
+ * Un giro di replica verso un peer: raccoglie i delta e li accoda in righe SCORES, una per
+ * gruppo di registri dello stesso tema, inviate tutte insieme
+ * @param peer Il peer, connesso
+ */
+static void peer_round(ReplicaPeer* peer) {
+    if (peer->out_len > 0) {
+        // Le righe precedenti non sono ancora partite: i delta restano nella classifica
+        return;
+    }
+    if (!peer->full && __atomic_load_n(&shared_state->board_seq_last, __ATOMIC_ACQUIRE) == peer->sent_seq) {
+        return;
+    }
+
+    uint64_t upto;
+    int count = collect_changes(peer, &upto);
+    char data[MAX_MSG_LEN];
+    int i = 0;
+    while (i < count) {
+        int theme_num = records[i].theme;
+        int len = snprintf(data, sizeof(data), "%d", theme_num);
+        while (i < count && records[i].theme == theme_num) {
+            char item[REPLICA_RECORD_MAX];
+            int n = snprintf(item, sizeof(item), ";%s,%d,%d", records[i].nickname, records[i].score,
+                             records[i].completed);
+            if (len + n >= REPLICA_LINE_DATA) {
+                break;
+            }
+            memcpy(data + len, item, n + 1);
+            len += n;
+            i++;
+        }
+        peer_queue(peer, MSG_REPLICA_SCORES, data);
+    }
+
+    peer->full = 0;
+    peer->sent_seq = upto;
+    metrics_replica_records(count, 0, 0);
+    peer_flush(peer);
+}
+
+/**
+ * Chiude una connessione in entrata
+ * @param link La connessione
+ * @param reason Il motivo, per il log
+ */
+static void link_close(ReplicaLink* link, const char* reason) {
+    LOG_INFO("Replica: connessione da %s chiusa (%s)", link->name, reason);
+    close(link->fd);
+    link->fd = -1;
+}
+
+/**
+ * Verifica il saluto di un nodo: stessa versione del protocollo e stesso catalogo dei temi
+ * (i registri indicano il tema con il suo numero)
+ *
+ * @param data I dati del saluto
+ * @return 1 se il nodo è compatibile
+ */
+static int hello_check(const char* data) {
+    char local[MAX_MSG_LEN];
+    hello_encode(local);
+    return strcmp(data, local) == 0;
+}
+
+/**
+ * Unisce nella classifica locale i registri di una riga SCORES, in una sola sezione critica
+ * La riga viene validata per intero prima di toccare la classifica: una riga malformata non
+ * lascia registri uniti a metà
+ *
+ * @param link La connessione da cui arriva la riga
+ * @param data I dati della riga
+ * @return 0 se la riga è ben formata, -1 altrimenti
+ */
+static int merge_scores(ReplicaLink* link, char* data) {
+    struct {
+        char nickname[MAX_NICKNAME_LEN];
+        int score;
+        int completed;
+    } records[REPLICA_LINE_RECORDS];
+
+    char* save = NULL;
+    char* item = strtok_r(data, ";", &save);
+    if (item == NULL || !is_numeric(item) || atoi(item) >= themes_count) {
+        return -1;
+    }
+    int theme_num = atoi(item);
+
+    int received = 0;
+    while ((item = strtok_r(NULL, ";", &save)) != NULL) {
+        if (received == REPLICA_LINE_RECORDS ||
+            sscanf(item, "%31[^,],%d,%d", records[received].nickname, &records[received].score,
+                   &records[received].completed) != 3 ||
+            !valid_nickname(records[received].nickname) || records[received].score < -1 ||
+            (records[received].completed != 0 && records[received].completed != 1)) {
+            return -1;
+        }
+        received++;
+    }
+
+    int merged = 0, full = 0;
+    lock_shared_state();
+    for (int i = 0; i < received; i++) {
+        int changed = board_update(theme_num, records[i].nickname, records[i].score, records[i].completed);
+        if (changed < 0) {
+            full++;
+        } else if (changed > 0) {
+            persist_append_score(records[i].nickname, theme_num, records[i].score, records[i].completed);
+            merged++;
+        }
+    }
+    if (merged > 0) {
+        shared_state->board_generation[theme_num]++;
+        metrics_rank_update();
+    }
+    unlock_shared_state();
+
+    if (full > 0) {
+        LOG_WARNING("Replica: classifica globale piena, %d registri da %s non registrati", full, link->name);
+    }
+    metrics_replica_records(0, received, merged);
+    return 0;
+}
+
+/**
+ * Elabora una riga ricevuta da un nodo
+ * @param link La connessione
+ * @param line La riga, senza '\n'
+ * @return 0 se la connessione resta aperta, -1 se è stata chiusa
+ */
+static int link_message(ReplicaLink* link, char* line) {
+    char type[MAX_TYPE_LEN];
+    char data[MAX_MSG_LEN];
+    if (parse_msg(line, type, data) < 0) {
+        link_close(link, "messaggio non valido");
+        return -1;
+    }
+
+    if (!link->hello) {
+        if (strcmp(type, MSG_REPLICA_HELLO) != 0 || !hello_check(data)) {
+            LOG_WARNING("Replica: %s ha un protocollo o un catalogo dei temi diverso", link->name);
+            link_close(link, "nodo incompatibile");
+            return -1;
+        }
+        link->hello = 1;
+        LOG_INFO("Replica: aggiornamenti da %s", link->name);
+        return 0;
+    }
+    if (strcmp(type, MSG_REPLICA_SCORES) != 0 || merge_scores(link, data) < 0) {
+        link_close(link, "messaggio non valido");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Legge da una connessione in entrata ed elabora le righe complete
+ * @param link La connessione
+ */
+static void link_read(ReplicaLink* link) {
+    ssize_t received = recv(link->fd, link->in + link->in_len, sizeof(link->in) - 1 - link->in_len, 0);
+    if (received <= 0) {
+        if (received < 0 && (errno == EINTR || errno == EAGAIN)) {
+            return;
+        }
+        link_close(link, received == 0 ? "chiusa dal nodo" : strerror(errno));
+        return;
+    }
+    link->in_len += received;
+
+    char* start = link->in;
+    char* newline;
+    while ((newline = memchr(start, '\n', link->in + link->in_len - start)) != NULL) {
+        *newline = '\0';
+        if (link_message(link, start) < 0) {
+            return;
+        }
+        start = newline + 1;
+    }
+    link->in_len -= start - link->in;
+    memmove(link->in, start, link->in_len);
+    if (link->in_len >= MAX_MSG_LEN) {
+        // Riga più lunga del massimo consentito: il flusso non è più sincronizzato
+        link_close(link, "riga troppo lunga");
+    }
+}
+
+/**
+ * Accetta una connessione in entrata, solo dagli indirizzi dei peer configurati
+ */
+static void link_accept(void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = accept(listen_fd, (struct sockaddr*)&addr, &len);
+    if (fd < 0) {
+        return;
+    }
+
+    char name[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, name, sizeof(name));
+    int allowed = 0;
+    for (int i = 0; i < peer_count && !allowed; i++) {
+        allowed = peers[i].addr.sin_addr.s_addr == addr.sin_addr.s_addr;
+    }
+    if (!allowed) {
+        LOG_WARNING("Replica: connessione da %s rifiutata (non è tra i peer)", name);
+        close(fd);
+        return;
+    }
+
+    for (int i = 0; i < REPLICA_MAX_LINKS; i++) {
+        if (links[i].fd < 0) {
+            links[i].fd = fd;
+            links[i].hello = 0;
+            links[i].in_len = 0;
+            memcpy(links[i].name, name, sizeof(name));
+            return;
+        }
+    }
+    LOG_WARNING("Replica: troppe connessioni in entrata, %s rifiutata", name);
+    close(fd);
+}
+
+/**
+ * Prepara il processo di replica
+ * @param listen_socket Il socket su cui arrivano gli aggiornamenti dei peer, -1 se nessuno
+ */
+void replica_worker_init(int listen_socket) {
+    listen_fd = listen_socket;
+    for (int i = 0; i < REPLICA_MAX_LINKS; i++) {
+        links[i].fd = -1;
+    }
+    for (int i = 0; i < peer_count; i++) {
+        peers[i].out = malloc(REPLICA_OUT_SIZE);
+        if (peers[i].out == NULL) {
+            LOG_ERROR("Replica: memoria insufficiente per %s", peers[i].name);
+            exit(1);
+        }
+        peers[i].state = PEER_IDLE;
+        peers[i].retry_at = 0;
+        peers[i].retry_ms = REPLICA_RETRY_MIN_MS;
+    }
+    connected = 0;
+    metrics_replica_peers(0);
+    catalog_generation = __atomic_load_n(&shared_state->catalog_generation, __ATOMIC_ACQUIRE);
+    next_round = clock_now_ns() / 1000000 + REPLICA_INTERVAL_MS;
+}
+
+/**
+ * Chiude tutte le connessioni (all'arresto o quando cambia il catalogo dei temi)
+ * @param reason Il motivo, per il log
+ */
+static void close_all(const char* reason) {
+    for (int i = 0; i < peer_count; i++) {
+        if (peers[i].fd >= 0) {
+            peer_close(&peers[i], reason);
+            peers[i].retry_at = 0;
+        }
+    }
+    for (int i = 0; i < REPLICA_MAX_LINKS; i++) {
+        if (links[i].fd >= 0) {
+            link_close(&links[i], reason);
+        }
+    }
+}
+
+/**
+ * Un passo del processo di replica: connessioni, ricezione e unione, invio dei delta
+ * @param timeout_ms Attesa massima di un evento sui socket
+ */
+void replica_worker_poll(int timeout_ms) {
+    struct pollfd fds[1 + REPLICA_MAX_PEERS + REPLICA_MAX_LINKS];
+    int index[1 + REPLICA_MAX_PEERS + REPLICA_MAX_LINKS];
+    int count = 0;
+
+    if (listen_fd >= 0) {
+        fds[count].fd = listen_fd;
+        fds[count].events = POLLIN;
+        index[count++] = -1;
+    }
+    for (int i = 0; i < peer_count; i++) {
+        if (peers[i].fd >= 0) {
+            // Dai peer non arriva nulla: POLLIN segnala solo la chiusura
+            fds[count].fd = peers[i].fd;
+            fds[count].events = peers[i].state == PEER_CONNECTING ? POLLOUT
+                              : POLLIN | (peers[i].out_len > 0 ? POLLOUT : 0);
+            index[count++] = i;
+        }
+    }
+    for (int i = 0; i < REPLICA_MAX_LINKS; i++) {
+        if (links[i].fd >= 0) {
+            fds[count].fd = links[i].fd;
+            fds[count].events = POLLIN;
+            index[count++] = REPLICA_MAX_PEERS + i;
+        }
+    }
+
+    uint64_t now = clock_now_ns() / 1000000;
+    int wait = next_round > now ? (int)(next_round - now) : 0;
+    if (poll(fds, count, wait < timeout_ms ? wait : timeout_ms) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (index[i] < 0) {
+                link_accept();
+            } else if (index[i] >= REPLICA_MAX_PEERS) {
+                link_read(&links[index[i] - REPLICA_MAX_PEERS]);
+            } else {
+                ReplicaPeer* peer = &peers[index[i]];
+                if (peer->state == PEER_CONNECTING) {
+                    int err = 0;
+                    socklen_t len = sizeof(err);
+                    getsockopt(peer->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                    if (err == 0) {
+                        peer_connected(peer);
+                    } else {
+                        peer_close(peer, strerror(err));
+                    }
+                } else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    char discard[256];
+                    ssize_t received = recv(peer->fd, discard, sizeof(discard), MSG_DONTWAIT);
+                    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+                        peer_close(peer, received == 0 ? "chiusa dal peer" : strerror(errno));
+                    }
+                } else if (fds[i].revents & POLLOUT) {
+                    peer_flush(peer);
+                }
+            }
+        }
+    }
+
+    now = clock_now_ns() / 1000000;
+    for (int i = 0; i < peer_count; i++) {
+        if (peers[i].state == PEER_IDLE && now >= peers[i].retry_at) {
+            peer_connect(&peers[i]);
+        }
+    }
+    if (now < next_round) {
+        return;
+    }
+    next_round = now + REPLICA_INTERVAL_MS;
+
+    // Con un nuovo catalogo i numeri dei temi cambiano: i saluti vanno ripetuti
+    int generation = __atomic_load_n(&shared_state->catalog_generation, __ATOMIC_ACQUIRE);
+    if (generation != catalog_generation) {
+        init_themes();
+        catalog_generation = generation;
+        close_all("catalogo dei temi ricaricato");
+        return;
+    }
+    for (int i = 0; i < peer_count; i++) {
+        if (peers[i].state == PEER_CONNECTED) {
+            peer_round(&peers[i]);
+        }
+    }
+}
+
+/**
+ * Chiude le connessioni all'arresto del processo
+ */
+void replica_worker_shutdown(void) {
+    close_all("arresto del server");
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+    metrics_replica_peers(0);
+}
@@ -0,0 +1,52 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include "server.h"
+
+/*
+ * Replica della classifica globale tra più nodi (opzioni -N e -j)
+ * - ogni voce della classifica è un registro di massimo per (nickname, tema): miglior punteggio
+ *   e completamento, che non torna mai a 0. Unire due classifiche significa prendere il massimo
+ *   registro per registro: l'unione è commutativa, associativa e idempotente, quindi i nodi
+ *   convergono qualunque sia l'ordine, la ripetizione o il percorso degli aggiornamenti, senza
+ *   un database centrale (board_update è già l'unione)
+ * - board_update assegna a ogni registro modificato una sequenza locale (board_seq): per ogni peer
+ *   il processo di replica ricorda l'ultima sequenza inviata e ogni REPLICA_INTERVAL_MS raccoglie
+ *   solo i registri cambiati da allora, raggruppati per tema in righe SCORES inviate insieme
+ * - un peer lento non accumula arretrato: finché le righe precedenti non sono partite non si
+ *   raccolgono nuovi delta, e il giro successivo porta solo il valore corrente dei registri
+ *   cambiati nel frattempo
+ * - a ogni connessione, anche dopo una caduta, il peer riceve lo stato intero: i registri che
+ *   conosce già non cambiano nulla
+ * - le connessioni in uscita inviano, quelle in entrata ricevono: due nodi che si elencano a
+ *   vicenda come peer si scambiano gli aggiornamenti nei due sensi. Un registro unito da un peer
+ *   riceve una nuova sequenza e viene inoltrato agli altri peer (catene e stelle convergono),
+ *   mentre un registro che non cambia non riparte
+ * - i registri uniti finiscono nel WAL e, tramite board_generation, negli aggiornamenti degli
+ *   iscritti alle classifiche come quelli locali
+ * - i nodi devono avere lo stesso catalogo dei temi: il saluto di ogni connessione lo confronta.
+ *   Le connessioni in entrata sono accettate solo dagli indirizzi dei peer (IPv4)
+ */
+
+#define REPLICA_MAX_PEERS 8             // Nodi a cui inviare gli aggiornamenti
+#define REPLICA_MAX_LINKS 16            // Connessioni in entrata contemporanee
+#define REPLICA_INTERVAL_MS 200         // Raccolta e invio dei delta
+#define REPLICA_RETRY_MIN_MS 500        // Attesa prima di riconnettersi a un peer, raddoppiata a ogni errore
+#define REPLICA_RETRY_MAX_MS 10000
+#define REPLICA_PROTOCOL_VERSION 1
+
+// Messaggi tra i nodi (righe TIPO|LUNGHEZZA|DATI, come il protocollo dei client)
+#define MSG_REPLICA_HELLO "REPLICA"     // Versione e catalogo dei temi: VERSIONE;TEMA;TEMA...
+#define MSG_REPLICA_SCORES "SCORES"     // Registri di un tema: TEMA;NICK,PUNTEGGIO,COMPLETATO;...
+
+// Processo principale
+int replica_configure(const char* peers);
+int replica_enabled(void);
+int replica_listen(int port);
+
+// Processo di replica
+void replica_worker_init(int listen_socket);
+void replica_worker_poll(int timeout_ms);
+void replica_worker_shutdown(void);
+
+#endif
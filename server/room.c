@@ -0,0 +1,1138 @@
+#define _GNU_SOURCE // POLLRDHUP
+#include "room.h"
+#include "quiz.h"
+#include "metrics.h"
+#include "config.h"
+#include "logger.h"
+#include "../shared/transport.h"
+#include <errno.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/uio.h>
+
+// Canale dei socket dei client: [0] letto dal processo delle stanze, [1] scritto dalle sessioni
+static int channel[2] = { -1, -1 };
+
+// Richiesta di ingresso, inviata sul canale insieme al socket del client
+typedef struct {
+    int seat;
+    pid_t pid;
+    int room;               // -1 per un'iscrizione alle classifiche
+    int themes;             // Temi seguiti dall'iscritto
+    char nickname[MAX_NICKNAME_LEN];
+} RoomJoin;
+
+// Messaggio codificato una volta e condiviso dalle code di tutti i destinatari
+// (lo usa solo il processo delle stanze: il contatore non richiede operazioni atomiche)
+typedef struct {
+    int refs;
+    int len;
+    char data[];
+} RoomFrame;
+
+typedef struct {
+    int fd;                 // Socket del client, -1 se la voce è libera
+    int seat;               // Posto in memoria condivisa
+    int room;               // -1 per un iscritto alle classifiche
+    int themes;             // Temi seguiti dall'iscritto
+    int resync;             // Temi per cui l'iscritto ha perso aggiornamenti: riceverà la classifica intera
+    int closing;            // Fine dell'evento accodata: rilascio del socket a coda vuota
+    char nickname[MAX_NICKNAME_LEN];
+    RoomFrame* queue[ROOM_MEMBER_QUEUE];
+    int head;
+    int count;
+    int offset;             // Byte del primo frame in coda già inviati
+    int bytes;              // Byte in coda non ancora inviati
+    int congested;          // Oltre ROOM_MEMBER_HIGH_WATER, fino al ritorno sotto ROOM_MEMBER_LOW_WATER
+    int counted;            // Sequenza della domanda la cui risposta è già stata contata
+} RoomMember;
+
+// Stato locale del processo delle stanze
+// Partecipanti e iscritti: la tabella cresce con gli ingressi (vedi member_alloc)
+static RoomMember* members = NULL;
+static int members_capacity = 0;
+static struct pollfd* poll_fds = NULL;          // Socket osservati da room_worker_poll (canale e partecipanti)
+static int* poll_members = NULL;                // Partecipante di ogni socket osservato
+static Quiz quizzes[MAX_THEMES];
+static uint64_t deadlines[MAX_THEMES];          // Prossimo passo dell'orologio di ogni stanza, in ms
+static RoomFrame* open_questions[MAX_THEMES];   // Domanda aperta, inviata anche a chi entra in ritardo
+static int room_answered[MAX_THEMES];           // Risposte contate alla domanda aperta (pubblicate alla chiusura)
+static int room_correct[MAX_THEMES];
+static int catalog_generation;
+
+// Classifiche seguite dagli iscritti: le ultime righe inviate sono la base degli aggiornamenti
+static LeaderboardRow ranks[MAX_THEMES][RANK_PUSH_ROWS];
+static int rank_count[MAX_THEMES];
+static int rank_generation[MAX_THEMES];         // Generazione della classifica a cui corrispondono le righe
+static int subscribers[MAX_THEMES];
+static uint64_t next_rank_push;
+static RankPolicy rank_policy = RANK_POLICY_COALESCE;
+static const char* rank_policy_names[] = { "coalesce", "drop", "disconnect" };
+
+/**
+ * Crea il canale tra i processi di sessione e il processo delle stanze (processo principale)
+ * @return 0 se successo, -1 in caso di errore (le stanze non sono disponibili)
+ */
+int room_channel_open(void) {
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, channel) < 0) {
+        channel[0] = channel[1] = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Chiude gli estremi del canale che il processo non usa
+ * @param role Il ruolo del processo
+ */
+void room_channel_close(RoomRole role) {
+    if (role != ROOM_ROLE_WORKER && channel[0] >= 0) {
+        close(channel[0]);
+        channel[0] = -1;
+    }
+    if (role != ROOM_ROLE_SESSION && channel[1] >= 0) {
+        close(channel[1]);
+        channel[1] = -1;
+    }
+}
+
+/**
+ * Interpreta il nome di una RankPolicy (opzione -P)
+ * @param name coalesce, drop o disconnect
+ * @return La politica, -1 se il nome non è valido
+ */
+int room_parse_policy(const char* name) {
+    for (int i = 0; i < (int)(sizeof(rank_policy_names) / sizeof(rank_policy_names[0])); i++) {
+        if (strcasecmp(name, rank_policy_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Imposta il trattamento degli iscritti lenti (prima dell'avvio del processo delle stanze)
+ * @param policy La politica
+ */
+void room_set_policy(RankPolicy policy) {
+    rank_policy = policy;
+}
+
+// --- Processo di sessione ---
+
+/**
+ * Indica se il processo delle stanze ha rilasciato il socket del client
+ * (il posto è libero o è già passato a un altro processo)
+ *
+ * @param seat Il posto del partecipante
+ * @return 1 se il socket è di nuovo solo del processo di sessione
+ */
+int room_released(int seat) {
+    RoomSeat* entry = &shared_state->room_seats[seat];
+    return __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) == SEAT_FREE ||
+           __atomic_load_n(&entry->pid, __ATOMIC_RELAXED) != getpid();
+}
+
+/**
+ * Attende che il posto lasci lo stato indicato
+ * @param seat Il posto
+ * @param state Lo stato di partenza
+ */
+static void wait_seat(int seat, int state) {
+    RoomSeat* entry = &shared_state->room_seats[seat];
+    for (int waited = 0; waited < ROOM_JOIN_WAIT_MS; waited += 10) {
+        if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) != state || room_released(seat)) {
+            return;
+        }
+        usleep(10000);
+    }
+}
+
+/**
+ * Passa il socket del client al processo delle stanze e ne attende la conferma
+ * @param room Il tema della stanza, -1 per un'iscrizione alle classifiche
+ * @param themes I temi seguiti (solo iscrizione)
+ * @param client_socket Il socket del client
+ * @param nickname Il nickname del giocatore
+ * @return Il posto occupato, -1 se rifiutato
+ */
+static int seat_join(int room, int themes, int client_socket, const char* nickname) {
+    // Le risposte ancora in coda partono prima dei messaggi del processo delle stanze
+    if (channel[1] < 0 || transport_flush(client_socket) < 0) {
+        return -1;
+    }
+
+    pid_t pid = getpid();
+    int seat = -1;
+    lock_shared_state();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        RoomSeat* entry = &shared_state->room_seats[i];
+        if (entry->state == SEAT_FREE) {
+            entry->state = SEAT_JOINING;
+            entry->pid = pid;
+            entry->room = room;
+            entry->themes = themes;
+            entry->answered_question = -1;
+            entry->leaving = 0;
+            seat = i;
+            break;
+        }
+    }
+    unlock_shared_state();
+    if (seat < 0) {
+        return -1;
+    }
+
+    RoomJoin join = { seat, pid, room, themes, {0} };
+    snprintf(join.nickname, sizeof(join.nickname), "%s", nickname);
+    if (transport_send_fd(channel[1], client_socket, &join, sizeof(join)) == 0) {
+        wait_seat(seat, SEAT_JOINING);
+    }
+
+    // Senza conferma il posto torna libero e il processo delle stanze scarterà la richiesta
+    int joined = 0;
+    lock_shared_state();
+    RoomSeat* entry = &shared_state->room_seats[seat];
+    if (entry->pid == pid) {
+        joined = entry->state == SEAT_MEMBER;
+        if (entry->state == SEAT_JOINING) {
+            entry->state = SEAT_FREE;
+            entry->pid = 0;
+        }
+    }
+    unlock_shared_state();
+    return joined ? seat : -1;
+}
+
+/**
+ * Entra nella stanza di un tema: il socket del client passa al processo delle stanze, che da
+ * questo momento invia i messaggi della stanza (il primo è MSG_ROOM_WAIT) fino a MSG_ROOM_END
+ *
+ * @param room Il tema della stanza
+ * @param client_socket Il socket del client
+ * @param nickname Il nickname del giocatore
+ * @return Il posto del partecipante, -1 se la stanza non è disponibile (nulla è stato inviato al client)
+ */
+int room_join(int room, int client_socket, const char* nickname) {
+    return seat_join(room, 0, client_socket, nickname);
+}
+
+/**
+ * Iscrive il client agli aggiornamenti delle classifiche di alcuni temi: come per le stanze il
+ * socket passa al processo delle stanze, che invia la classifica di ogni tema (MSG_RANK) e poi
+ * le sole righe cambiate, fino a MSG_RANK_END. L'uscita si chiede con room_leave.
+ *
+ * @param themes I temi seguiti, un bit per tema
+ * @param client_socket Il socket del client
+ * @param nickname Il nickname del giocatore
+ * @return Il posto dell'iscritto, -1 se l'iscrizione non è disponibile (nulla è stato inviato al client)
+ */
+int room_subscribe(int themes, int client_socket, const char* nickname) {
+    return seat_join(-1, themes, client_socket, nickname);
+}
+
+/**
+ * Registra la risposta del partecipante alla domanda aperta della stanza, senza lock:
+ * la risposta corretta è copiata dallo stato della stanza e l'esito annotato nel posto,
+ * dove il processo delle stanze lo conta (vedi room_collect).
+ * Conta solo la prima risposta a ogni domanda; le risposte fuori tempo vengono ignorate
+ *
+ * @param seat Il posto del partecipante
+ * @param answer La risposta
+ * @return 1 se corretta, 0 se sbagliata, -1 se non registrata
+ */
+int room_answer(int seat, const char* answer) {
+    RoomSeat* entry = &shared_state->room_seats[seat];
+    if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) != SEAT_MEMBER || entry->pid != getpid() ||
+        __atomic_load_n(&entry->leaving, __ATOMIC_RELAXED) || entry->room < 0) {
+        return -1;
+    }
+    Room* room = &shared_state->rooms[entry->room];
+
+    // La copia della risposta corretta vale se la sequenza della domanda non è cambiata nel frattempo
+    Question question = { "", "" };
+    int asked = __atomic_load_n(&room->asked, __ATOMIC_ACQUIRE);
+    if ((asked & 1) || __atomic_load_n(&room->phase, __ATOMIC_RELAXED) != ROOM_QUESTION) {
+        return -1;
+    }
+    memcpy(question.correct_answer, room->answer, sizeof(question.correct_answer));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&room->asked, __ATOMIC_RELAXED) != asked) {
+        return -1;
+    }
+    question.correct_answer[sizeof(question.correct_answer) - 1] = '\0';
+
+    int previous = __atomic_load_n(&entry->answered_question, __ATOMIC_RELAXED);
+    if (previous >= asked) {
+        return -1;
+    }
+    char reply[MAX_ANSWER_LEN];
+    snprintf(reply, sizeof(reply), "%s", answer);
+    int correct = check_answer(&question, reply);
+
+    // Il processo delle stanze chiude i posti alla fine della domanda con lo stesso confronto:
+    // la risposta conta solo se arriva prima della chiusura
+    __atomic_store_n(&entry->answer_correct, correct, __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&entry->answered_question, &previous, asked, 0,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+    return correct;
+}
+
+/**
+ * Chiede l'uscita dalla stanza (o dalle classifiche): il processo delle stanze invia
+ * MSG_ROOM_END (o MSG_RANK_END) e rilascia il socket
+ * @param seat Il posto del partecipante
+ * @param wait 1 per attendere il rilascio (prima di scrivere di nuovo sul socket)
+ */
+void room_leave(int seat, int wait) {
+    lock_shared_state();
+    RoomSeat* entry = &shared_state->room_seats[seat];
+    if (entry->state == SEAT_MEMBER && entry->pid == getpid()) {
+        entry->leaving = 1;
+    }
+    unlock_shared_state();
+    if (wait) {
+        wait_seat(seat, SEAT_MEMBER);
+    }
+}
+
+/**
+ * Libera i posti di un processo di sessione terminato senza uscire dalla stanza (processo principale)
+ * Un ingresso non ancora confermato viene annullato; un partecipante riceve la richiesta di uscita
+ * e il processo delle stanze chiude l'ultimo riferimento alla connessione del client.
+ * Il chiamante deve possedere il lock sulla memoria condivisa
+ *
+ * @param pid Il pid del processo terminato
+ */
+void room_reclaim(pid_t pid) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        RoomSeat* entry = &shared_state->room_seats[i];
+        if (entry->state == SEAT_FREE || entry->pid != pid) {
+            continue;
+        }
+        if (entry->state == SEAT_JOINING) {
+            entry->pid = 0;
+            __atomic_store_n(&entry->state, SEAT_FREE, __ATOMIC_RELEASE);
+        } else {
+            entry->leaving = 1;
+        }
+    }
+}
+
+// --- Processo delle stanze ---
+
+/**
+ * Codifica un messaggio della stanza in un frame condivisibile
+ * @param type Il tipo del messaggio
+ * @param data Il payload
+ * @return Il frame con un riferimento per il chiamante, NULL in caso di errore
+ */
+static RoomFrame* frame_encode(const char* type, const char* data) {
+    char message[MAX_MSG_LEN];
+    int len = format_msg(message, sizeof(message), type, data);
+    RoomFrame* frame = malloc(sizeof(RoomFrame) + len);
+    if (frame == NULL) {
+        LOG_ERROR("Memoria insufficiente per un messaggio della stanza");
+        return NULL;
+    }
+    frame->refs = 1;
+    frame->len = len;
+    memcpy(frame->data, message, len);
+    return frame;
+}
+
+static void frame_release(RoomFrame* frame) {
+    if (frame != NULL && --frame->refs == 0) {
+        free(frame);
+    }
+}
+
+/**
+ * Rilascia il socket di un partecipante: il processo di sessione torna a scriverci
+ * @param member Il partecipante
+ */
+static void member_release(RoomMember* member) {
+    while (member->count > 0) {
+        frame_release(member->queue[member->head]);
+        member->head = (member->head + 1) % ROOM_MEMBER_QUEUE;
+        member->count--;
+    }
+    member->bytes = 0;
+    member->congested = 0;
+    // Il socket si chiude prima di liberare il posto: il processo di sessione non scrive
+    // finché questo processo può ancora farlo
+    close(member->fd);
+    member->fd = -1;
+
+    for (int theme_num = 0; theme_num < MAX_THEMES; theme_num++) {
+        if (member->themes & (1 << theme_num)) {
+            subscribers[theme_num]--;
+        }
+    }
+
+    lock_shared_state();
+    RoomSeat* entry = &shared_state->room_seats[member->seat];
+    if (!member->closing && member->room >= 0) {
+        shared_state->rooms[member->room].members--;
+    }
+    entry->pid = 0;
+    __atomic_store_n(&entry->state, SEAT_FREE, __ATOMIC_RELEASE);
+    unlock_shared_state();
+}
+
+/**
+ * Rimuove un partecipante senza attendere la sua coda
+ * @param member Il partecipante
+ * @param reason Il motivo, per il log
+ * @param disconnect 1 per chiudere anche la connessione del client (la sessione resta riprendibile)
+ */
+static void member_drop(RoomMember* member, const char* reason, int disconnect) {
+    if (member->room >= 0) {
+        LOG_WARNING("Stanza %s: %s rimosso (%s)", theme[member->room], member->nickname, reason);
+    } else {
+        LOG_WARNING("Classifiche: %s rimosso (%s)", member->nickname, reason);
+    }
+    if (disconnect) {
+        shutdown(member->fd, SHUT_RDWR);
+    }
+    member_release(member);
+}
+
+/**
+ * Invia i frame in coda di un partecipante con una sola sendmsg, senza bloccare:
+ * quello che il socket non accetta resta in coda fino al prossimo POLLOUT
+ *
+ * @param member Il partecipante
+ */
+static void member_flush(RoomMember* member) {
+    while (member->fd >= 0 && member->count > 0) {
+        struct iovec iov[ROOM_MEMBER_QUEUE];
+        for (int i = 0; i < member->count; i++) {
+            RoomFrame* frame = member->queue[(member->head + i) % ROOM_MEMBER_QUEUE];
+            int skip = i == 0 ? member->offset : 0;
+            iov[i].iov_base = frame->data + skip;
+            iov[i].iov_len = frame->len - skip;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = member->count;
+
+        // Il socket è condiviso con il processo di sessione: niente O_NONBLOCK, solo MSG_DONTWAIT
+        ssize_t sent = sendmsg(member->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                member_drop(member, strerror(errno), 0);
+            }
+            return;
+        }
+
+        member->bytes -= sent;
+        while (sent > 0) {
+            RoomFrame* frame = member->queue[member->head];
+            int left = frame->len - member->offset;
+            if (sent < left) {
+                member->offset += sent;
+                break;
+            }
+            sent -= left;
+            member->offset = 0;
+            frame_release(frame);
+            member->head = (member->head + 1) % ROOM_MEMBER_QUEUE;
+            member->count--;
+        }
+    }
+    if (member->congested && member->bytes <= ROOM_MEMBER_LOW_WATER) {
+        member->congested = 0;
+    }
+    if (member->fd >= 0 && member->count == 0 && member->closing) {
+        member_release(member);
+    }
+}
+
+/**
+ * Accoda un frame a un partecipante senza inviarlo
+ * @param member Il partecipante
+ * @param frame Il frame (il partecipante ne prende un riferimento)
+ * @return 1 se accodato, 0 se il partecipante è stato rimosso
+ */
+static int member_queue(RoomMember* member, RoomFrame* frame) {
+    if (member->count == ROOM_MEMBER_QUEUE) {
+        // Il client non legge più: la connessione viene chiusa e la sessione resta riprendibile
+        metrics_slow_consumer();
+        member_drop(member, "troppo lento", 1);
+        return 0;
+    }
+    member->queue[(member->head + member->count) % ROOM_MEMBER_QUEUE] = frame;
+    frame->refs++;
+    member->count++;
+    member->bytes += frame->len;
+    if (member->bytes > ROOM_MEMBER_HIGH_WATER) {
+        member->congested = 1;
+    }
+    return 1;
+}
+
+/**
+ * Accoda un frame a un partecipante e prova a inviarlo
+ * @param member Il partecipante
+ * @param frame Il frame (il partecipante ne prende un riferimento)
+ * @return 1 se accodato, 0 se il partecipante è stato rimosso
+ */
+static int member_send(RoomMember* member, RoomFrame* frame) {
+    if (!member_queue(member, frame)) {
+        return 0;
+    }
+    member_flush(member);
+    return 1;
+}
+
+/**
+ * Accoda MSG_ROOM_END: a coda vuota il socket torna al processo di sessione
+ * @param member Il partecipante
+ * @param frame Il frame di fine
+ */
+static void member_finish(RoomMember* member, RoomFrame* frame) {
+    if (member->room >= 0) {
+        lock_shared_state();
+        shared_state->rooms[member->room].members--;
+        unlock_shared_state();
+    }
+    member->closing = 1;
+    member_send(member, frame);
+}
+
+/**
+ * Invia a un solo partecipante un messaggio che lo riguarda
+ * @param member Il partecipante
+ * @param type Il tipo del messaggio
+ * @param data Il payload
+ * @param finish 1 se è il messaggio di fine (MSG_ROOM_END o MSG_RANK_END)
+ */
+static void member_message(RoomMember* member, const char* type, const char* data, int finish) {
+    RoomFrame* frame = frame_encode(type, data);
+    if (frame == NULL) {
+        member_drop(member, "messaggio non codificato", 1);
+        return;
+    }
+    if (finish) {
+        member_finish(member, frame);
+    } else {
+        member_send(member, frame);
+    }
+    metrics_room_broadcast(1);
+    frame_release(frame);
+}
+
+/**
+ * Restituisce una voce libera per un nuovo partecipante, raddoppiando la tabella se è piena
+ * (la tabella non è limitata dal numero di giocatori: crescono solo i posti in uso)
+ *
+ * @return La voce, NULL se la memoria non è sufficiente
+ */
+static RoomMember* member_alloc(void) {
+    for (int i = 0; i < members_capacity; i++) {
+        if (members[i].fd < 0) {
+            return &members[i];
+        }
+    }
+
+    int capacity = members_capacity > 0 ? members_capacity * 2 : ROOM_MEMBERS_INITIAL;
+    RoomMember* grown = realloc(members, capacity * sizeof(RoomMember));
+    if (grown == NULL) {
+        return NULL;
+    }
+    members = grown;
+    struct pollfd* fds = realloc(poll_fds, (capacity + 1) * sizeof(struct pollfd));
+    if (fds != NULL) {
+        poll_fds = fds;
+    }
+    int* index = realloc(poll_members, (capacity + 1) * sizeof(int));
+    if (index != NULL) {
+        poll_members = index;
+    }
+    if (fds == NULL || index == NULL) {
+        return NULL;
+    }
+
+    for (int i = members_capacity; i < capacity; i++) {
+        members[i].fd = -1;
+    }
+    RoomMember* member = &members[members_capacity];
+    members_capacity = capacity;
+    return member;
+}
+
+/**
+ * Invia lo stesso frame a tutti i partecipanti di una stanza
+ * @param room La stanza
+ * @param frame Il frame, codificato una sola volta
+ * @param finish 1 se è il messaggio di fine dell'evento
+ * @return I partecipanti a cui è stato accodato
+ */
+static int room_broadcast(int room, RoomFrame* frame, int finish) {
+    int recipients = 0;
+    if (frame == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < members_capacity; i++) {
+        RoomMember* member = &members[i];
+        if (member->fd < 0 || member->room != room || member->closing) {
+            continue;
+        }
+        if (finish) {
+            member_finish(member, frame);
+            recipients++;
+        } else {
+            recipients += member_send(member, frame);
+        }
+    }
+    metrics_room_broadcast(recipients);
+    return recipients;
+}
+
+/**
+ * Apre l'attesa dei partecipanti di una stanza, caricando le domande del tema
+ * @param room La stanza
+ * @return 0 se successo, -1 se il quiz del tema non è disponibile
+ */
+static int room_open(int room) {
+    // Il catalogo ricaricato vale per i nuovi eventi
+    int generation = __atomic_load_n(&shared_state->catalog_generation, __ATOMIC_ACQUIRE);
+    if (generation != catalog_generation) {
+        init_themes();
+        catalog_generation = generation;
+    }
+
+    char filename[CONFIG_VALUE_LEN + MAX_THEME_LEN + 8];
+    if (room >= themes_count) {
+        return -1;
+    }
+    quiz_path(filename, sizeof(filename), theme[room]);
+    if (load_quiz(filename, &quizzes[room]) <= 0) {
+        LOG_ERROR("Stanza %s: impossibile caricare il quiz", theme[room]);
+        return -1;
+    }
+
+    lock_shared_state();
+    Room* state = &shared_state->rooms[room];
+    state->phase = ROOM_LOBBY;
+    state->question = 0;
+    state->questions = quizzes[room].count;
+    state->answered = 0;
+    state->correct = 0;
+    unlock_shared_state();
+
+    deadlines[room] = clock_now_ns() / 1000000 + ROOM_LOBBY_SEC * 1000;
+    LOG_INFO("Stanza %s: attesa dei partecipanti per %d secondi", theme[room], ROOM_LOBBY_SEC);
+    return 0;
+}
+
+/**
+ * Pone una domanda a tutti i partecipanti
+ * @param room La stanza
+ * @param index La domanda
+ * @param now L'istante corrente in ms
+ */
+static void room_ask(int room, int index, uint64_t now) {
+    Question* question = &quizzes[room].questions[index];
+    Room* state = &shared_state->rooms[room];
+
+    // Solo questo processo scrive la domanda: i processi di sessione la leggono senza lock
+    // e scartano la copia se la sequenza è dispari o cambiata (vedi room_answer)
+    __atomic_add_fetch(&state->asked, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    state->question = index;
+    snprintf(state->answer, sizeof(state->answer), "%s", question->correct_answer);
+    __atomic_store_n(&state->phase, ROOM_QUESTION, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&state->asked, 1, __ATOMIC_RELEASE);
+    room_answered[room] = 0;
+    room_correct[room] = 0;
+
+    char data[MAX_MSG_LEN];
+    snprintf(data, sizeof(data), "Domanda %d di %d (%d secondi): %s", index + 1, state->questions,
+             ROOM_QUESTION_SEC, question->question);
+    open_questions[room] = frame_encode(MSG_ROOM_QUESTION, data);
+    int recipients = room_broadcast(room, open_questions[room], 0);
+    deadlines[room] = now + ROOM_QUESTION_SEC * 1000;
+    LOG_INFO("Stanza %s: domanda %d inviata a %d partecipanti", theme[room], index + 1, recipients);
+}
+
+/**
+ * Conta le risposte annotate dai processi di sessione nei posti dei partecipanti di una stanza
+ * I posti sono letti senza lock; ogni risposta è contata una sola volta, nello stato locale
+ *
+ * @param room La stanza
+ * @param close 1 alla chiusura della domanda: i posti senza risposta non ne accettano più
+ */
+static void room_collect(int room, int close) {
+    int asked = shared_state->rooms[room].asked;
+    for (int i = 0; i < members_capacity; i++) {
+        RoomMember* member = &members[i];
+        if (member->fd < 0 || member->room != room || member->counted == asked) {
+            continue;
+        }
+        RoomSeat* entry = &shared_state->room_seats[member->seat];
+        int answered = __atomic_load_n(&entry->answered_question, __ATOMIC_ACQUIRE);
+        // Una risposta registrata durante la chiusura fa fallire il confronto e viene contata
+        if (close && answered != asked &&
+            __atomic_compare_exchange_n(&entry->answered_question, &answered, asked + 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        if (answered == asked) {
+            member->counted = asked;
+            room_answered[room]++;
+            room_correct[room] += __atomic_load_n(&entry->answer_correct, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * Chiude la domanda aperta e invia a tutti la risposta corretta e le risposte aggregate
+ * @param room La stanza
+ * @param now L'istante corrente in ms
+ */
+static void room_reveal(int room, uint64_t now) {
+    Room* state = &shared_state->rooms[room];
+    int answered, correct, participants;
+
+    __atomic_store_n(&state->phase, ROOM_RESULT, __ATOMIC_RELAXED);
+    room_collect(room, 1);
+    answered = room_answered[room];
+    correct = room_correct[room];
+
+    // Un solo aggiornamento dello stato condiviso per domanda
+    lock_shared_state();
+    state->answered = answered;
+    state->correct = correct;
+    participants = state->members;
+    unlock_shared_state();
+
+    frame_release(open_questions[room]);
+    open_questions[room] = NULL;
+
+    char data[MAX_MSG_LEN];
+    snprintf(data, sizeof(data), "Risposta corretta: %s (%d corrette su %d risposte, %d partecipanti)",
+             state->answer, correct, answered, participants);
+    RoomFrame* frame = frame_encode(MSG_ROOM_RESULT, data);
+    room_broadcast(room, frame, 0);
+    frame_release(frame);
+
+    deadlines[room] = now + ROOM_RESULT_SEC * 1000;
+    LOG_INFO("Stanza %s: domanda %d, %d corrette su %d risposte", theme[room], state->question + 1,
+             correct, answered);
+}
+
+/**
+ * Conclude l'evento di una stanza: tutti i partecipanti ricevono MSG_ROOM_END
+ * @param room La stanza
+ * @param reason Il payload del messaggio di fine
+ */
+static void room_end(int room, const char* reason) {
+    frame_release(open_questions[room]);
+    open_questions[room] = NULL;
+
+    RoomFrame* frame = frame_encode(MSG_ROOM_END, reason);
+    int recipients = room_broadcast(room, frame, 1);
+    frame_release(frame);
+
+    lock_shared_state();
+    shared_state->rooms[room].phase = ROOM_IDLE;
+    unlock_shared_state();
+    LOG_INFO("Stanza %s: evento concluso (%d partecipanti)", theme[room], recipients);
+}
+
+/**
+ * Fa avanzare l'orologio di una stanza
+ * @param room La stanza
+ * @param now L'istante corrente in ms
+ */
+static void room_clock(int room, uint64_t now) {
+    Room* state = &shared_state->rooms[room];
+    int phase = state->phase;
+
+    if (phase == ROOM_IDLE) {
+        return;
+    }
+    if (__atomic_load_n(&state->members, __ATOMIC_RELAXED) <= 0) {
+        room_end(room, "Nessun partecipante");
+        return;
+    }
+
+    if (phase == ROOM_LOBBY && now >= deadlines[room]) {
+        room_ask(room, 0, now);
+    } else if (phase == ROOM_QUESTION) {
+        room_collect(room, 0);
+        // Tutti hanno risposto: non serve attendere la scadenza
+        if (now >= deadlines[room] || room_answered[room] >= state->members) {
+            room_reveal(room, now);
+        }
+    } else if (phase == ROOM_RESULT && now >= deadlines[room]) {
+        if (state->question + 1 < state->questions) {
+            room_ask(room, state->question + 1, now);
+        } else {
+            char data[MAX_MSG_LEN];
+            snprintf(data, sizeof(data), "Evento concluso: %d domande", state->questions);
+            room_end(room, data);
+        }
+    }
+}
+
+/**
+ * Codifica le righe della classifica di un tema che differiscono dalla base
+ * Payload: "tema righe" seguito da " posizione:nickname:punti:completato" per ogni riga cambiata;
+ * le righe non elencate restano quelle dell'aggiornamento precedente
+ *
+ * @param theme_num Il tema
+ * @param base Le righe già inviate, NULL per inviarle tutte
+ * @param base_count Il numero di righe già inviate
+ * @param rows Le righe correnti
+ * @param count Il numero di righe correnti
+ * @return Il frame, NULL se nessuna riga è cambiata (o in caso di errore)
+ */
+static RoomFrame* rank_encode(int theme_num, const LeaderboardRow* base, int base_count,
+                              const LeaderboardRow* rows, int count) {
+    char data[MAX_MSG_LEN];
+    int len = snprintf(data, sizeof(data), "%d %d", theme_num, count);
+    int changed = base == NULL || count != base_count;
+
+    for (int i = 0; i < count; i++) {
+        if (base != NULL && i < base_count && rows[i].score == base[i].score &&
+            rows[i].completed == base[i].completed && strcmp(rows[i].nickname, base[i].nickname) == 0) {
+            continue;
+        }
+        // RANK_PUSH_ROWS righe da al più ~50 byte stanno sempre in un messaggio
+        len += snprintf(data + len, sizeof(data) - len, " %d:%s:%d:%d", i + 1, rows[i].nickname,
+                        rows[i].score, rows[i].completed);
+        changed = 1;
+    }
+    return changed ? frame_encode(MSG_RANK, data) : NULL;
+}
+
+/**
+ * Allinea la base di una classifica alla classifica globale
+ * @param theme_num Il tema
+ * @param rows Output: le righe correnti
+ * @return Il numero di righe correnti
+ */
+static int rank_collect(int theme_num, LeaderboardRow* rows) {
+    // La generazione si legge prima delle righe: una modifica concorrente produrrà un altro aggiornamento
+    rank_generation[theme_num] = __atomic_load_n(&shared_state->board_generation[theme_num], __ATOMIC_ACQUIRE);
+    return board_collect(theme_num, rows, RANK_PUSH_ROWS);
+}
+
+/**
+ * Accoda a un iscritto la classifica intera dei temi indicati, così come l'hanno ricevuta gli altri
+ * @param member L'iscritto
+ * @param themes I temi
+ * @return 1 se accodata, 0 se l'iscritto è stato rimosso
+ */
+static int rank_snapshot(RoomMember* member, int themes) {
+    for (int theme_num = 0; theme_num < MAX_THEMES; theme_num++) {
+        if (!(themes & (1 << theme_num))) {
+            continue;
+        }
+        RoomFrame* frame = rank_encode(theme_num, NULL, 0, ranks[theme_num], rank_count[theme_num]);
+        if (frame == NULL) {
+            member_drop(member, "messaggio non codificato", 1);
+            return 0;
+        }
+        int queued = member_queue(member, frame);
+        frame_release(frame);
+        if (!queued) {
+            return 0;
+        }
+        metrics_rank_push(1);
+    }
+    return 1;
+}
+
+/**
+ * Applica rank_policy agli aggiornamenti che un iscritto oltre la soglia alta non può ricevere
+ * @param member L'iscritto
+ * @param missed I temi modificati che l'iscritto segue
+ */
+static void rank_congested(RoomMember* member, int missed) {
+    if (missed == 0) {
+        return;
+    }
+    switch (rank_policy) {
+        case RANK_POLICY_COALESCE:
+            // Appena la coda scende sotto la soglia bassa riceve la classifica intera dei temi persi
+            member->resync |= missed;
+            metrics_push_skipped(__builtin_popcount(missed), 1);
+            break;
+        case RANK_POLICY_DROP:
+            metrics_push_skipped(__builtin_popcount(missed), 0);
+            break;
+        case RANK_POLICY_DISCONNECT:
+            metrics_slow_consumer();
+            member_drop(member, "troppo lento", 1);
+            break;
+    }
+}
+
+/**
+ * Invia agli iscritti le modifiche delle classifiche avvenute nell'ultimo intervallo
+ * - per ogni tema modificato le righe cambiate sono codificate una sola volta, qualunque sia il
+ *   numero di save_score dell'intervallo e di iscritti
+ * - ogni iscritto riceve gli aggiornamenti di tutti i suoi temi con una sola sendmsg
+ * - un iscritto che non legge non accumula aggiornamenti oltre ROOM_MEMBER_HIGH_WATER: gli
+ *   aggiornamenti successivi seguono rank_policy (vedi rank_congested)
+ *
+ * @param now L'istante corrente in ms
+ */
+static void rank_push(uint64_t now) {
+    if (now < next_rank_push) {
+        return;
+    }
+    next_rank_push = now + RANK_PUSH_INTERVAL_MS;
+
+    RoomFrame* frames[MAX_THEMES] = { NULL };
+    int changed = 0;
+    for (int theme_num = 0; theme_num < MAX_THEMES; theme_num++) {
+        int generation = __atomic_load_n(&shared_state->board_generation[theme_num], __ATOMIC_ACQUIRE);
+        if (subscribers[theme_num] <= 0 || generation == rank_generation[theme_num]) {
+            continue;
+        }
+        LeaderboardRow rows[RANK_PUSH_ROWS];
+        int count = rank_collect(theme_num, rows);
+        frames[theme_num] = rank_encode(theme_num, ranks[theme_num], rank_count[theme_num], rows, count);
+        memcpy(ranks[theme_num], rows, sizeof(rows));
+        rank_count[theme_num] = count;
+        if (frames[theme_num] != NULL) {
+            changed |= 1 << theme_num;
+        }
+    }
+
+    int recipients[MAX_THEMES] = { 0 };
+    for (int i = 0; i < members_capacity; i++) {
+        RoomMember* member = &members[i];
+        if (member->fd < 0 || member->room >= 0 || member->closing) {
+            continue;
+        }
+        if (member->congested) {
+            rank_congested(member, member->themes & changed);
+            continue;
+        }
+        if (member->resync != 0 && !rank_snapshot(member, member->resync)) {
+            continue;
+        }
+        int pending = member->themes & changed & ~member->resync;
+        member->resync = 0;
+        for (int theme_num = 0; theme_num < MAX_THEMES && member->fd >= 0; theme_num++) {
+            if ((pending & (1 << theme_num)) && member_queue(member, frames[theme_num])) {
+                recipients[theme_num]++;
+            }
+        }
+        member_flush(member);
+    }
+
+    for (int theme_num = 0; theme_num < MAX_THEMES; theme_num++) {
+        if (frames[theme_num] != NULL) {
+            metrics_rank_push(recipients[theme_num]);
+            frame_release(frames[theme_num]);
+        }
+    }
+}
+
+/**
+ * Accoglie un iscritto alle classifiche: riceve subito la classifica intera di ogni tema seguito
+ * @param member L'iscritto
+ */
+static void rank_subscribe(RoomMember* member) {
+    int count = 0;
+    for (int theme_num = 0; theme_num < MAX_THEMES; theme_num++) {
+        if (!(member->themes & (1 << theme_num))) {
+            continue;
+        }
+        // Il primo iscritto di un tema aggiorna la base; gli altri la ricevono com'è e
+        // si allineano con il prossimo aggiornamento
+        if (subscribers[theme_num]++ == 0) {
+            rank_count[theme_num] = rank_collect(theme_num, ranks[theme_num]);
+        }
+        count++;
+    }
+    LOG_INFO("Classifiche: %s segue %d temi", member->nickname, count);
+    if (rank_snapshot(member, member->themes)) {
+        member_flush(member);
+    }
+}
+
+/**
+ * Accoglie un partecipante: riceve il socket del client dal processo di sessione,
+ * conferma il posto e gli invia lo stato della stanza
+ */
+static void room_accept(void) {
+    RoomJoin join;
+    int fd;
+    ssize_t n = transport_recv_fd(channel[0], &fd, &join, sizeof(join));
+    if (n <= 0 || fd < 0) {
+        return;
+    }
+    int subscription = join.room < 0;
+    if (n != sizeof(join) || join.seat < 0 || join.seat >= MAX_CLIENTS || join.room >= MAX_THEMES ||
+        (subscription && (join.themes <= 0 || join.themes >= 1 << MAX_THEMES))) {
+        close(fd);
+        return;
+    }
+    join.nickname[MAX_NICKNAME_LEN - 1] = '\0';
+
+    RoomMember* member = member_alloc();
+
+    Room* state = subscription ? NULL : &shared_state->rooms[join.room];
+    int opened = member != NULL && (subscription || state->phase != ROOM_IDLE || room_open(join.room) == 0);
+
+    // Il processo di sessione può aver già rinunciato (posto libero o riassegnato)
+    int accepted = 0;
+    lock_shared_state();
+    RoomSeat* entry = &shared_state->room_seats[join.seat];
+    if (entry->state == SEAT_JOINING && entry->pid == join.pid) {
+        if (opened) {
+            __atomic_store_n(&entry->state, SEAT_MEMBER, __ATOMIC_RELEASE);
+            if (!subscription) {
+                state->members++;
+            }
+            accepted = 1;
+        } else {
+            entry->pid = 0;
+            __atomic_store_n(&entry->state, SEAT_FREE, __ATOMIC_RELEASE);
+        }
+    }
+    int participants = subscription ? 0 : state->members;
+    unlock_shared_state();
+    if (!accepted) {
+        close(fd);
+        return;
+    }
+
+    memset(member, 0, sizeof(*member));
+    member->fd = fd;
+    member->seat = join.seat;
+    member->room = join.room;
+    snprintf(member->nickname, sizeof(member->nickname), "%s", join.nickname);
+    if (subscription) {
+        member->themes = join.themes;
+        rank_subscribe(member);
+        return;
+    }
+    LOG_INFO("Stanza %s: entra %s (%d partecipanti)", theme[join.room], member->nickname, participants);
+
+    char data[MAX_MSG_LEN];
+    if (state->phase == ROOM_LOBBY) {
+        // Tutti i partecipanti in attesa vedono il nuovo numero
+        int seconds = (int)((deadlines[join.room] - clock_now_ns() / 1000000 + 999) / 1000);
+        snprintf(data, sizeof(data), "Stanza %s: %d partecipanti, inizio tra %d secondi",
+                 theme[join.room], participants, seconds);
+        RoomFrame* frame = frame_encode(MSG_ROOM_WAIT, data);
+        room_broadcast(join.room, frame, 0);
+        frame_release(frame);
+    } else {
+        snprintf(data, sizeof(data), "Stanza %s: evento in corso, domanda %d di %d",
+                 theme[join.room], state->question + 1, state->questions);
+        member_message(member, MSG_ROOM_WAIT, data, 0);
+        if (member->fd >= 0 && open_questions[join.room] != NULL) {
+            // Chi entra a domanda aperta riceve lo stesso frame già inviato agli altri
+            member_send(member, open_questions[join.room]);
+        }
+    }
+}
+
+/**
+ * Prepara lo stato delle stanze all'avvio del processo: i posti di un processo precedente
+ * (terminato o sostituito) non hanno più un socket e tornano liberi
+ */
+void room_worker_init(void) {
+    lock_shared_state();
+    memset(shared_state->rooms, 0, sizeof(shared_state->rooms));
+    memset(shared_state->room_seats, 0, sizeof(shared_state->room_seats));
+    unlock_shared_state();
+    catalog_generation = __atomic_load_n(&shared_state->catalog_generation, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Un passo del processo delle stanze: ingressi, invii in sospeso, uscite e orologi
+ * @param timeout_ms Attesa massima di un evento sui socket
+ */
+void room_worker_poll(int timeout_ms) {
+    struct pollfd channel_fd = { channel[0], POLLIN, 0 };
+    struct pollfd* fds = poll_fds != NULL ? poll_fds : &channel_fd;
+    int* index = poll_members;
+    int count = 1;
+
+    fds[0] = channel_fd;
+    for (int i = 0; i < members_capacity; i++) {
+        if (members[i].fd >= 0) {
+            fds[count].fd = members[i].fd;
+            // Il processo di sessione legge il socket: qui interessano solo chiusura e spazio di invio
+            fds[count].events = POLLRDHUP | (members[i].count > 0 ? POLLOUT : 0);
+            index[count++] = i;
+        }
+    }
+
+    if (poll(fds, count, timeout_ms) > 0) {
+        // Prima i partecipanti: un ingresso potrebbe riusare il numero di un socket appena chiuso
+        for (int i = 1; i < count; i++) {
+            RoomMember* member = &members[index[i]];
+            if (member->fd != fds[i].fd) {
+                continue;
+            }
+            if (fds[i].revents & (POLLRDHUP | POLLHUP | POLLERR)) {
+                member_drop(member, "connessione chiusa", 0);
+            } else if (fds[i].revents & POLLOUT) {
+                member_flush(member);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            room_accept();
+        }
+    }
+
+    // Uscite richieste dai processi di sessione
+    for (int i = 0; i < members_capacity; i++) {
+        RoomMember* member = &members[i];
+        if (member->fd >= 0 && !member->closing &&
+            __atomic_load_n(&shared_state->room_seats[member->seat].leaving, __ATOMIC_RELAXED)) {
+            if (member->room >= 0) {
+                member_message(member, MSG_ROOM_END, "Uscita dalla stanza", 1);
+            } else {
+                member_message(member, MSG_RANK_END, "Fine degli aggiornamenti", 1);
+            }
+        }
+    }
+
+    uint64_t now = clock_now_ns() / 1000000;
+    for (int room = 0; room < MAX_THEMES; room++) {
+        room_clock(room, now);
+    }
+    rank_push(now);
+}
+
+/**
+ * Chiude le stanze all'arresto del processo: i partecipanti ricevono MSG_ROOM_END e gli iscritti
+ * MSG_RANK_END (se il socket lo accetta subito), e tutti i socket tornano ai processi di sessione
+ */
+void room_worker_shutdown(void) {
+    for (int room = 0; room < MAX_THEMES; room++) {
+        if (shared_state->rooms[room].phase != ROOM_IDLE) {
+            room_end(room, "Stanze chiuse dal server");
+        }
+    }
+    for (int i = 0; i < members_capacity; i++) {
+        if (members[i].fd >= 0 && members[i].room < 0 && !members[i].closing) {
+            member_message(&members[i], MSG_RANK_END, "Classifiche chiuse dal server", 1);
+        }
+    }
+    for (int i = 0; i < members_capacity; i++) {
+        if (members[i].fd >= 0) {
+            member_release(&members[i]);
+        }
+    }
+    room_channel_close(ROOM_ROLE_NONE);
+}
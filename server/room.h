@@ -0,0 +1,69 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include "server.h"
+
+/*
+ * Stanze dal vivo: tutti i partecipanti rispondono alla stessa domanda nello stesso momento
+ * - una stanza per tema; il primo ingresso apre l'attesa dei partecipanti, poi l'orologio
+ *   della stanza pone le domande a tempo a tutti i partecipanti insieme
+ * - il processo di sessione passa il socket del client al processo delle stanze (SCM_RIGHTS):
+ *   da lì fino a MSG_ROOM_END scrive sul socket solo il processo delle stanze, mentre il
+ *   processo di sessione continua a ricevere le risposte e ne annota l'esito nel proprio posto,
+ *   senza lock; il processo delle stanze le conta e pubblica il totale alla chiusura della domanda
+ * - ogni messaggio della stanza è codificato una sola volta in un frame con contatore di
+ *   riferimenti, accodato a tutti i partecipanti e inviato con una sola sendmsg per
+ *   partecipante (i frame ancora in coda partono insieme)
+ *
+ * Lo stesso processo invia agli iscritti gli aggiornamenti delle classifiche dei temi seguiti:
+ * save_score incrementa la generazione della classifica del tema e ogni RANK_PUSH_INTERVAL_MS
+ * le righe cambiate (delle prime RANK_PUSH_ROWS) partono in un solo frame per tema, condiviso
+ * da tutti gli iscritti: al più un aggiornamento per iscritto e per intervallo
+ */
+
+#define ROOM_LOBBY_SEC 10           // Attesa dei partecipanti prima della prima domanda
+#define ROOM_QUESTION_SEC 20        // Tempo per rispondere a una domanda
+#define ROOM_RESULT_SEC 3           // Pausa tra il risultato e la domanda successiva
+#define ROOM_TICK_MS 100            // Risoluzione dell'orologio delle stanze
+#define ROOM_JOIN_WAIT_MS 2000      // Attesa massima della conferma di ingresso o di uscita
+#define ROOM_MEMBERS_INITIAL 16     // Voci iniziali della tabella dei partecipanti (raddoppia quando è piena)
+#define ROOM_MEMBER_QUEUE 16        // Frame in attesa di invio per partecipante: oltre, il client è troppo lento
+#define ROOM_MEMBER_HIGH_WATER 4096 // Byte non letti oltre i quali un iscritto non riceve aggiornamenti (vedi RankPolicy)
+#define ROOM_MEMBER_LOW_WATER 1024  // Byte non letti a cui l'iscritto torna a ricevere aggiornamenti
+#define RANK_PUSH_INTERVAL_MS 1000  // Intervallo minimo tra due aggiornamenti delle classifiche
+
+// Trattamento degli aggiornamenti delle classifiche per un iscritto oltre la soglia alta
+// (i messaggi delle stanze non si scartano mai: oltre ROOM_MEMBER_QUEUE il client viene disconnesso)
+typedef enum {
+    RANK_POLICY_COALESCE,   // Gli aggiornamenti persi diventano la classifica intera quando la coda scende
+    RANK_POLICY_DROP,       // Gli aggiornamenti persi sono scartati: le righe restano vecchie fino alla modifica successiva
+    RANK_POLICY_DISCONNECT  // L'iscritto viene disconnesso (la sessione resta riprendibile)
+} RankPolicy;
+
+// Estremi del canale tra i processi di sessione e il processo delle stanze
+typedef enum {
+    ROOM_ROLE_NONE,     // Nessuno dei due: il processo chiude il canale
+    ROOM_ROLE_SESSION,  // Invia i socket dei client
+    ROOM_ROLE_WORKER    // Riceve i socket dei client
+} RoomRole;
+
+// Processo principale e processi figli
+int room_channel_open(void);
+int room_parse_policy(const char* name);
+void room_set_policy(RankPolicy policy);
+void room_channel_close(RoomRole role);
+void room_reclaim(pid_t pid);
+
+// Processo di sessione
+int room_join(int room, int client_socket, const char* nickname);
+int room_subscribe(int themes, int client_socket, const char* nickname);
+int room_answer(int seat, const char* answer);
+void room_leave(int seat, int wait);
+int room_released(int seat);
+
+// Processo delle stanze
+void room_worker_init(void);
+void room_worker_poll(int timeout_ms);
+void room_worker_shutdown(void);
+
+#endif
@@ -1,15 +1,49 @@
 #include <sys/shm.h>
 #include <sys/ipc.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <netinet/tcp.h>
 #include "server.h"
+#include "persist.h"
+#include "profiles.h"
+#include "session.h"
+#include "quiz.h"
+#include "metrics.h"
+#include "trace.h"
+#include "admin.h"
+#include "supervisor.h"
+#include "room.h"
+#include "ratelimit.h"
+#include "config.h"
+#include "replica.h"
+#include "../shared/transport.h"
 
-extern void print_players_status(void);
-
-// Variabili globali per la memoria condivisa
-ServerState* shared_state = NULL;
-int shm_id = -1;
-int sem_id = -1;  // Semaforo per sincronizzazione
 int server_socket = -1;
+static const char* unix_path = NULL; // Socket Unix di ascolto (unix_socket, opzione -U), NULL per TCP
+static const char* metrics_address = NULL; // Porta o socket Unix delle metriche (metrics, opzione -m)
+static const char* admin_path = ADMIN_SOCKET_PATH; // Socket del canale di amministrazione (admin_socket, opzione -A)
+static char handed_unix_path[108]; // Socket Unix di ascolto ricevuto dal vecchio server (opzione -u)
+static int upgrade_socket = -1; // Richieste di aggiornamento a caldo da un nuovo binario
+static int metrics_socket = -1; // Ascolto delle metriche, tenuto aperto per riavviare il processo
+static int admin_socket = -1;   // Ascolto del canale di amministrazione, idem
+static int replica_socket = -1; // Ascolto degli aggiornamenti dei peer, idem
+
+// Processi di servizio avviati dal processo principale
+static pid_t background_pid = -1;
+static pid_t metrics_pid = -1;
+static pid_t admin_pid = -1;
+static pid_t room_pid = -1;
+static pid_t replica_pid = -1;
+static int worker_restarts[PROCESS_REPLICA + 1]; // Riavvii dopo una terminazione anomala, per tipo
+
+static void close_service_sockets(int keep);
+static void reap_children(int restart);
+static void wait_workers(void);
+
+// Richieste del canale di amministrazione al processo principale (vedi admin.h)
+static volatile sig_atomic_t drain_pending = 0;
+static volatile sig_atomic_t reload_pending = 0;
 
 /**
  * Gestore di segnali per il processo server principale
@@ -24,7 +58,23 @@ void signal_handler(int sig) {
         if (server_socket >= 0) {
             close(server_socket);
         }
-        // Le risorse IPC (semafori e memoria condivisa) vengono rilasciate automaticamente alla terminazione
+        if (unix_path) {
+            unlink(unix_path);
+        }
+        if (metrics_address && !metrics_address_is_port(metrics_address)) {
+            unlink(metrics_address);
+        }
+        if (admin_path) {
+            unlink(admin_path);
+        }
+        if (upgrade_socket >= 0) {
+            unlink(UPGRADE_SOCKET_PATH);
+        }
+        // La memoria condivisa viene distrutta quando l'ultimo processo se ne stacca; il semaforo
+        // resta ai figli ancora attivi e viene sostituito al prossimo avvio (vedi init_semaphore)
+        if (shm_id != -1) {
+            shmctl(shm_id, IPC_RMID, NULL);
+        }
         sleep(2); // Attendi brevemente
         exit(0);
     } else if (sig == SIGPIPE) {
@@ -35,73 +85,474 @@ void signal_handler(int sig) {
 }
 
 /**
- * Acquisisce il lock sulla memoria condivisa usando un semaforo POSIX
- * Implementa l'operazione P (wait) su un semaforo binario
- * Blocca il processo chiamante finché il semaforo non è disponibile
+ * Gestore delle richieste del canale di amministrazione al processo principale
+ * Installato senza SA_RESTART: l'accept in corso si interrompe e il ciclo principale
+ * serve la richiesta subito
  */
-void lock_shared_state() {
-    struct sembuf sem_op;
-    sem_op.sem_num = 0;    // Numero del semaforo (usiamo il primo del set)
-    sem_op.sem_op = -1;    // Operazione P (wait/lock): decrementa il semaforo
-    sem_op.sem_flg = 0;    // Nessun flag speciale (operazione bloccante)
-    
-    if (semop(sem_id, &sem_op, 1) == -1) {
-        perror("Errore lock semaforo");
+static void admin_signal_handler(int sig) {
+    if (sig == ADMIN_DRAIN_SIGNAL) {
+        drain_pending = 1;
+    } else if (sig == ADMIN_RELOAD_SIGNAL) {
+        reload_pending = 1;
     }
 }
 
 /**
- * Rilascia il lock sulla memoria condivisa
- * Implementa l'operazione V (signal) su un semaforo binario
- * Consente ad altri processi in attesa di acquisire il lock
+ * Installa i gestori delle richieste di amministrazione nel processo principale
  */
-void unlock_shared_state() {
-    struct sembuf sem_op;
-    sem_op.sem_num = 0;    // Numero del semaforo
-    sem_op.sem_op = 1;     // Operazione V (signal/unlock): incrementa il semaforo
-    sem_op.sem_flg = 0;    // Nessun flag speciale
-    
-    if (semop(sem_id, &sem_op, 1) == -1) {
-        perror("Errore unlock semaforo");
+static void install_admin_signals(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = admin_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(ADMIN_DRAIN_SIGNAL, &sa, NULL);
+    sigaction(ADMIN_RELOAD_SIGNAL, &sa, NULL);
+}
+
+/**
+ * Nei processi figli le richieste per il processo principale vengono ignorate:
+ * interromperebbero le recv in corso
+ */
+static void ignore_admin_signals(void) {
+    signal(ADMIN_DRAIN_SIGNAL, SIG_IGN);
+    signal(ADMIN_RELOAD_SIGNAL, SIG_IGN);
+}
+
+/**
+ * Ricarica il catalogo dei temi (ADMIN_RELOAD_SIGNAL)
+ * I processi figli già avviati conservano la propria copia: il nuovo catalogo vale
+ * per le sessioni accettate da qui in poi
+ */
+static void reload_catalog(void) {
+    printf("Ricaricamento del catalogo dei temi...\n");
+    init_themes();
+    __atomic_store_n(&shared_state->catalog_themes, themes_count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&shared_state->catalog_generation, 1, __ATOMIC_RELEASE);
+    LOG_INFO("Catalogo dei temi ricaricato: %d temi", themes_count);
+}
+
+/**
+ * Drena il server (ADMIN_DRAIN_SIGNAL): chiude il socket di ascolto, attende la fine
+ * delle sessioni attive e ferma il processo di background, che rende durevoli i punteggi
+ */
+static void drain_server(void) {
+    close(server_socket);
+    server_socket = -1;
+    if (unix_path) {
+        unlink(unix_path);
+    }
+
+    printf("Drenaggio: nessuna nuova connessione, attesa della fine delle sessioni...\n");
+    LOG_INFO("Drenaggio: socket di ascolto chiuso, %lld sessioni attive",
+             (long long)__atomic_load_n(&shared_state->metrics.sessions_active, __ATOMIC_RELAXED));
+    // Le sessioni terminate in modo anomalo vengono recuperate e non bloccano il drenaggio
+    while (__atomic_load_n(&shared_state->metrics.sessions_active, __ATOMIC_RELAXED) > 0) {
+        usleep(200000);
+        reap_children(0);
     }
+
+    LOG_INFO("Drenaggio completato: nessuna sessione attiva");
+    shared_state->server_running = 0;
+    wait_workers();
 }
 
 /**
- * Inizializza il semaforo per la sincronizzazione
- * @return 0 se successo, -1 in caso di errore
+ * Passa il socket di ascolto al nuovo binario che si è connesso al socket di aggiornamento
+ * Dopo l'invio il vecchio server non accetta più connessioni (quelle in coda restano al
+ * socket, ora servito dal nuovo processo), ferma i propri processi di servizio e, quando
+ * sono terminati, dà il via libera al nuovo server, che avvia i suoi
+ *
+ * @param conn La connessione del nuovo binario
+ * @return 0 se il servizio è passato al nuovo server, -1 se il passaggio è fallito
  */
-int init_semaphore() {
-    // Crea il semaforo
-    sem_id = semget(SEM_KEY, 1, IPC_CREAT | 0666);
-    if (sem_id == -1) {
-        perror("Errore creazione semaforo");
+static int hand_off_listener(int conn) {
+    const char* path = unix_path ? unix_path : "";
+    if (transport_send_fd(conn, server_socket, path, strlen(path) + 1) < 0) {
+        perror("Errore invio del socket di ascolto");
+        LOG_ERROR("Aggiornamento a caldo fallito: socket di ascolto non inviato");
+        close(conn);
         return -1;
     }
-    
-    // Inizializza il semaforo a 1 (mutex libero)
-    if (semctl(sem_id, 0, SETVAL, 1) == -1) {
-        perror("Errore inizializzazione semaforo");
-        return -1;
+
+    close(server_socket);
+    server_socket = -1;
+    close(upgrade_socket);
+    upgrade_socket = -1;
+
+    // Socket e percorsi appartengono ora al nuovo server: questo processo non li rimuove più
+    unix_path = NULL;
+    metrics_address = NULL;
+    admin_path = NULL;
+    printf("Socket di ascolto passato al nuovo server, arresto dei processi di servizio...\n");
+    LOG_INFO("Aggiornamento a caldo: socket di ascolto passato al nuovo server");
+
+    // Nessun processo principale in servizio: background, metriche e amministrazione terminano
+    // (e liberano la porta delle metriche, che il nuovo server riapre)
+    shared_state->master_pid = 0;
+    wait_workers();
+    close_service_sockets(-1);
+    room_channel_close(ROOM_ROLE_NONE);
+
+    // Via libera: il nuovo server può aprire i propri socket e avviare i propri processi
+    char ready = 1;
+    if (send(conn, &ready, 1, 0) != 1) {
+        LOG_WARNING("Il nuovo server non ha ricevuto il via libera");
     }
-    
-    LOG_INFO("Semaforo inizializzato con ID: %d", sem_id);
+    close(conn);
     return 0;
 }
+
 /**
- * Rimuove il semaforo dal sistema
- * Deve essere chiamato solo dal processo server principale alla terminazione
- * Tutti i processi che usano questo semaforo devono essere terminati prima
+ * Riceve il socket di ascolto dal server in esecuzione e attende che questo abbia
+ * fermato i propri processi di servizio (opzione -u)
+ *
+ * @return Il socket di ascolto, -1 in caso di errore
  */
-void cleanup_semaphore() {
-    if (sem_id != -1) {
-        // IPC_RMID rimuove il semaforo dal sistema operativo
-        if (semctl(sem_id, 0, IPC_RMID) == -1) {
-            perror("Errore rimozione semaforo");
-        } else {
-            LOG_INFO("Semaforo rimosso con successo");
+static int receive_listener(void) {
+    int conn = transport_unix_connect(UPGRADE_SOCKET_PATH);
+    if (conn < 0) {
+        perror("Errore connessione al server da aggiornare");
+        return -1;
+    }
+
+    int listener;
+    char path[sizeof(handed_unix_path)];
+    if (transport_recv_fd(conn, &listener, path, sizeof(path)) <= 0 || listener < 0) {
+        fprintf(stderr, "Il server in esecuzione non ha passato il socket di ascolto\n");
+        close(conn);
+        return -1;
+    }
+    path[sizeof(path) - 1] = '\0';
+    if (path[0] != '\0') {
+        snprintf(handed_unix_path, sizeof(handed_unix_path), "%s", path);
+        unix_path = handed_unix_path;
+    }
+
+    // Le connessioni che arrivano nel frattempo attendono nella coda del socket
+    struct timeval timeout = { UPGRADE_READY_TIMEOUT_SEC, 0 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char ready = 0;
+    if (recv(conn, &ready, 1, 0) != 1) {
+        fprintf(stderr, "Attenzione: il vecchio server non ha confermato l'arresto dei processi di servizio\n");
+    }
+    close(conn);
+    return listener;
+}
+
+/**
+ * Crea il socket su cui un nuovo binario chiede il passaggio del servizio
+ * Come il canale di amministrazione nasce con i permessi 0600 (umask 0177 durante la bind)
+ *
+ * @return Il file descriptor del socket, -1 in caso di errore
+ */
+static int upgrade_listen(void) {
+    mode_t mask = umask(0177);
+    int fd = transport_unix_listen(UPGRADE_SOCKET_PATH, 1);
+    umask(mask);
+    return fd;
+}
+
+/**
+ * Condizione di servizio dei processi avviati dal processo principale: terminano quando
+ * il server si ferma, il loro processo principale muore o passa il servizio a un nuovo
+ * binario (aggiornamento a caldo)
+ *
+ * @param parent Il processo principale che li ha avviati
+ * @return 1 se il processo deve continuare
+ */
+static int still_serving(pid_t parent) {
+    return shared_state->server_running && getppid() == parent && shared_state->master_pid == parent;
+}
+
+/**
+ * Chiude i socket di ascolto del processo principale ereditati da un processo figlio
+ * @param keep Il socket che il figlio continua a usare, -1 se nessuno
+ */
+static void close_service_sockets(int keep) {
+    int* sockets[] = { &server_socket, &upgrade_socket, &metrics_socket, &admin_socket, &replica_socket };
+    for (size_t i = 0; i < sizeof(sockets) / sizeof(sockets[0]); i++) {
+        if (*sockets[i] >= 0 && *sockets[i] != keep) {
+            close(*sockets[i]);
+            *sockets[i] = -1;
+        }
+    }
+}
+
+/**
+ * Crea un processo figlio registrandolo nella tabella dei processi (vedi supervisor.h)
+ * Nel figlio i gestori di segnali del processo principale tornano a quelli predefiniti
+ *
+ * @param kind Il tipo di processo
+ * @return Come fork: 0 nel figlio, il pid del figlio nel padre, -1 in caso di errore
+ *         (errno EAGAIN se la tabella dei processi è piena)
+ */
+static pid_t fork_process(ProcessKind kind) {
+    // Svuota i buffer del logger e di stdout: il figlio non deve ereditare record già accodati
+    flush_logger();
+    fflush(stdout);
+
+    int index = process_reserve(kind);
+    if (index < 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        process_enter(index);
+        signal(SIGCHLD, SIG_DFL);
+        ignore_admin_signals();
+        room_channel_close(kind == PROCESS_SESSION ? ROOM_ROLE_SESSION :
+                           kind == PROCESS_ROOM ? ROOM_ROLE_WORKER : ROOM_ROLE_NONE);
+    } else if (pid > 0) {
+        process_started(index, pid);
+    } else {
+        process_release(index);
+    }
+    return pid;
+}
+
+/**
+ * Avvia il processo di background che si occupa della persistenza dei punteggi
+ * (group commit del WAL e snapshot periodici della classifica), della scadenza delle sessioni
+ * e del riepilogo periodico delle latenze
+ * Il processo termina quando il server si ferma o il processo principale muore,
+ * rendendo durevole la coda del WAL prima di uscire
+ *
+ * @return Il pid del processo di background, -1 in caso di errore
+ */
+static pid_t start_background_worker(void) {
+    pid_t pid = fork_process(PROCESS_BACKGROUND);
+    if (pid != 0) {
+        if (pid < 0) {
+            perror("Errore fork processo di background");
+            LOG_ERROR("Impossibile avviare il processo di background");
+        }
+        return pid;
+    }
+
+    // Processo di background: non serve alcun socket di ascolto
+    close_service_sockets(-1);
+
+    // Ctrl+C arriva a tutto il gruppo di processi: la chiusura la decide il processo principale
+    signal(SIGINT, SIG_IGN);
+
+    pid_t parent = getppid();
+    int ticks = 0;
+    while (still_serving(parent)) {
+        usleep(WAL_SYNC_INTERVAL_MS * 1000);
+        persist_tick();
+        profiles_maintain();
+
+        // Circa una volta al secondo: scrittura asincrona dell'archivio dei profili
+        // e rilascio delle sessioni disconnesse oltre il tempo di ripresa
+        if (++ticks % (1000 / WAL_SYNC_INTERVAL_MS) == 0) {
+            profiles_sync();
+            sessions_expire();
+        }
+        if (ticks % (METRICS_REPORT_INTERVAL_SEC * 1000 / WAL_SYNC_INTERVAL_MS) == 0) {
+            metrics_log_summary();
+        }
+    }
+
+    persist_tick();
+    persist_shutdown();
+    profiles_sync();
+    metrics_log_summary();
+    exit(0);
+}
+
+/**
+ * Avvia il processo che espone le metriche in formato Prometheus
+ * Serve una richiesta alla volta leggendo solo i contatori atomici in memoria condivisa:
+ * lo scraping non acquisisce mai il lock dello stato e non rallenta le sessioni
+ *
+ * @return Il pid del processo delle metriche, -1 in caso di errore
+ */
+static pid_t start_metrics_worker(void) {
+    pid_t pid = fork_process(PROCESS_METRICS);
+    if (pid != 0) {
+        if (pid < 0) {
+            perror("Errore fork processo delle metriche");
+            LOG_ERROR("Impossibile avviare il processo delle metriche");
+        }
+        return pid;
+    }
+
+    close_service_sockets(metrics_socket);
+    signal(SIGINT, SIG_IGN);
+
+    pid_t parent = getppid();
+    while (still_serving(parent)) {
+        // Attesa limitata: il processo si accorge della chiusura del server entro un secondo
+        struct pollfd pfd = { metrics_socket, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+        int client_fd = accept(metrics_socket, NULL, NULL);
+        if (client_fd >= 0) {
+            metrics_serve(client_fd);
+        }
+    }
+    close(metrics_socket);
+    exit(0);
+}
+
+/**
+ * Avvia il processo che serve il canale di amministrazione (vedi admin.h)
+ * I comandi sono serviti uno alla volta, fuori dai processi che servono le partite;
+ * il processo acquisisce il lock dello stato solo per brevi copie
+ *
+ * @return Il pid del processo di amministrazione, -1 in caso di errore
+ */
+static pid_t start_admin_worker(void) {
+    pid_t pid = fork_process(PROCESS_ADMIN);
+    if (pid != 0) {
+        if (pid < 0) {
+            perror("Errore fork processo di amministrazione");
+            LOG_ERROR("Impossibile avviare il processo di amministrazione");
+        }
+        return pid;
+    }
+
+    close_service_sockets(admin_socket);
+    signal(SIGINT, SIG_IGN);
+
+    pid_t parent = getppid();
+    while (still_serving(parent)) {
+        struct pollfd pfd = { admin_socket, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+        int client_fd = accept(admin_socket, NULL, NULL);
+        if (client_fd >= 0) {
+            admin_serve(client_fd);
+        }
+    }
+    close(admin_socket);
+    exit(0);
+}
+
+/**
+ * Avvia il processo delle stanze dal vivo (vedi room.h): riceve dai processi di sessione
+ * i socket dei partecipanti, fa avanzare gli orologi delle stanze e invia a tutti i
+ * partecipanti ogni messaggio codificato una sola volta
+ *
+ * @return Il pid del processo delle stanze, -1 in caso di errore
+ */
+static pid_t start_room_worker(void) {
+    pid_t pid = fork_process(PROCESS_ROOM);
+    if (pid != 0) {
+        if (pid < 0) {
+            perror("Errore fork processo delle stanze");
+            LOG_ERROR("Impossibile avviare il processo delle stanze");
+        }
+        return pid;
+    }
+
+    close_service_sockets(-1);
+    signal(SIGINT, SIG_IGN);
+
+    pid_t parent = getppid();
+    room_worker_init();
+    while (still_serving(parent)) {
+        room_worker_poll(ROOM_TICK_MS);
+    }
+    room_worker_shutdown();
+    exit(0);
+}
+
+/**
+ * Avvia il processo che replica la classifica globale verso gli altri nodi (vedi replica.h):
+ * invia ai peer i registri modificati e unisce nella classifica locale quelli ricevuti
+ *
+ * @return Il pid del processo di replica, -1 in caso di errore
+ */
+static pid_t start_replica_worker(void) {
+    pid_t pid = fork_process(PROCESS_REPLICA);
+    if (pid != 0) {
+        if (pid < 0) {
+            perror("Errore fork processo di replica");
+            LOG_ERROR("Impossibile avviare il processo di replica");
+        }
+        return pid;
+    }
+
+    close_service_sockets(replica_socket);
+    signal(SIGINT, SIG_IGN);
+
+    pid_t parent = getppid();
+    replica_worker_init(replica_socket);
+    while (still_serving(parent)) {
+        replica_worker_poll(1000);
+    }
+    replica_worker_shutdown();
+    exit(0);
+}
+
+/**
+ * Elabora la terminazione di un figlio: aggiorna la tabella dei processi, recupera la sessione
+ * di un processo terminato in modo anomalo e, se richiesto, riavvia un processo di servizio
+ *
+ * @param pid Il pid del figlio raccolto
+ * @param status Lo stato restituito da waitpid
+ * @param restart 1 per riavviare un processo di servizio terminato mentre il server è in servizio
+ */
+static void child_exited(pid_t pid, int status, int restart) {
+    ProcessKind kind = process_exited(pid, status);
+
+    pid_t* worker = pid == background_pid ? &background_pid
+                  : pid == metrics_pid ? &metrics_pid
+                  : pid == admin_pid ? &admin_pid
+                  : pid == room_pid ? &room_pid
+                  : pid == replica_pid ? &replica_pid : NULL;
+    if (worker == NULL) {
+        return;
+    }
+    *worker = -1;
+    if (!restart || !shared_state->server_running || kind == PROCESS_FREE) {
+        return;
+    }
+    if (++worker_restarts[kind] > WORKER_MAX_RESTARTS) {
+        LOG_ERROR("Processo %s terminato troppe volte: non viene più riavviato", process_kind_name(kind));
+        return;
+    }
+
+    LOG_WARNING("Riavvio del processo %s (%d/%d)", process_kind_name(kind), worker_restarts[kind],
+                WORKER_MAX_RESTARTS);
+    *worker = kind == PROCESS_BACKGROUND ? start_background_worker()
+            : kind == PROCESS_METRICS ? start_metrics_worker()
+            : kind == PROCESS_ADMIN ? start_admin_worker()
+            : kind == PROCESS_ROOM ? start_room_worker() : start_replica_worker();
+}
+
+/**
+ * Raccoglie senza attendere i figli già terminati
+ * @param restart 1 per riavviare i processi di servizio terminati (vedi child_exited)
+ */
+static void reap_children(int restart) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        child_exited(pid, status, restart);
+    }
+}
+
+/**
+ * Attende la terminazione dei processi di servizio, raccogliendo nel frattempo le sessioni
+ * che terminano (server_running o master_pid devono già averne chiesto l'arresto)
+ */
+static void wait_workers(void) {
+    int status;
+    while (background_pid > 0 || metrics_pid > 0 || admin_pid > 0 || room_pid > 0 || replica_pid > 0) {
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid > 0) {
+            child_exited(pid, status, 0);
+        } else if (errno != EINTR) {
+            break;
         }
     }
-}  
+}
 
 /**
  * Funzione di pulizia del server
@@ -123,54 +574,231 @@ void cleanup_server(int status) {
     LOG_INFO("Memoria condivisa rimossa. Server terminato con stato %d", status);
 }
 
-int main(){
-    
+/**
+ * Stampa la sintassi della riga di comando del server
+ * @param prog Il nome del programma
+ */
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [-c file] [-o chiave=valore] [-b] [-l info|warning|error] [-S MB] [-T secondi] [-U percorso] [-m porta|percorso] [-L] [-t N] [-A percorso] [-k] [-u] [-H secondi] [-I secondi] [-M secondi] [-P politica] [-R conn,msg] [-r] [-N porta] [-j host:porta,...]\n", prog);
+    fprintf(stderr, "  -c  file di configurazione (righe chiave = valore); le altre opzioni valgono sul file\n");
+    fprintf(stderr, "  -o  imposta una chiave della configurazione (ripetibile), ad esempio -o port=9000\n");
+    fprintf(stderr, "  -b  eventi strutturati in formato binario su %s\n", BINLOG_FILE_PATH);
+    fprintf(stderr, "  -l  livello minimo di log (default info)\n");
+    fprintf(stderr, "  -S  ruota i file di log oltre questa dimensione in MB (0 disattiva, default %lld)\n",
+            LOG_ROTATE_DEFAULT_BYTES / (1024 * 1024));
+    fprintf(stderr, "  -T  ruota i file di log ogni N secondi (default disattivato)\n");
+    fprintf(stderr, "  -U  ascolta su un socket Unix invece che sulla porta TCP %d\n", SERVER_PORT);
+    fprintf(stderr, "  -m  espone le metriche Prometheus su una porta locale o un socket Unix\n");
+    fprintf(stderr, "  -L  profilo del lock dello stato: attesa e possesso per punto di chiamata\n");
+    fprintf(stderr, "  -t  traccia una sessione ogni N in %s/ (formato Chrome trace-event)\n", TRACE_DIR);
+    fprintf(stderr, "  -A  socket Unix del canale di amministrazione (default %s)\n", ADMIN_SOCKET_PATH);
+    fprintf(stderr, "  -k  rimuove memoria condivisa e semaforo dell'istanza se nessun server li usa, poi termina\n");
+    fprintf(stderr, "  -u  aggiornamento a caldo: subentra al server in esecuzione senza chiudere le sessioni\n");
+    fprintf(stderr, "  -H  attesa massima della registrazione dopo la connessione (0 disattiva, default %d)\n", HANDSHAKE_TIMEOUT_SEC);
+    fprintf(stderr, "  -I  inattività massima di un client registrato (0 disattiva, default %d)\n", IDLE_TIMEOUT_SEC);
+    fprintf(stderr, "  -M  tempo massimo per completare un messaggio iniziato (0 disattiva, default %d)\n", MESSAGE_TIMEOUT_SEC);
+    fprintf(stderr, "  -P  iscritti alle classifiche che non leggono: coalesce, drop o disconnect (default coalesce)\n");
+    fprintf(stderr, "  -R  connessioni e messaggi al secondo per indirizzo IP (0 disattiva, default %d,%d)\n",
+            RATE_CONNECT_PER_SEC, RATE_MESSAGE_PER_SEC);
+    fprintf(stderr, "  -r  applica i limiti di -R anche agli indirizzi locali (127.0.0.0/8, ::1)\n");
+    fprintf(stderr, "  -N  porta su cui ricevere la classifica dagli altri nodi (default disattivata)\n");
+    fprintf(stderr, "  -j  nodi a cui replicare la classifica, host:porta separati da virgole\n");
+}
+
+#define SERVER_OPTIONS "c:o:bl:S:T:U:m:Lt:A:kuH:I:M:P:R:rN:j:"
+
+/**
+ * Legge la configurazione: valori predefiniti, poi il file indicato con -c, poi le altre opzioni
+ * della riga di comando (che valgono sul file in qualunque posizione compaiano)
+ *
+ * @param argc Il numero di argomenti
+ * @param argv Gli argomenti
+ * @param upgrade Output: 1 con l'opzione -u
+ * @param remove_stale Output: 1 con l'opzione -k
+ */
+static void parse_options(int argc, char* argv[], int* upgrade, int* remove_stale) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, SERVER_OPTIONS)) != -1) {
+        if (opt == 'c' && config_load(optarg) < 0) {
+            exit(1);
+        } else if (opt == '?') {
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    int ok = 1;
+    optind = 1;
+    while ((opt = getopt(argc, argv, SERVER_OPTIONS)) != -1) {
+        switch (opt) {
+            case 'o': ok &= config_set_option(optarg) == 0; break;
+            case 'b': ok &= config_set("binary_log", "1") == 0; break;
+            case 'l': ok &= config_set("log_level", optarg) == 0; break;
+            case 'S': ok &= config_set("log_rotate_mb", optarg) == 0; break;
+            case 'T': ok &= config_set("log_rotate_sec", optarg) == 0; break;
+            case 'U': ok &= config_set("unix_socket", optarg) == 0; break;
+            case 'm': ok &= config_set("metrics", optarg) == 0; break;
+            case 'L': ok &= config_set("lock_profile", "1") == 0; break;
+            case 't': ok &= config_set("trace_sample", optarg) == 0; break;
+            case 'A': ok &= config_set("admin_socket", optarg) == 0; break;
+            case 'k': *remove_stale = 1; break;
+            case 'u': *upgrade = 1; break;
+            case 'H': ok &= config_set("handshake_timeout", optarg) == 0; break;
+            case 'I': ok &= config_set("idle_timeout", optarg) == 0; break;
+            case 'M': ok &= config_set("message_timeout", optarg) == 0; break;
+            case 'P': ok &= config_set("rank_policy", optarg) == 0; break;
+            case 'R': {
+                char connect[16], message[16];
+                ok &= sscanf(optarg, "%15[^,],%15s", connect, message) == 2 &&
+                      config_set("rate_connect", connect) == 0 && config_set("rate_message", message) == 0;
+                break;
+            }
+            case 'r': ok &= config_set("rate_loopback", "1") == 0; break;
+            case 'N': ok &= config_set("replica_port", optarg) == 0; break;
+            case 'j': ok &= config_set("replica_peers", optarg) == 0; break;
+        }
+    }
+
+    // Valori che dipendono l'uno dall'altro o dai moduli
+    if (parse_log_level(server_config.log_level) < 0) {
+        fprintf(stderr, "Livello di log non valido: %s\n", server_config.log_level);
+        ok = 0;
+    }
+    if (room_parse_policy(server_config.rank_policy) < 0) {
+        fprintf(stderr, "Politica delle classifiche non valida: %s\n", server_config.rank_policy);
+        ok = 0;
+    }
+    if (replica_configure(server_config.replica_peers) < 0) {
+        ok = 0;
+    }
+    if (server_config.send_low_water >= server_config.send_high_water) {
+        fprintf(stderr, "send_low_water deve essere minore di send_high_water\n");
+        ok = 0;
+    }
+    if (!ok) {
+        usage(argv[0]);
+        exit(1);
+    }
+}
+
+int main(int argc, char* argv[]){
+    int upgrade = 0;
+    int remove_stale = 0;
+
+    parse_options(argc, argv, &upgrade, &remove_stale);
+    if (ipc_resolve_keys() < 0 || ipc_enter_instance() < 0) {
+        exit(1);
+    }
+    if (remove_stale) {
+        exit(ipc_remove_stale() < 0 ? 1 : 0);
+    }
+    int log_level = parse_log_level(server_config.log_level);
+    unix_path = server_config.unix_socket[0] ? server_config.unix_socket : NULL;
+    metrics_address = server_config.metrics[0] ? server_config.metrics : NULL;
+    admin_path = server_config.admin_socket;
+    set_client_timeouts(server_config.handshake_timeout, server_config.idle_timeout, server_config.message_timeout);
+    room_set_policy(room_parse_policy(server_config.rank_policy));
+    rate_configure(server_config.rate_connect, server_config.rate_message, server_config.rate_loopback);
+
     // Registrazione gestori di segnali
     signal(SIGINT, signal_handler);
     signal(SIGPIPE, signal_handler);
+    install_admin_signals();
     
     system("clear");
     printf("=== TRIVIA QUIZ SERVER ===\n");
     printf("Inizializzazione del server...\n");
     
-    // Crea segmento di memoria condivisa
-    shm_id = shmget(SHM_KEY, sizeof(ServerState), IPC_CREAT | 0666);
-    if (shm_id < 0) {
-        perror("shmget");
-        exit(1);
+    if (upgrade) {
+        // Aggiornamento a caldo: stato condiviso e semaforo restano quelli del server in esecuzione
+        if (attach_shared_state() < 0 || attach_semaphore() < 0) {
+            printf("Errore: nessun server compatibile da aggiornare\n");
+            exit(1);
+        }
+        uint64_t log_dropped = shared_state->metrics.log_dropped;
+        set_log_level(log_level);
+        log_attach_level(&shared_state->log_level);
+        log_attach_drop_counter(&shared_state->metrics.log_dropped);
+        shared_state->metrics.log_dropped = log_dropped;
+    } else {
+        // Crea la memoria condivisa dell'istanza (vedi create_shared_state)
+        if (create_shared_state() < 0) {
+            printf("Errore: impossibile creare la memoria condivisa\n");
+            exit(1);
+        }
+        shared_state->server_running = 1;
+        shared_state->player_count = 0;
+
+        // Il livello di log vive in memoria condivisa: una modifica vale per tutti i processi
+        set_log_level(log_level);
+        log_attach_level(&shared_state->log_level);
+        log_attach_drop_counter(&shared_state->metrics.log_dropped);
+
+        // Inizializza il semaforo per la sincronizzazione
+        if (init_semaphore() < 0) {
+            printf("Errore: impossibile inizializzare il semaforo\n");
+            LOG_ERROR("Impossibile inizializzare il semaforo");
+            cleanup_server(1);
+            exit(1);
+        }
     }
-    
-    // Collega il segmento di memoria condivisa
-    shared_state = (ServerState*)shmat(shm_id, NULL, 0);
-    if (shared_state == (ServerState*)-1) {
-        perror("shmat");
+    shared_state->locks.enabled = server_config.lock_profile;
+    shared_state->trace_sample = server_config.trace_sample;
+
+    // Inizializza il logger
+    set_log_rotation((long long)server_config.log_rotate_mb * 1024 * 1024, server_config.log_rotate_sec,
+                     LOG_ROTATE_DEFAULT_KEEP);
+    init_logger(server_config.log_file);
+    if (server_config.binary_log && init_binary_logger(server_config.binlog_file) < 0) {
+        printf("Attenzione: log binario non disponibile, uso il formato testo\n");
+    }
+    config_log();
+
+    // Ricostruisce la classifica globale da snapshot e WAL
+    // (con -u la classifica è già in memoria condivisa e l'archivio dei profili si mappa al primo uso)
+    if (!upgrade && persist_init() < 0) {
+        printf("Errore: impossibile inizializzare la persistenza dei punteggi\n");
+        LOG_ERROR("Impossibile inizializzare la persistenza dei punteggi");
+        close_logger();
         cleanup_server(1);
         exit(1);
     }
-    
-    // Inizializza la memoria condivisa
-    memset(shared_state, 0, sizeof(ServerState));
-    shared_state->server_running = 1;
-    shared_state->player_count = 0;
-    
-    // Inizializza il semaforo per la sincronizzazione
-    if (init_semaphore() < 0) {
-        printf("Errore: impossibile inizializzare il semaforo\n");
-        LOG_ERROR("Impossibile inizializzare il semaforo");
+
+    // Archivio su disco dei profili dei giocatori
+    if (!upgrade && profiles_init() < 0) {
+        printf("Errore: impossibile aprire l'archivio dei profili\n");
+        LOG_ERROR("Impossibile aprire l'archivio dei profili");
+        close_logger();
         cleanup_server(1);
         exit(1);
     }
 
-    // Inizializza il logger
-    init_logger(LOG_FILE_PATH);
-
     printf("=== TRIVIA QUIZ SERVER ===\n");
-    printf("Avvio server sulla porta %d...\n", SERVER_PORT);
-    LOG_INFO("Avvio server sulla porta %d...", SERVER_PORT);
+    if (unix_path) {
+        printf("Avvio server sul socket Unix %s...\n", unix_path);
+        LOG_INFO("Avvio server sul socket Unix %s...", unix_path);
+    } else {
+        printf("Avvio server sulla porta %d...\n", server_config.port);
+        LOG_INFO("Avvio server sulla porta %d...", server_config.port);
+    }
     
     printf("Caricamento temi...\n");
     
-    server_socket = create_server_socket(SERVER_PORT);
+    if (upgrade) {
+        server_socket = receive_listener();
+        if (server_socket >= 0) {
+            printf("Socket di ascolto ricevuto dal server in esecuzione\n");
+            LOG_INFO("Aggiornamento a caldo: socket di ascolto ricevuto, le sessioni esistenti proseguono");
+        }
+    } else if (unix_path) {
+        server_socket = transport_unix_listen(unix_path, server_config.backlog);
+        if (server_socket < 0) {
+            perror("Errore socket Unix");
+        }
+    } else {
+        server_socket = create_server_socket();
+    }
     if(server_socket < 0){
         printf("Errore: impossibile avviare server\n");
         LOG_ERROR("Impossibile avviare il server");
@@ -184,23 +812,110 @@ int main(){
     LOG_INFO("Server avviato con successo");
     
     init_themes();
-    
+    shared_state->catalog_themes = themes_count;
+
+    // Da qui i processi di servizio fanno capo a questo processo principale
+    shared_state->master_pid = getpid();
+    supervisor_install();
+    background_pid = start_background_worker();
+
+    if (metrics_address) {
+        metrics_socket = metrics_listen(metrics_address);
+        if (metrics_socket < 0) {
+            perror("Errore socket delle metriche");
+            LOG_WARNING("Metriche non disponibili su %s", metrics_address);
+        } else {
+            printf("Metriche Prometheus su %s\n", metrics_address);
+            LOG_INFO("Metriche Prometheus su %s", metrics_address);
+            metrics_pid = start_metrics_worker();
+        }
+    }
+
+    admin_socket = admin_listen(admin_path);
+    if (admin_socket < 0) {
+        perror("Errore socket di amministrazione");
+        LOG_WARNING("Canale di amministrazione non disponibile su %s", admin_path);
+    } else {
+        printf("Canale di amministrazione su %s\n", admin_path);
+        LOG_INFO("Canale di amministrazione su %s", admin_path);
+        admin_pid = start_admin_worker();
+    }
+
+    if (room_channel_open() < 0) {
+        perror("Errore canale delle stanze");
+        LOG_WARNING("Stanze dal vivo non disponibili");
+    } else {
+        room_pid = start_room_worker();
+    }
+
+    if (replica_enabled()) {
+        if (server_config.replica_port > 0) {
+            replica_socket = replica_listen(server_config.replica_port);
+            if (replica_socket < 0) {
+                perror("Errore socket di replica");
+                LOG_WARNING("Replica: impossibile ricevere aggiornamenti sulla porta %d", server_config.replica_port);
+            }
+        }
+        printf("Replica della classifica: porta %d, peer %s\n", server_config.replica_port,
+               server_config.replica_peers[0] ? server_config.replica_peers : "nessuno");
+        LOG_INFO("Replica della classifica: porta %d, peer %s", server_config.replica_port,
+                 server_config.replica_peers[0] ? server_config.replica_peers : "nessuno");
+        replica_pid = start_replica_worker();
+    }
+
+    upgrade_socket = upgrade_listen();
+    if (upgrade_socket < 0) {
+        LOG_WARNING("Aggiornamento a caldo non disponibile su %s", UPGRADE_SOCKET_PATH);
+    }
+
     printf("In attesa di connessioni...\n");
     printf("Premi Ctrl+C per terminare\n\n");
     LOG_INFO("Server in ascolto in attesa di connessioni");
 
     // Loop principale del server
+    int handed_off = 0;
     while (shared_state->server_running)
     {
+        // Attesa di una connessione o di una richiesta di aggiornamento a caldo
+        // (interrotta da SIGCHLD; il timeout copre un segnale arrivato prima della poll)
+        struct pollfd fds[2] = { { server_socket, POLLIN, 0 }, { upgrade_socket, POLLIN, 0 } };
+        int ready = poll(fds, upgrade_socket >= 0 ? 2 : 1, SUPERVISOR_POLL_MS);
+        reap_children(1);
+
+        // Richieste del canale di amministrazione, arrivate durante l'attesa
+        if (drain_pending) {
+            drain_server();
+            break;
+        }
+        if (reload_pending) {
+            reload_pending = 0;
+            reload_catalog();
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        if (upgrade_socket >= 0 && (fds[1].revents & POLLIN)) {
+            int conn = accept(upgrade_socket, NULL, NULL);
+            if (conn >= 0 && hand_off_listener(conn) == 0) {
+                handed_off = 1;
+                break;
+            }
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
         int client_socket = accept_client(server_socket);
         if(client_socket < 0){
-            if(shared_state->server_running){
+            if(shared_state->server_running && errno != ECONNREFUSED){
                 LOG_WARNING("Errore accept, continuazione...");
             }
             continue;
         }
         
         LOG_INFO("Nuova connessione accettata");
+        metrics_connection_accepted();
 
         // Stampa la lista aggiornata dei giocatori e le classifiche
         //print_players_status();
@@ -208,12 +923,12 @@ int main(){
         // Fork: crea un processo figlio per gestire questo client
         // Il processo padre continua ad accettare nuove connessioni
         // Il processo figlio gestisce la comunicazione con il singolo client
-        pid_t pid = fork();
+        pid_t pid = fork_process(PROCESS_SESSION);
 
         if(pid == 0){
             // Processo figlio: gestisce il client
-            // Chiudi il socket del server (non necessario nel figlio)
-            close(server_socket);
+            // Chiudi i socket di ascolto (non necessari nel figlio)
+            close_service_sockets(-1);
             
             // Gestisce tutta la comunicazione con il client
             // Questa funzione non ritorna finché il client non si disconnette
@@ -223,16 +938,49 @@ int main(){
             // Chiudi il socket del client (gestito dal processo figlio)
             close(client_socket);
         } else {
-            // Errore nella fork
+            // Errore nella fork, o tabella dei processi piena: la connessione è rifiutata
+            int error = errno;
             perror("Errore fork");
-            LOG_ERROR("Errore nella creazione del processo figlio");
+            LOG_ERROR("Errore nella creazione del processo figlio: %s", strerror(error));
+            metrics_connection_rejected();
             close(client_socket);
         }
     }
 
+    if (handed_off) {
+        // Le sessioni di questo processo proseguono fino alla loro conclusione; lo stato
+        // condiviso e il semaforo restano al nuovo server
+        printf("Attesa della fine delle sessioni servite da questo processo...\n");
+        LOG_INFO("Aggiornamento a caldo: attesa della fine delle sessioni del vecchio server");
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, 0)) > 0 || errno == EINTR) {
+            if (pid > 0) {
+                child_exited(pid, status, 0);
+            }
+        }
+        printf("Server sostituito.\n");
+        LOG_INFO("Aggiornamento a caldo completato: vecchio server terminato");
+        close_logger();
+        return 0;
+    }
+
     printf("Chiusura server...\n");
     LOG_INFO("Chiusura server in corso");
-    close(server_socket);
+    if (server_socket >= 0) {
+        close(server_socket);
+    }
+    if (unix_path) {
+        unlink(unix_path);
+    }
+    if (metrics_address && !metrics_address_is_port(metrics_address)) {
+        unlink(metrics_address);
+    }
+    unlink(admin_path);
+    if (upgrade_socket >= 0) {
+        unlink(UPGRADE_SOCKET_PATH);
+    }
+    close_service_sockets(-1);
 
     printf("Server terminato.\n");
     LOG_INFO("Server terminato");
@@ -244,21 +992,49 @@ int main(){
 }
 
 /**
- * Crea e configura il socket del server
+ * Imposta un'opzione intera di un socket; un'opzione non supportata non impedisce l'avvio
+ * @param fd Il socket
+ * @param level Il livello (SOL_SOCKET, IPPROTO_TCP)
+ * @param name L'opzione
+ * @param value Il valore
+ * @param label Il nome dell'opzione nei log
+ */
+static void set_socket_option(int fd, int level, int name, int value, const char* label) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+        LOG_WARNING("Opzione %s non impostata: %s", label, strerror(errno));
+    }
+}
+
+/**
+ * Crea e configura il socket del server (porta, backlog e opzioni da server_config)
+ * I buffer impostati sul socket di ascolto valgono anche per i socket accettati; SO_RCVBUF va
+ * impostato prima di listen per contare nella finestra annunciata nel SYN-ACK
+ *
  * @return Il socket del server o -1 in caso di errore
  */
-int create_server_socket(){
+int create_server_socket(void){
     int server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if(server_socket < 0){
         perror("Errore creazione socket");
         LOG_ERROR("Errore creazione socket");
         return -1;
     }
+
+    if (server_config.reuse_addr) {
+        // Riavvio immediato anche con connessioni del server precedente in TIME_WAIT
+        set_socket_option(server_socket, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+    }
+    if (server_config.rcvbuf > 0) {
+        set_socket_option(server_socket, SOL_SOCKET, SO_RCVBUF, server_config.rcvbuf, "SO_RCVBUF");
+    }
+    if (server_config.sndbuf > 0) {
+        set_socket_option(server_socket, SOL_SOCKET, SO_SNDBUF, server_config.sndbuf, "SO_SNDBUF");
+    }
     
     struct sockaddr_in server_addr;
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(SERVER_PORT);
+    server_addr.sin_port = htons(server_config.port);
 
     if(bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0){
         perror("Errore bind");
@@ -267,7 +1043,16 @@ int create_server_socket(){
         return -1;
     }
 
-    if(listen(server_socket, MAX_CLIENTS) < 0){
+    if (server_config.tcp_defer_accept > 0) {
+        // La accept (e la fork) avviene quando arriva il primo messaggio, non al termine dell'handshake
+        set_socket_option(server_socket, IPPROTO_TCP, TCP_DEFER_ACCEPT, server_config.tcp_defer_accept, "TCP_DEFER_ACCEPT");
+    }
+    if (server_config.tcp_fastopen > 0) {
+        // Un client che si riconnette può inviare NICK o RESUME già nel SYN
+        set_socket_option(server_socket, IPPROTO_TCP, TCP_FASTOPEN, server_config.tcp_fastopen, "TCP_FASTOPEN");
+    }
+
+    if(listen(server_socket, server_config.backlog) < 0){
         perror("Errore listen");
         LOG_ERROR("Errore listen socket");
         close(server_socket);
@@ -277,52 +1062,13 @@ int create_server_socket(){
     return server_socket;
 }
 
-/**
- * Inizializza i temi caricandoli dal file temi.txt
- */
-void init_themes(){
-    FILE *fp;
-    char buffer[MAX_THEME_LEN];
-    int count = 0;
-
-    fp = fopen("./src/temi.txt", "r");
-    if (fp == NULL) {
-        printf("Errore: impossibile aprire il file dei temi\n");
-    } else {
-        while (fgets(buffer, MAX_THEME_LEN, fp) != NULL && count < MAX_THEMES) {
-            // Rimuovi il carattere newline se presente
-            size_t len = strlen(buffer);
-            if (len > 0 && buffer[len-1] == '\n')
-                buffer[len-1] = '\0';
-            
-            // Salva il tema nell'array globale
-            strncpy(theme[count], buffer, MAX_THEME_LEN);
-            count++;
-        }
-        fclose(fp);
-        
-        if (count == 0) {
-            printf("  Nessun tema disponibile\n");
-        } else {
-            printf("Trovati %d temi\n", count);
-            // Stampa i temi disponibili
-            for (int i = 0; i < count; i++) {
-                printf("  - %s\n", theme[i]);
-            }
-        }
-        
-        // Aggiorna il numero totale di temi
-        themes_count = count;
-    }
-}
-
 /**
  * Accetta una nuova connessione client
  * @param server_socket Il socket del server
  * @return Il socket del client accettato o -1 in caso di errore
  */
 int accept_client(int server_socket){
-    struct sockaddr_in client_addr;
+    struct sockaddr_storage client_addr;
     socklen_t client_len = sizeof(client_addr);
 
     int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
@@ -336,7 +1082,32 @@ int accept_client(int server_socket){
         LOG_WARNING("Errore nella accept");
         return -1;
     }
+    if (server_config.tcp_nodelay && client_addr.ss_family != AF_UNIX) {
+        // Richieste e risposte brevi: ogni messaggio parte subito, senza attendere l'ACK del precedente
+        set_socket_option(client_socket, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    }
+
+    // Connessione oltre il limite dell'indirizzo: chiusa subito, senza fork né slot
+    RateKey key;
+    if (rate_key((struct sockaddr*)&client_addr, &key) == 0 && !rate_allow_connect(&key)) {
+        static time_t last_warning = 0;
+        time_t now = time(NULL);
+        if (now != last_warning) {
+            // Al più un avviso al secondo: un flood di connessioni non deve diventare un flood di log
+            last_warning = now;
+            LOG_WARNING("Connessioni oltre il limite di frequenza: rifiutate");
+        }
+        send_msg(client_socket, MSG_ERROR, "Troppe connessioni, riprova più tardi");
+        close(client_socket);
+        errno = ECONNREFUSED;
+        return -1;
+    }
 
-    printf("Nuovo client connesso: %s:%d\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+    if (client_addr.ss_family == AF_INET) {
+        struct sockaddr_in* addr = (struct sockaddr_in*)&client_addr;
+        printf("Nuovo client connesso: %s:%d\n", inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+    } else {
+        printf("Nuovo client connesso sul socket Unix\n");
+    }
     return client_socket;
 }
\ No newline at end of file
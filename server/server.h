@@ -2,16 +2,62 @@
 #define SERVER_H
 
 #include "../shared/protocol.h"
+#include "../shared/histogram.h"
+#include "../shared/clock.h"
 #include "logger.h"
 #include <sys/shm.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <signal.h>
+#include <time.h>
 
+// Valori predefiniti della configurazione (vedi config.h)
 #define SERVER_PORT 8080
 #define LOG_FILE_PATH "server.log"
-#define SHM_KEY 12345 // Chiave per la memoria condivisa
-#define SEM_KEY 54321 // Chiave per il semaforo
+#define BINLOG_FILE_PATH "server.blog" // Eventi strutturati in modalità binaria (opzione -b)
+#define INSTANCE_DIR "." // Directory dell'istanza: chiavi IPC (ftok) e base dei percorsi relativi
+#define IPC_PROJ_SHM 'Q' // Identificatori ftok della memoria condivisa e del semaforo
+#define IPC_PROJ_SEM 'S'
+#define QUIZ_DIR "src" // Directory dei temi (temi.txt) e dei file dei quiz
+#define DATA_DIR "data" // Directory dei dati persistenti (WAL e snapshot dei punteggi)
+
+// Scadenze delle connessioni dei client (opzioni -H, -I, -M; 0 le disattiva)
+#define HANDSHAKE_TIMEOUT_SEC 10    // Attesa massima della registrazione (NICK o RESUME) dopo la connessione
+#define IDLE_TIMEOUT_SEC 300        // Inattività massima di un client registrato tra due richieste
+#define MESSAGE_TIMEOUT_SEC 5       // Tempo massimo per completare un messaggio iniziato
+
+// Coda di uscita delle sessioni (vedi transport_output_buffer)
+#define SEND_HIGH_WATER (32 * 1024) // Byte non ancora letti dal client oltre i quali la sessione attende
+#define SEND_LOW_WATER (8 * 1024)   // Byte non letti a cui la sessione riprende
+#define SEND_TIMEOUT_SEC 10         // Attesa massima del client che non legge: poi la connessione viene chiusa
+
+// Aggiornamento a caldo (opzione -u): il nuovo server riceve il socket di ascolto dal vecchio
+#define UPGRADE_SOCKET_PATH "quiz-upgrade.sock"
+#define UPGRADE_READY_TIMEOUT_SEC 30 // Attesa massima dell'uscita dei processi di servizio del vecchio server
+
+// Intestazione della memoria condivisa: un nuovo binario si collega allo stato esistente
+// solo se formato e dimensione coincidono (SERVER_STATE_VERSION va incrementata a ogni
+// modifica delle strutture in memoria condivisa)
+#define SERVER_STATE_MAGIC 0x51535453 // "QSTS"
+#define SERVER_STATE_VERSION 12
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;      // sizeof(ServerState) del server che ha creato il segmento
+    uint32_t reserved;
+} ServerStateHeader;
+
+// Voci massime della classifica globale (giocatori storici, non solo quelli connessi)
+// (potenza di 2: l'indice per nickname usa il doppio degli slot e un mascheramento)
+#ifndef MAX_BOARD_ENTRIES
+#define MAX_BOARD_ENTRIES 16384
+#endif
+#if MAX_BOARD_ENTRIES & (MAX_BOARD_ENTRIES - 1)
+#error "MAX_BOARD_ENTRIES deve essere una potenza di 2"
+#endif
+#define BOARD_INDEX_SIZE (MAX_BOARD_ENTRIES * 2)
+#define BOARD_TOP_ROWS 64 // Prime voci di ogni tema mantenute in ordine da board_update (almeno LEADERBOARD_MAX_ROWS)
 
 typedef struct{
     char nickname[MAX_NICKNAME_LEN];
@@ -19,11 +65,238 @@ typedef struct{
     int completed [MAX_THEMES]; // 0 se non completato, 1 completato
 } Player;
 
+// Stato condiviso della persistenza dei punteggi (vedi persist.c)
+typedef struct {
+    unsigned long long wal_seq;     // Ultimo numero di sequenza scritto nel WAL
+    unsigned long long synced_seq;  // Ultimo numero di sequenza reso durevole (fdatasync)
+    unsigned long long snapshot_seq; // Numero di sequenza coperto dall'ultimo snapshot
+    int wal_generation;             // File WAL corrente: DATA_DIR/scores.wal.<generazione>
+} PersistState;
+
+// Tipi di richiesta del client misurati (vedi metrics.c)
+typedef enum {
+    METRIC_NICK,
+    METRIC_RESUME,
+    METRIC_THEMES,
+    METRIC_THEME,
+    METRIC_QUIZ_START,
+    METRIC_ANSWER,
+    METRIC_SCORE,
+    METRIC_END,
+    METRIC_OTHER,
+    METRIC_TYPES
+} MetricType;
+
+// Motivi della chiusura di una connessione per tempo scaduto (vedi client_handler.c)
+typedef enum {
+    EVICT_HANDSHAKE,    // Nessuna registrazione entro il tempo concesso
+    EVICT_IDLE,         // Client registrato inattivo
+    EVICT_MESSAGE,      // Messaggio iniziato e non completato (client lento o slowloris)
+    EVICT_FLOOD,        // Messaggi oltre il limite di frequenza dell'indirizzo (vedi ratelimit.h)
+    EVICT_REASONS
+} EvictReason;
+
+// Limiti di frequenza per indirizzo IP del client (vedi ratelimit.c)
+#define RATE_TABLE_SIZE 1024    // Indirizzi tracciati contemporaneamente
+#define RATE_PROBES 8           // Voci esaminate per indirizzo (indirizzamento aperto)
+
+typedef enum {
+    RATE_CONNECT,       // Connessioni accettate
+    RATE_MESSAGE,       // Messaggi ricevuti
+    RATE_KINDS
+} RateKind;
+
+typedef enum {
+    RATE_FREE,          // Voce libera
+    RATE_WRITING,       // Indirizzo in scrittura da parte di un processo
+    RATE_READY          // Indirizzo e bucket validi
+} RateEntryState;
+
+typedef struct {
+    int state;                      // RateEntryState
+    uint8_t addr[16];
+    uint64_t full_at[RATE_KINDS];   // Istante (µs, CLOCK_MONOTONIC) in cui il bucket torna pieno
+} RateEntry;
+
+// Esiti della coda di ammissione dei client oltre MAX_CLIENTS giocatori (vedi admission.c)
+typedef enum {
+    ADMISSION_QUEUED,       // Client entrato in coda
+    ADMISSION_ADMITTED,     // Client in coda registrato appena si è liberato uno slot
+    ADMISSION_ABANDONED,    // Client disconnesso (o nickname occupato) durante l'attesa
+    ADMISSION_REJECTED,     // Coda piena: il client riceve "Server pieno"
+    ADMISSION_OUTCOMES
+} AdmissionOutcome;
+
+// Contatori in memoria condivisa, aggiornati con operazioni atomiche senza il lock dello stato
+typedef struct {
+    Histogram latency[METRIC_TYPES];    // Tempo di servizio per tipo di richiesta, in ns
+    uint64_t bytes_in[METRIC_TYPES];    // Byte di payload ricevuti per tipo di richiesta
+    Histogram lock_wait;                // Attesa per acquisire il lock dello stato, in ns
+    uint64_t connections_accepted;
+    uint64_t connections_rejected;      // Server pieno o processo figlio non creato
+    int64_t sessions_active;            // Processi figli che servono un client
+    uint64_t log_dropped;               // Righe e record di log persi (vedi logger.c)
+    uint64_t room_frames_encoded;       // Messaggi delle stanze codificati (uno per invio a tutti)
+    uint64_t room_frames_sent;          // Consegne di quei messaggi ai partecipanti
+    uint64_t rank_updates;              // Modifiche della classifica globale registrate da save_score
+    uint64_t rank_frames_sent;          // Aggiornamenti della classifica consegnati agli iscritti
+    uint64_t sessions_evicted[EVICT_REASONS]; // Connessioni chiuse per tempo scaduto, per motivo
+    uint64_t slow_consumers;            // Connessioni chiuse perché il client non leggeva i messaggi
+    uint64_t pushes_dropped;            // Aggiornamenti delle classifiche scartati per iscritti lenti
+    uint64_t pushes_coalesced;          // Aggiornamenti delle classifiche riassunti nella classifica intera
+    uint64_t rate_limited[RATE_KINDS];  // Connessioni rifiutate e messaggi rallentati dai limiti per indirizzo
+    uint64_t admissions[ADMISSION_OUTCOMES]; // Client oltre la capienza, per esito
+    uint64_t admission_wait_ms;         // Attesa complessiva dei client ammessi dalla coda
+    uint64_t replica_sent;              // Registri della classifica inviati ai peer (vedi replica.h)
+    uint64_t replica_received;          // Registri ricevuti dai peer
+    uint64_t replica_merged;            // Di cui hanno modificato la classifica locale
+    int64_t replica_peers;              // Peer a cui il processo di replica è connesso
+} Metrics;
+
+// Profilo del lock dello stato condiviso per punto di chiamata (vedi ipc.c, opzione -L)
+#define LOCK_MAX_SITES 64
+
+typedef struct {
+    char file[32];
+    char func[32];
+    int line;
+    Histogram wait;     // Attesa per acquisire il lock, in ns
+    Histogram hold;     // Tempo di possesso del lock, in ns
+} LockSite;
+
+typedef struct {
+    int enabled;
+    int count;          // Punti di chiamata registrati
+    LockSite sites[LOCK_MAX_SITES];
+} LockProfile;
+
+// Stato di una sessione di gioco, conservato per la ripresa dopo una disconnessione (vedi session.c)
+typedef enum {
+    SESSION_FREE,       // Slot libero
+    SESSION_ACTIVE,     // Un processo figlio serve la sessione
+    SESSION_DETACHED    // Connessione caduta: la sessione attende la ripresa fino alla scadenza
+} SessionState;
+
+typedef struct {
+    char token[SESSION_TOKEN_LEN + 1];
+    char nickname[MAX_NICKNAME_LEN];
+    int state;              // SessionState
+    pid_t owner;            // Processo figlio che serve la sessione
+    int theme;              // Tema del quiz in corso, -1 se nessun quiz è in corso
+    int current_question;   // Prossima domanda da porre
+    int score;              // Punteggio accumulato nel quiz in corso
+    time_t detached_at;     // Istante della disconnessione
+} Session;
+
+// Tabella dei processi figli del processo principale (vedi supervisor.c)
+#define PROCESS_TABLE_SIZE (MAX_CLIENTS * 2 + 8) // Sessioni, connessioni rifiutate e processi di servizio
+
+typedef enum {
+    PROCESS_FREE,       // Voce libera
+    PROCESS_SESSION,    // Processo figlio che serve un client
+    PROCESS_BACKGROUND, // Persistenza, profili, scadenza delle sessioni
+    PROCESS_METRICS,    // Esposizione delle metriche (opzione -m)
+    PROCESS_ADMIN,      // Canale di amministrazione
+    PROCESS_ROOM,       // Orologio e invii delle stanze dal vivo
+    PROCESS_REPLICA     // Replica della classifica verso gli altri nodi
+} ProcessKind;
+
+typedef struct {
+    int kind;               // ProcessKind
+    pid_t pid;              // 0 finché la fork non è completata
+    time_t started_at;
+    int session_slot;       // Slot della sessione servita, -1 se nessuna
+    int finished;           // 1 se il processo ha chiuso la propria sessione in modo ordinato
+    char nickname[MAX_NICKNAME_LEN]; // Giocatore registrato dal processo, vuoto se nessuno
+} ProcessEntry;
+
+// Stanze dal vivo, una per tema (vedi room.c)
+typedef enum {
+    ROOM_IDLE,          // Nessun evento
+    ROOM_LOBBY,         // Attesa dei partecipanti prima della prima domanda
+    ROOM_QUESTION,      // Domanda aperta: le risposte vengono aggregate
+    ROOM_RESULT         // Domanda chiusa, pausa prima della successiva
+} RoomPhase;
+
+typedef struct {
+    int phase;                      // RoomPhase
+    int asked;                      // Sequenza delle domande poste: dispari mentre la domanda cambia
+    int question;                   // Domanda corrente (da 0)
+    int questions;                  // Domande dell'evento
+    char answer[MAX_ANSWER_LEN];    // Risposta corretta della domanda aperta (letta senza lock, vedi asked)
+    int members;                    // Partecipanti all'evento
+    int answered;                   // Risposte all'ultima domanda chiusa (contate dal processo delle stanze)
+    int correct;                    // Di cui corrette
+} Room;
+
+typedef enum {
+    SEAT_FREE,          // Posto libero
+    SEAT_JOINING,       // Socket inviato al processo delle stanze, in attesa di conferma
+    SEAT_MEMBER         // Il processo delle stanze scrive sul socket del client
+} SeatState;
+
+typedef struct {
+    int state;              // SeatState
+    pid_t pid;              // Processo di sessione del partecipante
+    int room;               // -1 per un iscritto alle classifiche
+    int themes;             // Temi seguiti dall'iscritto (un bit per tema)
+    int answered_question;  // Sequenza (Room.asked) dell'ultima risposta, +1 se chiusa senza risposta; -1 se nessuna
+    int answer_correct;     // 1 se l'ultima risposta è corretta
+    int leaving;            // Uscita richiesta: il processo delle stanze invia la fine e rilascia il socket
+} RoomSeat;
+
+// Coda di ammissione: client registrati quando si libera uno slot del giocatore, in ordine di arrivo
+#define ADMISSION_QUEUE_SIZE MAX_CLIENTS
+
+typedef struct {
+    pid_t pid;          // Processo di sessione in attesa, 0 se la voce è libera
+    uint64_t ticket;    // Ordine di arrivo
+} AdmissionEntry;
+
+typedef struct {
+    uint64_t next_ticket;
+    int waiting;                    // Voci occupate
+    AdmissionEntry entries[ADMISSION_QUEUE_SIZE];
+    uint64_t last_release_ms;       // Ultimo slot del giocatore liberato (CLOCK_MONOTONIC), 0 se nessuno
+    uint64_t release_interval_ms;   // Media mobile dell'intervallo tra due slot liberati, 0 se sconosciuta
+} AdmissionQueue;
+
 // Struttura per la memoria condivisa
 typedef struct {
+    ServerStateHeader header;
+    pid_t master_pid;   // Processo principale in servizio: i processi di servizio di un altro terminano
     Player players[MAX_CLIENTS];
     int player_count;
     int server_running;
+    int log_level; // Livello minimo di log condiviso da tutti i processi
+    int trace_sample;           // Traccia una sessione ogni trace_sample (0: solo su richiesta, vedi trace.h)
+    uint64_t trace_sessions;    // Sessioni avviate, per il campionamento delle tracce
+    int catalog_generation;     // Incrementata dal processo principale a ogni ricaricamento dei temi
+    int catalog_themes;         // Temi dell'ultimo catalogo caricato
+
+    // Classifica globale: miglior punteggio per tema di ogni giocatore, anche disconnesso
+    Player board[MAX_BOARD_ENTRIES];
+    int board_count;
+    int board_index[BOARD_INDEX_SIZE];  // Indirizzamento aperto per nickname: voce + 1, 0 se vuoto
+    int board_top[MAX_THEMES][BOARD_TOP_ROWS]; // Voci migliori per tema, in ordine di classifica
+    int board_top_count[MAX_THEMES];
+    int board_generation[MAX_THEMES]; // Incrementata da save_score a ogni modifica della classifica del tema
+    uint64_t board_seq[MAX_BOARD_ENTRIES][MAX_THEMES]; // Sequenza dell'ultima modifica di ogni registro (vedi replica.h)
+    uint64_t board_seq_last;          // Ultima sequenza assegnata da board_update
+    PersistState persist;
+    int profiles_generation; // Incrementata quando l'archivio dei profili viene ampliato e sostituito
+    int profiles_grow;       // ProfilesGrow: crescita dell'archivio richiesta o in corso (vedi profiles.c)
+    int profiles_migration;  // Identificativo della crescita in corso
+    uint64_t profiles_migrated; // Slot del vecchio archivio già copiati nel nuovo
+    Session sessions[MAX_CLIENTS];
+    Metrics metrics;
+    LockProfile locks;
+    pid_t lock_owner;       // Processo che possiede il lock dello stato, 0 se libero
+    ProcessEntry processes[PROCESS_TABLE_SIZE];
+    Room rooms[MAX_THEMES];
+    RoomSeat room_seats[MAX_CLIENTS];
+    RateEntry rates[RATE_TABLE_SIZE];
+    AdmissionQueue admission;
 } ServerState;
 
 // Variabili globali
@@ -32,16 +305,27 @@ extern int shm_id;
 extern int sem_id;
 
 // Funzioni per sincronizzazione
-void lock_shared_state();
+// lock_shared_state() passa il punto di chiamata al profilo dei lock; la variabile statica
+// della macro ricorda, per ogni punto di chiamata, la sua voce nel profilo
+#define lock_shared_state() \
+    do { static int lock_site_ = -1; lock_shared_state_at(&lock_site_, __FILE__, __LINE__, __func__); } while (0)
+void lock_shared_state_at(int* site, const char* file, int line, const char* func);
 void unlock_shared_state();
 int init_semaphore();
+int attach_semaphore(void);
 void cleanup_semaphore();
+int attach_shared_state(void);
+int ipc_resolve_keys(void);
+int ipc_enter_instance(void);
+int ipc_remove_stale(void);
+int create_shared_state(void);
 
 // Funzioni
-int create_server_socket();
-void init_themes();
+int create_server_socket(void);
 void handle_client(int client_socket);
 int accept_client(int server_socket);
 void cleanup_server(int status);
+void set_session_exit_hook(void (*hook)(void));
+void set_client_timeouts(int handshake_sec, int idle_sec, int message_sec);
 
 #endif
\ No newline at end of file
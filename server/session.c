@@ -0,0 +1,252 @@
+#include "session.h"
+#include "quiz.h"
+#include "logger.h"
+#include <fcntl.h>
+
+/**
+ * Genera un token di sessione: 16 byte da /dev/urandom codificati in esadecimale
+ * @param token Buffer di almeno SESSION_TOKEN_LEN + 1 byte
+ * @return 0 se successo, -1 in caso di errore
+ */
+static int generate_token(char* token) {
+    unsigned char bytes[SESSION_TOKEN_LEN / 2];
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, bytes, sizeof(bytes));
+    close(fd);
+    if (n != (ssize_t)sizeof(bytes)) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        snprintf(token + i * 2, 3, "%02x", bytes[i]);
+    }
+    return 0;
+}
+
+/**
+ * Crea la sessione di un giocatore appena registrato
+ * @param nickname Il nickname del giocatore
+ * @param token Buffer di almeno SESSION_TOKEN_LEN + 1 byte che riceve il token
+ * @return Lo slot della sessione, -1 se non ci sono slot liberi o il token non è generabile
+ */
+int session_create(const char* nickname, char* token) {
+    if (generate_token(token) < 0) {
+        LOG_ERROR("Impossibile generare il token di sessione per %s", nickname);
+        return -1;
+    }
+
+    lock_shared_state();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Session* session = &shared_state->sessions[i];
+        if (session->state == SESSION_FREE) {
+            memset(session, 0, sizeof(*session));
+            strcpy(session->token, token);
+            strcpy(session->nickname, nickname);
+            session->state = SESSION_ACTIVE;
+            session->owner = getpid();
+            session->theme = -1;
+            unlock_shared_state();
+            return i;
+        }
+    }
+    unlock_shared_state();
+    return -1;
+}
+
+/**
+ * Confronta due token in tempo costante: tutti i SESSION_TOKEN_LEN byte sono sempre esaminati,
+ * così il tempo di risposta non rivela quanti caratteri iniziali di un token tentato sono giusti
+ * @return 1 se i token coincidono
+ */
+static int token_equal(const char* a, const char* b) {
+    unsigned char diff = 0;
+    for (int i = 0; i < SESSION_TOKEN_LEN; i++) {
+        diff |= (unsigned char)a[i] ^ (unsigned char)b[i];
+    }
+    return diff == 0;
+}
+
+/**
+ * Riprende una sessione disconnessa a partire dal token
+ * Una sessione ancora attiva (il vecchio processo non si è ancora accorto della caduta della
+ * connessione) non viene presa: il chiamante chiede al vecchio processo di sospenderla
+ * (SESSION_TAKEOVER_SIGNAL) e riprova, altrimenti i due processi la servirebbero insieme
+ *
+ * @param token Il token ricevuto dal client
+ * @param session Output: copia dello stato della sessione (anche se ancora attiva, per il proprietario)
+ * @return Lo slot della sessione, SESSION_RESUME_BUSY se la sessione è ancora attiva,
+ *         -1 se il token non corrisponde a nessuna sessione
+ */
+int session_resume(const char* token, Session* session) {
+    if (strlen(token) != SESSION_TOKEN_LEN) {
+        return -1;
+    }
+
+    // Tutti gli slot sono confrontati, senza fermarsi al primo che coincide
+    lock_shared_state();
+    int found = -1;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Session* s = &shared_state->sessions[i];
+        if (token_equal(s->token, token) & (s->state != SESSION_FREE)) {
+            found = i;
+        }
+    }
+
+    if (found >= 0) {
+        Session* s = &shared_state->sessions[found];
+        *session = *s;
+        if (s->state == SESSION_ACTIVE) {
+            unlock_shared_state();
+            return SESSION_RESUME_BUSY;
+        }
+        s->state = SESSION_ACTIVE;
+        s->owner = getpid();
+        session->state = SESSION_ACTIVE;
+        session->owner = s->owner;
+        unlock_shared_state();
+        return found;
+    }
+    unlock_shared_state();
+    return -1;
+}
+
+/**
+ * Aggiorna l'avanzamento del quiz della sessione
+ * @param slot Lo slot della sessione
+ * @param theme Il tema in corso, -1 se nessun quiz è in corso
+ * @param current_question La prossima domanda da porre
+ * @param score Il punteggio accumulato nel quiz in corso
+ */
+void session_update(int slot, int theme, int current_question, int score) {
+    if (slot < 0) {
+        return;
+    }
+
+    lock_shared_state();
+    Session* session = &shared_state->sessions[slot];
+    if (session->owner == getpid()) {
+        session->theme = theme;
+        session->current_question = current_question;
+        session->score = score;
+    }
+    unlock_shared_state();
+}
+
+/**
+ * Conserva la sessione dopo una disconnessione, in attesa della ripresa
+ * Non fa nulla se nel frattempo la sessione è stata ripresa da un altro processo
+ *
+ * @param slot Lo slot della sessione
+ */
+void session_detach(int slot) {
+    if (slot < 0) {
+        return;
+    }
+
+    lock_shared_state();
+    Session* session = &shared_state->sessions[slot];
+    if (session->state == SESSION_ACTIVE && session->owner == getpid()) {
+        session->state = SESSION_DETACHED;
+        session->detached_at = time(NULL);
+    }
+    unlock_shared_state();
+}
+
+/**
+ * Chiude definitivamente la sessione (uscita volontaria del client)
+ * @param slot Lo slot della sessione, -1 se il giocatore non ha una sessione riprendibile
+ * @return 1 se il chiamante ne era il proprietario (o non aveva una sessione) e deve rimuovere
+ *         il giocatore, 0 se la sessione è stata ripresa da un altro processo
+ */
+int session_close(int slot) {
+    if (slot < 0) {
+        return 1;
+    }
+
+    int owned = 0;
+    lock_shared_state();
+    Session* session = &shared_state->sessions[slot];
+    if (session->state != SESSION_FREE && session->owner == getpid()) {
+        memset(session, 0, sizeof(*session));
+        owned = 1;
+    }
+    unlock_shared_state();
+    return owned;
+}
+
+/**
+ * Libera le sessioni disconnesse da più di SESSION_GRACE_SEC secondi
+ * e rimuove i relativi giocatori, rendendo di nuovo disponibile il nickname
+ * Chiamata periodicamente dal processo di background
+ */
+void sessions_expire(void) {
+    char expired[MAX_CLIENTS][MAX_NICKNAME_LEN];
+    int count = 0;
+    time_t now = time(NULL);
+
+    lock_shared_state();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Session* session = &shared_state->sessions[i];
+        if (session->state == SESSION_DETACHED && now - session->detached_at >= SESSION_GRACE_SEC) {
+            strcpy(expired[count++], session->nickname);
+            memset(session, 0, sizeof(*session));
+        }
+    }
+    unlock_shared_state();
+
+    // remove_player acquisisce il lock: va chiamata fuori dalla sezione critica
+    for (int i = 0; i < count; i++) {
+        LOG_INFO("Sessione di %s scaduta senza riconnessione", expired[i]);
+        remove_player(expired[i]);
+    }
+}
+
+/**
+ * Cerca la sessione di un giocatore (usata dal canale di amministrazione)
+ * @param nickname Il nickname del giocatore
+ * @param session Output: copia dello stato della sessione
+ * @return Lo slot della sessione, -1 se il giocatore non ha una sessione
+ */
+int session_find(const char* nickname, Session* session) {
+    int slot = -1;
+
+    lock_shared_state();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (shared_state->sessions[i].state != SESSION_FREE &&
+            strcmp(shared_state->sessions[i].nickname, nickname) == 0) {
+            *session = shared_state->sessions[i];
+            slot = i;
+            break;
+        }
+    }
+    unlock_shared_state();
+    return slot;
+}
+
+/**
+ * Libera subito una sessione disconnessa e il suo giocatore, senza attendere la scadenza
+ * @param nickname Il nickname del giocatore
+ * @return 0 se la sessione è stata liberata, -1 se non era in attesa di ripresa
+ */
+int session_release(const char* nickname) {
+    int released = -1;
+
+    lock_shared_state();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Session* session = &shared_state->sessions[i];
+        if (session->state == SESSION_DETACHED && strcmp(session->nickname, nickname) == 0) {
+            memset(session, 0, sizeof(*session));
+            released = 0;
+            break;
+        }
+    }
+    unlock_shared_state();
+
+    if (released == 0) {
+        remove_player(nickname);
+    }
+    return released;
+}
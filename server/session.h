@@ -0,0 +1,31 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "server.h"
+
+/*
+ * Ripresa delle sessioni
+ * - alla registrazione il server rilascia un token casuale (payload dell'OK)
+ * - se la connessione cade la sessione resta in memoria condivisa per SESSION_GRACE_SEC secondi,
+ *   insieme al nickname riservato, al tema in corso, alla domanda corrente e al punteggio
+ * - il client si riconnette con RESUME|token e riprende dalla stessa domanda
+ * - se la connessione precedente risulta ancora attiva, il nuovo processo chiede al vecchio di
+ *   sospendere la sessione (SESSION_TAKEOVER_SIGNAL) e la riprende appena è disconnessa
+ * - il processo di background libera le sessioni scadute
+ */
+
+#define SESSION_GRACE_SEC 60            // Tempo concesso per la riconnessione
+#define SESSION_TAKEOVER_SIGNAL SIGUSR2 // Al vecchio processo figlio: sospende la sessione e termina
+#define SESSION_TAKEOVER_MS 2000        // Attesa massima della sospensione da parte del vecchio processo
+#define SESSION_RESUME_BUSY -2          // session_resume: sessione ancora servita da un altro processo
+
+int session_create(const char* nickname, char* token);
+int session_resume(const char* token, Session* session);
+void session_update(int slot, int theme, int current_question, int score);
+void session_detach(int slot);
+int session_close(int slot);
+void sessions_expire(void);
+int session_find(const char* nickname, Session* session);
+int session_release(const char* nickname);
+
+#endif
@@ -0,0 +1,181 @@
+#include "supervisor.h"
+#include "metrics.h"
+#include "quiz.h"
+#include "logger.h"
+#include "admission.h"
+#include "room.h"
+
+static const char* kind_names[] = { "libero", "sessione", "background", "metriche", "amministrazione", "stanze", "replica" };
+
+// Voce della tabella del processo corrente (nei figli), -1 se non registrato
+static int current_process = -1;
+
+/**
+ * Restituisce il nome di un tipo di processo
+ * @param kind Il tipo di processo
+ * @return Il nome
+ */
+const char* process_kind_name(ProcessKind kind) {
+    return kind >= PROCESS_FREE && kind <= PROCESS_REPLICA ? kind_names[kind] : "sconosciuto";
+}
+
+/**
+ * Riserva una voce della tabella per un processo che sta per essere creato
+ * Chiamata solo dal processo principale, l'unico che alloca e libera le voci
+ *
+ * @param kind Il tipo di processo
+ * @return L'indice della voce, -1 se la tabella è piena (il processo non va creato)
+ */
+int process_reserve(ProcessKind kind) {
+    for (int i = 0; i < PROCESS_TABLE_SIZE; i++) {
+        ProcessEntry* entry = &shared_state->processes[i];
+        if (entry->kind == PROCESS_FREE) {
+            memset(entry, 0, sizeof(*entry));
+            entry->kind = kind;
+            entry->session_slot = -1;
+            entry->started_at = time(NULL);
+            return i;
+        }
+    }
+    LOG_WARNING("Tabella dei processi piena: nuovo processo %s rifiutato", process_kind_name(kind));
+    return -1;
+}
+
+/**
+ * Completa la voce dopo la fork (processo principale)
+ * @param index La voce riservata
+ * @param pid Il pid del figlio
+ */
+void process_started(int index, pid_t pid) {
+    if (index >= 0) {
+        shared_state->processes[index].pid = pid;
+    }
+}
+
+/**
+ * Libera una voce (fork fallita o processo raccolto)
+ * @param index La voce
+ */
+void process_release(int index) {
+    if (index >= 0) {
+        memset(&shared_state->processes[index], 0, sizeof(ProcessEntry));
+    }
+}
+
+/**
+ * Associa il processo figlio appena creato alla sua voce
+ * @param index La voce riservata dal processo principale
+ */
+void process_enter(int index) {
+    current_process = index;
+}
+
+/**
+ * Annota nella voce del processo il giocatore registrato e lo slot della sua sessione
+ * @param nickname Il nickname registrato
+ * @param slot Lo slot della sessione, -1 se la sessione non è riprendibile
+ */
+void process_set_session(const char* nickname, int slot) {
+    if (current_process < 0) {
+        return;
+    }
+    ProcessEntry* entry = &shared_state->processes[current_process];
+    snprintf(entry->nickname, sizeof(entry->nickname), "%s", nickname);
+    entry->session_slot = slot;
+}
+
+/**
+ * Segnala che il processo ha chiuso (o sospeso) la propria sessione in modo ordinato
+ */
+void process_finished(void) {
+    if (current_process >= 0) {
+        shared_state->processes[current_process].finished = 1;
+    }
+}
+
+/**
+ * Recupera lo stato lasciato da un processo di sessione terminato senza chiudere la sessione
+ * @param entry La voce del processo
+ * @param pid Il pid del processo
+ */
+static void reclaim_session(const ProcessEntry* entry, pid_t pid) {
+    int detached = 0;
+
+    // SEM_UNDO ha già rilasciato il semaforo se il processo lo possedeva
+    lock_shared_state();
+    if (shared_state->lock_owner == pid) {
+        shared_state->lock_owner = 0;
+        LOG_WARNING("Il processo %d è terminato con il lock dello stato acquisito", (int)pid);
+    }
+    if (entry->session_slot >= 0) {
+        Session* session = &shared_state->sessions[entry->session_slot];
+        if (session->state == SESSION_ACTIVE && session->owner == pid) {
+            session->state = SESSION_DETACHED;
+            session->detached_at = time(NULL);
+            detached = 1;
+        }
+    }
+    // Posti nelle stanze rimasti al processo: il processo delle stanze chiude la connessione
+    room_reclaim(pid);
+    unlock_shared_state();
+
+    metrics_session_change(-1);
+    admission_reclaim(pid);
+    if (detached) {
+        LOG_WARNING("Sessione di %s conservata per la ripresa dopo la terminazione del processo %d",
+                    entry->nickname, (int)pid);
+    } else if (entry->nickname[0] != '\0' && entry->session_slot < 0) {
+        // Giocatore registrato senza sessione riprendibile: nessuno lo rimuoverebbe
+        remove_player(entry->nickname);
+        LOG_WARNING("Giocatore %s rimosso dopo la terminazione del processo %d", entry->nickname, (int)pid);
+    }
+}
+
+/**
+ * Elabora la terminazione di un figlio raccolto con waitpid (processo principale)
+ * @param pid Il pid del figlio
+ * @param status Lo stato restituito da waitpid
+ * @return Il tipo del processo terminato, PROCESS_FREE se non era nella tabella
+ */
+ProcessKind process_exited(pid_t pid, int status) {
+    for (int i = 0; i < PROCESS_TABLE_SIZE; i++) {
+        ProcessEntry* entry = &shared_state->processes[i];
+        if (entry->kind == PROCESS_FREE || entry->pid != pid) {
+            continue;
+        }
+
+        ProcessKind kind = entry->kind;
+        if (kind == PROCESS_SESSION && !entry->finished) {
+            if (WIFSIGNALED(status)) {
+                LOG_ERROR("Processo di sessione %d terminato dal segnale %d", (int)pid, WTERMSIG(status));
+            } else {
+                LOG_ERROR("Processo di sessione %d terminato senza chiudere la sessione (stato %d)",
+                          (int)pid, WEXITSTATUS(status));
+            }
+            reclaim_session(entry, pid);
+        } else if (kind != PROCESS_SESSION && (WIFSIGNALED(status) || WEXITSTATUS(status) != 0)) {
+            LOG_ERROR("Processo %s %d terminato in modo anomalo", process_kind_name(kind), (int)pid);
+        }
+        process_release(i);
+        return kind;
+    }
+    return PROCESS_FREE;
+}
+
+// SIGCHLD: interrompe l'attesa del ciclo principale, che raccoglie i figli fuori dal gestore
+static void sigchld_handler(int sig) {
+    (void)sig;
+}
+
+/**
+ * Installa il gestore di SIGCHLD nel processo principale (senza SA_RESTART:
+ * l'attesa del ciclo principale si interrompe e i figli vengono raccolti subito)
+ */
+void supervisor_install(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+}
@@ -0,0 +1,34 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "server.h"
+
+/*
+ * Supervisione dei processi figli
+ * - il processo principale registra ogni figlio nella tabella dei processi in memoria condivisa
+ *   (sessioni e processi di servizio) e lo raccoglie con waitpid appena termina (SIGCHLD)
+ * - ogni processo di sessione annota nella propria voce nickname e slot della sessione
+ * - un figlio che termina senza chiudere la sessione (crash, segnale) non la perde:
+ *   la sessione passa in attesa di ripresa e scade come una disconnessione, il giocatore
+ *   registrato senza sessione viene rimosso, il suo posto in una stanza liberato e il contatore
+ *   delle sessioni attive corretto
+ * - il giocatore è annotato nella voce da init_player prima di diventare visibile agli altri
+ * - con la tabella piena la connessione è rifiutata: nessun processo nasce senza supervisione
+ * - il semaforo usa SEM_UNDO: se il figlio muore con il lock acquisito il kernel lo rilascia
+ */
+
+#define SUPERVISOR_POLL_MS 1000     // Attesa massima del ciclo principale tra due raccolte
+#define WORKER_MAX_RESTARTS 5       // Riavvii di un processo di servizio prima di rinunciare
+
+int process_reserve(ProcessKind kind);
+void process_started(int index, pid_t pid);
+void process_release(int index);
+void process_enter(int index);
+void process_set_session(const char* nickname, int slot);
+void process_finished(void);
+ProcessKind process_exited(pid_t pid, int status);
+const char* process_kind_name(ProcessKind kind);
+
+void supervisor_install(void);
+
+#endif
@@ -0,0 +1,207 @@
+#include "timer.h"
+#include "../shared/clock.h"
+#include <stddef.h>
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+
+// Ruota del processo
+static Timer* wheel[TIMER_LEVELS][TIMER_SLOTS];
+static uint64_t current_tick;       // Ultimo tick elaborato
+static int started = 0;
+static int pending = 0;             // Timer attivi
+
+// Orologio dei timer: un orologio virtuale (simulazione), NULL per l'orologio monotono comune
+static uint64_t (*clock_ms)(void) = NULL;
+
+/**
+ * Restituisce l'istante corrente dell'orologio dei timer
+ * @return L'istante in ms
+ */
+uint64_t timer_now_ms(void) {
+    return clock_ms ? clock_ms() : clock_now_ns() / 1000000;
+}
+
+/**
+ * Sostituisce l'orologio dei timer (prima di avviarne qualcuno)
+ * Chi simula molte sessioni in un solo processo usa un orologio virtuale: scadenze e
+ * punteggi a tempo restano deterministici
+ *
+ * @param clock La funzione che restituisce l'istante corrente in ms, NULL per l'orologio monotono
+ */
+void timer_set_clock(uint64_t (*clock)(void)) {
+    clock_ms = clock;
+    started = 0;
+}
+
+static uint64_t now_tick(void) {
+    return timer_now_ms() / TIMER_TICK_MS;
+}
+
+/**
+ * Inserisce un timer nello slot che corrisponde alla sua distanza dal tick corrente
+ * @param timer Il timer, con expires >= current_tick
+ */
+static void wheel_insert(Timer* timer) {
+    uint64_t delta = timer->expires - current_tick;
+    int level = 0;
+
+    // Oltre l'ultimo livello il timer attende nell'ultimo slot raggiungibile e viene
+    // ridistribuito a ogni cascata finché non rientra nella ruota
+    while (level < TIMER_LEVELS - 1 && delta >= (uint64_t)1 << (TIMER_SLOT_BITS * (level + 1))) {
+        level++;
+    }
+    uint64_t horizon = ((uint64_t)1 << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1;
+    uint64_t expires = delta > horizon ? current_tick + horizon : timer->expires;
+    int slot = (expires >> (TIMER_SLOT_BITS * level)) & TIMER_MASK;
+
+    Timer** head = &wheel[level][slot];
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+}
+
+static void wheel_unlink(Timer* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * Avvia (o riavvia) un timer
+ * @param timer Il timer, di proprietà del chiamante finché è attivo
+ * @param delay_ms Il ritardo della scadenza
+ * @param callback La funzione chiamata alla scadenza (da timer_run)
+ * @param arg L'argomento della funzione
+ */
+void timer_start(Timer* timer, uint64_t delay_ms, TimerCallback callback, void* arg) {
+    if (!started) {
+        current_tick = now_tick();
+        started = 1;
+    }
+    timer_cancel(timer);
+
+    // Arrotondato per eccesso: il timer non scade mai prima del ritardo richiesto
+    uint64_t expires = (timer_now_ms() + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    timer->expires = expires > current_tick ? expires : current_tick + 1;
+    timer->callback = callback;
+    timer->arg = arg;
+    wheel_insert(timer);
+    pending++;
+}
+
+/**
+ * Ferma un timer (nessun effetto se non è attivo)
+ * @param timer Il timer
+ */
+void timer_cancel(Timer* timer) {
+    if (timer->pprev != NULL) {
+        wheel_unlink(timer);
+        pending--;
+    }
+}
+
+/**
+ * Indica se un timer è attivo
+ * @param timer Il timer
+ * @return 1 se attivo
+ */
+int timer_pending(const Timer* timer) {
+    return timer->pprev != NULL;
+}
+
+/**
+ * Ridistribuisce uno slot di un livello superiore sui livelli inferiori
+ * @param level Il livello
+ * @return L'indice dello slot ridistribuito (0: anche il livello successivo ha completato un giro)
+ */
+static int cascade(int level) {
+    int slot = (current_tick >> (TIMER_SLOT_BITS * level)) & TIMER_MASK;
+    Timer* list = wheel[level][slot];
+    wheel[level][slot] = NULL;
+    while (list != NULL) {
+        Timer* timer = list;
+        list = timer->next;
+        wheel_insert(timer);
+    }
+    return slot;
+}
+
+/**
+ * Fa avanzare la ruota fino all'istante corrente ed esegue i timer scaduti
+ * Le funzioni dei timer possono avviare o fermare altri timer
+ *
+ * @return Il numero di timer scaduti
+ */
+int timer_run(void) {
+    uint64_t target = now_tick();
+    int fired = 0;
+
+    if (!started || pending == 0) {
+        // Ruota vuota: nessun tick da percorrere
+        current_tick = target;
+        started = 1;
+        return 0;
+    }
+
+    while (current_tick < target && pending > 0) {
+        current_tick++;
+        int slot = current_tick & TIMER_MASK;
+        for (int level = 1; slot == 0 && level < TIMER_LEVELS; level++) {
+            slot = cascade(level);
+        }
+
+        Timer** head = &wheel[0][current_tick & TIMER_MASK];
+        while (*head != NULL) {
+            Timer* timer = *head;
+            wheel_unlink(timer);
+            pending--;
+            fired++;
+            timer->callback(timer->arg);
+        }
+    }
+    if (pending == 0) {
+        current_tick = target;
+    }
+    return fired;
+}
+
+/**
+ * Calcola l'attesa fino alla prossima elaborazione utile della ruota: la scadenza più vicina
+ * del livello 0 o, se prima, la cascata del primo slot occupato di un livello superiore
+ *
+ * @return L'attesa in ms, -1 se nessun timer è attivo
+ */
+int timer_next_ms(void) {
+    if (!started || pending == 0) {
+        return -1;
+    }
+
+    uint64_t next = UINT64_MAX;
+    for (uint64_t tick = current_tick + 1; tick < current_tick + TIMER_SLOTS; tick++) {
+        if (wheel[0][tick & TIMER_MASK] != NULL) {
+            next = tick;
+            break;
+        }
+    }
+    for (int level = 1; level < TIMER_LEVELS; level++) {
+        int shift = TIMER_SLOT_BITS * level;
+        uint64_t base = current_tick >> shift;
+        for (uint64_t k = 1; k <= TIMER_SLOTS; k++) {
+            if (wheel[level][(base + k) & TIMER_MASK] != NULL) {
+                uint64_t tick = (base + k) << shift;
+                next = tick < next ? tick : next;
+                break;
+            }
+        }
+    }
+
+    uint64_t now = timer_now_ms();
+    uint64_t at = next * TIMER_TICK_MS;
+    return at > now ? (int)(at - now) : 0;
+}
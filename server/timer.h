@@ -0,0 +1,41 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+/*
+ * Timer delle sessioni: ruota gerarchica (hashed hierarchical timing wheel)
+ * - TIMER_LEVELS livelli di TIMER_SLOTS slot; il livello 0 ha la risoluzione di TIMER_TICK_MS,
+ *   ogni livello successivo copre TIMER_SLOTS volte l'intervallo del precedente
+ * - ogni slot è una lista intrusiva: inserimento e cancellazione costano O(1) e non allocano
+ * - quando il livello 0 completa un giro, lo slot corrente del livello superiore viene
+ *   ridistribuito sui livelli inferiori (cascata)
+ * - una sola ruota per processo: nel server contiene i timer dell'unica sessione del processo
+ *   figlio, nella simulazione quelli di tutte le sessioni, senza thread né chiamate di sistema
+ *   per sessione; chi attende un messaggio calcola il timeout con timer_next_ms
+ */
+
+#define TIMER_TICK_MS 10
+#define TIMER_LEVELS 4
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+
+typedef void (*TimerCallback)(void* arg);
+
+typedef struct Timer {
+    struct Timer* next;
+    struct Timer** pprev;   // Puntatore che punta a questo timer, NULL se il timer non è attivo
+    uint64_t expires;       // Tick di scadenza
+    TimerCallback callback;
+    void* arg;
+} Timer;
+
+uint64_t timer_now_ms(void);
+void timer_set_clock(uint64_t (*clock)(void));
+void timer_start(Timer* timer, uint64_t delay_ms, TimerCallback callback, void* arg);
+void timer_cancel(Timer* timer);
+int timer_pending(const Timer* timer);
+int timer_run(void);
+int timer_next_ms(void);
+
+#endif
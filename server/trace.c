@@ -0,0 +1,168 @@
+#include "trace.h"
+#include "logger.h"
+#include "../shared/protocol.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+typedef struct {
+    const char* category;
+    const char* name;
+    char detail[TRACE_DETAIL_LEN];
+    uint64_t start_ns;
+    uint64_t duration_ns;
+} TraceEvent;
+
+volatile int trace_active = 0;
+
+static TraceEvent* events = NULL;    // Buffer circolare, allocato al primo span
+static uint64_t recorded = 0;        // Span registrati dall'inizio della sessione
+static char session_nickname[MAX_NICKNAME_LEN] = "";
+static volatile sig_atomic_t dump_requested = 0;
+
+// Ricezione e invio dei messaggi, segnalati da send_msg/recv_msg
+static void trace_message(int sending, const char* type, uint64_t start_ns) {
+    trace_span("net", sending ? "send" : "recv", type, start_ns);
+}
+
+static void trace_activate(void) {
+    trace_active = 1;
+    set_msg_trace_hook(trace_message);
+}
+
+// SIGUSR1: richiesta di tracciamento o di scrittura del buffer, servita da trace_poll_dump()
+static void trace_signal_handler(int sig) {
+    (void)sig;
+    dump_requested = 1;
+}
+
+/**
+ * Decide se tracciare la sessione appena iniziata e abilita le richieste con SIGUSR1
+ * @param sample_every Traccia una sessione ogni sample_every (0: solo su richiesta)
+ * @param session_counter Contatore condiviso delle sessioni, incrementato in modo atomico
+ */
+void trace_session_start(int sample_every, uint64_t* session_counter) {
+    signal(SIGUSR1, trace_signal_handler);
+
+    uint64_t number = __atomic_fetch_add(session_counter, 1, __ATOMIC_RELAXED);
+    if (sample_every > 0 && number % sample_every == 0) {
+        trace_activate();
+    }
+}
+
+/**
+ * Associa il nickname alla traccia (nome del processo nel visualizzatore e nome del file)
+ * @param nickname Il nickname della sessione
+ */
+void trace_set_nickname(const char* nickname) {
+    snprintf(session_nickname, sizeof(session_nickname), "%s", nickname);
+}
+
+/**
+ * Registra uno span concluso adesso
+ * @param category La categoria (stringa costante)
+ * @param name Il nome (stringa costante)
+ * @param detail Un dettaglio copiato nello span (es. il tipo del messaggio), può essere NULL
+ * @param start_ns L'inizio dello span (clock_now_ns)
+ */
+void trace_span(const char* category, const char* name, const char* detail, uint64_t start_ns) {
+    if (events == NULL) {
+        events = malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent));
+        if (events == NULL) {
+            trace_active = 0;
+            return;
+        }
+    }
+
+    TraceEvent* event = &events[recorded % TRACE_BUFFER_EVENTS];
+    event->category = category;
+    event->name = name;
+    snprintf(event->detail, sizeof(event->detail), "%s", detail ? detail : "");
+    event->start_ns = start_ns;
+    event->duration_ns = clock_now_ns() - start_ns;
+    recorded++;
+}
+
+/**
+ * Serve una richiesta arrivata con SIGUSR1, in un punto sicuro del processo figlio
+ * Se la sessione non era tracciata il tracciamento parte ora (scrittura a fine sessione),
+ * altrimenti il buffer viene scritto subito
+ *
+ * @return 1 se è stata servita una richiesta, 0 altrimenti
+ */
+int trace_poll_dump(void) {
+    if (!dump_requested) {
+        return 0;
+    }
+    dump_requested = 0;
+
+    if (!trace_active) {
+        LOG_INFO("Tracciamento della sessione %s avviato su richiesta", session_nickname);
+        trace_activate();
+    } else {
+        trace_dump();
+    }
+    return 1;
+}
+
+// Scrive una stringa JSON (i dettagli sono tipi di messaggio, nickname e nomi di funzione)
+static void write_json_string(FILE* fp, const char* str) {
+    fputc('"', fp);
+    for (const char* p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', fp);
+        }
+        if ((unsigned char)*p >= 0x20) {
+            fputc(*p, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/**
+ * Scrive il buffer della sessione in TRACE_DIR in formato Chrome trace-event
+ * Gli span sono in ordine di chiusura; ts e dur sono in microsecondi
+ *
+ * @return 0 se successo, -1 in caso di errore o se non ci sono span
+ */
+int trace_dump(void) {
+    if (events == NULL || recorded == 0) {
+        return -1;
+    }
+    if (mkdir(TRACE_DIR, 0755) < 0 && errno != EEXIST) {
+        LOG_WARNING("Impossibile creare la directory delle tracce %s", TRACE_DIR);
+        return -1;
+    }
+
+    int pid = (int)getpid();
+    char path[128];
+    snprintf(path, sizeof(path), "%s/session-%d-%s.json", TRACE_DIR, pid,
+             session_nickname[0] ? session_nickname : "anonimo");
+
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        LOG_WARNING("Impossibile scrivere la traccia %s", path);
+        return -1;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", pid, pid);
+    write_json_string(fp, session_nickname[0] ? session_nickname : "sessione");
+    fprintf(fp, "}}");
+
+    uint64_t first = recorded > TRACE_BUFFER_EVENTS ? recorded - TRACE_BUFFER_EVENTS : 0;
+    for (uint64_t i = first; i < recorded; i++) {
+        const TraceEvent* event = &events[i % TRACE_BUFFER_EVENTS];
+        char name[64 + TRACE_DETAIL_LEN];
+        snprintf(name, sizeof(name), event->detail[0] ? "%s %s" : "%s", event->name, event->detail);
+        fprintf(fp, ",\n{\"name\":");
+        write_json_string(fp, name);
+        fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                event->category, event->start_ns / 1000.0, event->duration_ns / 1000.0, pid, pid);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    LOG_INFO("Traccia della sessione %s scritta in %s (%llu span, %llu scartati)", session_nickname, path,
+             (unsigned long long)(recorded - first), (unsigned long long)first);
+    return 0;
+}
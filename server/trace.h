@@ -0,0 +1,36 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "../shared/clock.h"
+
+/*
+ * Tracciamento delle sessioni in formato Chrome trace-event (chrome://tracing, Perfetto)
+ * - il processo figlio di una sessione tracciata registra intervalli (span) in un buffer
+ *   circolare locale: ricezione e invio dei messaggi, servizio di ogni richiesta,
+ *   attesa del lock dello stato, check_answer() e save_score()
+ * - le sessioni si tracciano per campionamento (opzione -t N: una sessione ogni N)
+ *   oppure su richiesta, inviando SIGUSR1 al processo figlio: il buffer viene scritto
+ *   dopo la richiesta in corso e il tracciamento resta attivo fino alla fine della sessione
+ * - a fine sessione il buffer è scritto in TRACE_DIR/session-<pid>-<nickname>.json
+ * Con il tracciamento spento ogni punto di misura costa un solo confronto.
+ */
+
+#define TRACE_DIR "traces"
+#define TRACE_BUFFER_EVENTS 4096    // Span conservati per sessione (i più vecchi vengono sovrascritti)
+#define TRACE_DETAIL_LEN 32
+
+// 1 se il processo sta tracciando la propria sessione
+extern volatile int trace_active;
+
+// Apre e chiude uno span: TRACE_BEGIN all'inizio, TRACE_END con nome e dettaglio alla fine
+#define TRACE_BEGIN(var) uint64_t var = trace_active ? clock_now_ns() : 0
+#define TRACE_END(var, category, name, detail) \
+    do { if (trace_active) trace_span(category, name, detail, var); } while (0)
+
+void trace_session_start(int sample_every, uint64_t* session_counter);
+void trace_set_nickname(const char* nickname);
+void trace_span(const char* category, const char* name, const char* detail, uint64_t start_ns);
+int trace_poll_dump(void);
+int trace_dump(void);
+
+#endif
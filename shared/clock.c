@@ -0,0 +1,12 @@
+#include "clock.h"
+#include <time.h>
+
+/**
+ * Istante corrente dell'orologio monotono
+ * @return I nanosecondi trascorsi da un'origine arbitraria, la stessa per tutti i processi
+ */
+uint64_t clock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,16 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/*
+ * Orologio monotono comune a server, client e strumenti (CLOCK_MONOTONIC, nanosecondi)
+ * - metriche, tracciamento, scadenze, limiti di frequenza e benchmark leggono lo stesso istante:
+ *   valori di processi diversi sono confrontabili
+ * - i timer delle sessioni passano da timer_now_ms (vedi timer.h), che nella simulazione
+ *   segue l'orologio virtuale
+ */
+
+uint64_t clock_now_ns(void);
+
+#endif
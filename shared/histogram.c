@@ -0,0 +1,126 @@
+#include "histogram.h"
+
+/**
+ * Calcola il bucket di un valore
+ * @param value Il valore
+ * @return L'indice del bucket, in [0, HIST_BUCKETS)
+ */
+int histogram_bucket(uint64_t value) {
+    if (value < HIST_SUB_BUCKETS) {
+        return (int)value;
+    }
+
+    // Posizione del bit più significativo: sceglie la potenza di 2,
+    // i HIST_SUB_BITS bit successivi scelgono il sotto-bucket
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + (int)((value >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+/**
+ * Restituisce il valore massimo rappresentato da un bucket
+ * @param bucket L'indice del bucket
+ * @return Il limite superiore (incluso) del bucket
+ */
+uint64_t histogram_bucket_limit(int bucket) {
+    if (bucket < HIST_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+
+    int shift = bucket / HIST_SUB_BUCKETS - 1;
+    uint64_t base = (uint64_t)(HIST_SUB_BUCKETS + bucket % HIST_SUB_BUCKETS) << shift;
+    return base + ((1ULL << shift) - 1);
+}
+
+/**
+ * Registra un valore nell'istogramma
+ * @param hist L'istogramma
+ * @param value Il valore da registrare
+ */
+void histogram_record(Histogram* hist, uint64_t value) {
+    hist->buckets[histogram_bucket(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+/**
+ * Somma un istogramma in un altro
+ * @param dest L'istogramma di destinazione
+ * @param src L'istogramma da sommare
+ */
+void histogram_merge(Histogram* dest, const Histogram* src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dest->buckets[i] += src->buckets[i];
+    }
+    dest->count += src->count;
+    dest->sum += src->sum;
+    if (src->max > dest->max) {
+        dest->max = src->max;
+    }
+}
+
+/**
+ * Calcola un percentile dell'istogramma
+ * @param hist L'istogramma
+ * @param percentile Il percentile richiesto, tra 0 e 100 (es. 99.9)
+ * @return Il limite superiore del bucket che contiene il percentile, 0 se l'istogramma è vuoto
+ */
+uint64_t histogram_percentile(const Histogram* hist, double percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    // Rango del valore cercato (1-based), arrotondato per eccesso
+    uint64_t rank = (uint64_t)(percentile / 100.0 * hist->count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t limit = histogram_bucket_limit(i);
+            return limit < hist->max ? limit : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/**
+ * Registra un valore con incrementi atomici (istogramma condiviso tra processi)
+ * @param hist L'istogramma
+ * @param value Il valore da registrare
+ */
+void histogram_record_atomic(Histogram* hist, uint64_t value) {
+    __atomic_fetch_add(&hist->buckets[histogram_bucket(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&hist->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // max aggiornato da un altro processo: riprova con il nuovo valore
+    }
+}
+
+/**
+ * Copia un istogramma aggiornato concorrentemente con histogram_record_atomic
+ * Il conteggio è ricalcolato dai bucket copiati, così i percentili restano coerenti
+ *
+ * @param dest L'istogramma di destinazione
+ * @param src L'istogramma condiviso
+ */
+void histogram_snapshot(Histogram* dest, const Histogram* src) {
+    uint64_t count = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dest->buckets[i] = __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+        count += dest->buckets[i];
+    }
+    dest->count = count;
+    dest->sum = __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+    dest->max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,35 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Istogramma di latenze a bucket log-lineari
+ * - valori sotto HIST_SUB_BUCKETS registrati esattamente
+ * - oltre, HIST_SUB_BUCKETS bucket per ogni potenza di 2 (errore relativo massimo ~6%)
+ * - dimensione fissa, nessuna allocazione: può vivere anche in memoria condivisa
+ * L'unità dei valori è scelta dal chiamante (tipicamente microsecondi).
+ * Le varianti _atomic permettono a più processi di aggiornare e leggere lo stesso istogramma
+ * senza lock: ogni campo è coerente, l'istogramma nel suo insieme è approssimato.
+ */
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+int histogram_bucket(uint64_t value);
+uint64_t histogram_bucket_limit(int bucket);
+void histogram_record(Histogram* hist, uint64_t value);
+void histogram_merge(Histogram* dest, const Histogram* src);
+uint64_t histogram_percentile(const Histogram* hist, double percentile);
+void histogram_record_atomic(Histogram* hist, uint64_t value);
+void histogram_snapshot(Histogram* dest, const Histogram* src);
+
+#endif // HISTOGRAM_H
@@ -1,8 +1,22 @@
 #include "../shared/protocol.h"
+#include "transport.h"
+#include "clock.h"
 
 char theme[MAX_THEMES] [MAX_THEME_LEN]= {0};
 int themes_count = 0;
 
+// Chiamata dopo ogni messaggio inviato o ricevuto, se impostata (tracciamento delle sessioni)
+static MsgTraceHook msg_trace_hook = NULL;
+
+/**
+ * Imposta la funzione chiamata dopo ogni send_msg/recv_msg riuscita
+ * @param hook La funzione (NULL per disattivarla): riceve la direzione (1 invio, 0 ricezione),
+ *             il tipo del messaggio e l'istante di inizio dell'operazione (CLOCK_MONOTONIC, ns)
+ */
+void set_msg_trace_hook(MsgTraceHook hook) {
+    msg_trace_hook = hook;
+}
+
 /**
  * Formatta e stampa una stringa che contiene sequenze di escape \n
  * Utile per visualizzare elenchi e liste formattate ricevute dal server
@@ -103,6 +117,66 @@ int is_numeric(const char* str) {
     return 1;
 }
 
+/**
+ * Formatta un messaggio secondo il protocollo TIPO|LUNGHEZZA|DATI\n
+ *
+ * @param buffer Il buffer di destinazione
+ * @param size La dimensione del buffer
+ * @param type Il tipo di messaggio
+ * @param data I dati del messaggio (può essere NULL per messaggi senza dati)
+ * @return La lunghezza del messaggio formattato (troncato alla dimensione del buffer)
+ */
+int format_msg(char* buffer, size_t size, const char* type, const char* data){
+    int len = data ? strlen(data) : 0;  // Alcuni messaggi hanno dati vuoti
+    int full_len = snprintf(buffer, size, "%s|%d|%s\n", type, len, data ? data : "");
+    if (full_len >= (int)size) {
+        // Messaggio troncato: il terminatore di riga va comunque preservato
+        full_len = size - 1;
+        buffer[full_len - 1] = '\n';
+    }
+    return full_len;
+}
+
+/**
+ * Estrae tipo e dati da una riga del protocollo TIPO|LUNGHEZZA|DATI (senza il '\n' finale)
+ * La riga viene modificata sul posto
+ *
+ * @param line La riga da analizzare, terminata da '\0'
+ * @param type Buffer per il tipo (output, almeno MAX_TYPE_LEN byte, può essere NULL)
+ * @param data Buffer per i dati (output, almeno MAX_MSG_LEN byte, può essere NULL)
+ * @return 0 se la riga è ben formata, -1 altrimenti
+ */
+int parse_msg(char* line, char* type, char* data){
+    // Trova il primo '|' (separa TIPO da LUNGHEZZA)
+    char *first = strchr(line, '|');
+    if(!first){
+        return -1;
+    }
+
+    // Trova il secondo '|' (separa LUNGHEZZA da DATI)
+    char *second = strchr(first + 1, '|');
+    if(!second){
+        return -1;
+    }
+
+    // Estrae il TIPO (prima del primo '|')
+    *first = '\0';
+    if (type != NULL) {
+        // strncpy riempie di zeri fino al limite: va usata la dimensione reale del buffer
+        strncpy(type, line, MAX_TYPE_LEN);
+        type[MAX_TYPE_LEN - 1] = '\0';  // Assicura terminazione
+    }
+
+    // Ignora la LUNGHEZZA (non rilevante per il parsing)
+    // Estrae i DATI (dopo il secondo '|')
+    if (data != NULL) {
+        strncpy(data, second + 1, MAX_MSG_LEN);
+        data[MAX_MSG_LEN - 1] = '\0';  // Assicura terminazione
+    }
+
+    return 0;
+}
+
 /**
  * Invia un messaggio formattato tramite socket secondo il protocollo TIPO|LUNGHEZZA|DATI\n
  * Gestisce l'invio parziale richiamando send() finché tutti i byte sono inviati
@@ -118,18 +192,14 @@ int send_msg (int socket, const char* type, char* data){
         return -1;
     }
     
+    uint64_t start = msg_trace_hook ? clock_now_ns() : 0;
     char message[MAX_MSG_LEN];
-    int len = data ? strlen(data) : 0;  // Alcuni messaggi hanno dati vuoti
-    
-    // Formatta il messaggio: TIPO|LUNGHEZZA|DATI\n
-    snprintf(message, sizeof(message), "%s|%d|%s\n", type, len, data ? data : "");
-
-    int full_len = strlen(message);
+    int full_len = format_msg(message, sizeof(message), type, data);
     int sent = 0;
 
     // Invia tutto il messaggio, gestendo invii parziali
     while(sent < full_len){
-        int res = send(socket, message + sent, full_len - sent, 0);
+        int res = transport_send(socket, message + sent, full_len - sent);
         if(res < 0){
             perror ("Errore invio messaggio");
             return -1;
@@ -137,74 +207,78 @@ int send_msg (int socket, const char* type, char* data){
         sent += res;
     }
     // printf("Inviato: %s", message);  // DEBUG
+    if (msg_trace_hook) {
+        msg_trace_hook(1, type, start);
+    }
     return 0;
 }
 
 /**
  * Riceve un messaggio formattato tramite socket e lo parse secondo il protocollo
  * Formato atteso: TIPO|LUNGHEZZA|DATI\n
+ * Restituisce esattamente un messaggio per chiamata, anche se la recv() ne legge più d'uno:
+ * i byte oltre il primo '\n' restano nel buffer dell'handle per la chiamata successiva
  * 
- * @param socket Il socket da cui ricevere il messaggio
- * @param type Buffer per il tipo di messaggio ricevuto (output)
+ * @param socket Il socket (o handle di trasporto) da cui ricevere il messaggio
+ * @param type Buffer per il tipo di messaggio ricevuto (output, almeno MAX_TYPE_LEN byte)
  * @param data Buffer per i dati del messaggio ricevuto (output)
  * @return 0 se la ricezione ha successo, -1 in caso di errore
  */
 int recv_msg (int socket, char* type, char* data){
+    uint64_t start = msg_trace_hook ? clock_now_ns() : 0;
     char message[MAX_MSG_LEN];
-    ssize_t received;
-    char *first, *second, *newline; 
+    RecvBuffer* pending = transport_recv_buffer(socket);
+    int len = 0;
+    char *newline;
 
-    // Ricevi i dati dal socket
-    received = recv(socket, message, MAX_MSG_LEN - 1, 0);
-    if(received < 0 ){
-        perror("Errore nella ricezione del messaggio");
+    // Senza buffer i byte oltre il primo messaggio andrebbero persi
+    if (pending == NULL) {
+        fprintf(stderr, "Errore nella ricezione del messaggio: buffer dell'handle %d non disponibile\n", socket);
         return -1;
     }
-    
-    // Termina la stringa ricevuta
-    message[received] = '\0';
-    
-    // printf("Ricevuto: %s", message); // DEBUG
 
-    // Parse del messaggio: cerca i delimitatori '|' e '\n'
-    
-    // Trova il primo '|' (separa TIPO da LUNGHEZZA)
-    first = strchr(message, '|');
-    if(!first){
-        return -1;
+    // Riparte dai byte avanzati dalla chiamata precedente
+    if (pending->len > 0) {
+        memcpy(message, pending->buf, pending->len);
+        len = pending->len;
+        pending->len = 0;
     }
+    message[len] = '\0';
 
-    // Trova il secondo '|' (separa LUNGHEZZA da DATI)
-    second = strchr(first + 1, '|');
-    if(!second){
-        return -1;
+    // Ricevi i dati dal socket finché non arriva un messaggio completo
+    while ((newline = memchr(message, '\n', len)) == NULL) {
+        if (len >= MAX_MSG_LEN - 1) {
+            // Riga più lunga del massimo consentito: il flusso non è più sincronizzato
+            return -1;
+        }
+        ssize_t received = transport_recv(socket, message + len, MAX_MSG_LEN - 1 - len);
+        if(received < 0 ){
+            perror("Errore nella ricezione del messaggio");
+            return -1;
+        }
+        if (received == 0) {
+            // Connessione chiusa dal peer
+            return -1;
+        }
+        len += received;
+        message[len] = '\0';
     }
 
-    // Trova il newline finale
-    newline = strchr(second, '\n');
-    if(!newline){
-        return -1;
-    }
+    // printf("Ricevuto: %s", message); // DEBUG
 
-    // Estrae il TIPO (prima del primo '|')
-    *first = '\0';
-    if (type != NULL) {
-        strncpy(type, message, MAX_MSG_LEN);
-        type[MAX_MSG_LEN - 1] = '\0';  // Assicura terminazione
+    // Conserva i byte dopo il '\n' per la prossima chiamata
+    int rest = len - (newline + 1 - message);
+    if (rest > 0) {
+        memcpy(pending->buf, newline + 1, rest);
+        pending->len = rest;
     }
-    
-    // Ignora la LUNGHEZZA (non rilevante per il parsing)
-    *second = '\0';
 
-    // Estrae i DATI (dopo il secondo '|', prima del '\n')
     *newline = '\0';
-
-    if (data != NULL) {
-        strncpy(data, second + 1, MAX_MSG_LEN);
-        data[MAX_MSG_LEN - 1] = '\0';  // Assicura terminazione
+    int result = parse_msg(message, type, data);
+    if (msg_trace_hook && result == 0) {
+        msg_trace_hook(0, type, start);
     }
-    
-    return 0;
+    return result;
 }
 
 /**
@@ -213,6 +287,6 @@ int recv_msg (int socket, char* type, char* data){
  */
 void clean_up_socket(int socket){
     if(socket >= 0){
-        close(socket);
+        transport_close(socket);
     }
 }
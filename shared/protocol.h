@@ -9,16 +9,24 @@
 #include <sys/wait.h>
 #include <arpa/inet.h>
 #include <signal.h>
+#include <stdint.h>
+#include <time.h>
 
 // costanti del protocollo
 #define MAX_NICKNAME_LEN 32
 #define MAX_MSG_LEN 1024
+#define MAX_TYPE_LEN 64 // Dimensione dei buffer per il tipo di messaggio (char type[64])
 #define MAX_THEMES 4
 #define MAX_THEME_LEN 32
 #define MAX_QUESTION_LEN 256
 #define MAX_ANSWER_LEN 128
-#define MAX_CLIENTS 20
+#ifndef MAX_CLIENTS
+#define MAX_CLIENTS 20      // Giocatori registrati contemporaneamente (la simulazione ne usa di più)
+#endif
 #define QUIZ_QUESTIONS 5
+#define QUESTION_TIME_SEC 20 // Tempo per rispondere a una domanda del quiz
+#define SESSION_TOKEN_LEN 32 // Token di ripresa della sessione: 16 byte casuali in esadecimale
+#define RANK_PUSH_ROWS 10    // Righe della classifica di un tema seguite dagli iscritti
 
 // Tipi di messaggio del protocollo
 #define MSG_NICK "NICK"
@@ -35,6 +43,18 @@
 #define MSG_END "END"
 #define MSG_OK "OK"
 #define MSG_ERROR "ERROR"
+#define MSG_RESUME "RESUME"  // Riconnessione: riprende la sessione identificata dal token
+#define MSG_ROOM "ROOM"                     // Ingresso nella stanza dal vivo di un tema
+#define MSG_ROOM_WAIT "ROOM_WAIT"           // Stato della stanza: partecipanti, inizio dell'evento
+#define MSG_ROOM_QUESTION "ROOM_QUESTION"   // Domanda posta a tutti i partecipanti
+#define MSG_ROOM_RESULT "ROOM_RESULT"       // Risposta corretta e risposte aggregate della stanza
+#define MSG_ROOM_END "ROOM_END"             // Fine dell'evento (o uscita): il client conferma con OK
+#define MSG_ROOM_LEAVE "ROOM_LEAVE"         // Uscita dalla stanza prima della fine dell'evento
+#define MSG_SUBSCRIBE "SUBSCRIBE"           // Iscrizione agli aggiornamenti delle classifiche dei temi indicati
+#define MSG_RANK "RANK"                     // Righe cambiate della classifica di un tema
+#define MSG_RANK_END "RANK_END"             // Fine degli aggiornamenti: il client conferma con OK
+#define MSG_UNSUBSCRIBE "UNSUBSCRIBE"       // Fine dell'iscrizione alle classifiche
+#define MSG_WAIT "WAIT"                     // Server pieno: posizione in coda e attesa stimata (s), poi OK o ERROR
 
 // Risposte del server
 #define RESP_CORRECT "CORRECT"
@@ -42,6 +62,8 @@
 #define RESP_NICK_TAKEN "NICK_TAKEN"
 #define RESP_INVALID_THEME "INVALID_THEME"
 #define RESP_QUIZ_COMPLETE "QUIZ_COMPLETE"
+#define RESP_RESUME_INVALID "RESUME_INVALID"
+#define RESP_TIMEOUT "TIMEOUT"      // Tempo scaduto: il client conferma con OK prima di chiedere la domanda successiva
 
 typedef struct{
     char question[MAX_QUESTION_LEN];
@@ -62,9 +84,14 @@ void trim_newline(char *str);
 int valid_nickname(const char *nickname);
 void clean_up_socket(int socket);
 int is_numeric(const char* str);
+int format_msg(char* buffer, size_t size, const char* type, const char* data);
+int parse_msg(char* line, char* type, char* data);
 int recv_msg(int socket, char* type, char* data);
 int send_msg(int socket, const char* type, char* data);
 
+typedef void (*MsgTraceHook)(int sending, const char* type, uint64_t start_ns);
+void set_msg_trace_hook(MsgTraceHook hook);
+
 
 
 #endif // PROTOCOL_H
\ No newline at end of file
@@ -0,0 +1,669 @@
+#include "transport.h"
+#include "clock.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/un.h>
+
+typedef struct {
+    const TransportOps* ops;    // NULL se l'handle è libero
+    void* ctx;
+    RecvBuffer pending;
+} TransportEntry;
+
+// Coda di uscita di un file descriptor (vedi transport_output_buffer)
+typedef struct {
+    int fd;
+    char* buf;              // NULL se la voce è libera
+    size_t len;             // Byte accodati, dall'inizio del buffer
+    size_t capacity;        // high_water + MAX_MSG_LEN: un messaggio entra sempre sotto la soglia alta
+    size_t high_water;
+    size_t low_water;
+    int timeout_ms;
+    int stalled;            // 1 se il peer non ha letto entro timeout_ms: la connessione è stata chiusa
+} OutQueue;
+
+static TransportEntry* transports[TRANSPORT_MAX_HANDLES];
+// Byte in attesa dei file descriptor: un buffer per descrittore, allocato al primo uso
+static RecvBuffer** fd_buffers = NULL;
+static int fd_buffers_size = 0;
+static OutQueue out_queues[TRANSPORT_FD_BUFFERS];
+static void (*wait_hook)(int handle) = NULL;
+
+static TransportEntry* transport_entry(int handle) {
+    if (handle < TRANSPORT_HANDLE_BASE || handle >= TRANSPORT_HANDLE_BASE + TRANSPORT_MAX_HANDLES) {
+        return NULL;
+    }
+    return transports[handle - TRANSPORT_HANDLE_BASE];
+}
+
+/**
+ * Registra un trasporto nel processo
+ * @param ops Le operazioni del trasporto (devono restare valide fino alla chiusura)
+ * @param ctx Il contesto passato alle operazioni
+ * @return L'handle assegnato, -1 se la tabella è piena
+ */
+int transport_register(const TransportOps* ops, void* ctx) {
+    for (int i = 0; i < TRANSPORT_MAX_HANDLES; i++) {
+        if (transports[i] == NULL) {
+            transports[i] = calloc(1, sizeof(TransportEntry));
+            if (transports[i] == NULL) {
+                return -1;
+            }
+            transports[i]->ops = ops;
+            transports[i]->ctx = ctx;
+            return TRANSPORT_HANDLE_BASE + i;
+        }
+    }
+    errno = EMFILE;
+    return -1;
+}
+
+// Libera la voce di un handle senza chiamare l'operazione di chiusura del trasporto
+static void transport_unregister(int handle) {
+    TransportEntry* entry = transport_entry(handle);
+    if (entry != NULL) {
+        free(entry);
+        transports[handle - TRANSPORT_HANDLE_BASE] = NULL;
+    }
+}
+
+// --- Code di uscita dei file descriptor ---
+
+static OutQueue* out_queue(int handle) {
+    for (int i = 0; i < TRANSPORT_FD_BUFFERS; i++) {
+        if (out_queues[i].buf != NULL && out_queues[i].fd == handle) {
+            return &out_queues[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Invia quanto il socket accetta dei byte in coda, senza attendere
+ * @return 0 se successo (anche parziale), -1 se la connessione è persa
+ */
+static int out_flush(OutQueue* queue) {
+    size_t sent = 0;
+    while (sent < queue->len) {
+        ssize_t n = send(queue->fd, queue->buf + sent, queue->len - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    memmove(queue->buf, queue->buf + sent, queue->len - sent);
+    queue->len -= sent;
+    return 0;
+}
+
+/**
+ * Attende che la coda scenda fino a target byte, inviando man mano che il socket accetta
+ * Un peer che non legge entro timeout_ms è un consumatore lento: la connessione viene chiusa
+ * (la recv successiva fallisce) e i byte in coda scartati
+ *
+ * @return 0 se successo, -1 se la connessione è persa o chiusa per lentezza
+ */
+static int out_drain(OutQueue* queue, size_t target) {
+    uint64_t deadline = clock_now_ns() / 1000000 + queue->timeout_ms;
+    while (1) {
+        if (out_flush(queue) < 0) {
+            return -1;
+        }
+        if (queue->len <= target) {
+            return 0;
+        }
+        uint64_t now = clock_now_ns() / 1000000;
+        struct pollfd pfd = { queue->fd, POLLOUT, 0 };
+        int ready = now < deadline ? poll(&pfd, 1, (int)(deadline - now)) : 0;
+        if (ready < 0 && errno != EINTR) {
+            return -1;
+        }
+        if (ready == 0) {
+            queue->stalled = 1;
+            queue->len = 0;
+            shutdown(queue->fd, SHUT_RDWR);
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+}
+
+/**
+ * Accoda byte in uscita e prova a inviarli senza attendere; oltre la soglia alta attende che
+ * il peer legga fino alla soglia bassa (backpressure sul solo chiamante)
+ * @return len se i byte sono stati inviati o accodati, -1 in caso di errore
+ */
+static ssize_t out_send(OutQueue* queue, const void* buf, size_t len) {
+    if (queue->stalled) {
+        errno = EPIPE;
+        return -1;
+    }
+    if (len > queue->capacity - queue->len) {
+        // Più grande della coda: si svuota e si invia in modo bloccante
+        if (out_drain(queue, 0) < 0) {
+            return -1;
+        }
+        if (len > queue->capacity) {
+            return send(queue->fd, buf, len, MSG_NOSIGNAL);
+        }
+    }
+
+    // Coda vuota: prima si prova l'invio diretto, in coda va solo ciò che il socket non accetta
+    size_t sent = 0;
+    if (queue->len == 0) {
+        ssize_t n = send(queue->fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return -1;
+        }
+        sent = n > 0 ? (size_t)n : 0;
+    }
+    memcpy(queue->buf + queue->len, (const char*)buf + sent, len - sent);
+    queue->len += len - sent;
+
+    if (queue->len > queue->high_water && out_drain(queue, queue->low_water) < 0) {
+        return -1;
+    }
+    return len;
+}
+
+/**
+ * Attiva la coda di uscita di un file descriptor: send_msg non si blocca più a ogni messaggio
+ * finché il peer non legge. I byte che il socket non accetta restano in coda e partono quando
+ * il socket torna scrivibile (transport_wait, transport_flush); oltre high_water il mittente
+ * attende fino a low_water e, se il peer non legge entro timeout_ms, la connessione viene chiusa.
+ * Per i trasporti registrati non ha effetto (il loopback ha già il proprio buffer).
+ *
+ * @param handle L'handle
+ * @param high_water Byte in coda oltre i quali il mittente attende
+ * @param low_water Byte in coda a cui l'attesa termina
+ * @param timeout_ms Attesa massima del peer
+ * @return 0 se attivata, -1 se l'handle non è un file descriptor o non ci sono voci libere
+ */
+int transport_output_buffer(int handle, size_t high_water, size_t low_water, int timeout_ms) {
+    if (transport_entry(handle) != NULL || handle >= TRANSPORT_HANDLE_BASE || out_queue(handle) != NULL) {
+        return -1;
+    }
+    for (int i = 0; i < TRANSPORT_FD_BUFFERS; i++) {
+        OutQueue* queue = &out_queues[i];
+        if (queue->buf == NULL) {
+            queue->buf = malloc(high_water + MAX_MSG_LEN);
+            if (queue->buf == NULL) {
+                return -1;
+            }
+            queue->fd = handle;
+            queue->len = 0;
+            queue->capacity = high_water + MAX_MSG_LEN;
+            queue->high_water = high_water;
+            queue->low_water = low_water < high_water ? low_water : high_water;
+            queue->timeout_ms = timeout_ms;
+            queue->stalled = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Invia tutti i byte in coda dell'handle, attendendo il peer al più per il timeout della coda
+ * (da chiamare prima di passare il socket a un altro processo)
+ *
+ * @param handle L'handle
+ * @return 0 se la coda è vuota, -1 se la connessione è persa o chiusa per lentezza
+ */
+int transport_flush(int handle) {
+    OutQueue* queue = out_queue(handle);
+    return queue != NULL ? out_drain(queue, 0) : 0;
+}
+
+/**
+ * Indica se la connessione è stata chiusa perché il peer non leggeva (vedi transport_output_buffer)
+ * @param handle L'handle
+ * @return 1 se chiusa per lentezza
+ */
+int transport_output_stalled(int handle) {
+    OutQueue* queue = out_queue(handle);
+    return queue != NULL && queue->stalled;
+}
+
+/**
+ * Invia byte sull'handle (send() per i file descriptor)
+ * @return Byte inviati, -1 in caso di errore
+ */
+ssize_t transport_send(int handle, const void* buf, size_t len) {
+    TransportEntry* entry = transport_entry(handle);
+    if (entry == NULL) {
+        OutQueue* queue = out_queue(handle);
+        return queue != NULL ? out_send(queue, buf, len) : send(handle, buf, len, 0);
+    }
+    return entry->ops->send(entry->ctx, buf, len);
+}
+
+/**
+ * Riceve byte dall'handle (recv() per i file descriptor)
+ * @return Byte ricevuti, 0 se il peer ha chiuso, -1 in caso di errore
+ */
+ssize_t transport_recv(int handle, void* buf, size_t len) {
+    TransportEntry* entry = transport_entry(handle);
+    if (entry == NULL) {
+        return recv(handle, buf, len, 0);
+    }
+    return entry->ops->recv(entry->ctx, buf, len);
+}
+
+/**
+ * Chiude l'handle e scarta i byte ricevuti in attesa
+ * @param handle L'handle da chiudere
+ */
+void transport_close(int handle) {
+    TransportEntry* entry = transport_entry(handle);
+    if (entry == NULL) {
+        if (handle >= 0 && handle < fd_buffers_size) {
+            free(fd_buffers[handle]);
+            fd_buffers[handle] = NULL;
+        }
+        OutQueue* queue = out_queue(handle);
+        if (queue != NULL) {
+            // Le ultime risposte partono prima della chiusura, se il peer legge
+            if (!queue->stalled) {
+                out_drain(queue, 0);
+            }
+            free(queue->buf);
+            queue->buf = NULL;
+        }
+        close(handle);
+        return;
+    }
+
+    if (entry->ops->close) {
+        entry->ops->close(entry->ctx);
+    }
+    transport_unregister(handle);
+}
+
+/**
+ * Attende che l'handle abbia byte da leggere, senza leggerli
+ * Senza limite di tempo, o con un messaggio completo già nel buffer dell'handle, non attende
+ * affatto: la recv successiva si blocca da sola. Se la coda di uscita non è vuota attende anche
+ * che il socket torni scrivibile e invia i byte in coda (restituisce 0: il chiamante riprova).
+ * Un trasporto registrato senza byte in arrivo cede il controllo una volta (wait hook)
+ * e restituisce 0: il chiamante ricontrolla le proprie scadenze e riprova.
+ *
+ * @param handle L'handle
+ * @param timeout_ms Attesa massima in ms, -1 senza limite
+ * @return 1 se una recv non attenderebbe, 0 se il tempo è scaduto (o l'attesa è stata
+ *         interrotta da un segnale), -1 in caso di errore
+ */
+int transport_wait(int handle, int timeout_ms) {
+    RecvBuffer* pending = transport_recv_buffer(handle);
+    OutQueue* queue = out_queue(handle);
+    int queued = queue != NULL && queue->len > 0;
+    if ((timeout_ms < 0 && !queued) || (pending != NULL && memchr(pending->buf, '\n', pending->len) != NULL)) {
+        return 1;
+    }
+
+    TransportEntry* entry = transport_entry(handle);
+    if (entry == NULL) {
+        // Con byte in coda in uscita si attende anche la scrittura: il peer non invia la
+        // richiesta successiva finché non ha ricevuto la risposta
+        struct pollfd pfd = { handle, POLLIN | (queued ? POLLOUT : 0), 0 };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        if ((pfd.revents & POLLOUT) && out_flush(queue) < 0) {
+            return 1;
+        }
+        return (pfd.revents & ~POLLOUT) != 0;
+    }
+
+    if (entry->ops->readable == NULL || entry->ops->readable(entry->ctx)) {
+        return 1;
+    }
+    if (timeout_ms > 0 && wait_hook != NULL) {
+        wait_hook(handle);
+    }
+    return entry->ops->readable(entry->ctx);
+}
+
+/**
+ * Legge senza attendere i byte già arrivati sull'handle e li accoda nel suo buffer (vedi
+ * recv_msg), così chi attende un messaggio può limitare anche il tempo di un messaggio iniziato
+ * e non ancora completo
+ *
+ * @param handle L'handle
+ * @return 1 se recv_msg non attenderebbe (messaggio completo nel buffer, peer chiuso, errore o
+ *         riga troppo lunga), 0 se il messaggio non è ancora completo
+ */
+int transport_fill(int handle) {
+    RecvBuffer* pending = transport_recv_buffer(handle);
+    if (pending == NULL) {
+        return 1;
+    }
+
+    while (memchr(pending->buf, '\n', pending->len) == NULL) {
+        size_t room = MAX_MSG_LEN - 1 - pending->len;
+        if (room == 0) {
+            return 1;
+        }
+
+        ssize_t received;
+        TransportEntry* entry = transport_entry(handle);
+        if (entry == NULL) {
+            received = recv(handle, pending->buf + pending->len, room, MSG_DONTWAIT);
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                return 0;
+            }
+        } else {
+            if (entry->ops->readable != NULL && !entry->ops->readable(entry->ctx)) {
+                return 0;
+            }
+            received = entry->ops->recv(entry->ctx, pending->buf + pending->len, room);
+        }
+        if (received <= 0) {
+            return 1;
+        }
+        pending->len += received;
+    }
+    return 1;
+}
+
+/**
+ * Restituisce il buffer dei byte in attesa dell'handle
+ * Per i trasporti registrati è nella voce dell'handle; ogni file descriptor ha il proprio,
+ * allocato al primo uso e liberato da transport_close
+ *
+ * @param handle L'handle
+ * @return Il buffer, NULL se la memoria non è sufficiente
+ */
+RecvBuffer* transport_recv_buffer(int handle) {
+    TransportEntry* entry = transport_entry(handle);
+    if (entry != NULL) {
+        return &entry->pending;
+    }
+    if (handle < 0 || handle >= TRANSPORT_HANDLE_BASE) {
+        return NULL;
+    }
+
+    if (handle >= fd_buffers_size) {
+        int size = fd_buffers_size > 0 ? fd_buffers_size : 16;
+        while (size <= handle) {
+            size *= 2;
+        }
+        RecvBuffer** buffers = realloc(fd_buffers, size * sizeof(RecvBuffer*));
+        if (buffers == NULL) {
+            return NULL;
+        }
+        memset(buffers + fd_buffers_size, 0, (size - fd_buffers_size) * sizeof(RecvBuffer*));
+        fd_buffers = buffers;
+        fd_buffers_size = size;
+    }
+    if (fd_buffers[handle] == NULL) {
+        fd_buffers[handle] = calloc(1, sizeof(RecvBuffer));
+    }
+    return fd_buffers[handle];
+}
+
+// --- Socket Unix ---
+
+static int unix_address(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/**
+ * Crea un socket Unix in ascolto su path (un file socket esistente viene sostituito)
+ * @param path Il percorso del socket
+ * @param backlog La coda delle connessioni in attesa
+ * @return Il file descriptor del socket, -1 in caso di errore
+ */
+int transport_unix_listen(const char* path, int backlog) {
+    struct sockaddr_un addr;
+    if (unix_address(path, &addr) < 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Si connette a un socket Unix
+ * @param path Il percorso del socket
+ * @return Il file descriptor connesso, -1 in caso di errore
+ */
+int transport_unix_connect(const char* path) {
+    struct sockaddr_un addr;
+    if (unix_address(path, &addr) < 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Passa un file descriptor a un altro processo attraverso un socket Unix (SCM_RIGHTS)
+ * Il descrittore resta aperto anche nel processo che lo invia
+ *
+ * @param sock Il socket Unix connesso
+ * @param fd Il file descriptor da passare
+ * @param data I byte inviati insieme al descrittore (almeno uno)
+ * @param len Il numero di byte
+ * @return 0 se successo, -1 in caso di errore
+ */
+int transport_send_fd(int sock, int fd, const void* data, size_t len) {
+    struct iovec iov = { (void*)data, len };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(sock, &msg, 0) == (ssize_t)len ? 0 : -1;
+}
+
+/**
+ * Riceve un file descriptor passato con transport_send_fd
+ * @param sock Il socket Unix connesso
+ * @param fd Output: il descrittore ricevuto, -1 se il messaggio non ne conteneva
+ * @param data Output: i byte inviati insieme al descrittore
+ * @param size La dimensione di data
+ * @return Byte ricevuti, 0 se il peer ha chiuso, -1 in caso di errore
+ */
+ssize_t transport_recv_fd(int sock, int* fd, void* data, size_t size) {
+    struct iovec iov = { data, size };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    *fd = -1;
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n <= 0) {
+        return n;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return n;
+}
+
+// --- Loopback in memoria ---
+
+// Una direzione del loopback: buffer circolare con indici liberi di crescere (modulo 2^32)
+typedef struct {
+    char data[LOOPBACK_RING_SIZE];
+    unsigned head;      // Prossimo byte da leggere
+    unsigned tail;      // Prossimo byte da scrivere
+    int writer_closed;
+    int reader_closed;
+} LoopbackRing;
+
+typedef struct {
+    int handle;
+    LoopbackRing* rx;
+    LoopbackRing* tx;
+} LoopbackEnd;
+
+static ssize_t loopback_send(void* ctx, const void* buf, size_t len) {
+    LoopbackEnd* end = ctx;
+    LoopbackRing* ring = end->tx;
+
+    while (1) {
+        if (ring->reader_closed) {
+            errno = EPIPE;
+            return -1;
+        }
+        unsigned space = LOOPBACK_RING_SIZE - (ring->tail - ring->head);
+        if (space > 0) {
+            size_t n = len < space ? len : space;
+            for (size_t i = 0; i < n; i++) {
+                ring->data[(ring->tail + i) & (LOOPBACK_RING_SIZE - 1)] = ((const char*)buf)[i];
+            }
+            ring->tail += n;
+            return n;
+        }
+        if (wait_hook == NULL) {
+            errno = EAGAIN;
+            return -1;
+        }
+        wait_hook(end->handle);
+    }
+}
+
+static ssize_t loopback_recv(void* ctx, void* buf, size_t len) {
+    LoopbackEnd* end = ctx;
+    LoopbackRing* ring = end->rx;
+
+    while (1) {
+        unsigned available = ring->tail - ring->head;
+        if (available > 0) {
+            size_t n = len < available ? len : available;
+            for (size_t i = 0; i < n; i++) {
+                ((char*)buf)[i] = ring->data[(ring->head + i) & (LOOPBACK_RING_SIZE - 1)];
+            }
+            ring->head += n;
+            return n;
+        }
+        if (ring->writer_closed) {
+            return 0;
+        }
+        if (wait_hook == NULL) {
+            errno = EAGAIN;
+            return -1;
+        }
+        wait_hook(end->handle);
+    }
+}
+
+static void loopback_close(void* ctx) {
+    LoopbackEnd* end = ctx;
+    end->tx->writer_closed = 1;
+    end->rx->reader_closed = 1;
+
+    // Ogni buffer è liberato dall'ultimo dei due estremi che lo abbandona
+    if (end->rx->writer_closed) {
+        free(end->rx);
+    }
+    if (end->tx->reader_closed) {
+        free(end->tx);
+    }
+    free(end);
+}
+
+static int loopback_readable(void* ctx) {
+    LoopbackEnd* end = ctx;
+    return end->rx->tail != end->rx->head || end->rx->writer_closed;
+}
+
+static const TransportOps loopback_ops = {
+    "loopback", loopback_send, loopback_recv, loopback_close, loopback_readable
+};
+
+/**
+ * Crea una coppia di handle collegati in memoria: ciò che si scrive su uno si legge dall'altro
+ * @param handles Output: i due handle
+ * @return 0 se successo, -1 in caso di errore
+ */
+int transport_loopback_pair(int handles[2]) {
+    LoopbackRing* a = calloc(1, sizeof(LoopbackRing));
+    LoopbackRing* b = calloc(1, sizeof(LoopbackRing));
+    LoopbackEnd* first = calloc(1, sizeof(LoopbackEnd));
+    LoopbackEnd* second = calloc(1, sizeof(LoopbackEnd));
+    if (!a || !b || !first || !second) {
+        free(a); free(b); free(first); free(second);
+        return -1;
+    }
+
+    first->rx = a;
+    first->tx = b;
+    second->rx = b;
+    second->tx = a;
+
+    handles[0] = first->handle = transport_register(&loopback_ops, first);
+    handles[1] = second->handle = transport_register(&loopback_ops, second);
+    if (handles[0] < 0 || handles[1] < 0) {
+        transport_unregister(handles[0]);
+        transport_unregister(handles[1]);
+        free(a); free(b); free(first); free(second);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Imposta la funzione chiamata quando un loopback deve attendere
+ * @param hook La funzione (NULL per far fallire le operazioni con EAGAIN)
+ */
+void transport_set_wait_hook(void (*hook)(int handle)) {
+    wait_hook = hook;
+}
@@ -0,0 +1,63 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "protocol.h"
+
+/*
+ * Trasporto dei messaggi del protocollo
+ * send_msg/recv_msg non usano direttamente send()/recv(): passano da un handle intero.
+ * - un handle sotto TRANSPORT_HANDLE_BASE è un file descriptor (socket TCP o Unix)
+ * - gli handle da TRANSPORT_HANDLE_BASE in su sono trasporti registrati nel processo,
+ *   come il loopback in memoria usato per simulare migliaia di sessioni senza socket né fork
+ */
+
+#define TRANSPORT_HANDLE_BASE 0x100000  // Primo handle registrato (oltre qualunque file descriptor)
+#define TRANSPORT_MAX_HANDLES 8192      // Trasporti registrati contemporaneamente
+#define TRANSPORT_FD_BUFFERS 8          // File descriptor con coda di uscita (vedi transport_output_buffer)
+#define LOOPBACK_RING_SIZE 8192         // Capacità di ogni direzione del loopback (potenza di 2)
+
+// Operazioni di un trasporto registrato; ctx è il contesto passato a transport_register
+typedef struct {
+    const char* name;
+    ssize_t (*send)(void* ctx, const void* buf, size_t len);
+    ssize_t (*recv)(void* ctx, void* buf, size_t len);
+    void (*close)(void* ctx);
+    int (*readable)(void* ctx);     // 1 se una recv non dovrebbe attendere (byte in arrivo o peer chiuso)
+} TransportOps;
+
+// Byte ricevuti oltre la fine di un messaggio, conservati per la recv_msg successiva
+typedef struct {
+    int len;
+    char buf[MAX_MSG_LEN];
+} RecvBuffer;
+
+int transport_register(const TransportOps* ops, void* ctx);
+ssize_t transport_send(int handle, const void* buf, size_t len);
+ssize_t transport_recv(int handle, void* buf, size_t len);
+void transport_close(int handle);
+int transport_wait(int handle, int timeout_ms);
+int transport_fill(int handle);
+RecvBuffer* transport_recv_buffer(int handle);
+
+// Coda di uscita con soglie alta e bassa per i file descriptor
+int transport_output_buffer(int handle, size_t high_water, size_t low_water, int timeout_ms);
+int transport_flush(int handle);
+int transport_output_stalled(int handle);
+
+// Socket Unix (i file descriptor usano le stesse operazioni dei socket TCP)
+int transport_unix_listen(const char* path, int backlog);
+int transport_unix_connect(const char* path);
+int transport_send_fd(int sock, int fd, const void* data, size_t len);
+ssize_t transport_recv_fd(int sock, int* fd, void* data, size_t size);
+
+// Loopback in memoria: due handle collegati da una coppia di buffer circolari
+int transport_loopback_pair(int handles[2]);
+
+// Chiamata quando un loopback non può avanzare (buffer vuoto in lettura o pieno in scrittura):
+// chi simula più sessioni in un solo thread la usa per passare a un'altra sessione.
+// Senza hook le operazioni falliscono con EAGAIN.
+void transport_set_wait_hook(void (*hook)(int handle));
+
+#endif // TRANSPORT_H
@@ -0,0 +1,146 @@
+#include "../server/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * logdump: decodifica offline i file di log binari del server
+ * Uso: logdump_bin [-j] file.blog
+ *   senza opzioni stampa una riga di testo per record, con -j una riga JSON per record
+ */
+
+static const char* level_name(uint8_t level) {
+    switch (level) {
+        case LOG_INFO:
+            return "INFO";
+        case LOG_WARNING:
+            return "WARNING";
+        case LOG_ERROR:
+            return "ERROR";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+/**
+ * Stampa una stringa come valore JSON, applicando gli escape necessari
+ * @param str La stringa da stampare
+ */
+static void print_json_string(const char* str) {
+    putchar('"');
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+/**
+ * Stampa un record in formato testo, con lo stesso aspetto del log testuale
+ * @param rec Il record da stampare
+ */
+static void print_text(const BinLogRecord* rec) {
+    time_t sec = (time_t)(rec->timestamp_ns / 1000000000ULL);
+    struct tm* t = localtime(&sec);
+    char timestamp[64];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", t);
+
+    printf("[%s.%06llu] [%s] [sessione %u] ", timestamp,
+           (unsigned long long)(rec->timestamp_ns % 1000000000ULL) / 1000, level_name(rec->level), rec->session_id);
+
+    if (rec->event_id >= LOG_EVENT_COUNT) {
+        printf("evento sconosciuto %u\n", rec->event_id);
+        return;
+    }
+    printf(log_event_info[rec->event_id].format, rec->str,
+           (long long)rec->args[0], (long long)rec->args[1], (long long)rec->args[2], (long long)rec->args[3]);
+    putchar('\n');
+}
+
+/**
+ * Stampa un record come oggetto JSON su una riga, con gli argomenti nominati
+ * @param rec Il record da stampare
+ */
+static void print_json(const BinLogRecord* rec) {
+    printf("{\"ts_ns\":%llu,\"level\":\"%s\",\"session\":%u,",
+           (unsigned long long)rec->timestamp_ns, level_name(rec->level), rec->session_id);
+
+    if (rec->event_id >= LOG_EVENT_COUNT) {
+        printf("\"event_id\":%u}\n", rec->event_id);
+        return;
+    }
+
+    printf("\"event\":\"%s\",\"str\":", log_event_info[rec->event_id].name);
+    print_json_string(rec->str);
+
+    // Gli argomenti prendono il nome dalla tabella degli eventi
+    char names[128];
+    strncpy(names, log_event_info[rec->event_id].arg_names, sizeof(names) - 1);
+    names[sizeof(names) - 1] = '\0';
+
+    printf(",\"args\":{");
+    char* saveptr = NULL;
+    char* name = strtok_r(names, ",", &saveptr);
+    for (int i = 0; name != NULL && i < rec->argc && i < BINLOG_MAX_ARGS; i++) {
+        printf("%s\"%s\":%lld", i > 0 ? "," : "", name, (long long)rec->args[i]);
+        name = strtok_r(NULL, ",", &saveptr);
+    }
+    printf("}}\n");
+}
+
+int main(int argc, char* argv[]) {
+    int json = 0;
+    const char* path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0) {
+            json = 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == NULL) {
+        fprintf(stderr, "Uso: %s [-j] file.blog\n", argv[0]);
+        return 1;
+    }
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror("Errore apertura file");
+        return 1;
+    }
+
+    BinLogHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, BINLOG_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s non è un log binario del server\n", path);
+        fclose(fp);
+        return 1;
+    }
+    if (header.version != BINLOG_VERSION || header.record_size != sizeof(BinLogRecord)) {
+        fprintf(stderr, "Versione del log non supportata (versione %u, record da %u byte)\n",
+                header.version, header.record_size);
+        fclose(fp);
+        return 1;
+    }
+
+    BinLogRecord rec;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        if (json) {
+            print_json(&rec);
+        } else {
+            print_text(&rec);
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "../server/admin.h"
+#include "../shared/protocol.h"
+#include "../shared/transport.h"
+#include <ctype.h>
+#include <errno.h>
+
+/*
+ * quizctl: invia un comando al canale di amministrazione del server e ne stampa la risposta
+ * Uso: quizctl_bin [-s percorso] comando [argomento]
+ *   es. quizctl_bin sessions, quizctl_bin kick mario, quizctl_bin loglevel warning
+ * Esce con 0 se il comando è riuscito, 1 altrimenti
+ */
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [-s percorso] comando [argomento]\n", prog);
+    fprintf(stderr, "  -s  socket del canale di amministrazione (default %s)\n", ADMIN_SOCKET_PATH);
+    fprintf(stderr, "Comandi: sessions, kick <nickname>, drain, reload, metrics, loglevel [livello],\n");
+    fprintf(stderr, "         locks, trace <nickname>, processes, help\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = ADMIN_SOCKET_PATH;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || argc - optind > 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Il comando viaggia come tipo del messaggio, l'argomento come dati
+    char command[MAX_TYPE_LEN];
+    snprintf(command, sizeof(command), "%s", argv[optind]);
+    for (char* p = command; *p; p++) {
+        *p = toupper((unsigned char)*p);
+    }
+    char argument[MAX_MSG_LEN] = "";
+    if (optind + 1 < argc) {
+        snprintf(argument, sizeof(argument), "%s", argv[optind + 1]);
+    }
+
+    int fd = transport_unix_connect(path);
+    if (fd < 0) {
+        fprintf(stderr, "Impossibile connettersi a %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    if (send_msg(fd, command, argument) < 0) {
+        clean_up_socket(fd);
+        return 1;
+    }
+
+    char type[MAX_TYPE_LEN], data[MAX_MSG_LEN];
+    int status = 1;
+    while (recv_msg(fd, type, data) == 0) {
+        if (strcmp(type, ADMIN_REPLY_LINE) == 0) {
+            printf("%s\n", data);
+        } else if (strcmp(type, MSG_END) == 0) {
+            status = 0;
+            break;
+        } else if (strcmp(type, MSG_ERROR) == 0) {
+            fprintf(stderr, "Errore: %s\n", data);
+            break;
+        }
+    }
+
+    clean_up_socket(fd);
+    return status;
+}